@@ -33,37 +33,40 @@ let POS1=POS_IN_TILE+1
 
 echo "Extracting info for read $LANE:$TILE:$POS_IN_TILE"
 
+# One line per fragment: global start position, length, zero-based tile number
+FragmentsDump=`mktemp`
+trap "rm -f $FragmentsDump" EXIT
+${abspath}/dumpFragments.pl > $FragmentsDump || exit 1
+
 if [ $LANE -ne 0 ]; then
   let TILENUM=32*\(LANE-1\)+16*\(TILE/1000%10\)-16+8*\(TILE/100%10\)-8+\(TILE%10\)-1
   HexTileNum=`printf "%02X" $TILENUM`
   echo "Zero-based sequential tile num: $TILENUM, 0x$HexTileNum"
 
   #tilenum("lane4 tile62")=3*32+6*4+2-1=121=0x79
-  let FragmentNum=`hexdump -v -e '1/2 "%02X\n"' fragments.tile |grep -n $HexTileNum -m $POS1 |tail -1|cut -f 1 -d ':'`
+  let FragmentNum=`awk -v TILE=$TILENUM -v N=$POS1 '$3 == TILE && ++count == N { print NR; exit }' $FragmentsDump`
 
 else
 
   let FragmentNum=${POS_IN_TILE}+1
 
   # Find in which tile and tile position this fragment got allocated
-  let BytesToSkip=2*POS_IN_TILE
-  FullTileNum=`hexdump -v -e '1/2 "%d\n"' fragments.tile -s $BytesToSkip -n 2`
-  FullTileHexNum=`hexdump -v -e '1/2 "%02X\n"' fragments.tile -s $BytesToSkip -n 2`
+  FullTileNum=`awk -v N=$FragmentNum 'NR == N { print $3; exit }' $FragmentsDump`
+  FullTileHexNum=`printf "%02X" $FullTileNum`
   let LANE=1+FullTileNum/32
   let TILENUM=1+FullTileNum%32
   TILE=`ls RunFolder/Data/Intensities/BaseCalls/s_1_*.filter | sed 's/.*_0*//' | sed 's/.filter//'|tail -n +$TILENUM |head -1`
 echo "LANE=$LANE, TILE=$TILE (TileNum=$TILENUM, FullTileNum=$FullTileNum=0x$FullTileHexNum)"
-  POS_IN_TILE=`hexdump -v -e '1/2 "%02X\n"' fragments.tile -n $BytesToSkip | grep -c $FullTileHexNum`
+  POS_IN_TILE=`awk -v TILE=$FullTileNum -v N=$POS_IN_TILE 'NR > N { exit } $3 == TILE { ++count } END { print count+0 }' $FragmentsDump`
   echo "PosInTile=$POS_IN_TILE"
   echo " => $LANE:$TILE:$POS_IN_TILE"
 fi
 echo "FragmentNum: $FragmentNum"
 
-let posInFile=2*$FragmentNum-2
-let FragmentLength=`hexdump -v -e '1/2 "%d\n"' -s $posInFile fragments.length -n 2`
+let FragmentLength=`awk -v N=$FragmentNum 'NR == N { print $2; exit }' $FragmentsDump`
 echo "FragmentLength: $FragmentLength"
 
-let GlobalPos=`hexdump -v -e '1/2 "%d\n"' fragments.pos|head -$FragmentNum| awk '{ if ($1 == 65536) { print "Error: extended 0xffff fragments.pos value not supported in this tool"; exit 1 } ; SUM += $1 } END { print SUM }'`
+let GlobalPos=`awk -v N=$FragmentNum 'NR == N { print $1; exit }' $FragmentsDump`
 echo "GlobalPos: $GlobalPos"
 
 echo -n "Left-most read should start at: "
@@ -0,0 +1,273 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Minimal microbenchmark harness: registration, timing and throughput reporting
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/Logger.hh"
+#include "model/Fragment.hh"
+#include "Benchmark.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace benchmark
+{
+
+
+vector<BenchmarkRegistry::Entry>& BenchmarkRegistry::entries()
+{
+    // Function-local static, so that registrations from any translation unit find it constructed
+    static vector<Entry> entries;
+    return entries;
+}
+
+void BenchmarkRegistry::add( const string& name, const string& itemName, Factory create )
+{
+    // Sorted by name, so that the report doesn't depend on the link order
+    Entry entry = { name, itemName, create };
+    vector<Entry>::iterator it = entries().begin();
+    while (it != entries().end() && it->name < name)
+    {
+        ++it;
+    }
+    entries().insert( it, entry );
+}
+
+
+namespace
+{
+
+// The code under test logs its progress and warnings, which would otherwise end up in the timings.
+// Errors are still reported, as they are thrown as exceptions
+class NullBuffer : public std::streambuf
+{
+protected:
+    virtual int overflow( int c ) { return c; }
+};
+
+class LogSilencer
+{
+public:
+    LogSilencer()
+        : previousClog_( clog.rdbuf( &nullBuffer_ ) )
+        , previousCerr_( cerr.rdbuf( &nullBuffer_ ) )
+    {}
+    ~LogSilencer()
+    {
+        clog.rdbuf( previousClog_ );
+        cerr.rdbuf( previousCerr_ );
+    }
+private:
+    NullBuffer nullBuffer_;
+    streambuf *previousClog_;
+    streambuf *previousCerr_;
+};
+
+double secondsSince( const boost::posix_time::ptime& start )
+{
+    return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+}
+
+} // anonymous namespace
+
+
+BenchmarkRunner::BenchmarkRunner( const BenchmarkContext& context, const double minSeconds, const unsigned int minIterations )
+    : context_( context )
+    , minSeconds_( minSeconds )
+    , minIterations_( minIterations )
+{
+}
+
+unsigned int BenchmarkRunner::run( const string& filter )
+{
+    cout << (boost::format("%-44s %10s %11s %16s %10s") % "benchmark" % "iterations" % "ms/iter" % "items/s" % "MB/s").str() << endl;
+
+    unsigned int benchmarkCount = 0;
+    BOOST_FOREACH( const BenchmarkRegistry::Entry& entry, BenchmarkRegistry::entries() )
+    {
+        if (filter.empty() || entry.name.find( filter ) != string::npos)
+        {
+            runOne( entry );
+            ++benchmarkCount;
+        }
+    }
+    return benchmarkCount;
+}
+
+void BenchmarkRunner::runOne( const BenchmarkRegistry::Entry& entry )
+{
+    boost::scoped_ptr<Benchmark> benchmark( entry.create() );
+    Throughput perIteration;
+    unsigned int iterations = 0;
+    double elapsed = 0;
+    {
+        LogSilencer silencer;
+        benchmark->setUp( context_ );
+
+        // Warm-up iteration, also giving the work done per iteration
+        perIteration = benchmark->run();
+        if (perIteration.items == 0)
+        {
+            EAGLE_ERROR( "Benchmark " + entry.name + " did not process anything" );
+        }
+
+        const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        do
+        {
+            benchmark->run();
+            ++iterations;
+            elapsed = secondsSince( start );
+        } while (iterations < minIterations_ || elapsed < minSeconds_);
+    }
+
+    const double itemsPerSecond = perIteration.items * iterations / elapsed;
+    const double megabytesPerSecond = perIteration.bytes * iterations / elapsed / (1024.0*1024.0);
+    cout << (boost::format("%-44s %10d %11.3f %16.0f %10s  (%s)")
+             % entry.name
+             % iterations
+             % (elapsed * 1000 / iterations)
+             % itemsPerSecond
+             % (perIteration.bytes ? (boost::format("%.1f") % megabytesPerSecond).str() : "-")
+             % entry.itemName
+        ).str() << endl;
+}
+
+
+namespace synthetic
+{
+
+string randomBases( const unsigned long length, const unsigned int seed )
+{
+    static const char bases[] = "ACGT";
+    boost::mt19937 randomGen( seed );
+    string result;
+    result.reserve( length );
+    while (result.size() < length)
+    {
+        const unsigned int r = randomGen();
+        switch (r % 64)
+        {
+        case 0: // homopolymer
+            result.append( 4 + (r >> 8) % 8, bases[(r >> 4) & 3] );
+            break;
+        case 1: // short tandem repeat
+            {
+                const string motif = result.substr( result.size() - min<size_t>( result.size(), 2 + (r >> 4) % 3 ) );
+                for (unsigned int i = 3 + (r >> 8) % 4; i > 0; --i)
+                {
+                    result += motif;
+                }
+            }
+            break;
+        default:
+            result += bases[(r >> 8) & 3];
+        }
+    }
+    result.resize( length );
+    return result;
+}
+
+vector<boost::filesystem::path> writeGenome( const boost::filesystem::path& dir, const unsigned int contigCount, const unsigned long contigLength, const unsigned int seed )
+{
+    const unsigned int basesPerLine = 60;
+    boost::filesystem::create_directories( dir );
+    vector<boost::filesystem::path> files;
+    // genome_size.xml and the .fai indexes make the directory usable as a sample genome, as generated by applyVariants
+    ofstream genomeSizeXml( (dir / "genome_size.xml").string().c_str() );
+    genomeSizeXml << "<sequenceSizes>\n";
+    for (unsigned int contigNum = 1; contigNum <= contigCount; ++contigNum)
+    {
+        const string contigName = (boost::format("chr%d") % contigNum).str();
+        const boost::filesystem::path filename = dir / (contigName + ".fa");
+        const string bases = randomBases( contigLength, seed + contigNum );
+
+        ofstream out( filename.string().c_str() );
+        out << '>' << contigName << '\n';
+        for (unsigned long pos = 0; pos < bases.size(); pos += basesPerLine)
+        {
+            out.write( bases.data() + pos, min<unsigned long>( basesPerLine, bases.size() - pos ) );
+            out << '\n';
+        }
+        if (!out.good())
+        {
+            EAGLE_ERROR( "Failed to write " + filename.string() );
+        }
+        files.push_back( filename );
+
+        ofstream fai( (filename.string() + ".fai").c_str() );
+        fai << (boost::format("%s\t%d\t%d\t%d\t%d\n") % contigName % contigLength % (contigName.size() + 2) % basesPerLine % (basesPerLine + 1)).str();
+        genomeSizeXml << (boost::format("\t<chromosome fileName=\"%s\" contigName=\"%s\" totalBases=\"%d\"/>\n") % filename.filename().string() % contigName % contigLength).str();
+    }
+    genomeSizeXml << "</sequenceSizes>\n";
+    return files;
+}
+
+void writeFragments( const boost::filesystem::path& dir, const unsigned long genomeLength, const unsigned long fragmentCount, const unsigned int tileCount, const unsigned int seed, const bool blockFormat )
+{
+    boost::filesystem::create_directories( dir );
+    if (blockFormat)
+    {
+        boost::filesystem::path legacyDir = dir / "legacy";
+        writeFragments( legacyDir, genomeLength, fragmentCount, tileCount, seed );
+        eagle::model::FragmentList legacyFragments( legacyDir );
+        eagle::model::FragmentBlockWriter blockWriter( dir/"fragments.blocks", tileCount );
+        for (eagle::model::FragmentWithAllocationMetadata f = legacyFragments.getNextWithTile( 0, 0 ); f.isValid(); f = legacyFragments.getNextWithTile( 0, 0 ))
+        {
+            blockWriter.add( f );
+        }
+        blockWriter.close();
+        boost::filesystem::remove_all( legacyDir );
+        return;
+    }
+    ofstream posFile   ( (dir/"fragments.pos"   ).string().c_str(), ios::binary );
+    ofstream lengthFile( (dir/"fragments.length").string().c_str(), ios::binary );
+    ofstream tileFile  ( (dir/"fragments.tile"  ).string().c_str(), ios::binary );
+
+    // Same 2-byte records as FragmentsAllocator writes, with a mean spacing giving fragmentCount fragments
+    boost::mt19937 randomGen( seed );
+    const unsigned long maxPosDiff = 2 * genomeLength / fragmentCount;
+    const unsigned long maxStartPos = genomeLength - 1000;
+    unsigned long pos = 0;
+    for (unsigned long i = 0; i < fragmentCount; ++i)
+    {
+        unsigned short posDiff = static_cast<unsigned short>( min<unsigned long>( randomGen() % (maxPosDiff + 1), 65534 ) );
+        if (pos + posDiff > maxStartPos)
+        {
+            posDiff = 0;
+        }
+        pos += posDiff;
+        const unsigned short length = 300 + randomGen() % 200;
+        const unsigned short tile = randomGen() % tileCount;
+        posFile.write( reinterpret_cast<const char*>( &posDiff ), 2 );
+        lengthFile.write( reinterpret_cast<const char*>( &length ), 2 );
+        tileFile.write( reinterpret_cast<const char*>( &tile ), 2 );
+    }
+    if (!posFile.good() || !lengthFile.good() || !tileFile.good())
+    {
+        EAGLE_ERROR( "Failed to write fragments in " + dir.string() );
+    }
+}
+
+} // namespace synthetic
+
+
+} // namespace benchmark
+} // namespace eagle
@@ -0,0 +1,140 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Minimal microbenchmark harness: registration, timing and throughput reporting
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_BENCHMARK_BENCHMARK_HH
+#define EAGLE_BENCHMARK_BENCHMARK_HH
+
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+
+namespace eagle
+{
+namespace benchmark
+{
+
+
+/**
+ ** \brief Inputs shared by all the benchmarks
+ **
+ ** Model tables come from the EAGLE data directory; everything else (genomes, fragments, BAM, VCF)
+ ** is generated by the benchmarks themselves under workDir, from a fixed seed.
+ **/
+struct BenchmarkContext
+{
+    boost::filesystem::path dataDir;
+    boost::filesystem::path workDir;
+    unsigned int seed;
+};
+
+
+/**
+ ** \brief Amount of work done by one iteration of a benchmark
+ **
+ ** bytes may be 0 for benchmarks where a byte throughput is meaningless.
+ **/
+struct Throughput
+{
+    Throughput( const unsigned long items_ = 0, const unsigned long bytes_ = 0 ) : items( items_ ), bytes( bytes_ ) {}
+    unsigned long items;
+    unsigned long bytes;
+};
+
+
+class Benchmark : boost::noncopyable
+{
+public:
+    virtual ~Benchmark() {}
+
+    // Untimed: load models and generate the synthetic inputs
+    virtual void setUp( const BenchmarkContext& context ) = 0;
+
+    // Timed: processes the whole input once. Must give the same result at every call
+    virtual Throughput run() = 0;
+};
+
+
+/**
+ ** \brief List of benchmarks, filled by the static EAGLE_BENCHMARK_REGISTRATION objects
+ **/
+class BenchmarkRegistry
+{
+public:
+    typedef Benchmark* (*Factory)();
+    struct Entry
+    {
+        std::string name;
+        std::string itemName;
+        Factory create;
+    };
+
+    static std::vector<Entry>& entries();
+    static void add( const std::string& name, const std::string& itemName, Factory create );
+};
+
+template<class T>
+class BenchmarkRegistration
+{
+public:
+    BenchmarkRegistration( const std::string& name, const std::string& itemName )
+    {
+        BenchmarkRegistry::add( name, itemName, &create );
+    }
+private:
+    static Benchmark* create() { return new T; }
+};
+
+#define EAGLE_BENCHMARK_REGISTRATION( BenchmarkClass, name, itemName ) \
+    static eagle::benchmark::BenchmarkRegistration< BenchmarkClass > BenchmarkClass##Registration( name, itemName )
+
+
+/**
+ ** \brief Runs each selected benchmark for at least minSeconds and prints items/s and MB/s
+ **/
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner( const BenchmarkContext& context, const double minSeconds, const unsigned int minIterations );
+
+    // Returns the number of benchmarks run
+    unsigned int run( const std::string& filter );
+
+private:
+    void runOne( const BenchmarkRegistry::Entry& entry );
+
+    const BenchmarkContext& context_;
+    const double minSeconds_;
+    const unsigned int minIterations_;
+};
+
+
+// Helpers to generate the synthetic inputs
+namespace synthetic
+{
+
+// Writes contigCount FASTA files chr<N>.fa of contigLength random bases each. Returns the generated file names
+std::vector<boost::filesystem::path> writeGenome( const boost::filesystem::path& dir, const unsigned int contigCount, const unsigned long contigLength, const unsigned int seed );
+
+// Writes fragments.{pos,length,tile} (or fragments.blocks) for fragmentCount fragments spread over a genome of genomeLength bases
+void writeFragments( const boost::filesystem::path& dir, const unsigned long genomeLength, const unsigned long fragmentCount, const unsigned int tileCount, const unsigned int seed, const bool blockFormat = false );
+
+// Random nucleotide string, with some homopolymers and short tandem repeats to exercise the error models
+std::string randomBases( const unsigned long length, const unsigned int seed );
+
+} // namespace synthetic
+
+
+} // namespace benchmark
+} // namespace eagle
+
+#endif // EAGLE_BENCHMARK_BENCHMARK_HH
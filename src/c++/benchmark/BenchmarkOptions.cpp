@@ -0,0 +1,68 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Command line options for 'eagleBenchmark'
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <string>
+
+#include "common/Exceptions.hh"
+#include "BenchmarkOptions.hh"
+
+namespace eagle
+{
+namespace benchmark
+{
+
+
+namespace bpo = boost::program_options;
+namespace bfs = boost::filesystem;
+
+BenchmarkOptions::BenchmarkOptions()
+    : eagle::common::Options(false)
+#ifdef EAGLE_BENCHMARK_DATA_DIR
+    , dataDir(EAGLE_BENCHMARK_DATA_DIR)
+#endif
+    , workDir(bfs::current_path() / "benchmark_inputs")
+    , filter("")
+    , minSeconds(2.0)
+    , minIterations(3)
+    , seed(1)
+    , list(false)
+{
+    namedOptions_.add_options()
+        ("data-dir",         bpo::value< bfs::path >(&dataDir)->default_value(dataDir),
+                                     "EAGLE data directory, containing the quality, mismatch and motif tables")
+        ("work-dir",         bpo::value< bfs::path >(&workDir)->default_value(workDir),
+                                     "Directory where the synthetic inputs get generated")
+        ("filter,f",         bpo::value< std::string >(&filter),
+                                     "Only run the benchmarks whose name contains this string")
+        ("min-time",         bpo::value< double >(&minSeconds)->default_value(minSeconds),
+                                     "Minimum time (in seconds) spent timing each benchmark")
+        ("min-iterations",   bpo::value< unsigned int >(&minIterations)->default_value(minIterations),
+                                     "Minimum number of timed iterations of each benchmark")
+        ("seed",             bpo::value< unsigned int >(&seed)->default_value(seed),
+                                     "Random seed used to generate the synthetic inputs and to drive the models")
+        ("list",             bpo::value< bool >(&list)->zero_tokens(),
+                                     "List the available benchmarks and exit")
+        ;
+}
+
+void BenchmarkOptions::postProcess(bpo::variables_map &vm)
+{
+    eagle::common::OptionsHelper check(vm);
+
+    check.addPathOptions(dataDir,"data-dir");
+    check.inputPathsExist();
+
+    check.inRange<double>(std::make_pair(minSeconds,"min-time"),0.0);
+    check.inRange<unsigned int>(std::make_pair(minIterations,"min-iterations"),1);
+}
+
+} // namespace benchmark
+} // namespace eagle
@@ -0,0 +1,46 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Command line options for 'eagleBenchmark'
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_BENCHMARK_BENCHMARK_OPTIONS_HH
+#define EAGLE_BENCHMARK_BENCHMARK_OPTIONS_HH
+
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace eagle
+{
+namespace benchmark
+{
+
+class BenchmarkOptions : public eagle::common::Options
+{
+public:
+    BenchmarkOptions();
+private:
+    std::string usagePrefix() const {return "Usage:\n       eagleBenchmark [options]";}
+    void postProcess(boost::program_options::variables_map &vm);
+
+public:
+    boost::filesystem::path dataDir;
+    boost::filesystem::path workDir;
+    std::string filter;
+    double minSeconds;
+    unsigned int minIterations;
+    unsigned int seed;
+    bool list;
+};
+
+} // namespace benchmark
+} // namespace eagle
+
+#endif // EAGLE_BENCHMARK_BENCHMARK_OPTIONS_HH
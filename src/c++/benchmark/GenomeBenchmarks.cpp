@@ -0,0 +1,229 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Benchmarks of the fragment list, of the reference access and of the genome mutator
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <boost/format.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/Logger.hh"
+#include "genome/Reference.hh"
+#include "main/GenomeMutator.hh"
+#include "main/GenomeMutatorOptions.hh"
+#include "model/Fragment.hh"
+#include "model/Genotype.hh"
+#include "Benchmark.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace benchmark
+{
+
+
+/**
+ ** \brief FragmentList::getNext over a whole fragments.{pos,length,tile} set
+ **/
+class FragmentListBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        dir_ = context.workDir / "FragmentList";
+        synthetic::writeFragments( dir_, GENOME_LENGTH, FRAGMENT_COUNT, 8, context.seed );
+    }
+
+    virtual Throughput run()
+    {
+        eagle::model::FragmentList fragmentList( dir_ );
+        eagle::model::Fragment fragment;
+        unsigned long fragmentCount = 0;
+        while (fragmentList.getNext( fragment ))
+        {
+            ++fragmentCount;
+        }
+        if (fragmentCount != FRAGMENT_COUNT)
+        {
+            EAGLE_ERROR( (boost::format("FragmentList returned %d fragments instead of %d") % fragmentCount % FRAGMENT_COUNT).str() );
+        }
+        return Throughput( fragmentCount, fragmentCount * 6 );
+    }
+
+protected:
+    static const unsigned long GENOME_LENGTH = 1000000000;
+    static const unsigned long FRAGMENT_COUNT = 2000000;
+    boost::filesystem::path dir_;
+};
+const unsigned long FragmentListBenchmark::FRAGMENT_COUNT; // odr-used by boost::format
+EAGLE_BENCHMARK_REGISTRATION( FragmentListBenchmark, "FragmentList::getNext", "fragments" );
+
+
+/**
+ ** \brief FragmentList::getNext over the same fragments stored as fragments.blocks
+ **/
+class FragmentBlocksBenchmark : public FragmentListBenchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        dir_ = context.workDir / "FragmentBlocks";
+        synthetic::writeFragments( dir_, GENOME_LENGTH, FRAGMENT_COUNT, 8, context.seed, true );
+    }
+};
+EAGLE_BENCHMARK_REGISTRATION( FragmentBlocksBenchmark, "FragmentList::getNext (blocks)", "fragments" );
+
+
+/**
+ ** \brief FastaReference::get, reading both ends of sorted fragments the way the read clusters do
+ **/
+class FastaReferenceBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        const boost::filesystem::path genomeDir = context.workDir / "FastaReference";
+        synthetic::writeGenome( genomeDir, CONTIG_COUNT, CONTIG_LENGTH, context.seed );
+        reference_.reset( new genome::MultiFastaReference( genomeDir ) );
+
+        boost::mt19937 randomGen( context.seed );
+        fragmentStarts_.clear();
+        for (unsigned int i = 0; i < FRAGMENT_COUNT; ++i)
+        {
+            fragmentStarts_.push_back( randomGen() % (CONTIG_COUNT * CONTIG_LENGTH - FRAGMENT_LENGTH) );
+        }
+        sort( fragmentStarts_.begin(), fragmentStarts_.end() );
+    }
+
+    virtual Throughput run()
+    {
+        unsigned long checksum = 0;
+        for (vector<unsigned long>::const_iterator startPos = fragmentStarts_.begin(); startPos != fragmentStarts_.end(); ++startPos)
+        {
+            bool overlapContigBoundary;
+            for (unsigned int offset = 0; offset < READ_LENGTH; ++offset)
+            {
+                checksum += reference_->get( *startPos, offset, overlapContigBoundary );
+                checksum += reference_->get( *startPos, FRAGMENT_LENGTH - 1 - offset, overlapContigBoundary );
+            }
+        }
+        checksum_ = checksum;
+        const unsigned long baseCount = fragmentStarts_.size() * 2 * READ_LENGTH;
+        return Throughput( baseCount );
+    }
+
+private:
+    static const unsigned int CONTIG_COUNT = 4;
+    static const unsigned long CONTIG_LENGTH = 1000000;
+    static const unsigned int FRAGMENT_COUNT = 20000;
+    static const unsigned int FRAGMENT_LENGTH = 400;
+    static const unsigned int READ_LENGTH = 101;
+    boost::scoped_ptr<genome::MultiFastaReference> reference_;
+    vector<unsigned long> fragmentStarts_;
+    volatile unsigned long checksum_;
+};
+EAGLE_BENCHMARK_REGISTRATION( FastaReferenceBenchmark, "FastaReference::get", "bases" );
+
+
+/**
+ ** \brief GenomeMutator, applying SNPs and small indels to a haploid genome
+ **
+ ** process() is private, so the whole run() is timed, including the loading and saving of the genomes.
+ **/
+class GenomeMutatorBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        const boost::filesystem::path dir = context.workDir / "GenomeMutator";
+        referenceFiles_ = synthetic::writeGenome( dir / "reference", CONTIG_COUNT, CONTIG_LENGTH, context.seed );
+        variantFiles_.assign( 1, dir / "variants.vcf" );
+        sampleDir_ = dir / "sample_genome";
+        canonicalVcf_ = dir / "canonical.vcf";
+
+        // Variants at random positions, with REF matching the synthetic reference
+        static const char bases[] = "ACGT";
+        boost::mt19937 randomGen( context.seed );
+        ofstream vcf( variantFiles_[0].string().c_str() );
+        vcf << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILT\tINFO\n";
+        variantCount_ = 0;
+        for (unsigned int contigNum = 1; contigNum <= CONTIG_COUNT; ++contigNum)
+        {
+            // Same sequence as synthetic::writeGenome generated
+            const string contig = synthetic::randomBases( CONTIG_LENGTH, context.seed + contigNum );
+            for (unsigned long pos = 1 + randomGen() % VARIANT_SPACING; pos < CONTIG_LENGTH - 100; pos += 20 + randomGen() % VARIANT_SPACING)
+            {
+                const unsigned int r = randomGen();
+                string ref( 1, contig[pos-1] );
+                string alt;
+                string type;
+                if (r % 10 == 0)
+                {
+                    ref = contig.substr( pos-1, 2 + r % 8 );
+                    alt = ref.substr( 0, 1 );
+                    type = "DEL";
+                }
+                else if (r % 10 == 1)
+                {
+                    alt = ref + synthetic::randomBases( 1 + r % 8, r );
+                    type = "INS";
+                }
+                else
+                {
+                    alt = bases[ (string( bases ).find( ref[0] ) + 1 + r % 3) & 3 ];
+                    type = "SNP";
+                }
+                vcf << (boost::format("chr%d\t%d\t.\t%s\t%s\t0\tPASS\tSVTYPE=%s\n") % contigNum % pos % ref % alt % type).str();
+                ++variantCount_;
+            }
+        }
+        if (!vcf.good())
+        {
+            EAGLE_ERROR( "Failed to write " + variantFiles_[0].string() );
+        }
+    }
+
+    virtual Throughput run()
+    {
+        eagle::main::GenomeMutatorOptions options;
+        options.noTranslocationError = true;
+        eagle::main::GenomeMutator genomeMutator(
+            referenceFiles_,
+            variantFiles_,
+            sampleDir_,
+            canonicalVcf_,
+            eagle::model::Ploidy( 1 ),
+            "",
+            true,
+            options );
+        genomeMutator.run();
+        return Throughput( variantCount_, CONTIG_COUNT * CONTIG_LENGTH );
+    }
+
+private:
+    static const unsigned int CONTIG_COUNT = 2;
+    static const unsigned long CONTIG_LENGTH = 2000000;
+    static const unsigned long VARIANT_SPACING = 1000;
+    vector<boost::filesystem::path> referenceFiles_;
+    vector<boost::filesystem::path> variantFiles_;
+    boost::filesystem::path sampleDir_;
+    boost::filesystem::path canonicalVcf_;
+    unsigned long variantCount_;
+};
+EAGLE_BENCHMARK_REGISTRATION( GenomeMutatorBenchmark, "GenomeMutator::process", "variants" );
+
+
+} // namespace benchmark
+} // namespace eagle
@@ -0,0 +1,224 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Benchmarks of the BGZF compression and of the BAM parser
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <sstream>
+#include <vector>
+#include <boost/format.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/device/null.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include "common/Logger.hh"
+#include "io/Bam.hh"
+#include "io/BamParserFilter.hh"
+#include "io/BgzfCompressor.hh"
+#include "Benchmark.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace benchmark
+{
+
+namespace bios = boost::iostreams;
+
+
+namespace
+{
+
+// Compresses data the way the simulator writes its BAM and FASTQ files
+void bgzfCompress( const string& data, vector<char>& result )
+{
+    result.clear();
+    bios::filtering_ostream bgzfStream;
+    bgzfStream.push( io::bam::BgzfCompressor( bios::gzip_params( bios::gzip::best_speed ) ) );
+    bgzfStream.push( bios::back_inserter( result ) );
+    bgzfStream.write( data.data(), data.size() );
+    bgzfStream.pop();
+    bgzfStream.pop();
+    ostringstream footer;
+    io::serializeBgzfFooter( footer );
+    const string footerBytes = footer.str();
+    result.insert( result.end(), footerBytes.begin(), footerBytes.end() );
+}
+
+// FASTQ records of 151 bases, as a typical BGZF payload
+string syntheticFastq( const unsigned long recordCount, const unsigned int seed )
+{
+    const unsigned int readLength = 151;
+    const string bases = synthetic::randomBases( recordCount * readLength, seed );
+    boost::mt19937 randomGen( seed );
+    string result;
+    for (unsigned long recordNum = 0; recordNum < recordCount; ++recordNum)
+    {
+        result += (boost::format("@EAGLE:1:FC:1:1101:%d:%d 1:N:0:0\n") % (randomGen() % 20000) % (randomGen() % 20000)).str();
+        result.append( bases, recordNum * readLength, readLength );
+        result += "\n+\n";
+        for (unsigned int i = 0; i < readLength; ++i)
+        {
+            result += static_cast<char>( '#' + ((i < 100) ? 30 + randomGen() % 10 : randomGen() % 40) );
+        }
+        result += '\n';
+    }
+    return result;
+}
+
+void appendInt( string& bam, const int value )
+{
+    bam.append( reinterpret_cast<const char*>( &value ), sizeof(value) );
+}
+
+// Uncompressed BAM: header with 2 contigs, followed by sorted single-end alignments of 151 bases
+string syntheticBam( const unsigned long alignmentCount, const unsigned int seed )
+{
+    const unsigned int readLength = 151;
+    const unsigned int contigLength = 10000000;
+    const string bases = synthetic::randomBases( readLength, seed );
+    boost::mt19937 randomGen( seed );
+
+    string bam( "BAM\1" );
+    const string headerText = "@HD\tVN:1.0\tSO:coordinate\n";
+    appendInt( bam, headerText.size() );
+    bam += headerText;
+    appendInt( bam, 2 );
+    for (unsigned int refId = 0; refId < 2; ++refId)
+    {
+        const string name = (boost::format("chr%d") % (refId + 1)).str();
+        appendInt( bam, name.size() + 1 );
+        bam.append( name.c_str(), name.size() + 1 );
+        appendInt( bam, contigLength );
+    }
+
+    string packedSeq( (readLength + 1) / 2, 0 );
+    for (unsigned int i = 0; i < readLength; ++i)
+    {
+        static const char bamBaseCode[4] = { 1, 2, 8, 4 }; // indexed by (ASCII>>1)&3: A, C, T, G
+        packedSeq[i/2] |= bamBaseCode[ (bases[i] >> 1) & 3 ] << ((i % 2) ? 0 : 4);
+    }
+
+    unsigned int pos = 0;
+    for (unsigned long alignmentNum = 0; alignmentNum < alignmentCount; ++alignmentNum)
+    {
+        const int refId = (alignmentNum < alignmentCount / 2) ? 0 : 1;
+        if (alignmentNum == alignmentCount / 2)
+        {
+            pos = 0;
+        }
+        pos += randomGen() % 100;
+        const string readName = (boost::format("EAGLE:1:FC:1:1101:%d:%d") % (randomGen() % 20000) % (randomGen() % 20000)).str();
+        const unsigned int cigar = readLength << 4; // M
+        string qual( readLength, 0 );
+        for (unsigned int i = 0; i < readLength; ++i)
+        {
+            qual[i] = 2 + randomGen() % 38;
+        }
+
+        const int blockSize = 32 + readName.size() + 1 + sizeof(cigar) + packedSeq.size() + qual.size();
+        appendInt( bam, blockSize );
+        appendInt( bam, refId );
+        appendInt( bam, pos );
+        appendInt( bam, (io::bam_reg2bin( pos, pos + readLength ) << 16) | (60 << 8) | (readName.size() + 1) );
+        appendInt( bam, (0 << 16) | 1 );
+        appendInt( bam, readLength );
+        appendInt( bam, -1 );
+        appendInt( bam, -1 );
+        appendInt( bam, 0 );
+        bam.append( readName.c_str(), readName.size() + 1 );
+        bam.append( reinterpret_cast<const char*>( &cigar ), sizeof(cigar) );
+        bam += packedSeq;
+        bam += qual;
+    }
+    return bam;
+}
+
+class AlignmentCounter : public io::bam::BamParserFilter
+{
+public:
+    AlignmentCounter( unsigned long& alignmentCount ) : alignmentCount_( alignmentCount ) {}
+protected:
+    virtual void parsedAlignment( const io::bam::BamAlignment& alignment, const io::bam::VirtualOffset&, const io::bam::VirtualOffset& )
+    {
+        ++alignmentCount_;
+    }
+private:
+    unsigned long& alignmentCount_;
+};
+
+} // anonymous namespace
+
+
+/**
+ ** \brief BgzfCompressor at the simulator's default compression level, on FASTQ data
+ **/
+class BgzfCompressorBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        fastq_ = syntheticFastq( RECORD_COUNT, context.seed );
+        compressed_.reserve( fastq_.size() );
+    }
+
+    virtual Throughput run()
+    {
+        bgzfCompress( fastq_, compressed_ );
+        return Throughput( RECORD_COUNT, fastq_.size() );
+    }
+
+private:
+    static const unsigned long RECORD_COUNT = 50000;
+    string fastq_;
+    vector<char> compressed_;
+};
+EAGLE_BENCHMARK_REGISTRATION( BgzfCompressorBenchmark, "BgzfCompressor", "FASTQ records" );
+
+
+/**
+ ** \brief BamParserFilter: BGZF decompression and BAM record parsing
+ **/
+class BamParserFilterBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        bgzfCompress( syntheticBam( ALIGNMENT_COUNT, context.seed ), compressedBam_ );
+    }
+
+    virtual Throughput run()
+    {
+        unsigned long alignmentCount = 0;
+        {
+            bios::filtering_ostream bamStream;
+            bamStream.push( AlignmentCounter( alignmentCount ) );
+            bamStream.push( bios::null_sink() );
+            bamStream.write( &compressedBam_[0], compressedBam_.size() );
+        }
+        if (alignmentCount != ALIGNMENT_COUNT)
+        {
+            EAGLE_ERROR( (boost::format("BamParserFilter parsed %d alignments instead of %d") % alignmentCount % ALIGNMENT_COUNT).str() );
+        }
+        return Throughput( alignmentCount, compressedBam_.size() );
+    }
+
+private:
+    static const unsigned long ALIGNMENT_COUNT = 100000;
+    vector<char> compressedBam_;
+};
+const unsigned long BamParserFilterBenchmark::ALIGNMENT_COUNT; // odr-used by boost::format
+EAGLE_BENCHMARK_REGISTRATION( BamParserFilterBenchmark, "BamParserFilter", "alignments" );
+
+
+} // namespace benchmark
+} // namespace eagle
@@ -0,0 +1,206 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Benchmarks of the error models and of the read cluster generation
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <vector>
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "genome/QualityModel.hh"
+#include "genome/ReadCluster.hh"
+#include "io/RunInfo.hh"
+#include "model/Fragment.hh"
+#include "model/FragmentRandomGenerator.hh"
+#include "model/Nucleotides.hh"
+#include "Benchmark.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace benchmark
+{
+
+
+namespace
+{
+
+const unsigned int READ_LENGTH = 101;
+
+vector<boost::filesystem::path> qualityTableFiles( const BenchmarkContext& context )
+{
+    return boost::assign::list_of
+        ( context.dataDir / "QualityTables" / "DefaultQualityTable.read1.length101.qval" )
+        ( context.dataDir / "QualityTables" / "DefaultQualityTable.read2.length101.qval" );
+}
+
+// bcl-encoded bases (0..3) of a read, as the error models see them
+vector<char> bclBases( const unsigned long length, const unsigned int seed )
+{
+    const string bases = synthetic::randomBases( length, seed );
+    eagle::model::IUPAC baseConverter;
+    vector<char> result;
+    result.reserve( length );
+    BOOST_FOREACH( const char base, bases )
+    {
+        result.push_back( baseConverter.normalizedBcl( base ) );
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+
+/**
+ ** \brief QualityModel::getQuality for 2x101 cycles
+ **/
+class QualityModelBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        seed_ = context.seed;
+        qualityModel_.reset( new genome::QualityModel( qualityTableFiles( context ) ) );
+    }
+
+    virtual Throughput run()
+    {
+        unsigned long checksum = 0;
+        for (unsigned long clusterNum = 0; clusterNum < CLUSTER_COUNT; ++clusterNum)
+        {
+            eagle::model::FragmentRandomGenerator randomGen( seed_, clusterNum );
+            genome::ClusterErrorModelContext clusterErrorModelContext;
+            for (unsigned int cycle = 1; cycle <= 2*READ_LENGTH; ++cycle)
+            {
+                if (cycle == READ_LENGTH + 1)
+                {
+                    clusterErrorModelContext.initialiseForNewRead();
+                }
+                checksum += qualityModel_->getQuality( randomGen, cycle, clusterErrorModelContext );
+            }
+        }
+        checksum_ = checksum;
+        return Throughput( CLUSTER_COUNT * 2 * READ_LENGTH );
+    }
+
+private:
+    static const unsigned long CLUSTER_COUNT = 20000;
+    unsigned int seed_;
+    boost::scoped_ptr<genome::QualityModel> qualityModel_;
+    volatile unsigned long checksum_;
+};
+EAGLE_BENCHMARK_REGISTRATION( QualityModelBenchmark, "QualityModel::getQuality", "qualities" );
+
+
+/**
+ ** \brief MotifQualityDropModel::applyQualityDrop over repeat-rich reads
+ **/
+class MotifQualityDropModelBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        seed_ = context.seed;
+        model_.reset( new genome::MotifQualityDropModel( context.dataDir / "MotifQualityDropTables" / "DefaultMotifQualityDropTable.tsv" ) );
+        bases_ = bclBases( READ_COUNT * READ_LENGTH, context.seed );
+    }
+
+    virtual Throughput run()
+    {
+        unsigned long checksum = 0;
+        vector<char>::const_iterator base = bases_.begin();
+        for (unsigned long readNum = 0; readNum < READ_COUNT; ++readNum)
+        {
+            eagle::model::FragmentRandomGenerator randomGen( seed_, readNum );
+            genome::ClusterErrorModelContext clusterErrorModelContext;
+            for (unsigned int cycle = 1; cycle <= READ_LENGTH; ++cycle, ++base)
+            {
+                unsigned int quality = 35;
+                model_->applyQualityDrop( quality, *base, clusterErrorModelContext, cycle, randomGen );
+                checksum += quality + clusterErrorModelContext.phasingContext.qualityDrop;
+            }
+        }
+        checksum_ = checksum;
+        return Throughput( READ_COUNT * READ_LENGTH );
+    }
+
+private:
+    static const unsigned long READ_COUNT = 20000;
+    unsigned int seed_;
+    boost::scoped_ptr<genome::MotifQualityDropModel> model_;
+    vector<char> bases_;
+    volatile unsigned long checksum_;
+};
+EAGLE_BENCHMARK_REGISTRATION( MotifQualityDropModelBenchmark, "MotifQualityDropModel", "bases" );
+
+
+/**
+ ** \brief ReadClusterFactory::getReadClusterWithErrors + getBclCluster, with the default error models
+ **/
+class ReadClusterBenchmark : public Benchmark
+{
+public:
+    virtual void setUp( const BenchmarkContext& context )
+    {
+        const boost::filesystem::path sampleGenomeDir = context.workDir / "ReadCluster" / "sample_genome";
+        synthetic::writeGenome( sampleGenomeDir, 1, GENOME_LENGTH, context.seed );
+
+        runInfo_.reset( new io::RunInfo( context.dataDir / "RunInfo" / "RunInfo_PairedReads1x1Tiles.xml" ) );
+        factory_.reset( new genome::ReadClusterFactory(
+                            *runInfo_,
+                            sampleGenomeDir,
+                            qualityTableFiles( context ),
+                            context.dataDir / "MismatchTables" / "DefaultMismatchTable.tsv",
+                            context.dataDir / "MismatchTables" / "DefaultHomopolymerIndelTable.tsv",
+                            context.dataDir / "MotifQualityDropTables" / "DefaultMotifQualityDropTable.tsv",
+                            context.dataDir / "QualityTables" / "DefaultQQTable.tsv",
+                            "", // no compiled error model: parse the tables above
+                            context.seed,
+                            vector<string>() ) );
+
+        boost::mt19937 randomGen( context.seed );
+        fragments_.clear();
+        for (unsigned long fragmentNum = 0; fragmentNum < CLUSTER_COUNT; ++fragmentNum)
+        {
+            const unsigned long length = 300 + randomGen() % 200;
+            const unsigned long startPos = randomGen() % (GENOME_LENGTH - length);
+            fragments_.push_back( eagle::model::Fragment( startPos, length, fragmentNum ) );
+        }
+    }
+
+    virtual Throughput run()
+    {
+        unsigned long checksum = 0;
+        BOOST_FOREACH( const eagle::model::Fragment& fragment, fragments_ )
+        {
+            genome::ReadClusterWithErrors cluster = factory_->getReadClusterWithErrors( fragment );
+            checksum += cluster.getBclCluster()[0];
+        }
+        checksum_ = checksum;
+        return Throughput( CLUSTER_COUNT, CLUSTER_COUNT * runInfo_->getClusterLength() );
+    }
+
+private:
+    static const unsigned long GENOME_LENGTH = 2000000;
+    static const unsigned long CLUSTER_COUNT = 10000;
+    boost::scoped_ptr<io::RunInfo> runInfo_;
+    boost::scoped_ptr<genome::ReadClusterFactory> factory_;
+    vector<eagle::model::Fragment> fragments_;
+    volatile unsigned long checksum_;
+};
+EAGLE_BENCHMARK_REGISTRATION( ReadClusterBenchmark, "ReadClusterFactory::getReadClusterWithErrors", "clusters" );
+
+
+} // namespace benchmark
+} // namespace eagle
@@ -0,0 +1,45 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Throughput benchmarks of the simulator's hot paths, on synthetic inputs
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <iostream>
+#include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
+
+#include "Benchmark.hh"
+#include "BenchmarkOptions.hh"
+
+
+static void benchmarkLauncher(const eagle::benchmark::BenchmarkOptions &options)
+{
+    if (options.list)
+    {
+        BOOST_FOREACH( const eagle::benchmark::BenchmarkRegistry::Entry& entry, eagle::benchmark::BenchmarkRegistry::entries() )
+        {
+            std::cout << entry.name << std::endl;
+        }
+        return;
+    }
+
+    const eagle::benchmark::BenchmarkContext context = { options.dataDir, options.workDir, options.seed };
+    boost::filesystem::create_directories( context.workDir );
+
+    eagle::benchmark::BenchmarkRunner runner( context, options.minSeconds, options.minIterations );
+    if (runner.run( options.filter ) == 0)
+    {
+        std::clog << "No benchmark matches '" << options.filter << "'" << std::endl;
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    eagle::common::run(benchmarkLauncher, argc, argv);
+}
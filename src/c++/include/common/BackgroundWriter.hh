@@ -0,0 +1,55 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Runs one write task at a time in a background thread
+ **
+ ** Used to double-buffer output: while the background thread writes buffer N,
+ ** the calling thread fills buffer N+1. Submitting the next task first waits
+ ** for the previous one, so that at most two buffers are alive at any time.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_COMMON_BACKGROUND_WRITER_HH
+#define EAGLE_COMMON_BACKGROUND_WRITER_HH
+
+#include <boost/exception_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+
+namespace eagle
+{
+namespace common
+{
+
+class BackgroundWriter : boost::noncopyable
+{
+public:
+    // With synchronous=true, the tasks run in the calling thread: no overlap, but no extra buffer either
+    BackgroundWriter( const bool synchronous = false );
+    ~BackgroundWriter();
+
+    // Waits for the previous task, rethrowing its exception if any, then starts this one
+    void write( const boost::function<void ()> &task );
+
+    // Waits for the current task, rethrowing its exception if any
+    void wait();
+
+private:
+    void runTask( const boost::function<void ()> task );
+
+    const bool synchronous_;
+    boost::thread thread_;
+    boost::exception_ptr taskException_;
+};
+
+
+} // namespace common
+} // namespace eagle
+
+#endif // EAGLE_COMMON_BACKGROUND_WRITER_HH
@@ -92,7 +92,6 @@ private:
 class EagleBamAlignmentAdapter
 {
 public:
-    unsigned long GlobalPos_;
     string QNAME_;
     unsigned int FLAG_;
     int refID_;
@@ -110,63 +109,6 @@ public:
 //    std::vector<unsigned int> CIGAR2_;
 
 public:
-    EagleBamAlignmentAdapter(
-        unsigned long GlobalPos
-        , string QNAME
-        , unsigned int FLAG
-        , unsigned int MAPQ
-        , const std::vector<unsigned int>& CIGAR
-        , unsigned long GlobalPNEXT
-        , long TLEN
-        , string SEQ
-        , string QUAL
-        , PreferredFastaReader& fastaReference
-        )
-        : GlobalPos_(GlobalPos)
-        , QNAME_(QNAME)
-        , FLAG_(FLAG)
-        , MAPQ_(MAPQ)
-        , CIGAR_(CIGAR)
-        , TLEN_(TLEN)
-    {
-        eagle::model::IUPAC converter;
-
-        unsigned int seqSize = SEQ.size();
-
-        // CIGAR
-//        CIGAR2_.push_back( seqSize<<4 | 0 ); // 101 M (M=0)
-
-        // TODO: optimise those SEQ2 and QUAL2 away
-        // SEQ
-        SEQ2_.resize( (seqSize+1) / 2 );
-        for (unsigned int i = 0; i<seqSize; ++i)
-        {
-            if (i%2 == 0)
-            {
-                SEQ2_[i/2] = converter.bin( SEQ[i] ) << 4;
-            }
-            else
-            {
-                SEQ2_[i/2] |= converter.bin( SEQ[i] );
-            }
-        }
-
-        // QUAL
-        QUAL2_.resize( seqSize );
-        for (unsigned int i = 0; i<seqSize; ++i)
-        {
-            QUAL2_[i] = QUAL[i] - 33;
-        }
-
-        // {refID_,POS_}
-        fastaReference.convertFromGlobalPos( GlobalPos, refID_, POS_);
-        --POS_;
-
-        // {next_refID_,PNEXT_}
-        fastaReference.convertFromGlobalPos( GlobalPNEXT, next_refID_, PNEXT_);
-        --PNEXT_;
-    }
-
     EagleBamAlignmentAdapter( const io::bam::StorableBamAlignment& alignment )
         : QNAME_( alignment.getReadNameAsString() )
         , FLAG_( alignment.getFlag() )
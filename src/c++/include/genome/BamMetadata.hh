@@ -30,11 +30,14 @@
 #include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
 
 #include "common/Exceptions.hh"
 #include "genome/ReadCluster.hh"
 #include "io/RunInfo.hh"
 #include "genome/BamAdapters.hh"
+#include "genome/BamReorderWindow.hh"
+#include "genome/BamRecordBuilder.hh"
 #include "genome/SharedFastaReference.hh"
 
 
@@ -46,25 +49,38 @@ namespace genome
 class BamOrMetadataOutput
 {
 public:
-    BamOrMetadataOutput( const boost::filesystem::path outDir, eagle::io::RunInfo &runInfo, PreferredFastaReader* fastaReference = eagle::genome::SharedFastaReference::get() );
+    // compressionThreads > 1 compresses the BGZF blocks in parallel
+    // The reverse reads waiting to be written in position order use up to reorderWindowMaxBytes of memory (0=unlimited),
+    // beyond which they get spilled to sorted temporary files next to the BAM file
+    BamOrMetadataOutput( const boost::filesystem::path outDir, eagle::io::RunInfo &runInfo, PreferredFastaReader* fastaReference = eagle::genome::SharedFastaReference::get(), const int compressionLevel = boost::iostreams::gzip::best_speed, const unsigned int compressionThreads = 1, const unsigned long reorderWindowMaxBytes = 0 );
     ~BamOrMetadataOutput();
     void init( const boost::filesystem::path outDir );
+    // Writes the reads still waiting to be reordered, then the end of the BAM file
+    void close();
     void add( eagle::genome::ReadClusterWithErrors& readClusterWithErrors );
     void addRebased( eagle::genome::ReadClusterWithErrors& readClusterWithErrors, const signed long globalPosShift, const unsigned long firstPosToProcess = 0, const unsigned long lastPosToProcess = 0, const bool dropLastBase = false, const genome::RefToSampleSegment& cigarModifierHelper = genome::RefToSampleSegment() );
 
 private:
     eagle::io::RunInfo &runInfo_;
     PreferredFastaReader* fastaReference_;
+    const int compressionLevel_;
+    const unsigned int compressionThreads_;
+    boost::filesystem::path outFilename_;
 //    ofstream simout_;
     boost::iostreams::filtering_ostream bamStream_;
     boost::iostreams::filtering_ostream bgzfStream_;
-    std::list<EagleBamAlignmentAdapter> reorderedAlignmentsWindow_;
+    EagleBamRecordBuilder recordBuilder_;
+
+    // Encoded BAM record, reused from one read to the next so that no allocation happens in steady state
+    std::vector<char> recordBuffer_;
+    BamReorderWindow reorderWindow_;
+    bool closed_;
+
+    std::vector<unsigned int> reversedCigar_;
 
     bool updateLhsCIGAR( const vector< unsigned int >& reorderedCIGAR, vector< unsigned int >& softClippedCIGAR, genome::ReadClusterWithErrors& readClusterWithErrors, const genome::RefToSampleSegment& cigarModifierHelper, const unsigned long firstPosToProcess, const signed long GlobalPos, unsigned int& FLAG, unsigned long& globalPosAfterSoftClipping );
     bool updateRhsCIGAR( const vector< unsigned int >& reorderedCIGAR, vector< unsigned int >& softClippedCIGAR, genome::ReadClusterWithErrors& readClusterWithErrors, const genome::RefToSampleSegment& cigarModifierHelper, const unsigned long firstPosToProcess, const signed long GlobalFirstPos, const signed long GlobalLastPos, unsigned int& FLAG, unsigned long& globalPosAfterSoftClipping );
     void softClipCIGAR( const vector< unsigned int > &CIGAR, unsigned int clippingLength, vector< unsigned int > &softClippedCIGAR );
-    void flushReorderedAlignmentsUntilPos( unsigned long POS );
-    void addToReorderedAlignments( EagleBamAlignmentAdapter &eagleBamAlignmentAdapter );
 };
 
 
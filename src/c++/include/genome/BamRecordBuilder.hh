@@ -0,0 +1,67 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Encodes BAM alignment records straight from the BCL bytes of the read clusters
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_GENOME_BAM_RECORD_BUILDER_HH
+#define EAGLE_GENOME_BAM_RECORD_BUILDER_HH
+
+#include <vector>
+
+#include "genome/SharedFastaReference.hh"
+
+
+namespace eagle
+{
+namespace genome
+{
+
+/**
+ ** \brief Same records as io::serializeAlignment( EagleBamAlignmentAdapter ), without the intermediate strings
+ **
+ ** The whole record, including its block_size prefix, gets encoded into a caller-provided buffer,
+ ** which keeps its capacity from one read to the next and can be written to the BAM stream in one go.
+ **/
+class EagleBamRecordBuilder
+{
+public:
+    EagleBamRecordBuilder( PreferredFastaReader& fastaReference );
+
+    // Encodes the read made of cycles [firstCycle,firstCycle+readLength) of bclCluster, reverse-complemented if revComp.
+    // The read name is derived from fragmentNum, and the QC-fail flag (0x200) is added to flag if the read doesn't pass filter
+    void build( std::vector<char>& record,
+                const char *bclCluster,
+                const unsigned int firstCycle,
+                const unsigned int readLength,
+                const bool revComp,
+                const unsigned long globalPos,
+                const unsigned long globalPNext,
+                const long tlen,
+                const unsigned long fragmentNum,
+                unsigned int flag,
+                const unsigned int mapq,
+                const std::vector<unsigned int>& cigar,
+                const bool reverseCigar );
+
+private:
+    // 0-based position, only querying the reference when leaving the contig of the previous call
+    void convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& pos );
+
+    PreferredFastaReader& fastaReference_;
+    const std::vector<unsigned long> contigLengths_;
+    int cachedRefId_;
+    unsigned long cachedContigStart_;
+    unsigned long cachedContigEnd_;
+};
+
+
+} // namespace genome
+} // namespace eagle
+
+#endif // EAGLE_GENOME_BAM_RECORD_BUILDER_HH
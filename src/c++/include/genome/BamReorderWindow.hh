@@ -0,0 +1,124 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Encoded BAM records waiting to be written in position order
+ **
+ ** The reverse reads of a fragment are only known once its forward read has been written,
+ ** further than their own position. They wait in a min-heap ordered by (globalPos,insertion order)
+ ** until the output goes past their position. Beyond its memory cap, the content of the heap gets
+ ** spilled to a sorted temporary file ("run"), and the runs get merged with the heap when flushing.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_GENOME_BAM_REORDER_WINDOW_HH
+#define EAGLE_GENOME_BAM_REORDER_WINDOW_HH
+
+#include <deque>
+#include <fstream>
+#include <ostream>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+namespace eagle
+{
+namespace genome
+{
+
+class BamReorderWindow : boost::noncopyable
+{
+public:
+    static const unsigned int DEFAULT_MAX_SPILLED_RUNS = 64;
+
+    // The records use up to maxBytes of memory (0=unlimited), beyond which they get spilled to <spillPrefix>.reorder<N>.tmp.
+    // Once maxSpilledRuns runs are open, the smallest ones get merged together, so that the open files stay bounded
+    BamReorderWindow( const boost::filesystem::path &spillPrefix, const unsigned long maxBytes = 0, const unsigned int maxSpilledRuns = DEFAULT_MAX_SPILLED_RUNS );
+
+    // Takes over the content of record (a BAM record starting with its block_size), giving it back the buffer of a spare record
+    void add( const unsigned long globalPos, std::vector<char> &record );
+    // Writes to os, in (globalPos,insertion order), all the records with globalPos <= maxGlobalPos
+    void flushUntilPos( const unsigned long maxGlobalPos, std::ostream &os );
+
+    bool empty() const {return heap_.empty() && spilledRunsHeap_.empty();}
+    unsigned int spilledRunCount() const {return spilledRunsHeap_.size();}
+
+private:
+    // Records reuse their buffer from one read to the next, so that no allocation happens in steady state
+    struct Record
+    {
+        unsigned long globalPos;
+        unsigned long sequenceNum;
+        std::vector<char> bytes;
+        bool operator<( const Record &rhs ) const { return globalPos < rhs.globalPos || (globalPos == rhs.globalPos && sequenceNum < rhs.sequenceNum); }
+    };
+
+    // Min-heap of indices into records_
+    class RecordGreater
+    {
+    public:
+        RecordGreater( const std::deque<Record> &records ) : records_( records ) {}
+        bool operator()( const unsigned int lhs, const unsigned int rhs ) const { return records_[rhs] < records_[lhs]; }
+    private:
+        const std::deque<Record> &records_;
+    };
+
+    // Sorted temporary file, removed when destroyed. Runs made of the merge of other runs get a higher level
+    class SpilledRun : boost::noncopyable
+    {
+    public:
+        SpilledRun( const boost::filesystem::path &filename, const unsigned int level );
+        ~SpilledRun();
+        // Loads the next record into head(), or returns false at the end of the file
+        bool next();
+        const Record &head() const { return head_; }
+        unsigned int level() const { return level_; }
+    private:
+        const boost::filesystem::path filename_;
+        const unsigned int level_;
+        std::ifstream is_;
+        Record head_;
+    };
+    typedef std::vector< boost::shared_ptr<SpilledRun> > SpilledRuns;
+
+    // Min-heap of indices into a SpilledRuns, by head
+    class SpilledRunGreater
+    {
+    public:
+        SpilledRunGreater( const SpilledRuns &runs ) : runs_( runs ) {}
+        bool operator()( const unsigned int lhs, const unsigned int rhs ) const { return runs_[rhs]->head() < runs_[lhs]->head(); }
+    private:
+        const SpilledRuns &runs_;
+    };
+
+    void spill();
+    // Merges the runs of the lowest levels into one, at least two of them
+    void mergeSpilledRuns();
+    boost::filesystem::path nextSpillFilename();
+    static void writeSpilledRecord( std::ostream &os, const Record &record );
+
+    const boost::filesystem::path spillPrefix_;
+    const unsigned long maxBytes_;
+    const unsigned int maxSpilledRuns_;
+
+    std::deque<Record> records_;
+    std::vector<unsigned int> heap_;
+    std::vector<unsigned int> spareRecords_;
+    unsigned long bytes_;
+    unsigned long nextSequenceNum_;
+
+    SpilledRuns spilledRuns_; // runs get reset once exhausted, and cleared once all of them are
+    std::vector<unsigned int> spilledRunsHeap_;
+    unsigned int spillFileCount_;
+};
+
+
+} // namespace genome
+} // namespace eagle
+
+#endif // EAGLE_GENOME_BAM_REORDER_WINDOW_HH
@@ -0,0 +1,79 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Process-wide store of the contigs loaded from FASTA files, shared by all the readers
+ **
+ ** Each contig is loaded once, whichever allele reader or worker thread asks for it first, and
+ ** then handed out to the others. Readers hold on to the contig they are currently reading from;
+ ** the other contigs are inactive and get evicted, least recently used first, when loading a new
+ ** contig takes the store over its memory budget.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_GENOME_CONTIG_STORE_HH
+#define EAGLE_GENOME_CONTIG_STORE_HH
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "io/Fasta.hh"
+
+
+namespace eagle
+{
+namespace genome
+{
+
+class ContigStore
+{
+public:
+    // Contig bases as stored in the FASTA file, end-of-lines included
+    typedef boost::shared_ptr< const std::vector<char> > ContigText;
+
+    // Thread-safe. The contig stays active, and therefore in the store, as long as the result is held
+    static ContigText get( const boost::filesystem::path& file, const eagle::io::FastaInfo& info );
+
+    // Memory budget of all the contigs in the store, active ones included, in bytes. Only inactive contigs get
+    // evicted to stay under it, so the active ones alone may go beyond it (0=only keep the active ones)
+    static void setMaxBytes( const unsigned long maxBytes );
+
+    // Size of all the contigs in the store, active ones included
+    static unsigned long bytes();
+    static unsigned int contigCount();
+
+    // Evicts all the inactive contigs
+    static void clear();
+
+private:
+    struct Entry
+    {
+        Entry( const ContigText& text, const unsigned long lastUse ) : text( text ), lastUse( lastUse ) {}
+        ContigText text;
+        unsigned long lastUse;
+    };
+    typedef std::map< std::pair< std::string, std::string >, Entry > ContigMap;
+
+    static ContigText load( const boost::filesystem::path& file, const eagle::io::FastaInfo& info );
+    // Called with mutex_ locked
+    static void evict( const unsigned long maxBytes );
+
+    static boost::mutex mutex_;
+    static ContigMap contigs_;
+    static unsigned long bytes_;
+    static unsigned long maxBytes_;
+    static unsigned long useCount_;
+};
+
+
+} // namespace genome
+} // namespace eagle
+
+#endif // EAGLE_GENOME_CONTIG_STORE_HH
@@ -31,6 +31,9 @@ struct FragmentComponent
     FragmentComponent() {}
     virtual ~FragmentComponent() {}//assert(false); } // should never deconstruct for the moment
     virtual char getBase( const unsigned int posInRead, const eagle::model::Fragment &fragment, const bool isForward ) const = 0;  // { assert(false); }
+    // Same bases as getBase() for [posInRead,posInRead+length), resolved once for the whole span.
+    // Returns false when some of them are out of the component (dest is then undefined), for the caller to use getBase()
+    virtual bool copyBases( char *dest, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment, const bool isForward ) const = 0;
 
     unsigned int length_;
 };
@@ -40,6 +43,7 @@ struct FragmentComponentHardcoded : public FragmentComponent
     FragmentComponentHardcoded( string bases);
     virtual ~FragmentComponentHardcoded() {}
     virtual char getBase( const unsigned int posInRead, const eagle::model::Fragment &fragment, const bool isForward ) const;
+    virtual bool copyBases( char *dest, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment, const bool isForward ) const;
 
 private:
     string bases_;
@@ -50,6 +54,7 @@ struct FragmentComponentRealDna : public FragmentComponent
     FragmentComponentRealDna();
     virtual ~FragmentComponentRealDna() {}
     virtual char getBase( const unsigned int posInRead, const eagle::model::Fragment &fragment, const bool isForward ) const;
+    virtual bool copyBases( char *dest, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment, const bool isForward ) const;
 
 private:
 
@@ -65,6 +70,7 @@ public:
     vector< pair< unsigned int, bool > > reads_;
 
     char getBase( const unsigned int readNum, const unsigned int posInRead, const eagle::model::Fragment &fragment ) const;
+    bool copyBases( char *dest, const unsigned int readNum, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment ) const;
     unsigned int getReadLength( const unsigned int readNum, const eagle::model::Fragment &fragment ) const;
     bool getReadInfo( const unsigned int readNum, /*bool &isIndex, unsigned long &startPos, */bool &directionIsForward ) const
         {
@@ -129,6 +135,7 @@ class EnrichedFragment
 public:
     EnrichedFragment( const eagle::model::Fragment &fragment, const vector<FragmentStructure> &multiplexedFragmentStructures, const unsigned int dnaFragmentDirection );
     char getBase( unsigned int read, unsigned int posInRead ) const;
+    bool copyBases( char *dest, unsigned int read, unsigned int posInRead, unsigned int length ) const;
     unsigned int getReadCount() const;
     unsigned int getReadLength( unsigned int r ) const;
 
@@ -0,0 +1,117 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Memory-mapped binary file holding the error model tables, already parsed and compiled.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_GENOME_ERROR_MODEL_BUNDLE_HH
+#define EAGLE_GENOME_ERROR_MODEL_BUNDLE_HH
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "model/AliasTable.hh"
+
+
+namespace eagle
+{
+namespace genome
+{
+
+
+/*
+ * Error model bundle, built once from the text tables (see compileErrorModel) and memory-mapped read-only,
+ * so that all the simulateSequencer processes of a node start without parsing and share the same physical copy.
+ * All values are native-endian 64-bit unsigned integers unless specified otherwise, and each section is 8-byte aligned:
+ *   header:   magic, version, payloadSize, checksum (CRC-32 of the payload), sectionCount
+ *   payload:  for each section: id, byteSize, data (padded)
+ * Alias tables sections contain: width (32 bits), tableCount (32 bits), outcome counts (32 bits each, padded), entries
+ */
+enum ErrorModelBundleSection
+{
+    QUALITY_PROFILE_COUNTS = 1,
+    QUALITY_DISTRIBUTIONS,
+    MISMATCH_DISTRIBUTIONS,
+    HOMOPOLYMER_DELETION_RATES,
+    HOMOPOLYMER_INSERTION_RATES,
+    MOTIF_KMERS,
+    MOTIF_GROUPS,
+    MOTIF_REPEATS,
+    MOTIF_WEIGHTS,
+    QQ_ERROR_RATES
+};
+
+
+class ErrorModelBundleWriter : boost::noncopyable
+{
+public:
+    static const unsigned long MAGIC = 0x4c444f4d52524545ul; // "EERRMODL"
+    static const unsigned long VERSION = 1;
+
+    ErrorModelBundleWriter( const boost::filesystem::path& filename );
+
+    void add( const ErrorModelBundleSection id, const void *data, const unsigned long byteSize );
+    template< typename T >
+    void add( const ErrorModelBundleSection id, const std::vector< T >& values )
+    {
+        add( id, values.empty() ? 0 : &values[0], values.size() * sizeof(T) );
+    }
+    void add( const ErrorModelBundleSection id, const model::AliasTables& tables );
+
+    void close();
+
+private:
+    void append( const void *data, const unsigned long byteSize );
+
+    const boost::filesystem::path filename_;
+    std::vector< char > payload_;
+    unsigned long sectionCount_;
+};
+
+
+class ErrorModelBundleReader : boost::noncopyable
+{
+public:
+    ErrorModelBundleReader( const boost::filesystem::path& filename );
+
+    // Points into the mapped file: only valid as long as the reader
+    template< typename T >
+    const T *get( const ErrorModelBundleSection id, unsigned long& count ) const
+    {
+        const std::pair< const char *, unsigned long >& section = find( id, sizeof(T) );
+        count = section.second / sizeof(T);
+        return reinterpret_cast<const T *>( section.first );
+    }
+    template< typename T >
+    std::vector< T > getVector( const ErrorModelBundleSection id ) const
+    {
+        unsigned long count;
+        const T *values = get<T>( id, count );
+        return std::vector< T >( values, values + count );
+    }
+    // The tables keep pointing into the mapped file
+    void get( const ErrorModelBundleSection id, model::AliasTables& tables ) const;
+    const boost::filesystem::path& filename() const { return filename_; }
+
+private:
+    const std::pair< const char *, unsigned long >& find( const ErrorModelBundleSection id, const unsigned int elementSize ) const;
+
+    const boost::filesystem::path filename_;
+    boost::iostreams::mapped_file_source file_;
+    std::map< unsigned long, std::pair< const char *, unsigned long > > sections_;
+};
+
+
+} // namespace genome
+} // namespace eagle
+
+#endif // EAGLE_GENOME_ERROR_MODEL_BUNDLE_HH
@@ -15,9 +15,9 @@
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/random/mersenne_twister.hpp>
 #include <boost/random/discrete_distribution.hpp>
 
+#include "model/FragmentRandomGenerator.hh"
 #include "model/Nucleotides.hh"
 #include "common/Logger.hh"
 
@@ -39,7 +39,7 @@ public:
     virtual ~ErrorModelPlugin()
     {
     }
-    virtual void apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext ) = 0;
+    virtual void apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext ) = 0;
 
 protected:
     template <class T>
@@ -75,7 +75,8 @@ class LongreadBaseDuplicationModel: public ErrorModelPlugin
 {
 public:
     LongreadBaseDuplicationModel( const std::vector< std::string >& errorModelOptions );
-    virtual void apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    virtual void apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    bool isActive() const { return prob_ != 0.0; }
 
 private:
     const double prob_;
@@ -86,12 +87,12 @@ class LongreadDeletionModel: public ErrorModelPlugin
 {
 public:
     LongreadDeletionModel( const std::vector< std::string >& errorModelOptions );
-    void apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    void apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    bool isActive() const { return prob_ != 0.0; }
 
 private:
     const double prob_;
     boost::random::discrete_distribution<> deletionLengthDist_;
-    unsigned int basesLeftToDelete_;
 };
 
 
@@ -14,6 +14,7 @@
 
 #include <utility>
 #include <iostream>
+#include <stdint.h>
 #include <fstream>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -32,6 +33,39 @@ namespace genome
 {
 
 
+/**
+ ** \brief Cumulative G/C and non-ACGT counts of a sequence, giving the GC content of any window in O(1)
+ **
+ ** Each block of 64 bases stores the counts preceding it, plus one bitmap per category for the bases it contains.
+ **/
+class GcContentIndex
+{
+public:
+    GcContentIndex() { clear(); }
+    void clear();
+    void push_back( const char base );
+    unsigned long size() const { return size_; }
+
+    // Counts of the bases in [begin,end)
+    void count( const unsigned long begin, const unsigned long end, unsigned int& gcCount, unsigned int& otherCount ) const;
+
+private:
+    struct Block
+    {
+        uint32_t gcBefore;
+        uint32_t otherBefore;
+        uint64_t gcBits;
+        uint64_t otherBits;
+    };
+
+    void countBefore( const unsigned long pos, unsigned int& gcCount, unsigned int& otherCount ) const;
+
+    std::vector<Block> blocks_;
+    unsigned long size_;
+    eagle::model::IUPAC baseConverter_;
+};
+
+
 class GcCoverageFit
 {
 public:
@@ -48,8 +82,14 @@ private:
     eagle::model::IUPAC baseConverter_;
     double averageMultiplier_;
 
+    // Fragments are allocated in increasing position order: only the contig currently visited gets indexed
+    std::vector<unsigned long> contigStarts_;
+    unsigned int currentContig_;
+    GcContentIndex currentContigGcIndex_;
+
     void parseGcCoverageFitFile( const boost::filesystem::path& filename );
     double getInterpolatedCoverageMultiplierForGcContent( const double gcContent );
+    void selectContigContaining( const unsigned long globalPos );
 };
 
 
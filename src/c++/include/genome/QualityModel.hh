@@ -15,10 +15,11 @@
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/random/mersenne_twister.hpp>
-#include <boost/random/discrete_distribution.hpp>
 
+#include "model/AliasTable.hh"
+#include "model/FragmentRandomGenerator.hh"
 #include "model/Nucleotides.hh"
+#include "genome/ErrorModelBundle.hh"
 #include "genome/ErrorModelPlugin.hh"
 
 
@@ -59,6 +60,11 @@ struct ClusterErrorModelContext
         float shortTermQualityDrop;
     } motifQualityDropModelContext;
 
+    struct
+    {
+        unsigned int basesLeftToDelete;
+    } longreadDeletionModelContext;
+
     ClusterErrorModelContext()
     {
         initialiseForNewRead();
@@ -76,6 +82,7 @@ struct ClusterErrorModelContext
         motifQualityDropModelContext.shortTermEffect = NULL;
         motifQualityDropModelContext.qualityDropLevel = 0;
         phasingContext.qualityDrop = 0;
+        longreadDeletionModelContext.basesLeftToDelete = 0;
     }
 };
 
@@ -85,15 +92,25 @@ class QualityModel
 public:
     QualityModel( const std::vector<boost::filesystem::path>& qualityTableFiles );
 
-    unsigned int getQuality( boost::mt19937& randomGen, const unsigned int cycle, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext );
-    unsigned int getQuality( boost::mt19937& randomGen, const unsigned int cycle, ClusterErrorModelContext& clusterErrorModelContext );
+    unsigned int getQuality( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    unsigned int getQuality( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, ClusterErrorModelContext& clusterErrorModelContext );
     double qualToProbError(unsigned int qual);
 
+    void save( ErrorModelBundleWriter& bundle ) const;
+    void load( const ErrorModelBundleReader& bundle );
+
 private:
     unsigned int parseQualityTableFile( const boost::filesystem::path& filename, const int cycleOffset = 0 );
-    void createDiscreteDistributionPerCycle();
+    void createAliasTables();
+    unsigned int tableNum( const unsigned int cycle, const unsigned int profileNumber ) const { return cycle * maxProfileCount_ + profileNumber; }
 
-    std::vector< std::vector< boost::random::discrete_distribution<> > > qualityDistPerCyclePerLastQuality;
+    // Weights parsed from the quality table files, only kept until they get compiled into alias tables
+    std::vector< std::vector< std::vector< double > > > qualityWeightsPerCyclePerLastQuality_;
+
+    // Distribution for {cycle, profileNumber} is at tableNum(cycle, profileNumber)
+    model::AliasTables qualityDistPerCyclePerLastQuality;
+    std::vector< unsigned int > profileCountPerCycle_;
+    unsigned int maxProfileCount_;
 
     // New stuff
     unsigned int parseBigQualityTableFile( const boost::filesystem::path& filename );
@@ -106,10 +123,13 @@ class SequencingMismatchModel
 {
 public:
     SequencingMismatchModel( const boost::filesystem::path& mismatchTableFilename );
-    void apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    void apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+
+    void save( ErrorModelBundleWriter& bundle ) const;
+    void load( const ErrorModelBundleReader& bundle );
 
 private:
-    std::vector< boost::random::discrete_distribution<> > errorDistPerBase;
+    model::AliasTables errorDistPerBase;
 };
 
 
@@ -117,7 +137,12 @@ class HomopolymerIndelModel
 {
 public:
     HomopolymerIndelModel( const boost::filesystem::path& homopolymerIndelTableFilename );
-    void apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    void apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    // False when all the rates are 0 (default table), in which case apply() never adds any error
+    bool isActive() const;
+
+    void save( ErrorModelBundleWriter& bundle ) const;
+    void load( const ErrorModelBundleReader& bundle );
 
 private:
     std::vector< double > homoDeletionTable_;
@@ -129,12 +154,22 @@ class MotifQualityDropModel
 {
 public:
     MotifQualityDropModel( const boost::filesystem::path& tableFilename );
-    void applyQualityDrop( unsigned int& quality, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext, const unsigned int cycle, boost::mt19937& randomGen );
+    void applyQualityDrop( unsigned int& quality, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext, const unsigned int cycle, model::FragmentRandomGenerator& randomGen );
+    bool isActive() const { return active_; }
+
+    void save( ErrorModelBundleWriter& bundle ) const;
+    void load( const ErrorModelBundleReader& bundle );
 
 private:
     MotifRepeatQualityDropInfo* getMotifRepeatQualityDrop( const uint64_t kmer1, const unsigned int repeatKmerLength, const unsigned int repeatCount );
+    unsigned int& kmerGroup( const unsigned int kmerLength, const uint64_t kmer );
+    static const unsigned int NO_GROUP = 0xFFFFFFFF;
+
     bool active_;
-    std::vector< std::map< uint64_t, boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > > > > tableData_;
+    // All the permutations of a kmer share the same group of repeat infos (indexed by repeat count)
+    std::vector< boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > > > groups_;
+    // Group number of each kmer, directly indexed by kmer for each kmer length. Empty for the lengths without any entry
+    std::vector< std::vector< unsigned int > > groupPerKmer_;
     eagle::model::IUPAC baseConverter_;
 };
 
@@ -175,6 +210,9 @@ public:
     QQTable( const boost::filesystem::path& qqTableFilename );
     double qualToErrorRate( const unsigned int quality );
 
+    void save( ErrorModelBundleWriter& bundle ) const;
+    void load( const ErrorModelBundleReader& bundle );
+
 private:
     std::vector< double > qualityToProbability_;
 };
@@ -185,21 +223,35 @@ class ErrorModel
 public:
     enum ErrorType { NoError, BaseSubstitution, BaseDeletion, BaseInsertion } ;
 
-    ErrorModel( const std::vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFilename, const boost::filesystem::path& motifQualityDropTableFilename, const boost::filesystem::path& qqTableFilename, const std::vector< std::string >& errorModelOptions );
-    void getQualityAndRandomError( boost::mt19937& randomGen, const unsigned int cycle, const char base, unsigned int& quality, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    // The tables are either parsed from the text files, or taken from compiledErrorModelFile when set (see save)
+    ErrorModel( const std::vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFilename, const boost::filesystem::path& motifQualityDropTableFilename, const boost::filesystem::path& qqTableFilename, const boost::filesystem::path& compiledErrorModelFile, const std::vector< std::string >& errorModelOptions );
+    void getQualityAndRandomError( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, const char base, unsigned int& quality, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+    {
+        (this->*pipeline_)( randomGen, cycle, base, quality, randomErrorType, bclBase, clusterErrorModelContext );
+    }
+
+    // Writes the tables into an ErrorModelBundle file. The plugins' errorModelOptions are not included
+    void save( const boost::filesystem::path& compiledErrorModelFile ) const;
 
 private:
+    // One instantiation per combination of optional models, so that the disabled ones cost nothing per base
+    template< bool withHomopolymerIndels, bool withMotifQualityDrop, bool withLongreadErrors >
+    void getQualityAndRandomErrorWith( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, const char base, unsigned int& quality, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    typedef void (ErrorModel::*Pipeline)( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, const char base, unsigned int& quality, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext );
+    void selectPipeline();
+
+    // Mapped file some of the tables point into
+    boost::shared_ptr< ErrorModelBundleReader > compiledErrorModel_;
     QualityModel qualityModel_;
     SequencingMismatchModel sequencingMismatchModel_;
     HomopolymerIndelModel homopolymerIndelModel_;
     MotifQualityDropModel motifQualityDropModel_;
-    RandomQualityDropModel randomQualityDropModel_;
-    QualityGlitchModel qualityGlitchModel_;
     HappyPhasingModel happyPhasingModel_;
     LongreadBaseDuplicationModel longreadBaseDuplicationModel_;
     LongreadDeletionModel longreadDeletionModel_;
     QQTable qqTable_;
     eagle::model::IUPAC baseConverter_;
+    Pipeline pipeline_;
 };
 
 
@@ -17,6 +17,7 @@
 #include "genome/Reference.hh"
 #include "io/RunInfo.hh"
 #include "model/Nucleotides.hh"
+#include "model/FragmentRandomGenerator.hh"
 #include "genome/QualityModel.hh"
 #include "genome/EnrichedFragment.hh"
 #include "genome/ReferenceToSample.hh"
@@ -31,7 +32,7 @@ namespace genome
 class ReadClusterSharedData
 {
 public:
-    ReadClusterSharedData( const unsigned int clusterLength, const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const std::vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions );
+    ReadClusterSharedData( const unsigned int clusterLength, const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const std::vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const boost::filesystem::path& compiledErrorModelFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions );
 
     unsigned int clusterLength_;
     const eagle::io::RunInfo &runInfo_;
@@ -44,15 +45,28 @@ public:
 class ReadClusterWithErrors
 {
 public:
-    ReadClusterWithErrors(ReadClusterSharedData &sharedData, const EnrichedFragment& eFragment, boost::shared_ptr<boost::mt19937> randomGen);
+    ReadClusterWithErrors(ReadClusterSharedData &sharedData, const EnrichedFragment& eFragment, const eagle::model::FragmentRandomGenerator& randomGen);
     const char *getBclCluster( bool generateCigar = false, const bool dropLastBase = false );
     const std::vector<unsigned int>& getCigar( unsigned int readNum, const bool dropLastBase = false );
     unsigned int getUsedDnaLength( unsigned int readNum, const bool dropLastBase = false );
     const string getNucleotideOrQualitySequenceForRead( unsigned int readNum, bool getNucleotides, bool revComp, const bool dropLastBase = false );
+    // BCL bytes of the whole cluster, without regenerating them if they were already evaluated
+    const char *getEvaluatedBclCluster( const bool dropLastBase = false )
+    {
+        return lazyEvaluationDone_ ? buf_.c_str() : getBclCluster( true, dropLastBase );
+    }
+
+    // Cycle by cycle generation, giving the same BCL bytes as getBclCluster (without CIGAR)
+    void startRead( const unsigned int readNum );
+    char getNextBclByte( const unsigned int readNum, const unsigned int cycle );
 
 private:
+    // One error model step at the current template position. Returns the CIGAR operation (0='M', 1='I', 2='D'),
+    // and the BCL byte of the cycle in bclBaseAndQ unless it was a deletion
+    unsigned int applyErrorModel( const unsigned int readNum, const unsigned int cycle, char& bclBaseAndQ );
+
     ReadClusterSharedData &sharedData_;
-    boost::shared_ptr< boost::mt19937 > randomGen_;
+    eagle::model::FragmentRandomGenerator randomGen_;
 
 public:
     const EnrichedFragment eFragment_;
@@ -61,6 +75,11 @@ public:
 private:
     bool lazyEvaluationDone_;
     string buf_;
+    string readBases_;
+    // Progress through the current read
+    ClusterErrorModelContext clusterErrorModelContext_;
+    unsigned int posToRead_;
+    unsigned int prefetchedBases_;
     std::vector< std::vector< unsigned int > > cigar_;
     std::vector< unsigned int > usedDnaLength_;
 //    unsigned int read1PosInBuf_, read1Length_, read2PosInBuf_, read2Length_;
@@ -70,8 +89,11 @@ private:
 class ReadClusterFactory
 {
 public:
-    ReadClusterFactory( const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const std::vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions );
+    ReadClusterFactory( const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const std::vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const boost::filesystem::path& compiledErrorModelFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions );
     ReadClusterWithErrors getReadClusterWithErrors( const eagle::model::Fragment &f );
+    // Generates the clusters of a block of fragments cycle by cycle across the block, so that the error model tables
+    // of each cycle stay in cache. The BCL byte of fragment i at a given cycle goes to bclBlock[cycle*fragments.size()+i]
+    void getBclClusterBlock( const std::vector< eagle::model::Fragment >& fragments, std::vector< char >& bclBlock );
 
 private:
     const eagle::io::RunInfo &runInfo_;
@@ -14,7 +14,9 @@
 
 
 #include "common/FileSystem.hh"
+#include "genome/ContigStore.hh"
 #include "io/Fasta.hh"
+#include "io/PackedFasta.hh"
 #include "model/Contig.hh"
 
 #include <boost/noncopyable.hpp>
@@ -22,6 +24,8 @@
 #include <boost/foreach.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <fstream>
 #include <algorithm>
 #include <string>
@@ -41,8 +45,30 @@ namespace genome
 class FastaReference: boost::noncopyable
 {
 public:
+    // Contigs of all the files sorted by global position, built at load time: a binary search on their
+    // end positions finds the contig of a global position, and the name table gives it for a name,
+    // however many alleles or contigs get interleaved. They never change once built, so that the readers
+    // of several threads or alleles can share them and only keep their own current contig
+    struct ContigTables
+    {
+        eagle::io::FastaMetadata index; // as completed by the *.fai files
+        std::vector< eagle::io::FastaInfo > infos;
+        std::vector< unsigned long > ends;
+        std::vector< boost::filesystem::path > files;
+        std::vector< unsigned int > fileIds; // positions of 'files' in 'index'
+        std::vector< int > ids; // in the order of allContigNames(), as BAM reference ids
+        boost::unordered_map< std::string, unsigned int > indexByName;
+
+        // Packed copies of the FASTA files (see packFasta), one per file of 'index': when all of them are
+        // available, get() serves the bases from them instead of loading each contig as text
+        std::vector< boost::shared_ptr< eagle::io::PackedFastaReader > > packedFiles;
+        std::vector< unsigned int > packedContigIds; // of each entry of 'infos', in its packed file
+    };
+
     FastaReference(   // read-only
         const eagle::io::FastaMetadata& metadata );
+    FastaReference(   // read-only, on the contig tables of another reader
+        const boost::shared_ptr< const ContigTables >& contigTables );
     FastaReference(   // write-only
         const boost::filesystem::path& outputDir,
         const bool overwrite = false );
@@ -56,14 +82,19 @@ public:
 
     char get( const unsigned long globalPos,      const unsigned long offset, bool &overlapContigBoundary );
     char get( const eagle::model::Locus location, const unsigned long offset, bool &overlapContigBoundary );
+    // Same bases as get() for offsets [offset,offset+length) in one go, or their complements (as ~base) in reverse order.
+    // Returns false without copying anything if they don't all belong to the contig of globalPos
+    bool copyBases( char *dest, const unsigned long globalPos, const unsigned long offset, const unsigned long length, const bool reverse );
     unsigned long read( eagle::model::Contig &contig, const std::string &contigName );
+    // Lets the ContigStore evict the current contig while this reader is not in use: the next get() fetches it again
+    void releaseContig() {currentContig_.reset();}
 
     unsigned long local2global(const eagle::model::Locus& position);
     eagle::model::Locus global2local(unsigned long globalPos);
     void convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& posInContig );
 
-    std::string currentChromosome() const {return reader_.getContigName();}
-    unsigned long estimatedLength() {return reader_.getContigSize();}
+    std::string currentChromosome() const {return currentGetInfo_.contigName;}
+    unsigned long estimatedLength() {return currentGetInfo_.contigSize;}
     std::vector<eagle::model::Contig>::const_iterator begin() const {return reference_.begin();}
     std::vector<eagle::model::Contig>::iterator begin() {return reference_.begin();}
     std::vector<eagle::model::Contig>::const_iterator end() const {return reference_.end();}
@@ -86,12 +117,24 @@ public:
     unsigned long getContigLength(const std::string &contigName) const;
     eagle::io::FastaMetadata & metadata()             {return metadata_;}
     eagle::io::FastaMetadata const & metadata() const {return metadata_;}
+    boost::shared_ptr< const ContigTables > contigTables() const {return contigTables_;}
 
 private:
     void inputStructure( const eagle::io::FastaMetadata& metadata );
     void outputStructure( const boost::filesystem::path& outputDir );
     void inputMode();
     void outputMode();
+    void openPackedFiles( ContigTables& tables ) const;
+    // Makes contigTables_->infos[i] the current contig
+    void selectContig( const unsigned int i );
+    void selectContigAt( const unsigned long globalPos );
+    const std::vector<char>& currentContigText();
+    void buildContigTables( ContigTables& tables ) const;
+    // Index in contigTables_->infos, or contigTables_->infos.size() when not found
+    unsigned int findContig( const unsigned long globalPos ) const;
+    unsigned int findContig( const std::string& contigName ) const;
+    char getFromCurrentContig( const unsigned long i, bool &overlapContigBoundary );
+    char getFromContigText( const unsigned long i, bool &overlapContigBoundary );
 
     eagle::io::MultiFastaReader reader_;
     eagle::io::MultiFastaWriter writer_;
@@ -100,12 +143,18 @@ private:
     eagle::io::FastaMetadata metadata_;
     std::vector< eagle::model::Contig > reference_;
     eagle::io::FastaInfo currentGetInfo_;
+    boost::filesystem::path currentGetFile_;
+    // Bases of currentGetInfo_'s contig, shared with the other readers through the ContigStore
+    ContigStore::ContigText currentContig_;
+
+    const eagle::io::PackedFastaReader *currentPackedFile_;
+    unsigned int currentPackedContig_;
+    eagle::io::PackedFastaCursor currentPackedCursor_;
 
-    unsigned int local2globalCache_roundRobin;
-    std::vector<std::string> local2globalCache_chr;
-    std::vector<unsigned long> local2globalCache_pos;
+    boost::shared_ptr< const ContigTables > contigTables_;
 
     eagle::io::FastaInfo global2localCache;
+    int global2localContigId_;
 };
 
 typedef std::vector<eagle::model::Contig>::const_iterator ReferenceIterator;
@@ -130,6 +179,11 @@ public:
     : FastaReference( initialize(inputPath) )
     , overwrite_(false)    // N/A
     {}
+    MultiFastaReference(   // read-only, on the contig tables of another reader
+        const boost::shared_ptr< const ContigTables >& contigTables )
+    : FastaReference( contigTables )
+    , overwrite_(false)    // N/A
+    {}
     MultiFastaReference(   // write-only
         const boost::filesystem::path outputDir,
         const bool overwrite)
@@ -10,8 +10,11 @@
 #ifndef SHARED_FASTA_REFERENCE_HH
 #define SHARED_FASTA_REFERENCE_HH
 
+#include <map>
+#include <string>
 #include <vector>
 #include <boost/filesystem.hpp>
+#include <boost/thread/tss.hpp>
 
 
 #ifndef USE_TMP_FASTA_READER
@@ -35,33 +38,90 @@ public:
     static void init( const boost::filesystem::path& sampleGenomeDir )
     {
         SharedFastaReference::fastaReference_ = new PreferredFastaReader( sampleGenomeDir );
+        initialFastaReference_ = fastaReference_;
         sampleGenomeDir_.clear();
         sampleGenomeDir_.push_back( sampleGenomeDir );
     }
     static void init( const std::vector<boost::filesystem::path>& sampleGenomeDir )
     {
         SharedFastaReference::fastaReference_ = new PreferredFastaReader( sampleGenomeDir );
+        initialFastaReference_ = fastaReference_;
         sampleGenomeDir_ = sampleGenomeDir;
     }
     static inline PreferredFastaReader *get()
     {
+        PreferredFastaReader *threadFastaReference = SharedFastaReference::threadFastaReference_.get();
+        if (threadFastaReference)
+        {
+            return threadFastaReference;
+        }
         assert (SharedFastaReference::fastaReference_);
         return SharedFastaReference::fastaReference_;
     }
-    static inline void setActive( std::string id )
+    // Readers cache the current contig and are not thread-safe: worker threads get their own reader
+    // on the same sample genome, which takes precedence over the shared one in the calling thread.
+    // It shares the contig tables of the initial reader and only keeps its own current contig
+    static void initForCurrentThread()
+    {
+        assert (!SharedFastaReference::threadFastaReference_.get());
+        SharedFastaReference::threadFastaReference_.reset( newReader() );
+    }
+    static void releaseForCurrentThread()
+    {
+        SharedFastaReference::threadFastaReference_.reset();
+    }
+    // Each allele gets its own reader, so that switching between alleles doesn't move a reader away
+    // from its contig. The contigs themselves are loaded once, in the ContigStore shared by all readers
+    static unsigned int alleleIndex( const std::string& id )
+    {
+        std::map< std::string, unsigned int >::const_iterator it = dictionary_.find( id );
+        if (it != dictionary_.end())
+        {
+            return it->second;
+        }
+        const unsigned int newIdx = fastaReferenceArray_.size();
+        fastaReferenceArray_.push_back( newReader() );
+        dictionary_[id] = newIdx;
+        return newIdx;
+    }
+    static inline void setActive( const unsigned int alleleIndex )
+    {
+        if (SharedFastaReference::threadFastaReference_.get())
+        {
+            return; // the reader of a worker thread serves all the alleles
+        }
+        PreferredFastaReader* newFastaReference = fastaReferenceArray_[ alleleIndex ];
+        if (newFastaReference != fastaReference_)
+        {
+            if (fastaReference_)
+            {
+                fastaReference_->releaseContig(); // inactive contig: evictable from the store
+            }
+            fastaReference_ = newFastaReference;
+        }
+    }
+    static inline void setActive( const std::string& id )
     {
-        if (dictionary_.find(id) == dictionary_.end())
+        if (SharedFastaReference::threadFastaReference_.get())
         {
-            unsigned int newIdx = fastaReferenceArray_.size();
-            PreferredFastaReader* newFastaReference = new PreferredFastaReader( sampleGenomeDir_ );
-            fastaReferenceArray_.push_back( newFastaReference );
-            dictionary_[id] = newIdx;
+            return;
         }
-        unsigned int idx = dictionary_[id];
-        fastaReference_ = fastaReferenceArray_[ idx ];
+        setActive( alleleIndex( id ) );
     }
 private:
+    static PreferredFastaReader *newReader()
+    {
+#ifndef USE_TMP_FASTA_READER
+        assert (SharedFastaReference::initialFastaReference_);
+        return new PreferredFastaReader( initialFastaReference_->contigTables() );
+#else
+        return new PreferredFastaReader( sampleGenomeDir_ );
+#endif
+    }
+
     static PreferredFastaReader*  fastaReference_;
+    static PreferredFastaReader*  initialFastaReference_;
+    static boost::thread_specific_ptr< PreferredFastaReader >  threadFastaReference_;
     static std::vector<boost::filesystem::path> sampleGenomeDir_;
     static std::vector< PreferredFastaReader* >  fastaReferenceArray_;
     static std::map< std::string, unsigned int > dictionary_;
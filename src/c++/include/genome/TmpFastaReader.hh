@@ -47,11 +47,21 @@ public:
     const vector<string> allContigNames() { return fastaRef_.allContigNames(); }
     const vector<unsigned long> allContigLengths() { return fastaRef_.allContigLengths(); }
     char get( const unsigned long globalPos, const unsigned long offset, bool& overlapContigBoundary );
+    bool copyBases( char *dest, const unsigned long globalPos, const unsigned long offset, const unsigned long length, const bool reverse );
     void convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& posInContig );
+    void releaseContig() {}
 
 private:
+    // Index in fileInfos_ of the contig of globalPos, walking from contigNum
+    unsigned int walkToContig( const unsigned long globalPos, unsigned int contigNum ) const;
+
     MultiFastaReference fastaRef_;
     vector<TmpFastaFileInfo> fileInfos_;
+
+    // Each reader keeps its own current contig, so that several of them can be used at once
+    unsigned int currentContigNum_;
+    vector<char> currentFileData_;
+    unsigned int convertedContigNum_;
 };
 
 
@@ -0,0 +1,41 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Concatenates indexed BAM files sharing the same header, without decompressing them
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_IO_BAM_CONCATENATOR_HH
+#define EAGLE_IO_BAM_CONCATENATOR_HH
+
+#include <vector>
+#include <boost/filesystem.hpp>
+
+
+namespace eagle
+{
+namespace io
+{
+namespace bam
+{
+
+/**
+ ** \brief Writes bamPath and bamPath.bai from the BAM files in parts and their .bai indexes
+ **
+ ** The parts must share the same header, stored in BGZF blocks of its own (see BamOrMetadataOutput),
+ ** and cover distinct contigs, given in reference order. The BGZF blocks of their alignments are copied
+ ** as they are. The index of each contig is taken from the part containing it, with its virtual offsets
+ ** shifted by the position the part's alignments moved to.
+ **/
+void concatenateBams( const std::vector<boost::filesystem::path> &parts, const boost::filesystem::path &bamPath );
+
+
+} // namespace bam
+} // namespace io
+} // namespace eagle
+
+#endif // EAGLE_IO_BAM_CONCATENATOR_HH
@@ -79,6 +79,7 @@ typedef std::pair< VirtualOffset, VirtualOffset > VirtualOffsetPair;
 
 class BamParserFilter
 {
+protected:
     // 512 Mbases is the longest chromosome length allowed in a BAM index
     static const unsigned int BAM_MAX_CONTIG_LENGTH     = 512*1024*1024; 
 
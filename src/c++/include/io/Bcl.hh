@@ -15,6 +15,8 @@
 
 #include <string>
 #include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
 #include "common/Exceptions.hh"
 
 
@@ -24,14 +26,34 @@ namespace io
 {
 
 
-class BclTile
+// BCL_FORMAT_CBCL tiles don't write any base call themselves: they get gathered by a CbclWriter
+enum BclFormat { BCL_FORMAT_BCL, BCL_FORMAT_BCL_GZ, BCL_FORMAT_CBCL };
+
+
+class BclTile : boost::noncopyable
 {
 public:
-    BclTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const std::string &filenameTemplate, const std::string &statsFilenameTemplate, const std::string &filterFilename, const std::string &clocsFilename, const std::string &controlFilename, const bool verbose=true );
+    // With a non-zero blockSize smaller than the tile, only blockSize clusters are kept in memory:
+    // each full block gets appended to the per-cycle files, which bounds the memory used per tile
+    BclTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const std::string &filenameTemplate, const std::string &statsFilenameTemplate, const std::string &filterFilename, const std::string &clocsFilename, const std::string &controlFilename, const bool verbose=true, const BclFormat format = BCL_FORMAT_BCL, const unsigned long long blockSize = 0 );
+    ~BclTile();
     void addClusterToRandomLocation( const char *bufCluster, const bool isPassingFilter = true );
-    void flushToDisk() const;
+    // clusterCount clusters stored cycle by cycle: the byte of cluster i at cycle c is bclBlock[c*clusterCount+i]
+    void addClusters( const char *bclBlock, const unsigned int clusterCount, const std::vector<char> &isPassingFilter );
+    void flushToDisk();
+
+    unsigned int getClusterCount() const { return expectedReadCount_; }
+    // Gzip-compressed CBCL block of one cycle: 4 bits per cluster, made of the base and the quality bin.
+    // Streaming tiles must have been flushed first
+    void getCompressedCbclBlock( const unsigned int cycle, std::vector<char> &compressedBlock ) const;
 
 private:
+    bool isStreaming() const { return blockSize_ < expectedReadCount_; }
+    std::string getBclFilename( const unsigned int cycle ) const;
+    // Uncompressed BCL file of a cycle, filled block by block when streaming
+    std::string getSpillFilename( const unsigned int cycle ) const;
+    void spillBlock( const unsigned long long paddingClusterCount = 0 );
+    void compressSpillFile( const unsigned int cycle ) const;
     void writeBclFile( const unsigned int cycle ) const;
     void writeStatsFile( const unsigned int cycle ) const;
     void writeFilterFile() const;
@@ -40,6 +62,7 @@ private:
 
     unsigned long long expectedReadCount_;
     unsigned int clusterLength_;
+    BclFormat format_;
     std::string filenameTemplate_;
     std::string statsFilenameTemplate_;
     std::string filterFilename_;
@@ -47,8 +70,45 @@ private:
     std::string controlFilename_;
     //    vector<bool> usedLocations;
     std::vector<std::vector<unsigned int> > stats_;
-    char *ramTile_;
+    unsigned long long blockSize_;
+    char *ramTile_; // blockSize_ clusters, stored cycle by cycle
     std::vector<char> passFilter_;
+    unsigned long long nextPos_; // TODO: make this random
+    unsigned long long blockStartPos_;
+};
+
+
+/**
+ ** \brief NovaSeq-style CBCL files of one lane surface: one file per cycle, containing all the tiles of the surface
+ **
+ ** Tiles can be added concurrently from several threads.
+ ** The files are written when the last expected tile gets added.
+ **/
+class CbclWriter : boost::noncopyable
+{
+public:
+    CbclWriter( const std::string &filenameTemplate, const unsigned int clusterLength, const unsigned int expectedTileCount );
+    void addTile( const unsigned int tileId, const BclTile &tile );
+
+    static unsigned char getQualityBin( const unsigned int quality );
+
+private:
+    struct TileBlocks
+    {
+        unsigned int tileId;
+        unsigned int clusterCount;
+        std::vector< std::vector<char> > compressedBlockPerCycle;
+        bool operator<( const TileBlocks &rhs ) const { return tileId < rhs.tileId; }
+    };
+
+    void flushToDisk();
+    void writeCbclFile( const unsigned int cycle ) const;
+
+    std::string filenameTemplate_;
+    unsigned int clusterLength_;
+    unsigned int expectedTileCount_;
+    boost::mutex mutex_;
+    std::vector< TileBlocks > tiles_;
 };
 
 
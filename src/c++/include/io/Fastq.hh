@@ -16,6 +16,8 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <boost/iostreams/filtering_stream.hpp>
 #include "common/Exceptions.hh"
 #include "io/RunInfo.hh"
 
@@ -26,26 +28,40 @@ namespace io
 {
 
 
+/**
+ ** \brief Pair of FASTQ files for one tile
+ **
+ ** With compressionLevel >= 0, the files are BGZF-compressed (readable by gunzip), using compressionThreads
+ ** threads. With compressionLevel < 0, they are written as plain text.
+ **/
 class FastqTile
 {
 public:
-    FastqTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const std::string &read1FastqFilename, const std::string &read2FastqFilename, const RunInfo &runInfo, const int lane, const unsigned int tileId, const bool verbose=true );
+    FastqTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const std::string &read1FastqFilename, const std::string &read2FastqFilename, const RunInfo &runInfo, const int lane, const unsigned int tileId, const bool verbose=true, const int compressionLevel=-1, const unsigned int compressionThreads=1 );
 
     void addCluster( const std::string &read1Nucleotides, const std::string &read1Qualities, const std::string &read2Nucleotides, const std::string &read2Qualities, const bool isPassingFilter, const unsigned long coordX, const unsigned long coordY );
     void finaliseAndWriteInfo();
 
 private:
+    void openFastqStream( const std::string &filename, std::ofstream &file, boost::iostreams::filtering_ostream &stream );
+    void closeFastqStream( std::ofstream &file, boost::iostreams::filtering_ostream &stream );
+    void appendRecord( const char readNum, const std::string &nucleotides, const std::string &qualities, const bool isPassingFilter, const unsigned long coordX, const unsigned long coordY );
 
     unsigned long long expectedReadCount_;
     unsigned int clusterLength_;
     std::string filenameTemplate_;
     std::string read1FastqFilename_;
     std::string read2FastqFilename_;
+    int compressionLevel_;
+    unsigned int compressionThreads_;
     std::ofstream read1FastqFile_;
     std::ofstream read2FastqFile_;
+    boost::iostreams::filtering_ostream read1Stream_;
+    boost::iostreams::filtering_ostream read2Stream_;
     std::ofstream infoFile_;
 
     std::string readNamePrefix_;
+    std::string recordBuf_; // Reused for each record, to avoid reallocations
     unsigned long long totalReadCount_;
     unsigned long long passedFilterReadCount_;
 };
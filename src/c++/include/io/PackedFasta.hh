@@ -0,0 +1,155 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Memory-mapped 2-bit representation of FASTA files.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_IO_PACKED_FASTA_HH
+#define EAGLE_IO_PACKED_FASTA_HH
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cctype>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+
+namespace eagle
+{
+namespace io
+{
+
+
+/*
+ * Packed FASTA format, built once from a FASTA file (see packFasta) and memory-mapped read-only,
+ * so that all the processes of a node share the same physical copy through the page cache.
+ * All values are native-endian 64-bit unsigned integers unless specified otherwise, and each section is 8-byte aligned:
+ *   header:   magic, version, footerOffset
+ *   contigs:  2-bit bases (A=0, C=1, G=2, T=3; base i in bits 2*(i%4) of byte i/4)
+ *             exception runs: {start, length(32 bits), base(8 bits), 24 bits padding} for upper-cased bases other than ACGT (N, IUPAC...)
+ *             mask runs:      {start, length} for lower-case bases
+ *   footer:   contigCount, then for each contig: nameLength, name (padded), size, basesOffset, exceptionCount, exceptionOffset, maskCount, maskOffset
+ */
+struct PackedFastaException
+{
+    unsigned long start;
+    unsigned int length;
+    char base;
+    char padding[3];
+};
+
+struct PackedFastaMask
+{
+    unsigned long start;
+    unsigned long length;
+};
+
+// Index of the first exception and mask runs starting after the last position looked up in a contig:
+// bases are mostly requested sequentially, which avoids a binary search for each of them.
+// The reader itself is immutable, so that threads can share it with a cursor each
+struct PackedFastaCursor
+{
+    PackedFastaCursor() : exception( 0 ), mask( 0 ) {}
+    unsigned long exception;
+    unsigned long mask;
+};
+
+struct PackedFastaContig
+{
+    std::string name;
+    unsigned long size;
+    const unsigned char *bases;
+    const PackedFastaException *exceptions;
+    unsigned long exceptionCount;
+    const PackedFastaMask *masks;
+    unsigned long maskCount;
+};
+
+
+class PackedFastaWriter : boost::noncopyable
+{
+public:
+    static const unsigned long MAGIC = 0x41545341464b4150ul; // "PAKFASTA"
+    static const unsigned long VERSION = 1;
+
+    PackedFastaWriter( const boost::filesystem::path& filename );
+    void beginContig( const std::string& name );
+    void add( const char *bases, const unsigned long count );
+    void endContig();
+    void close();
+
+    static boost::filesystem::path packedFilename( const boost::filesystem::path& fastaPath ) { return fastaPath.string() + ".packed"; }
+    static bool isUpToDate( const boost::filesystem::path& fastaPath );
+
+private:
+    void align();
+    void writeUnsignedLong( const unsigned long value ) { out_.write( (const char*)&value, sizeof(unsigned long) ); }
+
+    struct ContigEntry
+    {
+        std::string name;
+        unsigned long size, basesOffset, exceptionCount, exceptionOffset, maskCount, maskOffset;
+    };
+
+    const boost::filesystem::path filename_;
+    const boost::filesystem::path tmpFilename_;
+    std::ofstream out_;
+    std::vector< ContigEntry > contigs_;
+    std::vector< PackedFastaException > exceptions_; // of the current contig
+    std::vector< PackedFastaMask > masks_;           // of the current contig
+    unsigned char currentByte_;
+    bool contigStarted_;
+};
+
+
+class PackedFastaReader : boost::noncopyable
+{
+public:
+    PackedFastaReader( const boost::filesystem::path& filename );
+
+    unsigned int contigCount() const { return contigs_.size(); }
+    const PackedFastaContig& contig( const unsigned int i ) const { return contigs_[i]; }
+    int findContig( const std::string& name ) const;
+
+    // 'cursor' must only be used with one contig at a time
+    char get( const unsigned int contigNum, const unsigned long pos, PackedFastaCursor& cursor ) const
+    {
+        const PackedFastaContig& contig = contigs_[contigNum];
+        char base = "ACGT"[ (contig.bases[pos >> 2] >> ((pos & 3) << 1)) & 3 ];
+        if (contig.exceptionCount)
+        {
+            const PackedFastaException *exception = findException( contig, pos, cursor.exception );
+            if (exception)
+            {
+                base = exception->base;
+            }
+        }
+        if (contig.maskCount && isMasked( contig, pos, cursor.mask ))
+        {
+            base = tolower( base );
+        }
+        return base;
+    }
+
+private:
+    static const PackedFastaException *findException( const PackedFastaContig& contig, const unsigned long pos, unsigned long& cursor );
+    static bool isMasked( const PackedFastaContig& contig, const unsigned long pos, unsigned long& cursor );
+
+    boost::iostreams::mapped_file_source file_;
+    std::vector< PackedFastaContig > contigs_;
+    boost::unordered_map< std::string, unsigned int > contigIndexByName_;
+};
+
+
+} // namespace io
+} // namespace eagle
+
+#endif // EAGLE_IO_PACKED_FASTA_HH
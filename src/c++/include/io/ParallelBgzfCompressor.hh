@@ -0,0 +1,173 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description multi-threaded bgzf filtering stream: the uncompressed data is cut into
+ ** bgzf blocks, which are deflated by a pool of worker threads and written out in order.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_BAM_PARALLEL_BGZF_COMPRESSOR_HH
+#define EAGLE_BAM_PARALLEL_BGZF_COMPRESSOR_HH
+
+#include <vector>
+#include <boost/exception_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+
+namespace eagle
+{
+namespace io
+{
+namespace bam
+{
+
+namespace bios=boost::iostreams;
+
+
+/**
+ ** \brief Fixed-size ring of bgzf blocks shared between the writing thread and the compression threads
+ **
+ ** Only the writing thread fills blocks and collects the compressed ones, in submission order.
+ **/
+class BgzfBlockQueue : boost::noncopyable
+{
+public:
+    BgzfBlockQueue(const int compressionLevel, const unsigned int threadCount);
+    ~BgzfBlockQueue();
+
+    // Uncompressed buffer of the block currently being filled by the writing thread
+    std::vector<char> &fillingBlock() {return blocks_[submitted_ % blocks_.size()].uncompressed;}
+    void submitFillingBlock();
+    bool isFull() const {return submitted_ - collected_ == blocks_.size();}
+
+    // Oldest submitted block, once compressed. Returns 0 if no block is pending, or if wait is false and the oldest one is not ready yet
+    const std::vector<char> *oldestCompressedBlock(const bool wait);
+    void releaseOldestBlock();
+
+private:
+    struct Block
+    {
+        Block() : compressed(false) {}
+        std::vector<char> uncompressed;
+        std::vector<char> bgzf;
+        bool compressed;
+    };
+
+    void compressBlocks();
+
+    const int compressionLevel_;
+    std::vector<Block> blocks_;
+    unsigned long submitted_;
+    unsigned long nextToCompress_;
+    unsigned long collected_;
+    bool stopping_;
+    boost::exception_ptr workerException_;
+
+    boost::mutex mutex_;
+    boost::condition_variable blockSubmitted_;
+    boost::condition_variable blockCompressed_;
+    boost::thread_group workers_;
+};
+
+
+/**
+ ** \brief Drop-in replacement for BgzfCompressor using several threads
+ **
+ ** Only the calling thread writes to the sink, so the downstream filters (e.g. BamIndexer) see the same
+ ** sequence of complete bgzf blocks as with BgzfCompressor.
+ **/
+class ParallelBgzfCompressor
+{
+public:
+    typedef char char_type;
+    struct category : bios::multichar_output_filter_tag , bios::flushable_tag {};
+
+    // Less than the 64KB bgzf limit, so that even incompressible data fits in a block once deflated
+    static const unsigned int max_uncompressed_per_block_ = 0xFF00;
+
+public:
+    ParallelBgzfCompressor(const int compressionLevel = bios::gzip::default_compression, const unsigned int threadCount = boost::thread::hardware_concurrency());
+    ParallelBgzfCompressor(const ParallelBgzfCompressor& that);
+
+    template <typename Sink>
+    std::streamsize write(Sink &snk, const char* s, std::streamsize n);
+
+    template<typename Sink>
+    bool flush(Sink& snk);
+
+private:
+    template<typename Sink>
+    void writeCompressedBlocks(Sink& snk, bool waitForOldest, const bool waitForAll);
+
+    const int compressionLevel_;
+    const unsigned int threadCount_;
+
+    // Created on first write only: boost::iostreams copies the filters pushed onto a chain
+    boost::shared_ptr<BgzfBlockQueue> blockQueue_;
+};
+
+template <typename Sink>
+std::streamsize ParallelBgzfCompressor::write(Sink &snk, const char* s, std::streamsize src_size)
+{
+    if (!blockQueue_)
+    {
+        blockQueue_.reset( new BgzfBlockQueue( compressionLevel_, threadCount_ ) );
+    }
+
+    std::streamsize left = src_size;
+    while (left)
+    {
+        std::vector<char> &block = blockQueue_->fillingBlock();
+        const std::streamsize to_buffer = std::min<std::streamsize>( max_uncompressed_per_block_ - block.size(), left );
+        block.insert( block.end(), s, s + to_buffer );
+        s += to_buffer;
+        left -= to_buffer;
+
+        if (block.size() == max_uncompressed_per_block_)
+        {
+            blockQueue_->submitFillingBlock();
+            writeCompressedBlocks( snk, blockQueue_->isFull(), false );
+        }
+    }
+    return src_size;
+}
+
+template<typename Sink>
+bool ParallelBgzfCompressor::flush(Sink& snk)
+{
+    if (blockQueue_)
+    {
+        if (!blockQueue_->fillingBlock().empty())
+        {
+            blockQueue_->submitFillingBlock();
+        }
+        writeCompressedBlocks( snk, true, true );
+    }
+    return true;
+}
+
+template<typename Sink>
+void ParallelBgzfCompressor::writeCompressedBlocks(Sink& snk, bool waitForOldest, const bool waitForAll)
+{
+    while (const std::vector<char> *bgzfBlock = blockQueue_->oldestCompressedBlock( waitForOldest || waitForAll ))
+    {
+        bios::write( snk, &bgzfBlock->front(), bgzfBlock->size() );
+        blockQueue_->releaseOldestBlock();
+        waitForOldest = false;
+    }
+}
+
+
+} // namespace bam
+} // namespace io
+} // namespace eagle
+
+
+#endif // EAGLE_BAM_PARALLEL_BGZF_COMPRESSOR_HH
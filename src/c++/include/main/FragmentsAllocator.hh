@@ -39,9 +39,9 @@ public:
 private:
     void setRandomSeed();
     model::FragmentWithAllocationMetadata getNextFragment( boost::shared_ptr<eagle::model::IntervalGenerator>& randomInterval,
-                                                           boost::shared_ptr<eagle::model::MultiFragmentFilesReader>& multiFragmentFilesReader,
                                                            const unsigned long fragmentNum,
                                                            const unsigned long fragmentCount );
+    void mergeExistingFragments( const std::vector<unsigned long>& contigLengths, const std::vector<std::string>& contigNames );
 
     const FragmentsAllocatorOptions &options_;
 //    boost::shared_ptr< boost::mt19937 > randomGen_;
@@ -0,0 +1,91 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Set of discrete distributions compiled into Walker/Vose alias tables,
+ ** for O(1) sampling with a single 32-bit random number.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_MODEL_ALIAS_TABLE_HH
+#define EAGLE_MODEL_ALIAS_TABLE_HH
+
+#include <cassert>
+#include <vector>
+#include <stdint.h>
+
+
+namespace eagle
+{
+namespace model
+{
+
+/**
+ ** \brief Many discrete distributions over {0..n-1}, stored in one contiguous array
+ **
+ ** All the tables are padded to the width of the widest distribution, so that table i starts at i*width.
+ ** Like boost::random::discrete_distribution, an empty weight vector behaves as the distribution {1.0}.
+ **/
+class AliasTables
+{
+public:
+    AliasTables() : width_( 0 ), table_( 0 ) {}
+    explicit AliasTables( const std::vector< std::vector< double > >& weightsPerTable ) { build( weightsPerTable ); }
+    AliasTables( const AliasTables& other ) { *this = other; }
+    AliasTables& operator=( const AliasTables& other );
+
+    void build( const std::vector< std::vector< double > >& weightsPerTable );
+
+    // Uses tables compiled beforehand (see entryData), stored in memory that must outlive this object, e.g. a memory-mapped file
+    void assign( const unsigned int width, const std::vector< unsigned int >& outcomeCounts, const void *entries );
+
+    unsigned int size() const { return outcomeCounts_.size(); }
+    unsigned int width() const { return width_; }
+    const std::vector< unsigned int >& outcomeCounts() const { return outcomeCounts_; }
+
+    // size()*width() entries of 8 bytes, in native byte order
+    const void *entryData() const { return table_; }
+    unsigned long entryBytes() const { return static_cast<unsigned long>( size() ) * width_ * sizeof(Entry); }
+
+    // Number of weights the distribution was built from (equivalent to discrete_distribution::max()+1)
+    unsigned int outcomeCount( const unsigned int tableNum ) const { return outcomeCounts_[tableNum]; }
+
+    // The high bits of random*width select a column, the low bits decide between the column and its alias
+    unsigned int get( const unsigned int tableNum, const uint32_t random ) const
+    {
+        assert( tableNum < outcomeCounts_.size() );
+        const uint64_t scaled = static_cast<uint64_t>( random ) * width_;
+        const unsigned int column = scaled >> 32;
+        const Entry &entry = table_[ tableNum * width_ + column ];
+        return (static_cast<uint32_t>( scaled ) < entry.threshold) ? column : entry.alias;
+    }
+
+    template< class RandomGen >
+    unsigned int operator()( const unsigned int tableNum, RandomGen &randomGen ) const
+    {
+        return get( tableNum, static_cast<uint32_t>( randomGen() ) );
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t threshold; // probability of keeping this column, scaled to 2^32
+        uint32_t alias;
+    };
+
+    void buildTable( const std::vector< double >& weights, Entry *table );
+
+    unsigned int width_;
+    std::vector< Entry > entries_; // empty when the tables are stored elsewhere
+    const Entry *table_;           // either &entries_[0] or the external tables
+    std::vector< unsigned int > outcomeCounts_;
+};
+
+
+} // namespace model
+} // namespace eagle
+
+#endif // EAGLE_MODEL_ALIAS_TABLE_HH
@@ -15,8 +15,11 @@
 #include <utility>
 #include <iostream>
 #include <fstream>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/shared_ptr.hpp>
 
 
 using namespace std;
@@ -72,6 +75,8 @@ public:
 };
 
 
+struct FragmentBlockHeader;
+
 class FragmentList
 {
 public:
@@ -83,10 +88,82 @@ public:
     FragmentWithAllocationMetadata getNextWithTile( unsigned int tilePattern = 0, unsigned int mask = -1, unsigned int *tilePtr=0 );
     unsigned long long getTileSize( unsigned int tileNum );
     unsigned long long size();
+    bool selectTile( unsigned int tileNum ); // Only read the fragments of this tile, from the tile lists of fragments.blocks or of indexTiles(). Returns false if there are none
+    // Prepares, once, the tile views of a list that hasn't been read from: opens the FragmentList of each manifest
+    // directory, and reads the legacy files into per-tile record lists (12 bytes per fragment)
+    void indexTiles();
+    // Fragments of one tile, sharing the mapped files and the tile lists of this list: the views of a list can be
+    // created and read by concurrent threads, as the list itself is left untouched
+    FragmentList tileView( const unsigned int tileNum ) const;
     
 private:
-    ifstream in1, in2, in3, in4;
+    void readManifest( const boost::filesystem::path& filename );
+    bool openNextManifestEntry();
+    FragmentWithAllocationMetadata getNextFromManifest( const unsigned int desiredTile, const unsigned int mask );
+    // Moves currentPos_ and fragmentNum_ to the next record. Returns false at the end
+    // desiredTile and mask are only used to skip the blocks of fragments.blocks that cannot match
+    bool readNextRecord( unsigned long& length, unsigned int& tile, const unsigned int desiredTile, const unsigned int mask );
+    bool decodeNextPositions();
+    bool decodeNextTileRecords();
+    bool isManifestEntryInRegion( const unsigned int entryNum ) const;
+    FragmentList *openManifestEntry( const unsigned int entryNum ) const; // restricted to the requested region
+    void openBlockFile( const boost::filesystem::path& filename );
+    // Decodes the matching blocks of the next group with any of them
+    bool decodeNextBlock( const unsigned int desiredTile, const unsigned int mask );
+    // Appends the records of a block to the batch, or stores them at their rank in the group when scattering
+    void decodeBlock( const FragmentBlockHeader& header, const char *block, const bool scatter );
+
+    const boost::filesystem::path dir_;
+    // fragments.manifest, used instead of all the other files except fragments.stats when present
+    struct ManifestEntry
+    {
+        boost::filesystem::path dir;
+        unsigned long posOffset;
+        unsigned long firstFragmentNum; // 0-based, sum of the fragment counts of the previous entries
+    };
+    std::vector<ManifestEntry> manifestEntries_;
+    unsigned int nextManifestEntry_;
+    boost::shared_ptr<FragmentList> manifestFragmentList_; // FragmentList of manifestEntries_[nextManifestEntry_-1]
+    std::vector< boost::shared_ptr<const FragmentList> > manifestEntryLists_; // filled by indexTiles(), null outside of the region
+    const unsigned long fetchBefore_;
+
+    // fragments.blocks, used instead of the other files when present: memory-mapped, and decoded one block at a time
+    boost::iostreams::mapped_file_source blockFile_;
+    unsigned long blockTileCount_;
+    // Shared by the tile views: blockOffsets_ points to all the blocks, or only to those of the selected tile
+    typedef std::vector<unsigned long> BlockOffsets;
+    boost::shared_ptr<const BlockOffsets> allBlockOffsets_;
+    boost::shared_ptr<const std::vector<BlockOffsets> > tileBlockOffsets_;
+    const BlockOffsets *blockOffsets_;
+    unsigned int nextBlock_;
+    std::vector<unsigned char> blockPayload_;
+    std::vector<unsigned int> blockSlots_;
+
+    // fragments.stats, and the legacy fragments.{pos,length,tile}, memory-mapped unless missing or empty
+    // The legacy files are only read for compatibility with the directories written before fragments.blocks
+    boost::iostreams::mapped_file_source posFile_, lengthFile_, tileFile_, statsFile_;
+    const unsigned short *posWords_, *lengths_, *tiles_;
+    unsigned long posWordCount_;
+    unsigned long recordCount_; // records available in both fragments.length and fragments.tile
+    unsigned long nextPosWord_;
     unsigned int fragmentNum_;
+    // Records of each tile in the legacy files, filled by indexTiles() and shared with the tile views
+    struct TileRecords
+    {
+        std::vector<unsigned long> positions;
+        std::vector<unsigned int> fragmentNums;
+    };
+    boost::shared_ptr<const std::vector<TileRecords> > legacyTileRecords_;
+    unsigned long nextTileRecord_;
+
+    // Next records, decoded by batches from fragments.{pos,length,tile} or one group of blocks at a time from fragments.blocks
+    std::vector<unsigned long> positions_;
+    std::vector<unsigned int> batchLengths_, batchTiles_, batchFragmentNums_;
+    unsigned int positionCount_;
+    unsigned int nextPosition_;
+
+    bool tileSelected_;
+    unsigned int selectedTile_;
 
 
     unsigned long insertSize_;
@@ -100,33 +177,84 @@ private:
 };
 
 
-class MultiFragmentFilesReader
+/*
+ * fragments.manifest v1: virtual merge of fragment directories (usually one per contig), read one after the other
+ * without copying their fragments. Text file:
+ *   Header: "#EAGLE fragments manifest v1", followed by a "#" comment line with the column names
+ *   Entries: one tab-separated line per directory, ordered by increasing position offset:
+ *            directory (relative to the manifest's directory unless absolute), global position offset, fragment count
+ * The fragments of each directory are shifted by its position offset, and numbered after those of the previous directories
+ */
+class FragmentManifestWriter
 {
 public:
-    MultiFragmentFilesReader( const std::vector<unsigned long>& contigLengths, const std::vector<string>& contigNames, const boost::filesystem::path& dir, unsigned long& readCount, const bool verbose=true );
-    virtual ~MultiFragmentFilesReader() {}
-    FragmentWithAllocationMetadata getNext( const signed long testValue = -1 );
+    static const unsigned long VERSION = 1;
+
+    FragmentManifestWriter( const boost::filesystem::path& filename );
+    void add( const boost::filesystem::path& dir, const unsigned long posOffset, const unsigned long fragmentCount );
+    void close();
 
 private:
-    bool openNextFragmentList( bool advance );
+    const boost::filesystem::path filename_;
+    ofstream out_;
+};
+
+
 /*
-    double step_;
-    struct ContigIntervalInfo
-    {
-        unsigned long firstGlobalPos;
-        unsigned long lastGlobalPos;
-    };
-    std::vector<ContigIntervalInfo> contigIntervalInfo_;
-    std::vector<ContigIntervalInfo>::iterator currentContigIntervalInfo_;
-*/
-    const std::vector<unsigned long> contigLengths_;
-    const std::vector<string> contigNames_;
-    const boost::filesystem::path dir_;
-    unsigned int currentContigNum_;
-    unsigned long currentContigStartPos_;
-    FragmentList *fragmentList_;
+ * fragments.blocks v2: the fragment records split into groups of groupSize consecutive records, each group stored as
+ * one block per tile with records in it. Blocks are compressed and checksummed independently, so that a tile process
+ * only decodes the blocks of its tile, and readers of a region skip the groups outside of it
+ *   Header: unsigned long magic, unsigned long version, unsigned long tileCount, unsigned long groupSize
+ *   Blocks: FragmentBlockHeader, followed by the zlib-compressed payload, made of unsigned LEB128 varints:
+ *           recordCount fragment number differences (the first one relative to firstFragmentNum),
+ *           then recordCount position differences (the first one relative to minPos), then recordCount lengths
+ *           The blocks of a group follow each other by increasing tile
+ *   Footer: unsigned long blockCount, followed by blockCount block offsets
+ *           for each tile: unsigned long blockCount, followed by the offsets of the tile's blocks
+ *           unsigned long footerOffset (last 8 bytes of the file)
+ */
+struct FragmentBlockHeader
+{
+    unsigned long firstFragmentNum; // 0-based, first record of the group
+    unsigned long minPos;           // start of the first record
+    unsigned long maxPos;           // last base covered by any record
+    unsigned int tile;
+    unsigned int recordCount;
+    unsigned int groupRecordCount;  // in all the blocks of the group
+    unsigned int payloadSize;       // uncompressed
+    unsigned int compressedSize;
+    unsigned int checksum;          // CRC-32 of the uncompressed payload
 };
 
+class FragmentBlockWriter
+{
+public:
+    static const unsigned long MAGIC = 0x4b4c424741524645ul; // "EFRAGBLK"
+    static const unsigned long VERSION = 2;
+
+    FragmentBlockWriter( const boost::filesystem::path& filename, const unsigned long tileCount, const unsigned int groupSize = 65536 );
+    ~FragmentBlockWriter();
+    void add( const FragmentWithAllocationMetadata& f ); // fragments must be added by increasing startPos_
+    void close();
+
+private:
+    void flushGroup();
+    void writeBlock( const unsigned int tile );
+
+    const boost::filesystem::path filename_;
+    ofstream out_;
+    const unsigned long tileCount_;
+    const unsigned int groupSize_;
+    unsigned long fragmentCount_;
+    std::vector<unsigned long> positions_;
+    std::vector<unsigned long> lengths_;
+    std::vector< std::vector<unsigned int> > tileRecords_; // ranks in the group of each tile's records
+    std::vector<unsigned char> payload_;
+    std::vector<unsigned char> compressed_;
+    std::vector<unsigned long> blockOffsets_;
+    std::vector< std::vector<unsigned long> > tileBlockOffsets_;
+    bool closed_;
+};
 
 
 } // namespace model
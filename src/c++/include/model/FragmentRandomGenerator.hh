@@ -0,0 +1,97 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Counter-based (Philox4x32-10) random number generator, giving each fragment
+ ** its own reproducible stream without any seeding cost.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_MODEL_FRAGMENT_RANDOM_GENERATOR_HH
+#define EAGLE_MODEL_FRAGMENT_RANDOM_GENERATOR_HH
+
+#include <stdint.h>
+
+
+namespace eagle
+{
+namespace model
+{
+
+/**
+ ** \brief Random stream of a fragment, keyed by (userRandomSeed, fragmentNum)
+ **
+ ** The n-th value of the stream is a pure function of (seed, fragmentNum, n), so a read is
+ ** identical whichever process or thread simulates it. The state is 32 bytes and lives on the stack.
+ ** Models the UniformRandomNumberGenerator concept, so it can drive boost::random distributions.
+ **/
+class FragmentRandomGenerator
+{
+public:
+    typedef uint32_t result_type;
+    static const bool has_fixed_range = true;
+    static const result_type min_value = 0;
+    static const result_type max_value = 0xFFFFFFFF;
+
+    FragmentRandomGenerator( const uint32_t seed, const uint64_t fragmentNum )
+        : blockNum_( 0 )
+        , posInBlock_( 4 )
+    {
+        key_[0] = seed;
+        key_[1] = 0;
+        fragmentNum_[0] = static_cast<uint32_t>( fragmentNum );
+        fragmentNum_[1] = static_cast<uint32_t>( fragmentNum >> 32 );
+    }
+
+    static result_type (min)() { return min_value; }
+    static result_type (max)() { return max_value; }
+
+    result_type operator()()
+    {
+        if (posInBlock_ == 4)
+        {
+            const uint32_t counter[4] = { fragmentNum_[0], fragmentNum_[1], blockNum_++, 0 };
+            philox4x32( counter, key_, block_ );
+            posInBlock_ = 0;
+        }
+        return block_[posInBlock_++];
+    }
+
+    // Philox4x32 with 10 rounds, as specified by Salmon et al., "Parallel random numbers: as easy as 1, 2, 3" (SC'11)
+    static void philox4x32( const uint32_t counter[4], const uint32_t key[2], uint32_t result[4] )
+    {
+        uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (unsigned int round=0; round<10; ++round)
+        {
+            const uint64_t product0 = static_cast<uint64_t>( 0xD2511F53 ) * c0;
+            const uint64_t product1 = static_cast<uint64_t>( 0xCD9E8D57 ) * c2;
+            c0 = static_cast<uint32_t>( product1 >> 32 ) ^ c1 ^ k0;
+            c1 = static_cast<uint32_t>( product1 );
+            c2 = static_cast<uint32_t>( product0 >> 32 ) ^ c3 ^ k1;
+            c3 = static_cast<uint32_t>( product0 );
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        result[0] = c0;
+        result[1] = c1;
+        result[2] = c2;
+        result[3] = c3;
+    }
+
+private:
+    uint32_t key_[2];
+    uint32_t fragmentNum_[2];
+    uint32_t blockNum_;
+    unsigned int posInBlock_;
+    uint32_t block_[4];
+};
+
+
+} // namespace model
+} // namespace eagle
+
+#endif // EAGLE_MODEL_FRAGMENT_RANDOM_GENERATOR_HH
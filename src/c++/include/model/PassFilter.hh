@@ -13,6 +13,7 @@
 #define EAGLE_MODEL_PASS_FILTER_HH
 
 #include <string>
+#include <vector>
 
 
 namespace eagle
@@ -33,6 +34,25 @@ public:
         return (Ncount < 64);
     }
 
+    // Same test for each cluster of a block stored cycle by cycle (bclBlock[cycle*clusterCount+i] for cluster i)
+    static void getBclBlockPassFilter( const char *bclBlock, const unsigned int clusterCount, const unsigned int clusterLength, std::vector<char> &isPassingFilter )
+    {
+        std::vector<unsigned int> Ncounts( clusterCount, 0 );
+        for (unsigned int cycle=0; cycle<clusterLength; ++cycle)
+        {
+            const char *bclCycle = bclBlock + cycle * clusterCount;
+            for (unsigned int i=0; i<clusterCount; ++i)
+            {
+                Ncounts[i] += (bclCycle[i] == 0)?1:0;
+            }
+        }
+        isPassingFilter.resize( clusterCount );
+        for (unsigned int i=0; i<clusterCount; ++i)
+        {
+            isPassingFilter[i] = (Ncounts[i] < 64);
+        }
+    }
+
     static bool isSequencePassingFilter( const std::string& seq )
     {
         unsigned int Ncount = std::count( seq.begin(), seq.end(), 'N' );
@@ -0,0 +1,78 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Runs one write task at a time in a background thread
+ **
+ ** \author Lilian Janin
+ **/
+
+#include "common/BackgroundWriter.hh"
+
+#include <boost/bind.hpp>
+
+
+namespace eagle
+{
+namespace common
+{
+
+BackgroundWriter::BackgroundWriter( const bool synchronous )
+    : synchronous_( synchronous )
+{
+}
+
+BackgroundWriter::~BackgroundWriter()
+{
+    // Only reached without wait() when unwinding from another error, which takes precedence over ours
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void BackgroundWriter::write( const boost::function<void ()> &task )
+{
+    wait();
+    if (synchronous_)
+    {
+        task();
+    }
+    else
+    {
+        thread_ = boost::thread( boost::bind( &BackgroundWriter::runTask, this, task ) );
+    }
+}
+
+void BackgroundWriter::wait()
+{
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    if (taskException_)
+    {
+        const boost::exception_ptr taskException = taskException_;
+        taskException_ = boost::exception_ptr();
+        boost::rethrow_exception( taskException );
+    }
+}
+
+void BackgroundWriter::runTask( const boost::function<void ()> task )
+{
+    try
+    {
+        task();
+    }
+    catch (...)
+    {
+        // Rethrown by the owner's next call to write() or wait()
+        taskException_ = boost::current_exception();
+    }
+}
+
+
+} // namespace common
+} // namespace eagle
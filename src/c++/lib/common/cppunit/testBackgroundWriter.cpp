@@ -0,0 +1,85 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <cerrno>
+#include <vector>
+#include <boost/bind.hpp>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "testBackgroundWriter.hh"
+#include "common/Exceptions.hh"
+
+using namespace eagle::common;
+
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBackgroundWriter, registryName("BackgroundWriter"));
+
+void TestBackgroundWriter::setUp()
+{
+}
+
+void TestBackgroundWriter::tearDown()
+{
+}
+
+
+namespace
+{
+
+void appendValue( vector<unsigned int> *values, const unsigned int value )
+{
+    values->push_back( value );
+}
+
+void failingWrite()
+{
+    BOOST_THROW_EXCEPTION( IoException( EIO, "background write failure" ) );
+}
+
+} // anonymous namespace
+
+
+void TestBackgroundWriter::testTasksRunInOrder()
+{
+    vector<unsigned int> values;
+    BackgroundWriter writer;
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+        writer.write( boost::bind( &appendValue, &values, i ) );
+    }
+    writer.wait();
+    CPPUNIT_ASSERT_EQUAL( 10ul, values.size() );
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL( i, values[i] );
+    }
+}
+
+void TestBackgroundWriter::testSynchronous()
+{
+    vector<unsigned int> values;
+    BackgroundWriter writer( true );
+    writer.write( boost::bind( &appendValue, &values, 42 ) );
+    CPPUNIT_ASSERT_EQUAL( 1ul, values.size() );
+    CPPUNIT_ASSERT_EQUAL( 42u, values[0] );
+}
+
+void TestBackgroundWriter::testExceptionRethrown()
+{
+    vector<unsigned int> values;
+    BackgroundWriter writer;
+    writer.write( &failingWrite );
+    CPPUNIT_ASSERT_THROW( writer.write( boost::bind( &appendValue, &values, 1 ) ), IoException );
+    CPPUNIT_ASSERT( values.empty() );
+
+    // The failure is only reported once
+    writer.write( boost::bind( &appendValue, &values, 2 ) );
+    writer.wait();
+    CPPUNIT_ASSERT_EQUAL( 1ul, values.size() );
+}
@@ -0,0 +1,31 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_COMMON_TEST_BACKGROUND_WRITER_HH
+#define EAGLE_COMMON_TEST_BACKGROUND_WRITER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "common/BackgroundWriter.hh"
+
+class TestBackgroundWriter : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBackgroundWriter );
+    CPPUNIT_TEST( testTasksRunInOrder );
+    CPPUNIT_TEST( testSynchronous );
+    CPPUNIT_TEST( testExceptionRethrown );
+    CPPUNIT_TEST_SUITE_END();
+private:
+public:
+    void setUp();
+    void tearDown();
+    void testTasksRunInOrder();
+    void testSynchronous();
+    void testExceptionRethrown();
+};
+
+#endif // EAGLE_COMMON_TEST_BACKGROUND_WRITER_HH
@@ -9,12 +9,14 @@
  ** \author Lilian Janin
  **/
 
+#include <algorithm>
+#include <cstring>
 #include <boost/iostreams/device/file.hpp>
 
-#include "model/PassFilter.hh"
 #include "genome/BamMetadata.hh"
 #include "io/Bam.hh"
 #include "io/BgzfCompressor.hh"
+#include "io/ParallelBgzfCompressor.hh"
 #include "io/BamIndexer.hh"
 
 
@@ -31,16 +33,44 @@ namespace genome
 {
 
 
-BamOrMetadataOutput::BamOrMetadataOutput( const boost::filesystem::path outFilename, eagle::io::RunInfo &runInfo, PreferredFastaReader* fastaReference )
+BamOrMetadataOutput::BamOrMetadataOutput( const boost::filesystem::path outFilename, eagle::io::RunInfo &runInfo, PreferredFastaReader* fastaReference, const int compressionLevel, const unsigned int compressionThreads, const unsigned long reorderWindowMaxBytes )
     : runInfo_( runInfo )
     , fastaReference_( fastaReference?fastaReference:eagle::genome::SharedFastaReference::get() )
+    , compressionLevel_( compressionLevel )
+    , compressionThreads_( compressionThreads )
+    , outFilename_( outFilename )
+    , recordBuilder_( *fastaReference_ )
+    , reorderWindow_( outFilename, reorderWindowMaxBytes )
+    , closed_( false )
 {
     init( outFilename );
 }
 
 BamOrMetadataOutput::~BamOrMetadataOutput()
 {
-    flushReorderedAlignmentsUntilPos( std::numeric_limits<unsigned long>::max() );
+    if (closed_)
+    {
+        return;
+    }
+    // Only reached without close() while unwinding from another error: report this one instead of throwing it
+    try
+    {
+        close();
+    }
+    catch (const std::exception &e)
+    {
+        EAGLE_WARNING( "Failed to close " << outFilename_ << ": " << e.what() );
+    }
+}
+
+void BamOrMetadataOutput::close()
+{
+    if (closed_)
+    {
+        return;
+    }
+    closed_ = true;
+    reorderWindow_.flushUntilPos( std::numeric_limits<unsigned long>::max(), bgzfStream_ );
     bgzfStream_.pop();
     io::serializeBgzfFooter( bamStream_ );
 }
@@ -50,7 +80,6 @@ void BamOrMetadataOutput::init( const boost::filesystem::path outFilename )
     // BAM creation attempt
     {
         const boost::filesystem::path bamPath( outFilename );
-        const int bamGzipLevel = boost::iostreams::gzip::best_speed;
         const std::vector<std::string> argv_;
 
         boost::iostreams::file_sink bamSink(bamPath.string());
@@ -61,7 +90,14 @@ void BamOrMetadataOutput::init( const boost::filesystem::path outFilename )
 
         bamStream_.push(bamSink);
 
-        bgzfStream_.push(eagle::io::bam::BgzfCompressor(bamGzipLevel));
+        if (compressionThreads_ > 1)
+        {
+            bgzfStream_.push(eagle::io::bam::ParallelBgzfCompressor(compressionLevel_, compressionThreads_));
+        }
+        else
+        {
+            bgzfStream_.push(eagle::io::bam::BgzfCompressor(compressionLevel_));
+        }
 
         { // Add BAM Index
             boost::filesystem::path baiPath( outFilename.string() + ".bai" );
@@ -76,6 +112,9 @@ void BamOrMetadataOutput::init( const boost::filesystem::path outFilename )
             , argv_
             , EagleBamHeaderAdapter( *fastaReference_ )
             );
+
+        // Header in BGZF blocks of its own, so that io::bam::concatenateBams can skip it without recompressing anything
+        bgzfStream_.flush();
     }
 }
 
@@ -100,7 +139,8 @@ void BamOrMetadataOutput::add( eagle::genome::ReadClusterWithErrors& readCluster
             }
 
             const vector< unsigned int > &CIGAR = readClusterWithErrors.getCigar( readNum ); // Calling getCigar first so that the lazy evaluation generates it
-            string SEQ = readClusterWithErrors.getNucleotideOrQualitySequenceForRead( readNum, true, !directionIsForward );
+            const char *bclCluster = readClusterWithErrors.getEvaluatedBclCluster();
+            const unsigned int readLength = rd.lastCycle - rd.firstCycle + 1;
             unsigned int usedDnaLength = readClusterWithErrors.getUsedDnaLength( readNum );
             if ( usedDnaLength > readClusterWithErrors.eFragment_.fragment_.fragmentLength_ )
             {
@@ -110,26 +150,23 @@ void BamOrMetadataOutput::add( eagle::genome::ReadClusterWithErrors& readCluster
             unsigned long startPos = readClusterWithErrors.eFragment_.fragment_.startPos_;
             unsigned long endPos   = readClusterWithErrors.eFragment_.fragment_.startPos_ + readClusterWithErrors.eFragment_.fragment_.fragmentLength_ - usedDnaLength;
 
-            string QNAME = (boost::format("FC:0:0:%d:%d") % (fragmentNum/100000) % (fragmentNum%100000)).str(); //readClusterWithErrors.id_;
-            bool isPassingFilter = model::PassFilter::isSequencePassingFilter( SEQ );
-            unsigned int FLAG  = 0x3 | (readNum12==1?0x40:0x80) | (directionIsForward?0x20:0x10) | (isPassingFilter?0:0x200);
+            // QC-fail flag (0x200) added by the record builder
+            unsigned int FLAG  = 0x3 | (readNum12==1?0x40:0x80) | (directionIsForward?0x20:0x10);
             unsigned long GlobalPos = directionIsForward?startPos:endPos;
             unsigned int MAPQ = 50;
             unsigned long PNEXT = directionIsForward?endPos:startPos;
             long TLEN = readClusterWithErrors.eFragment_.fragment_.fragmentLength_ * (directionIsForward?1:-1);
-            string QUAL  = readClusterWithErrors.getNucleotideOrQualitySequenceForRead( readNum, false, !directionIsForward );
-            EagleBamAlignmentAdapter eagleBamAlignmentAdapter( GlobalPos, QNAME, FLAG, MAPQ, 
-                                                               directionIsForward?CIGAR:(std::vector<unsigned int>(CIGAR.rbegin(),CIGAR.rend())),
-                                                               PNEXT, TLEN, SEQ, QUAL, *fastaReference_ );
 
             if (directionIsForward)
             {
-                flushReorderedAlignmentsUntilPos( GlobalPos );
-                io::serializeAlignment( bgzfStream_, eagleBamAlignmentAdapter );
+                reorderWindow_.flushUntilPos( GlobalPos, bgzfStream_ );
+                recordBuilder_.build( recordBuffer_, bclCluster, rd.firstCycle, readLength, false, GlobalPos, PNEXT, TLEN, fragmentNum, FLAG, MAPQ, CIGAR, false );
+                io::serialize( bgzfStream_, recordBuffer_ );
             }
             else
             {
-                addToReorderedAlignments( eagleBamAlignmentAdapter );
+                recordBuilder_.build( recordBuffer_, bclCluster, rd.firstCycle, readLength, true, GlobalPos, PNEXT, TLEN, fragmentNum, FLAG, MAPQ, CIGAR, true );
+                reorderWindow_.add( GlobalPos, recordBuffer_ );
             }
 
             ++readNum12;
@@ -157,7 +194,8 @@ void BamOrMetadataOutput::addRebased( eagle::genome::ReadClusterWithErrors& read
             }
 
             const vector< unsigned int > &CIGAR = readClusterWithErrors.getCigar( readNum, dropLastBase ); // Calling getCigar first so that the lazy evaluation generates it
-            string SEQ = readClusterWithErrors.getNucleotideOrQualitySequenceForRead( readNum, true, !directionIsForward, dropLastBase );
+            const char *bclCluster = readClusterWithErrors.getEvaluatedBclCluster( dropLastBase );
+            const unsigned int readLength = rd.lastCycle - rd.firstCycle + (dropLastBase?0:1);
             unsigned int usedDnaLength = readClusterWithErrors.getUsedDnaLength( readNum, dropLastBase );
             if ( usedDnaLength > readClusterWithErrors.eFragment_.fragment_.fragmentLength_ )
             {
@@ -170,9 +208,8 @@ void BamOrMetadataOutput::addRebased( eagle::genome::ReadClusterWithErrors& read
             signed long GlobalPos = (directionIsForward?startPos1:startPos2) + globalPosShift;
             if (GlobalPos+usedDnaLength-1 >= (signed long)firstPosToProcess && GlobalPos <= (signed long)lastPosToProcess)
             {
-                string QNAME = (boost::format("FC:0:0:%d:%d") % (readClusterWithErrors.eFragment_.fragment_.fragmentNum_/100000) % (readClusterWithErrors.eFragment_.fragment_.fragmentNum_%100000)).str(); //readClusterWithErrors.id_;
-                bool isPassingFilter = model::PassFilter::isSequencePassingFilter( SEQ );
-                unsigned int FLAG  = 0x3 | (readNum12==1?0x40:0x80) | (directionIsForward?0x20:0x10) | (isPassingFilter?0:0x200);
+                // QC-fail flag (0x200) added by the record builder
+                unsigned int FLAG  = 0x3 | (readNum12==1?0x40:0x80) | (directionIsForward?0x20:0x10);
                 unsigned int MAPQ = 50;
                 unsigned long PNEXT = (directionIsForward?startPos2:startPos1) + globalPosShift; // TODO: This PNEXT is incorrect if there are some vcf indels between the 2 ends of the cluster
                 // In the meantime, we artificially prevent PNEXT from becoming negative:
@@ -181,11 +218,14 @@ void BamOrMetadataOutput::addRebased( eagle::genome::ReadClusterWithErrors& read
                     PNEXT = 0;
                 }
                 long TLEN = readClusterWithErrors.eFragment_.fragment_.fragmentLength_ * (directionIsForward?1:-1);
-                string QUAL  = readClusterWithErrors.getNucleotideOrQualitySequenceForRead( readNum, false, !directionIsForward, dropLastBase );
 
                 // Soft-clip the CIGAR string if required
                 bool throwThisReadAway = false;
-                const vector< unsigned int > &reorderedCIGAR = directionIsForward?CIGAR:(std::vector<unsigned int>(CIGAR.rbegin(),CIGAR.rend()));
+                if (!directionIsForward)
+                {
+                    reversedCigar_.assign( CIGAR.rbegin(), CIGAR.rend() );
+                }
+                const vector< unsigned int > &reorderedCIGAR = directionIsForward?CIGAR:reversedCigar_;
                 unsigned long globalPosAfterSoftClipping = GlobalPos;
                 softClippedCIGAR.clear();
                 if (GlobalPos < (signed long)firstPosToProcess)
@@ -203,19 +243,20 @@ void BamOrMetadataOutput::addRebased( eagle::genome::ReadClusterWithErrors& read
                 {
                     const vector< unsigned int > &goodCIGAR = softClippedCIGAR.empty()?reorderedCIGAR:softClippedCIGAR;
 
-                    EagleBamAlignmentAdapter eagleBamAlignmentAdapter( globalPosAfterSoftClipping, QNAME, FLAG, MAPQ, goodCIGAR,
-                                                                       PNEXT, TLEN, SEQ, QUAL, *fastaReference_ );
+                    const unsigned long fragmentNum = readClusterWithErrors.eFragment_.fragment_.fragmentNum_;
 
                     if (directionIsForward)
                     {
-                        flushReorderedAlignmentsUntilPos( globalPosAfterSoftClipping );
-                        io::serializeAlignment( bgzfStream_, eagleBamAlignmentAdapter );
+                        reorderWindow_.flushUntilPos( globalPosAfterSoftClipping, bgzfStream_ );
+                        recordBuilder_.build( recordBuffer_, bclCluster, rd.firstCycle, readLength, false, globalPosAfterSoftClipping, PNEXT, TLEN, fragmentNum, FLAG, MAPQ, goodCIGAR, false );
+                        io::serialize( bgzfStream_, recordBuffer_ );
                     }
                     else
                     {
                         if (lastPosToProcess && startPos2+globalPosShift <= lastPosToProcess)
                         {
-                            addToReorderedAlignments( eagleBamAlignmentAdapter );
+                            recordBuilder_.build( recordBuffer_, bclCluster, rd.firstCycle, readLength, true, globalPosAfterSoftClipping, PNEXT, TLEN, fragmentNum, FLAG, MAPQ, goodCIGAR, false );
+                            reorderWindow_.add( globalPosAfterSoftClipping, recordBuffer_ );
                         }
                     }
                 }
@@ -411,29 +452,6 @@ void BamOrMetadataOutput::softClipCIGAR( const vector< unsigned int > &CIGAR, un
     }
 }
 
-void BamOrMetadataOutput::flushReorderedAlignmentsUntilPos( unsigned long GlobalPos )
-{
-    while (reorderedAlignmentsWindow_.size() >0 && reorderedAlignmentsWindow_.begin()->GlobalPos_ <= GlobalPos)
-    {
-        io::serializeAlignment( bgzfStream_, *reorderedAlignmentsWindow_.begin() );
-        reorderedAlignmentsWindow_.pop_front();
-    }
-}
-
-void BamOrMetadataOutput::addToReorderedAlignments( EagleBamAlignmentAdapter &alignment )
-{
-    list<EagleBamAlignmentAdapter>::reverse_iterator itr;
-    for (itr=reorderedAlignmentsWindow_.rbegin(); itr!=reorderedAlignmentsWindow_.rend(); ++itr)
-    {
-        if (itr->GlobalPos_ <= alignment.GlobalPos_)
-        {
-            reorderedAlignmentsWindow_.insert( itr.base(), alignment );
-            return;
-        }
-    }
-    reorderedAlignmentsWindow_.push_front( alignment );
-}
-
 
 } // namespace genome
 } // namespace eagle
@@ -0,0 +1,148 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Encodes BAM alignment records straight from the BCL bytes of the read clusters
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <cstdio>
+#include <cstring>
+
+#include "genome/BamRecordBuilder.hh"
+#include "io/Bam.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace genome
+{
+
+
+namespace
+{
+
+template <typename T>
+void write( char *&dest, const T value )
+{
+    memcpy( dest, &value, sizeof(value) );
+    dest += sizeof(value);
+}
+
+} // anonymous namespace
+
+
+EagleBamRecordBuilder::EagleBamRecordBuilder( PreferredFastaReader& fastaReference )
+    : fastaReference_( fastaReference )
+    , contigLengths_( fastaReference.allContigLengths() )
+    , cachedRefId_( -1 )
+    , cachedContigStart_( 0 )
+    , cachedContigEnd_( 0 )
+{
+}
+
+void EagleBamRecordBuilder::convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& pos )
+{
+    if (globalPos < cachedContigStart_ || globalPos >= cachedContigEnd_)
+    {
+        unsigned long posInContig;
+        fastaReference_.convertFromGlobalPos( globalPos, refId, posInContig );
+        pos = posInContig - 1;
+        if (refId >= 0 && static_cast<unsigned int>(refId) < contigLengths_.size())
+        {
+            cachedRefId_ = refId;
+            cachedContigStart_ = globalPos - pos;
+            cachedContigEnd_ = cachedContigStart_ + contigLengths_[refId];
+        }
+        return;
+    }
+    refId = cachedRefId_;
+    pos = globalPos - cachedContigStart_;
+}
+
+void EagleBamRecordBuilder::build( vector<char>& record,
+                                   const char *bclCluster,
+                                   const unsigned int firstCycle,
+                                   const unsigned int readLength,
+                                   const bool revComp,
+                                   const unsigned long globalPos,
+                                   const unsigned long globalPNext,
+                                   const long tlen,
+                                   const unsigned long fragmentNum,
+                                   unsigned int flag,
+                                   const unsigned int mapq,
+                                   const vector<unsigned int>& cigar,
+                                   const bool reverseCigar )
+{
+    char readName[64];
+    const int readNameLength = snprintf( readName, sizeof(readName), "FC:0:0:%lu:%lu", fragmentNum/100000, fragmentNum%100000 );
+
+    int refId, nextRefId;
+    unsigned long pos, nextPos;
+    convertFromGlobalPos( globalPos, refId, pos );
+    convertFromGlobalPos( globalPNext, nextRefId, nextPos );
+
+    const unsigned int seqSize = (readLength + 1) / 2;
+    const int blockSize = 8*sizeof(int) + readNameLength + 1 + cigar.size()*sizeof(unsigned int) + seqSize + readLength;
+    record.resize( sizeof(int) + blockSize );
+
+    // SEQ and QUAL first, as the pass filter flag depends on the number of no-calls
+    unsigned char *seq = reinterpret_cast<unsigned char*>( &record[record.size() - readLength - seqSize] );
+    unsigned char *qual = seq + seqSize;
+    memset( seq, 0, seqSize );
+    unsigned int noCallCount = 0;
+    for (unsigned int i=0; i<readLength; ++i)
+    {
+        const unsigned char bclBase = bclCluster[firstCycle - 1 + (revComp ? readLength-1-i : i)];
+        unsigned char bamBase;
+        if ((bclBase >> 2) == 0 || (revComp && bclBase == 0xFF))
+        {
+            bamBase = 15; // N
+            ++noCallCount;
+        }
+        else
+        {
+            bamBase = 1 << (revComp ? 3 - (bclBase & 3) : (bclBase & 3));
+        }
+        seq[i/2] |= (i%2) ? bamBase : (bamBase << 4);
+        qual[i] = bclBase >> 2;
+    }
+    if (noCallCount >= 64) // same threshold as model::PassFilter
+    {
+        flag |= 0x200;
+    }
+
+    char *dest = &record[0];
+    write( dest, blockSize );
+    write( dest, refId );
+    write( dest, static_cast<int>(pos) );
+    write( dest, static_cast<unsigned int>(io::bam_reg2bin( pos, pos + readLength )) << 16 | mapq << 8 | (readNameLength + 1) );
+    write( dest, flag << 16 | static_cast<unsigned int>(cigar.size() & 0xFFFF) );
+    write( dest, static_cast<int>(readLength) );
+    write( dest, nextRefId );
+    write( dest, static_cast<int>(nextPos) );
+    write( dest, static_cast<int>(tlen) );
+    memcpy( dest, readName, readNameLength + 1 );
+    dest += readNameLength + 1;
+    if (reverseCigar)
+    {
+        for (vector<unsigned int>::const_reverse_iterator it = cigar.rbegin(); it != cigar.rend(); ++it)
+        {
+            write( dest, *it );
+        }
+    }
+    else if (!cigar.empty())
+    {
+        memcpy( dest, &cigar[0], cigar.size()*sizeof(unsigned int) );
+    }
+}
+
+
+} // namespace genome
+} // namespace eagle
@@ -0,0 +1,260 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Encoded BAM records waiting to be written in position order
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "genome/BamReorderWindow.hh"
+#include "io/Bam.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace genome
+{
+
+
+BamReorderWindow::BamReorderWindow( const boost::filesystem::path &spillPrefix, const unsigned long maxBytes, const unsigned int maxSpilledRuns )
+    : spillPrefix_( spillPrefix )
+    , maxBytes_( maxBytes )
+    , maxSpilledRuns_( std::max( maxSpilledRuns, 2u ) )
+    , bytes_( 0 )
+    , nextSequenceNum_( 0 )
+    , spillFileCount_( 0 )
+{
+}
+
+void BamReorderWindow::add( const unsigned long globalPos, vector<char> &record )
+{
+    if (maxBytes_ && !heap_.empty() && bytes_ + record.size() > maxBytes_)
+    {
+        spill();
+    }
+
+    unsigned int recordIndex;
+    if (spareRecords_.empty())
+    {
+        recordIndex = records_.size();
+        records_.push_back( Record() );
+    }
+    else
+    {
+        recordIndex = spareRecords_.back();
+        spareRecords_.pop_back();
+    }
+    Record &newRecord = records_[recordIndex];
+    newRecord.globalPos = globalPos;
+    newRecord.sequenceNum = nextSequenceNum_++;
+    newRecord.bytes.swap( record ); // the caller gets the spare buffer, keeping its capacity
+    bytes_ += newRecord.bytes.size();
+
+    heap_.push_back( recordIndex );
+    push_heap( heap_.begin(), heap_.end(), RecordGreater( records_ ) );
+}
+
+void BamReorderWindow::flushUntilPos( const unsigned long maxGlobalPos, std::ostream &os )
+{
+    const RecordGreater recordGreater( records_ );
+    const SpilledRunGreater runGreater( spilledRuns_ );
+    while (true)
+    {
+        // Smallest record between the tops of both heaps
+        const Record *smallest = heap_.empty() ? 0 : &records_[heap_.front()];
+        const bool fromSpilledRun = !spilledRunsHeap_.empty() && (!smallest || spilledRuns_[spilledRunsHeap_.front()]->head() < *smallest);
+        if (fromSpilledRun)
+        {
+            smallest = &spilledRuns_[spilledRunsHeap_.front()]->head();
+        }
+        if (!smallest || smallest->globalPos > maxGlobalPos)
+        {
+            break;
+        }
+
+        io::serialize( os, smallest->bytes );
+        if (fromSpilledRun)
+        {
+            pop_heap( spilledRunsHeap_.begin(), spilledRunsHeap_.end(), runGreater );
+            if (spilledRuns_[spilledRunsHeap_.back()]->next())
+            {
+                push_heap( spilledRunsHeap_.begin(), spilledRunsHeap_.end(), runGreater );
+            }
+            else
+            {
+                spilledRuns_[spilledRunsHeap_.back()].reset(); // closes and removes the file
+                spilledRunsHeap_.pop_back();
+                if (spilledRunsHeap_.empty())
+                {
+                    spilledRuns_.clear();
+                }
+            }
+        }
+        else
+        {
+            pop_heap( heap_.begin(), heap_.end(), recordGreater );
+            bytes_ -= smallest->bytes.size();
+            spareRecords_.push_back( heap_.back() );
+            heap_.pop_back();
+        }
+    }
+}
+
+void BamReorderWindow::spill()
+{
+    const boost::filesystem::path filename = nextSpillFilename();
+    {
+        ofstream os( filename.string().c_str(), ios_base::binary );
+        const RecordGreater greater( records_ );
+        while (!heap_.empty())
+        {
+            pop_heap( heap_.begin(), heap_.end(), greater );
+            writeSpilledRecord( os, records_[heap_.back()] );
+            spareRecords_.push_back( heap_.back() );
+            heap_.pop_back();
+        }
+        if (!os.good())
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Cannot write file %s") % filename).str() ) );
+        }
+    }
+    bytes_ = 0;
+    spilledRuns_.push_back( boost::shared_ptr<SpilledRun>( new SpilledRun( filename, 0 ) ) );
+    spilledRunsHeap_.push_back( spilledRuns_.size() - 1 );
+    push_heap( spilledRunsHeap_.begin(), spilledRunsHeap_.end(), SpilledRunGreater( spilledRuns_ ) );
+
+    if (spilledRunsHeap_.size() >= maxSpilledRuns_)
+    {
+        mergeSpilledRuns();
+    }
+}
+
+void BamReorderWindow::mergeSpilledRuns()
+{
+    // Levels grow with the merges, so that each record only gets rewritten a logarithmic number of times
+    vector<unsigned int> levels;
+    BOOST_FOREACH( const unsigned int runIndex, spilledRunsHeap_ )
+    {
+        levels.push_back( spilledRuns_[runIndex]->level() );
+    }
+    sort( levels.begin(), levels.end() );
+    const unsigned int maxMergedLevel = levels[1];
+
+    SpilledRuns mergedRuns, keptRuns;
+    BOOST_FOREACH( const unsigned int runIndex, spilledRunsHeap_ )
+    {
+        (spilledRuns_[runIndex]->level() <= maxMergedLevel ? mergedRuns : keptRuns).push_back( spilledRuns_[runIndex] );
+    }
+    spilledRuns_.clear();
+    spilledRunsHeap_.clear();
+
+    const boost::filesystem::path filename = nextSpillFilename();
+    {
+        ofstream os( filename.string().c_str(), ios_base::binary );
+        const SpilledRunGreater greater( mergedRuns );
+        vector<unsigned int> mergeHeap;
+        for (unsigned int i=0; i<mergedRuns.size(); ++i)
+        {
+            mergeHeap.push_back( i );
+        }
+        make_heap( mergeHeap.begin(), mergeHeap.end(), greater );
+        while (!mergeHeap.empty())
+        {
+            pop_heap( mergeHeap.begin(), mergeHeap.end(), greater );
+            SpilledRun &run = *mergedRuns[mergeHeap.back()];
+            writeSpilledRecord( os, run.head() );
+            if (run.next())
+            {
+                push_heap( mergeHeap.begin(), mergeHeap.end(), greater );
+            }
+            else
+            {
+                mergedRuns[mergeHeap.back()].reset();
+                mergeHeap.pop_back();
+            }
+        }
+        if (!os.good())
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Cannot write file %s") % filename).str() ) );
+        }
+    }
+
+    spilledRuns_.swap( keptRuns );
+    spilledRuns_.push_back( boost::shared_ptr<SpilledRun>( new SpilledRun( filename, maxMergedLevel + 1 ) ) );
+    for (unsigned int i=0; i<spilledRuns_.size(); ++i)
+    {
+        spilledRunsHeap_.push_back( i );
+    }
+    make_heap( spilledRunsHeap_.begin(), spilledRunsHeap_.end(), SpilledRunGreater( spilledRuns_ ) );
+}
+
+boost::filesystem::path BamReorderWindow::nextSpillFilename()
+{
+    return (boost::format("%s.reorder%d.tmp") % spillPrefix_.string() % spillFileCount_++).str();
+}
+
+void BamReorderWindow::writeSpilledRecord( std::ostream &os, const Record &record )
+{
+    os.write( reinterpret_cast<const char*>(&record.globalPos), sizeof(record.globalPos) );
+    os.write( reinterpret_cast<const char*>(&record.sequenceNum), sizeof(record.sequenceNum) );
+    os.write( &record.bytes[0], record.bytes.size() );
+}
+
+
+BamReorderWindow::SpilledRun::SpilledRun( const boost::filesystem::path &filename, const unsigned int level )
+    : filename_( filename )
+    , level_( level )
+    , is_( filename.string().c_str(), ios_base::binary )
+{
+    if (!next())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Failed to read back " + filename_.string() ) );
+    }
+}
+
+BamReorderWindow::SpilledRun::~SpilledRun()
+{
+    is_.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove( filename_, ec );
+}
+
+bool BamReorderWindow::SpilledRun::next()
+{
+    // Same layout as written by writeSpilledRecord: globalPos, sequenceNum, then the BAM record starting with its block_size
+    int blockSize;
+    if (!is_.read( reinterpret_cast<char*>(&head_.globalPos), sizeof(head_.globalPos) ))
+    {
+        return false;
+    }
+    is_.read( reinterpret_cast<char*>(&head_.sequenceNum), sizeof(head_.sequenceNum) );
+    is_.read( reinterpret_cast<char*>(&blockSize), sizeof(blockSize) );
+    if (is_.good())
+    {
+        head_.bytes.resize( sizeof(blockSize) + blockSize );
+        memcpy( &head_.bytes[0], &blockSize, sizeof(blockSize) );
+        is_.read( &head_.bytes[sizeof(blockSize)], blockSize );
+    }
+    if (!is_.good())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Failed to read record from " + filename_.string() ) );
+    }
+    return true;
+}
+
+
+} // namespace genome
+} // namespace eagle
@@ -0,0 +1,149 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Process-wide store of the contigs loaded from FASTA files, shared by all the readers
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <algorithm>
+#include <cerrno>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "genome/ContigStore.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace genome
+{
+
+namespace
+{
+
+struct LessRecentlyUsed
+{
+    template <typename T>
+    bool operator()( const std::pair< unsigned long, T >& lhs, const std::pair< unsigned long, T >& rhs ) const
+    {
+        return lhs.first < rhs.first;
+    }
+};
+
+} // anonymous namespace
+
+
+boost::mutex              ContigStore::mutex_;
+ContigStore::ContigMap    ContigStore::contigs_;
+unsigned long             ContigStore::bytes_ = 0;
+unsigned long             ContigStore::maxBytes_ = 0;
+unsigned long             ContigStore::useCount_ = 0;
+
+
+ContigStore::ContigText ContigStore::get( const boost::filesystem::path& file, const eagle::io::FastaInfo& info )
+{
+    const pair< string, string > key( file.string(), info.contigName );
+    {
+        boost::unique_lock<boost::mutex> lock( mutex_ );
+        ContigMap::iterator it = contigs_.find( key );
+        if (it != contigs_.end())
+        {
+            it->second.lastUse = ++useCount_;
+            return it->second.text;
+        }
+    }
+
+    // Loaded without the lock, so that the other threads keep reading from their contigs meanwhile
+    ContigText text = load( file, info );
+
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    ContigMap::iterator it = contigs_.find( key );
+    if (it == contigs_.end())
+    {
+        // Most recently used already, for evict() to rank it against the others
+        it = contigs_.insert( make_pair( key, Entry( text, ++useCount_ ) ) ).first;
+        bytes_ += text->size();
+        evict( maxBytes_ );
+    }
+    else
+    {   // loaded by another thread in the meantime
+        it->second.lastUse = ++useCount_;
+    }
+    return it->second.text;
+}
+
+void ContigStore::setMaxBytes( const unsigned long maxBytes )
+{
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    maxBytes_ = maxBytes;
+    evict( maxBytes_ );
+}
+
+unsigned long ContigStore::bytes()
+{
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    return bytes_;
+}
+
+unsigned int ContigStore::contigCount()
+{
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    return contigs_.size();
+}
+
+void ContigStore::clear()
+{
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    evict( 0 );
+}
+
+ContigStore::ContigText ContigStore::load( const boost::filesystem::path& file, const eagle::io::FastaInfo& info )
+{
+    eagle::io::FastaReader reader;
+    reader.open( file.string().c_str() );
+    if (!reader.is_open())
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to open FASTA file %s for reading") % file).str()));
+    }
+    const unsigned int eol = info.contigWidth.second - info.contigWidth.first;
+    assert(1 == eol && "we do not support platforms that have EOL > 1 byte");
+    reader.read( info.position.second, info.contigSize, eol * (info.contigSize / info.contigWidth.first) );
+
+    boost::shared_ptr< vector<char> > text( new vector<char> );
+    text->swap( reader.cache() );
+    return text;
+}
+
+void ContigStore::evict( const unsigned long maxBytes )
+{
+    if (bytes_ <= maxBytes)
+    {
+        return;
+    }
+    // Only the store holds the inactive contigs
+    vector< pair< unsigned long, ContigMap::iterator > > inactiveContigs;
+    for (ContigMap::iterator it = contigs_.begin(); it != contigs_.end(); ++it)
+    {
+        if (it->second.text.use_count() == 1)
+        {
+            inactiveContigs.push_back( make_pair( it->second.lastUse, it ) );
+        }
+    }
+    sort( inactiveContigs.begin(), inactiveContigs.end(), LessRecentlyUsed() );
+    for (unsigned int i=0; i<inactiveContigs.size() && bytes_ > maxBytes; ++i)
+    {
+        bytes_ -= inactiveContigs[i].second->second.text->size();
+        contigs_.erase( inactiveContigs[i].second );
+    }
+}
+
+
+} // namespace genome
+} // namespace eagle
@@ -7,6 +7,8 @@
  ** \author Lilian Janin
  **/
 
+#include <cstring>
+
 #include "genome/SharedFastaReference.hh"
 #include "genome/Reference.hh"
 #include "genome/EnrichedFragment.hh"
@@ -44,6 +46,24 @@ char FragmentComponentHardcoded::getBase( const unsigned int posInRead, const ea
     return base;
 }
 
+bool FragmentComponentHardcoded::copyBases( char *dest, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment, const bool isForward ) const
+{
+    if (posInRead + length > bases_.size())
+    {
+        return false;
+    }
+    memcpy( dest, bases_.data() + posInRead, length );
+    if (!isForward)
+    {
+        // complement, in the same order as getBase()
+        for (unsigned int i = 0; i < length; ++i)
+        {
+            dest[i] = ~dest[i];
+        }
+    }
+    return true;
+}
+
 
 FragmentComponentRealDna::FragmentComponentRealDna()
     : FragmentComponent()
@@ -76,6 +96,20 @@ char FragmentComponentRealDna::getBase( const unsigned int posInRead, const eagl
     return base;
 }
 
+bool FragmentComponentRealDna::copyBases( char *dest, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment, const bool isForward ) const
+{
+    if (isForward)
+    {
+        return eagle::genome::SharedFastaReference::get()->copyBases( dest, fragment.startPos_, posInRead, length, false );
+    }
+    if (posInRead + length > fragment.fragmentLength_)
+    {
+        return false;
+    }
+    // getBase() reads the fragment backwards from its end
+    return eagle::genome::SharedFastaReference::get()->copyBases( dest, fragment.startPos_, fragment.fragmentLength_ - posInRead - length, length, true );
+}
+
 
 char FragmentStructure::getBase( const unsigned int readNum, const unsigned int posInRead, const eagle::model::Fragment &fragment ) const
 {
@@ -86,6 +120,12 @@ char FragmentStructure::getBase( const unsigned int readNum, const unsigned int
     return base;
 }
 
+bool FragmentStructure::copyBases( char *dest, const unsigned int readNum, const unsigned int posInRead, const unsigned int length, const eagle::model::Fragment &fragment ) const
+{
+    assert( readNum < reads_.size() );
+    return components_[reads_[readNum].first]->copyBases( dest, posInRead, length, fragment, reads_[readNum].second );
+}
+
 unsigned int FragmentStructure::getReadLength( const unsigned int readNum, const eagle::model::Fragment &fragment ) const
 {
     assert( readNum < reads_.size() );
@@ -112,6 +152,11 @@ char EnrichedFragment::getBase( unsigned int read, unsigned int posInRead ) cons
     return base;
 }
 
+bool EnrichedFragment::copyBases( char *dest, unsigned int read, unsigned int posInRead, unsigned int length ) const
+{
+    return structure_.copyBases( dest, read, posInRead, length, fragment_ );
+}
+
 unsigned int EnrichedFragment::getReadCount() const
 {
     return structure_.reads_.size();
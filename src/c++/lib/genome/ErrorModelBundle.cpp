@@ -0,0 +1,177 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Memory-mapped binary file holding the error model tables, already parsed and compiled.
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <boost/crc.hpp>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "genome/ErrorModelBundle.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace genome
+{
+
+namespace
+{
+
+const unsigned long HEADER_SIZE = 5 * sizeof(unsigned long);
+
+unsigned long paddedSize( const unsigned long byteSize )
+{
+    return (byteSize + sizeof(unsigned long) - 1) / sizeof(unsigned long) * sizeof(unsigned long);
+}
+
+unsigned long checksum( const char *data, const unsigned long byteSize )
+{
+    boost::crc_32_type crc;
+    crc.process_bytes( data, byteSize );
+    return crc.checksum();
+}
+
+} // anonymous namespace
+
+
+ErrorModelBundleWriter::ErrorModelBundleWriter( const boost::filesystem::path& filename )
+    : filename_( filename )
+    , sectionCount_( 0 )
+{
+}
+
+void ErrorModelBundleWriter::add( const ErrorModelBundleSection id, const void *data, const unsigned long byteSize )
+{
+    const unsigned long sectionHeader[2] = { static_cast<unsigned long>( id ), byteSize };
+    append( sectionHeader, sizeof(sectionHeader) );
+    append( data, byteSize );
+    ++sectionCount_;
+}
+
+void ErrorModelBundleWriter::add( const ErrorModelBundleSection id, const model::AliasTables& tables )
+{
+    vector< char > data( paddedSize( 2 * sizeof(unsigned int) + tables.size() * sizeof(unsigned int) ) + tables.entryBytes(), 0 );
+    unsigned int *header = reinterpret_cast<unsigned int *>( &data[0] );
+    header[0] = tables.width();
+    header[1] = tables.size();
+    copy( tables.outcomeCounts().begin(), tables.outcomeCounts().end(), header + 2 );
+    if (tables.entryBytes())
+    {
+        memcpy( &data[data.size() - tables.entryBytes()], tables.entryData(), tables.entryBytes() );
+    }
+    add( id, data );
+}
+
+void ErrorModelBundleWriter::append( const void *data, const unsigned long byteSize )
+{
+    const char *bytes = static_cast<const char *>( data );
+    payload_.insert( payload_.end(), bytes, bytes + byteSize );
+    payload_.resize( paddedSize( payload_.size() ), 0 );
+}
+
+void ErrorModelBundleWriter::close()
+{
+    const boost::filesystem::path tmpFilename = filename_.string() + ".tmp";
+    ofstream out( tmpFilename.string().c_str(), ios::binary );
+    if (!out.good())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Cannot create file %s") % tmpFilename).str() ) );
+    }
+    const char *payload = payload_.empty() ? 0 : &payload_[0];
+    const unsigned long header[5] = { MAGIC, VERSION, payload_.size(), checksum( payload, payload_.size() ), sectionCount_ };
+    out.write( reinterpret_cast<const char *>( header ), sizeof(header) );
+    out.write( payload, payload_.size() );
+    out.close();
+    if (out.fail())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to write %s") % tmpFilename).str() ) );
+    }
+
+    // Only make the file visible once complete, as simulations may be waiting for it
+    boost::filesystem::rename( tmpFilename, filename_ );
+}
+
+
+ErrorModelBundleReader::ErrorModelBundleReader( const boost::filesystem::path& filename )
+    : filename_( filename )
+{
+    try
+    {
+        file_.open( filename.string() );
+    }
+    catch (const std::exception &e)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to memory-map %s: %s") % filename % e.what()).str() ) );
+    }
+    const unsigned long *header = reinterpret_cast<const unsigned long *>( file_.data() );
+    if (file_.size() < HEADER_SIZE || header[0] != ErrorModelBundleWriter::MAGIC)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s is not a compiled error model") % filename).str() ) );
+    }
+    if (header[1] != ErrorModelBundleWriter::VERSION)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::UnsupportedVersionException( (boost::format("%s: unsupported compiled error model version %d") % filename % header[1]).str() ) );
+    }
+    const char *payload = file_.data() + HEADER_SIZE;
+    const unsigned long payloadSize = header[2];
+    if (file_.size() != HEADER_SIZE + payloadSize || checksum( payload, payloadSize ) != header[3])
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s is truncated or corrupted (checksum mismatch)") % filename).str() ) );
+    }
+
+    const char *pos = payload;
+    for (unsigned long i=0; i<header[4]; ++i)
+    {
+        const unsigned long *sectionHeader = reinterpret_cast<const unsigned long *>( pos );
+        if (pos + 2 * sizeof(unsigned long) > payload + payloadSize
+            || sectionHeader[1] > static_cast<unsigned long>( payload + payloadSize - pos ) - 2 * sizeof(unsigned long))
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s: section %d goes beyond the end of the file") % filename % i).str() ) );
+        }
+        sections_[ sectionHeader[0] ] = make_pair( pos + 2 * sizeof(unsigned long), sectionHeader[1] );
+        pos += 2 * sizeof(unsigned long) + paddedSize( sectionHeader[1] );
+    }
+}
+
+const pair< const char *, unsigned long >& ErrorModelBundleReader::find( const ErrorModelBundleSection id, const unsigned int elementSize ) const
+{
+    map< unsigned long, pair< const char *, unsigned long > >::const_iterator it = sections_.find( id );
+    if (it == sections_.end() || it->second.second % elementSize)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s: missing or invalid section %d") % filename_ % id).str() ) );
+    }
+    return it->second;
+}
+
+void ErrorModelBundleReader::get( const ErrorModelBundleSection id, model::AliasTables& tables ) const
+{
+    unsigned long byteSize;
+    const char *data = get<char>( id, byteSize );
+    const unsigned int *header = reinterpret_cast<const unsigned int *>( data );
+    const unsigned long countsSize = (byteSize < 2 * sizeof(unsigned int)) ? 0 : paddedSize( (2ul + header[1]) * sizeof(unsigned int) );
+    // Each entry is a {threshold, alias} pair of 32-bit values
+    if (countsSize == 0 || byteSize != countsSize + 2 * sizeof(uint32_t) * header[0] * header[1])
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s: invalid alias tables in section %d") % filename_ % id).str() ) );
+    }
+    const vector< unsigned int > outcomeCounts( header + 2, header + 2 + header[1] );
+    tables.assign( header[0], outcomeCounts, data + countsSize );
+}
+
+
+} // namespace genome
+} // namespace eagle
@@ -79,7 +79,7 @@ LongreadBaseDuplicationModel::LongreadBaseDuplicationModel( const vector< string
     }
 }
 
-void LongreadBaseDuplicationModel::apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+void LongreadBaseDuplicationModel::apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
 {
     if (prob_ == 0.0) { return; }
 
@@ -97,7 +97,6 @@ void LongreadBaseDuplicationModel::apply( boost::mt19937& randomGen, const doubl
 LongreadDeletionModel::LongreadDeletionModel( const vector< string >& errorModelOptions )
     : ErrorModelPlugin( errorModelOptions, "LONGREAD-deletion" )
     , prob_             ( getParsedValue<double>( "prob"     , 0.0 ) )
-    , basesLeftToDelete_( 0 )
 {
     string distTableFilename = getParsedValue<string>( "dist-file", ""  );
     if (prob_ > 0 && distTableFilename != "")
@@ -144,14 +143,15 @@ LongreadDeletionModel::LongreadDeletionModel( const vector< string >& errorModel
     reportUnusedCommandLineOptionsForThisPlugin();
 }
 
-void LongreadDeletionModel::apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+void LongreadDeletionModel::apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
 {
     if (prob_ == 0.0) { return; }
 
-    if (basesLeftToDelete_ > 0)
+    unsigned int &basesLeftToDelete = clusterErrorModelContext.longreadDeletionModelContext.basesLeftToDelete;
+    if (basesLeftToDelete > 0)
     {
         randomErrorType = ErrorModel::BaseDeletion;
-        --basesLeftToDelete_;
+        --basesLeftToDelete;
     }
     else
     {
@@ -161,11 +161,11 @@ void LongreadDeletionModel::apply( boost::mt19937& randomGen, const double error
             double randomValue = (double)randomGen() / ((double)randomGen.max() + 1.0);
             if (randomValue < prob_)
             {
-                basesLeftToDelete_ = deletionLengthDist_(randomGen); //(int)( randomValue / prob_ * (double)(maxLength_ - minLength_ + 1) + minLength_ - 1 );
-                if (basesLeftToDelete_ > 0)
+                basesLeftToDelete = deletionLengthDist_(randomGen); //(int)( randomValue / prob_ * (double)(maxLength_ - minLength_ + 1) + minLength_ - 1 );
+                if (basesLeftToDelete > 0)
                 {
                     randomErrorType = ErrorModel::BaseDeletion;
-                    --basesLeftToDelete_;
+                    --basesLeftToDelete;
                 }
             }
         }
@@ -24,9 +24,61 @@ namespace genome
 {
 
 
+void GcContentIndex::clear()
+{
+    // There is always one block after the last complete one, so that countBefore( size() ) stays valid
+    const Block emptyBlock = { 0, 0, 0, 0 };
+    blocks_.assign( 1, emptyBlock );
+    size_ = 0;
+}
+
+void GcContentIndex::push_back( const char base )
+{
+    Block& block = blocks_.back();
+    const uint64_t bit = 1ull << (size_ % 64);
+    switch (toupper( baseConverter_.norm( base ) ))
+    {
+    case 'C':
+    case 'G':
+        block.gcBits |= bit;
+        break;
+    case 'A':
+    case 'T':
+        break;
+    default:
+        block.otherBits |= bit;
+    }
+
+    if (++size_ % 64 == 0)
+    {
+        const Block nextBlock = { block.gcBefore + __builtin_popcountll( block.gcBits ), block.otherBefore + __builtin_popcountll( block.otherBits ), 0, 0 };
+        blocks_.push_back( nextBlock );
+    }
+}
+
+void GcContentIndex::count( const unsigned long begin, const unsigned long end, unsigned int& gcCount, unsigned int& otherCount ) const
+{
+    assert( begin <= end && end <= size_ );
+    unsigned int gcBeforeBegin, otherBeforeBegin;
+    countBefore( begin, gcBeforeBegin, otherBeforeBegin );
+    countBefore( end, gcCount, otherCount );
+    gcCount -= gcBeforeBegin;
+    otherCount -= otherBeforeBegin;
+}
+
+void GcContentIndex::countBefore( const unsigned long pos, unsigned int& gcCount, unsigned int& otherCount ) const
+{
+    const Block& block = blocks_[pos / 64];
+    const uint64_t mask = (1ull << (pos % 64)) - 1;
+    gcCount = block.gcBefore + __builtin_popcountll( block.gcBits & mask );
+    otherCount = block.otherBefore + __builtin_popcountll( block.otherBits & mask );
+}
+
+
 GcCoverageFit::GcCoverageFit( const boost::filesystem::path& gcCoverageFitFilename, const boost::filesystem::path& sampleGenomeDir/*, boost::shared_ptr<boost::mt19937> randomGen*/ )
     : isActive_( !gcCoverageFitFilename.empty() )
                             //    , randomGen_( randomGen )
+    , currentContig_( 0 )
 {
     if (isActive_)
     {
@@ -130,39 +182,33 @@ bool GcCoverageFit::needsDiscarding( const model::Fragment& fragment )
     }
 #endif
 
-    unsigned int gcCount=0, acgtCount=0;
-    for (unsigned long offset = 0; offset < fragment.fragmentLength_; ++offset)
-    {
-        // Only consider the first and last 150 bases, to make the GC% values less average and to match a bit more closely Firebrand's GC plots, which are calculated using 150bp windows
-        if (offset >= 150 && offset < fragment.fragmentLength_-150)
-        {
-            continue;
-        }
+    // Only consider the first and last 150 bases, to make the GC% values less average and to match a bit more closely Firebrand's GC plots, which are calculated using 150bp windows
+    const unsigned long fragmentLength = fragment.fragmentLength_;
+    const unsigned long firstWindowEnd = min<unsigned long>( fragmentLength, 150 );
+    const unsigned long secondWindowBegin = (fragmentLength > 300) ? (fragmentLength - 150) : firstWindowEnd;
 
-        bool overlapContigBoundary;
-        char base = genome::SharedFastaReference::get()->get( fragment.startPos_, offset, overlapContigBoundary );
-        if (overlapContigBoundary)
-        {
-            // safety check
-            return true;
-        }
-        base = baseConverter_.norm( base );
-        base = toupper( base );
+    selectContigContaining( fragment.startPos_ );
+    const unsigned long posInContig = fragment.startPos_ - contigStarts_[currentContig_];
+    const unsigned long basesLeftInContig = currentContigGcIndex_.size() - posInContig;
 
-        switch (base)
-        {
-        case 'C':
-        case 'G':
-            ++gcCount;
-        case 'A':
-        case 'T':
-            ++acgtCount;
-            break;
-        default:
-            return needsDiscarding( averageMultiplier() ); // if, for example, any 'N' appears, we keep the fragment
-        }
+    unsigned int gcCount1, otherCount1, gcCount2, otherCount2;
+    currentContigGcIndex_.count( posInContig, posInContig + min( firstWindowEnd, basesLeftInContig ), gcCount1, otherCount1 );
+    currentContigGcIndex_.count( posInContig + min( secondWindowBegin, basesLeftInContig ), posInContig + min( fragmentLength, basesLeftInContig ), gcCount2, otherCount2 );
+
+    // Bases are checked in order: any 'N' before the end of the contig keeps the fragment with the average probability
+    if (otherCount1 + otherCount2 > 0)
+    {
+        return needsDiscarding( averageMultiplier() );
+    }
+    if (fragmentLength > basesLeftInContig)
+    {
+        // safety check
+        return true;
     }
 
+    const unsigned int gcCount = gcCount1 + gcCount2;
+    const unsigned long acgtCount = firstWindowEnd + (fragmentLength - secondWindowBegin);
+
     // special case
     if (acgtCount == 0)
     {
@@ -173,6 +219,37 @@ bool GcCoverageFit::needsDiscarding( const model::Fragment& fragment )
     return needsDiscarding( gcContent );
 }
 
+void GcCoverageFit::selectContigContaining( const unsigned long globalPos )
+{
+    if (contigStarts_.empty())
+    {
+        const vector<unsigned long> contigLengths = genome::SharedFastaReference::get()->allContigLengths();
+        contigStarts_.push_back( 0 );
+        BOOST_FOREACH( const unsigned long contigLength, contigLengths )
+        {
+            contigStarts_.push_back( contigStarts_.back() + contigLength );
+        }
+        currentContig_ = contigLengths.size(); // none indexed yet
+    }
+
+    if (currentContig_ < contigStarts_.size() - 1 && globalPos >= contigStarts_[currentContig_] && globalPos < contigStarts_[currentContig_+1])
+    {
+        return;
+    }
+    currentContig_ = upper_bound( contigStarts_.begin(), contigStarts_.end(), globalPos ) - contigStarts_.begin() - 1;
+    assert( currentContig_ < contigStarts_.size() - 1 && "Fragment position beyond the end of the reference" );
+
+    const unsigned long contigStart = contigStarts_[currentContig_];
+    const unsigned long contigLength = contigStarts_[currentContig_+1] - contigStart;
+    clog << (boost::format("Indexing GC content of contig %d (%d bases)") % currentContig_ % contigLength).str() << endl;
+    currentContigGcIndex_.clear();
+    for (unsigned long offset = 0; offset < contigLength; ++offset)
+    {
+        bool overlapContigBoundary;
+        currentContigGcIndex_.push_back( genome::SharedFastaReference::get()->get( contigStart, offset, overlapContigBoundary ) );
+    }
+}
+
 bool GcCoverageFit::needsDiscarding( const double gcContent )
 {
     double covMult = getInterpolatedCoverageMultiplierForGcContent( gcContent );
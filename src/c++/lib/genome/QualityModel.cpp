@@ -7,6 +7,7 @@
  ** \author Lilian Janin
  **/
 
+#include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -60,6 +61,9 @@ public:
             return weights_.size() - 1;
     }
 
+    const vector<double>& cumulativeWeights() const { return weights_; }
+    void setCumulativeWeights( const double *begin, const double *end ) { weights_.assign( begin, end ); }
+
 private:
     vector<double> weights_;
 };
@@ -78,6 +82,46 @@ QualityModel::QualityModel( const vector<boost::filesystem::path>& qualityTableF
     {
         lastCycle = parseQualityTableFile( file, lastCycle );
     }
+    createAliasTables();
+}
+
+void QualityModel::createAliasTables()
+{
+    maxProfileCount_ = 0;
+    profileCountPerCycle_.clear();
+    BOOST_FOREACH( const vector< vector< double > >& weightsPerProfile, qualityWeightsPerCyclePerLastQuality_ )
+    {
+        profileCountPerCycle_.push_back( weightsPerProfile.size() );
+        maxProfileCount_ = std::max<unsigned int>( maxProfileCount_, weightsPerProfile.size() );
+    }
+
+    vector< vector< double > > weightsPerTable( profileCountPerCycle_.size() * maxProfileCount_ );
+    for (unsigned int cycle=0; cycle<profileCountPerCycle_.size(); ++cycle)
+    {
+        for (unsigned int profileNumber=0; profileNumber<profileCountPerCycle_[cycle]; ++profileNumber)
+        {
+            weightsPerTable[ tableNum( cycle, profileNumber ) ].swap( qualityWeightsPerCyclePerLastQuality_[cycle][profileNumber] );
+        }
+    }
+    qualityDistPerCyclePerLastQuality.build( weightsPerTable );
+    qualityWeightsPerCyclePerLastQuality_.clear();
+}
+
+void QualityModel::save( ErrorModelBundleWriter& bundle ) const
+{
+    bundle.add( QUALITY_PROFILE_COUNTS, profileCountPerCycle_ );
+    bundle.add( QUALITY_DISTRIBUTIONS, qualityDistPerCyclePerLastQuality );
+}
+
+void QualityModel::load( const ErrorModelBundleReader& bundle )
+{
+    profileCountPerCycle_ = bundle.getVector<unsigned int>( QUALITY_PROFILE_COUNTS );
+    maxProfileCount_ = profileCountPerCycle_.empty() ? 0 : *std::max_element( profileCountPerCycle_.begin(), profileCountPerCycle_.end() );
+    bundle.get( QUALITY_DISTRIBUTIONS, qualityDistPerCyclePerLastQuality );
+    if (qualityDistPerCyclePerLastQuality.size() != profileCountPerCycle_.size() * maxProfileCount_)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", "The quality distributions of the compiled error model don't match its profile counts" ) );
+    }
 }
 
 unsigned int QualityModel::parseBigQualityTableFile( const boost::filesystem::path& filename )
@@ -138,15 +182,15 @@ unsigned int QualityModel::parseQualityTableFile( const boost::filesystem::path&
             }
 
             // Extend quality vector as appropriate
-            if (qualityDistPerCyclePerLastQuality.size() <= cycle)
+            if (qualityWeightsPerCyclePerLastQuality_.size() <= cycle)
             {
-                qualityDistPerCyclePerLastQuality.resize( cycle+1 );
+                qualityWeightsPerCyclePerLastQuality_.resize( cycle+1 );
             }
-            if (qualityDistPerCyclePerLastQuality[cycle].size() <= profileId)
+            if (qualityWeightsPerCyclePerLastQuality_[cycle].size() <= profileId)
             {
-                qualityDistPerCyclePerLastQuality[cycle].resize( profileId+1 );
+                qualityWeightsPerCyclePerLastQuality_[cycle].resize( profileId+1 );
             }
-            qualityDistPerCyclePerLastQuality[cycle][profileId] = boost::random::discrete_distribution<>(qualityTable[profileId][cycle]);
+            qualityWeightsPerCyclePerLastQuality_[cycle][profileId].assign( qualityTable[profileId][cycle].begin(), qualityTable[profileId][cycle].end() );
         }
         return cycle;
     }
@@ -179,15 +223,15 @@ unsigned int QualityModel::parseQualityTableFile( const boost::filesystem::path&
         }
 
         // Extend quality vector as appropriate
-        if (qualityDistPerCyclePerLastQuality.size() <= cycle)
+        if (qualityWeightsPerCyclePerLastQuality_.size() <= cycle)
         {
-            qualityDistPerCyclePerLastQuality.resize( cycle+1 );
+            qualityWeightsPerCyclePerLastQuality_.resize( cycle+1 );
         }
-        if (qualityDistPerCyclePerLastQuality[cycle].size() <= lastQ)
+        if (qualityWeightsPerCyclePerLastQuality_[cycle].size() <= lastQ)
         {
-            qualityDistPerCyclePerLastQuality[cycle].resize( lastQ+1 );
+            qualityWeightsPerCyclePerLastQuality_[cycle].resize( lastQ+1 );
         }
-        qualityDistPerCyclePerLastQuality[cycle][lastQ] = boost::random::discrete_distribution<>(values);
+        qualityWeightsPerCyclePerLastQuality_[cycle][lastQ].swap( values );
 /*
         // Expected errors statistics
         double expectedErrors = 0.0;
@@ -240,7 +284,7 @@ static int bin2Q[8] = { 0, 6, 15, 22, 27, 33, 37, 40 };
 */
 
 /*
-unsigned int QualityModel::getQuality( boost::mt19937& randomGen, const unsigned int cycle, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+unsigned int QualityModel::getQuality( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext )
 {
     unsigned int result = bin2Q[ 5 ];
     assert (useNewStuff_);
@@ -298,11 +342,11 @@ unsigned int QualityModel::getQuality( boost::mt19937& randomGen, const unsigned
 }
 */
 
-unsigned int QualityModel::getQuality( boost::mt19937& randomGen, const unsigned int cycle, ClusterErrorModelContext& clusterErrorModelContext )
+unsigned int QualityModel::getQuality( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, ClusterErrorModelContext& clusterErrorModelContext )
 {
     assert (!useNewStuff_);
 
-    if (cycle >= qualityDistPerCyclePerLastQuality.size())
+    if (cycle >= profileCountPerCycle_.size())
     {
         EAGLE_ERROR( "The quality table doesn't model as many cycles as necessary for this simulation" );
     }
@@ -311,7 +355,7 @@ unsigned int QualityModel::getQuality( boost::mt19937& randomGen, const unsigned
     {
         // No profile number assigned to this read => find the last cycle containing a profile spec and use it
         unsigned int cycleForProfileNumber = cycle;
-        while (qualityDistPerCyclePerLastQuality[cycleForProfileNumber][0].max() == 0)
+        while (profileCountPerCycle_[cycleForProfileNumber] == 0 || qualityDistPerCyclePerLastQuality.outcomeCount( tableNum( cycleForProfileNumber, 0 ) ) <= 1)
         {
             if (cycleForProfileNumber == 0)
             {
@@ -319,16 +363,16 @@ unsigned int QualityModel::getQuality( boost::mt19937& randomGen, const unsigned
             }
             --cycleForProfileNumber;
         }
-        clusterErrorModelContext.qualityModelContext.profileNumber = qualityDistPerCyclePerLastQuality[cycleForProfileNumber][0](randomGen);
+        clusterErrorModelContext.qualityModelContext.profileNumber = qualityDistPerCyclePerLastQuality( tableNum( cycleForProfileNumber, 0 ), randomGen );
         assert( clusterErrorModelContext.qualityModelContext.profileNumber > 0 );
     }
     unsigned int profileNumber = clusterErrorModelContext.qualityModelContext.profileNumber;
     assert( profileNumber > 0 );
-    if (profileNumber >= qualityDistPerCyclePerLastQuality[cycle].size())
+    if (profileNumber >= profileCountPerCycle_[cycle])
     {
         EAGLE_ERROR( (boost::format("The quality table doesn't contain the required entry for {cycle=%d, profileNumber=%d}") % cycle % profileNumber).str() );
     }
-    unsigned int quality = qualityDistPerCyclePerLastQuality[cycle][profileNumber](randomGen);
+    unsigned int quality = qualityDistPerCyclePerLastQuality( tableNum( cycle, profileNumber ), randomGen );
 
 #ifdef DEBUG_QUALITIES
     cout << (boost::format("Q=%d => error-rate=%f") % quality % model::Phred::qualToProb(quality)).str() << endl;
@@ -348,16 +392,15 @@ SequencingMismatchModel::SequencingMismatchModel( const boost::filesystem::path&
         vector< double > errorG = boost::assign::list_of(1.0)(1.0)(0.0)(1.0)(0.0)(0.0)(0.0)(0.0)(0.0);
         vector< double > errorT = boost::assign::list_of(1.0)(1.0)(1.0)(0.0)(0.0)(0.0)(0.0)(0.0)(0.0);
 
-        errorDistPerBase.push_back( boost::random::discrete_distribution<>(errorA) );
-        errorDistPerBase.push_back( boost::random::discrete_distribution<>(errorC) );
-        errorDistPerBase.push_back( boost::random::discrete_distribution<>(errorG) );
-        errorDistPerBase.push_back( boost::random::discrete_distribution<>(errorT) );
+        const vector< vector< double > > errorPerBase = boost::assign::list_of(errorA)(errorC)(errorG)(errorT);
+        errorDistPerBase.build( errorPerBase );
     }
     else
     { // Parse mismatch table file
         io::DsvReader tsvReader( mismatchTableFilename );
         vector<string> tokens;
         const vector<string> expectedRowHeaders = boost::assign::list_of("A")("C")("G")("T");
+        vector< vector< double > > valuesPerBase;
         BOOST_FOREACH( const string& expectedRowHeader, expectedRowHeaders)
         {
             (void)expectedRowHeader; // prevents "unused variable" warning when asserts are not compiled
@@ -374,12 +417,23 @@ SequencingMismatchModel::SequencingMismatchModel( const boost::filesystem::path&
                 EAGLE_ERROR("Error while reading mismatch table: a numerical field seems to contain non-numerical characters");
             }
             assert( values.size() == 9 );
-            errorDistPerBase.push_back( boost::random::discrete_distribution<>(values) );
+            valuesPerBase.push_back( values );
         }
+        errorDistPerBase.build( valuesPerBase );
     }
 }
 
-void SequencingMismatchModel::apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+void SequencingMismatchModel::save( ErrorModelBundleWriter& bundle ) const
+{
+    bundle.add( MISMATCH_DISTRIBUTIONS, errorDistPerBase );
+}
+
+void SequencingMismatchModel::load( const ErrorModelBundleReader& bundle )
+{
+    bundle.get( MISMATCH_DISTRIBUTIONS, errorDistPerBase );
+}
+
+void SequencingMismatchModel::apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
 {
     if (randomGen() > errorRate * randomGen.max())
     {
@@ -387,7 +441,7 @@ void SequencingMismatchModel::apply( boost::mt19937& randomGen, const double err
     }
     else
     {
-        unsigned char errorType = errorDistPerBase[bclBase](randomGen);
+        unsigned char errorType = errorDistPerBase( bclBase, randomGen );
         switch (errorType)
         {
         case 0: // x->A
@@ -464,7 +518,35 @@ HomopolymerIndelModel::HomopolymerIndelModel( const boost::filesystem::path& hom
     }
 }
 
-void HomopolymerIndelModel::apply( boost::mt19937& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+void HomopolymerIndelModel::save( ErrorModelBundleWriter& bundle ) const
+{
+    bundle.add( HOMOPOLYMER_DELETION_RATES, homoDeletionTable_ );
+    bundle.add( HOMOPOLYMER_INSERTION_RATES, homoInsertionTable_ );
+}
+
+void HomopolymerIndelModel::load( const ErrorModelBundleReader& bundle )
+{
+    homoDeletionTable_ = bundle.getVector<double>( HOMOPOLYMER_DELETION_RATES );
+    homoInsertionTable_ = bundle.getVector<double>( HOMOPOLYMER_INSERTION_RATES );
+    if (homoDeletionTable_.empty() || homoDeletionTable_.size() != homoInsertionTable_.size())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", "Invalid homopolymer indel table in compiled error model" ) );
+    }
+}
+
+bool HomopolymerIndelModel::isActive() const
+{
+    for (unsigned int i=0; i<homoDeletionTable_.size(); ++i)
+    {
+        if (homoDeletionTable_[i] != 0.0 || homoInsertionTable_[i] != 0.0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HomopolymerIndelModel::apply( model::FragmentRandomGenerator& randomGen, const double errorRate, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
 {
     if (bclBase != clusterErrorModelContext.homopolymerModelContext.lastBase)
     {
@@ -541,13 +623,14 @@ uint64_t kmerStringToInt64( const string &s )
 
 #define MAX_MOTIF_KMER_LENGTH 10
 #define AVERAGE_QUALITY 34
+const unsigned int MotifQualityDropModel::NO_GROUP;
+
 MotifQualityDropModel::MotifQualityDropModel( const boost::filesystem::path& tableFilename )
     : active_( false )
+    , groupPerKmer_( MAX_MOTIF_KMER_LENGTH+1 )
 {
     if (tableFilename != "")
     {
-        tableData_.resize( MAX_MOTIF_KMER_LENGTH+1 );
-
         // Parse motif quality drop table file
         io::DsvReader tsvReader( tableFilename );
         vector<string> tokens;
@@ -559,6 +642,10 @@ MotifQualityDropModel::MotifQualityDropModel( const boost::filesystem::path& tab
             unsigned int repeatCount = boost::lexical_cast<unsigned int, string>( tokens[1] );
             float meanQualityDrop = boost::lexical_cast<double, string>( tokens[2] );
             unsigned int kmerLength = tokens[0].size();
+            if (kmerLength > MAX_MOTIF_KMER_LENGTH)
+            {
+                EAGLE_ERROR( (boost::format("Error while reading motif quality drop table: kmer %s is longer than the maximum of %d bases") % tokens[0] % MAX_MOTIF_KMER_LENGTH).str() );
+            }
             unsigned int kmerLengthInBits = 2 * kmerLength;
             uint64_t kmerMask = (1ull << kmerLengthInBits) - 1;
 
@@ -575,10 +662,11 @@ MotifQualityDropModel::MotifQualityDropModel( const boost::filesystem::path& tab
             }
 
             active_ = true;
-            boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > > &mapData = tableData_[kmerLength][ kmer ];
-            if (mapData.get() == NULL)
+            unsigned int &group = kmerGroup( kmerLength, kmer );
+            if (group == NO_GROUP)
             {
-                mapData.reset( new std::vector< MotifRepeatQualityDropInfo > );
+                group = groups_.size();
+                groups_.push_back( boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > >( new std::vector< MotifRepeatQualityDropInfo > ) );
 
                 uint64_t kmerPermutation = kmer;
                 for (unsigned int permutation=1; permutation < kmerLength; ++permutation)
@@ -588,11 +676,12 @@ MotifQualityDropModel::MotifQualityDropModel( const boost::filesystem::path& tab
                     kmerPermutation = ((kmerPermutation << 2) & kmerMask) | leftMostBase;
 
                     //            cout << "MotifQualityDropModel constructor: Adding " << kmer << "\t" << repeatCount << "\t" << roundf(37 - meanQualityDrop) << endl;
-                    boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > > &mapDataPermutation = tableData_[kmerLength][ kmerPermutation ];
-                    assert (mapDataPermutation.get() == NULL);
-                    mapDataPermutation = mapData;
+                    unsigned int &permutationGroup = kmerGroup( kmerLength, kmerPermutation );
+                    assert (permutationGroup == NO_GROUP);
+                    permutationGroup = group;
                 }
             }
+            std::vector< MotifRepeatQualityDropInfo > *mapData = groups_[group].get();
 
             if (repeatCount >= mapData->size())
             {
@@ -605,6 +694,120 @@ MotifQualityDropModel::MotifQualityDropModel( const boost::filesystem::path& tab
     }
 }
 
+unsigned int& MotifQualityDropModel::kmerGroup( const unsigned int kmerLength, const uint64_t kmer )
+{
+    std::vector< unsigned int > &groupPerKmer = groupPerKmer_[kmerLength];
+    if (groupPerKmer.empty())
+    {
+        groupPerKmer.resize( 1ul << (2 * kmerLength), NO_GROUP );
+    }
+    return groupPerKmer[kmer];
+}
+
+namespace
+{
+
+// Layout of the motif quality drop table in an ErrorModelBundle
+struct MotifKmerRecord
+{
+    uint64_t kmer;
+    uint32_t kmerLength;
+    uint32_t group;
+};
+
+struct MotifRepeatRecord
+{
+    float meanQualityDrop;
+    uint32_t weightCount;
+    uint64_t firstWeight;
+};
+
+} // anonymous namespace
+
+void MotifQualityDropModel::save( ErrorModelBundleWriter& bundle ) const
+{
+    vector< MotifKmerRecord > kmers;
+    vector< uint64_t > groupEnds;
+    vector< MotifRepeatRecord > repeats;
+    vector< double > weights;
+    for (unsigned int kmerLength=0; kmerLength<groupPerKmer_.size(); ++kmerLength)
+    {
+        for (uint64_t kmer=0; kmer<groupPerKmer_[kmerLength].size(); ++kmer)
+        {
+            if (groupPerKmer_[kmerLength][kmer] != NO_GROUP)
+            {
+                MotifKmerRecord record;
+                record.kmer = kmer;
+                record.kmerLength = kmerLength;
+                record.group = groupPerKmer_[kmerLength][kmer];
+                kmers.push_back( record );
+            }
+        }
+    }
+    BOOST_FOREACH( const boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > >& group, groups_ )
+    {
+        BOOST_FOREACH( const MotifRepeatQualityDropInfo& info, *group )
+        {
+            const vector<double>& cumulativeWeights = info.distribution.cumulativeWeights();
+            MotifRepeatRecord repeat;
+            repeat.meanQualityDrop = info.meanQualityDrop;
+            repeat.weightCount = cumulativeWeights.size();
+            repeat.firstWeight = weights.size();
+            repeats.push_back( repeat );
+            weights.insert( weights.end(), cumulativeWeights.begin(), cumulativeWeights.end() );
+        }
+        groupEnds.push_back( repeats.size() );
+    }
+    bundle.add( MOTIF_KMERS, kmers );
+    bundle.add( MOTIF_GROUPS, groupEnds );
+    bundle.add( MOTIF_REPEATS, repeats );
+    bundle.add( MOTIF_WEIGHTS, weights );
+}
+
+void MotifQualityDropModel::load( const ErrorModelBundleReader& bundle )
+{
+    unsigned long kmerCount, groupCount, repeatCount, weightCount;
+    const MotifKmerRecord *kmers = bundle.get<MotifKmerRecord>( MOTIF_KMERS, kmerCount );
+    const uint64_t *groupEnds = bundle.get<uint64_t>( MOTIF_GROUPS, groupCount );
+    const MotifRepeatRecord *repeats = bundle.get<MotifRepeatRecord>( MOTIF_REPEATS, repeatCount );
+    const double *weights = bundle.get<double>( MOTIF_WEIGHTS, weightCount );
+
+    // The sections are only checked as a whole by the bundle: their indices must not send us outside of them
+    groups_.resize( groupCount );
+    uint64_t groupStart = 0;
+    for (unsigned int i=0; i<groupCount; ++i)
+    {
+        if (groupEnds[i] < groupStart || groupEnds[i] > repeatCount)
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s: invalid end of motif group %d") % bundle.filename() % i).str() ) );
+        }
+        groups_[i].reset( new std::vector< MotifRepeatQualityDropInfo >( groupEnds[i] - groupStart ) );
+        for (uint64_t j=groupStart; j<groupEnds[i]; ++j)
+        {
+            if (repeats[j].firstWeight > weightCount || repeats[j].weightCount > weightCount - repeats[j].firstWeight)
+            {
+                BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s: motif repeat %d goes beyond the weights") % bundle.filename() % j).str() ) );
+            }
+            MotifRepeatQualityDropInfo &info = (*groups_[i])[j - groupStart];
+            info.meanQualityDrop = repeats[j].meanQualityDrop;
+            info.distribution.setCumulativeWeights( weights + repeats[j].firstWeight, weights + repeats[j].firstWeight + repeats[j].weightCount );
+        }
+        groupStart = groupEnds[i];
+    }
+
+    active_ = (kmerCount > 0);
+    groupPerKmer_.clear();
+    groupPerKmer_.resize( MAX_MOTIF_KMER_LENGTH+1 );
+    for (unsigned int i=0; i<kmerCount; ++i)
+    {
+        if (kmers[i].kmerLength > MAX_MOTIF_KMER_LENGTH || kmers[i].kmer >= (1ul << (2 * kmers[i].kmerLength)) || kmers[i].group >= groupCount)
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "error model", (boost::format("%s: invalid motif kmer %d") % bundle.filename() % i).str() ) );
+        }
+        kmerGroup( kmers[i].kmerLength, kmers[i].kmer ) = kmers[i].group;
+    }
+}
+
 MotifRepeatQualityDropInfo* MotifQualityDropModel::getMotifRepeatQualityDrop( const uint64_t kmer1, const unsigned int repeatKmerLength, const unsigned int repeatCount )
 {
 //    cout << "getMotifRepeatQualityDrop:" << endl;
@@ -615,16 +818,17 @@ MotifRepeatQualityDropInfo* MotifQualityDropModel::getMotifRepeatQualityDrop( co
 //    int result = ( repeatCount - 1 ) * repeatKmerLength;
 //    cout << " => result=" << result << endl;
 
-    std::map< uint64_t, boost::shared_ptr< std::vector< MotifRepeatQualityDropInfo > > >::iterator it = tableData_[repeatKmerLength].find( kmer1 );
-    if (it != tableData_[repeatKmerLength].end())
+    const unsigned int group = groupPerKmer_[repeatKmerLength][kmer1];
+    if (group != NO_GROUP)
     {
-//        cout << "kmer found up to repeat " << it->second->size() << endl;
-        unsigned int repeatCount2 = min<unsigned int>( repeatCount, it->second->size() );
+        std::vector< MotifRepeatQualityDropInfo > &repeatInfos = *groups_[group];
+//        cout << "kmer found up to repeat " << repeatInfos.size() << endl;
+        unsigned int repeatCount2 = min<unsigned int>( repeatCount, repeatInfos.size() );
         if (repeatCount2 > 0)
         {
-            if ( (*it->second).size() <= repeatCount2 )
-                repeatCount2 = (*it->second).size() - 1;
-            MotifRepeatQualityDropInfo *info = &((*it->second)[repeatCount2]);
+            if ( repeatInfos.size() <= repeatCount2 )
+                repeatCount2 = repeatInfos.size() - 1;
+            MotifRepeatQualityDropInfo *info = &(repeatInfos[repeatCount2]);
 //            int result2 = (int)(info.meanQualityDrop);
 //            cout << " => result2=" << result2 << endl;
             return info;
@@ -634,7 +838,7 @@ MotifRepeatQualityDropInfo* MotifQualityDropModel::getMotifRepeatQualityDrop( co
     return 0;
 }
 
-void MotifQualityDropModel::applyQualityDrop( unsigned int& quality, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext, const unsigned int cycle, boost::mt19937& randomGen )
+void MotifQualityDropModel::applyQualityDrop( unsigned int& quality, const char bclBase, ClusterErrorModelContext& clusterErrorModelContext, const unsigned int cycle, model::FragmentRandomGenerator& randomGen )
 {
     if (!active_) { return; }
 
@@ -653,10 +857,16 @@ void MotifQualityDropModel::applyQualityDrop( unsigned int& quality, const char
     {
         // detect repeated kmer
         const unsigned int maxKmerLength = min<unsigned int>( MAX_MOTIF_KMER_LENGTH, kmerLength );
+        const unsigned int repeatLengthThreshold = 4;
 
         for ( unsigned int repeatKmerLength = 1; repeatKmerLength <= maxKmerLength; ++repeatKmerLength )
         {
             unsigned int repeatKmerLengthInBits = 2 * repeatKmerLength;
+            // Any repeat above the threshold has its last 4 bases equal to the ones a kmer before: most bases stop here
+            if (groupPerKmer_[repeatKmerLength].empty() || ((kmer ^ (kmer >> repeatKmerLengthInBits)) & 0xFF))
+            {
+                continue;
+            }
             uint64_t kmerMask = (1ull << repeatKmerLengthInBits) - 1;
             uint64_t kmer0 = kmer;
             uint64_t kmer1 = kmer & kmerMask;
@@ -673,7 +883,6 @@ void MotifQualityDropModel::applyQualityDrop( unsigned int& quality, const char
                 );
 
             unsigned int repeatLengthExcludingFirst = ( repeatCount - 1 ) * repeatKmerLength;
-            const unsigned int repeatLengthThreshold = 4;
             if ( repeatLengthExcludingFirst >= repeatLengthThreshold
                  && repeatLengthExcludingFirst > strongestRepeat_repeatLengthExcludingFirst )
             {
@@ -826,6 +1035,20 @@ QQTable::QQTable( const boost::filesystem::path& qqTableFilename )
     }
 }
 
+void QQTable::save( ErrorModelBundleWriter& bundle ) const
+{
+    bundle.add( QQ_ERROR_RATES, qualityToProbability_ );
+}
+
+void QQTable::load( const ErrorModelBundleReader& bundle )
+{
+    qualityToProbability_ = bundle.getVector<double>( QQ_ERROR_RATES );
+    if (qualityToProbability_.size() < model::Phred::QUALITY_MAX+1)
+    {
+        EAGLE_ERROR("QQ table doesn't contain enough values");
+    }
+}
+
 double QQTable::qualToErrorRate( const unsigned int qual )
 {
     if (qual >= qualityToProbability_.size())
@@ -837,21 +1060,56 @@ double QQTable::qualToErrorRate( const unsigned int qual )
 }
 
 
-ErrorModel::ErrorModel( const vector<boost::filesystem::path>& qualityTableFilenames, const boost::filesystem::path& mismatchTableFilename, const boost::filesystem::path& homopolymerIndelTableFilename, const boost::filesystem::path& motifQualityDropTableFilename, const boost::filesystem::path& qqTableFilename, const std::vector< std::string >& errorModelOptions )
+ErrorModel::ErrorModel( const vector<boost::filesystem::path>& qualityTableFilenames, const boost::filesystem::path& mismatchTableFilename, const boost::filesystem::path& homopolymerIndelTableFilename, const boost::filesystem::path& motifQualityDropTableFilename, const boost::filesystem::path& qqTableFilename, const boost::filesystem::path& compiledErrorModelFile, const std::vector< std::string >& errorModelOptions )
     : qualityModel_           ( qualityTableFilenames )
     , sequencingMismatchModel_( mismatchTableFilename )
     , homopolymerIndelModel_  ( homopolymerIndelTableFilename )
     , motifQualityDropModel_  ( motifQualityDropTableFilename )
-    , randomQualityDropModel_ ()
-    , qualityGlitchModel_     ()
     , happyPhasingModel_      ()
     , longreadBaseDuplicationModel_( errorModelOptions )
     , longreadDeletionModel_       ( errorModelOptions )
     , qqTable_                ( qqTableFilename )
 {
+    if (!compiledErrorModelFile.empty())
+    {
+        compiledErrorModel_.reset( new ErrorModelBundleReader( compiledErrorModelFile ) );
+        qualityModel_.load( *compiledErrorModel_ );
+        sequencingMismatchModel_.load( *compiledErrorModel_ );
+        homopolymerIndelModel_.load( *compiledErrorModel_ );
+        motifQualityDropModel_.load( *compiledErrorModel_ );
+        qqTable_.load( *compiledErrorModel_ );
+    }
+    selectPipeline();
+}
+
+void ErrorModel::selectPipeline()
+{
+    // Indexed by [withHomopolymerIndels][withMotifQualityDrop][withLongreadErrors]
+    static const Pipeline pipelines[2][2][2] = {
+        { { &ErrorModel::getQualityAndRandomErrorWith<false, false, false>, &ErrorModel::getQualityAndRandomErrorWith<false, false, true> },
+          { &ErrorModel::getQualityAndRandomErrorWith<false, true, false>,  &ErrorModel::getQualityAndRandomErrorWith<false, true, true> } },
+        { { &ErrorModel::getQualityAndRandomErrorWith<true, false, false>,  &ErrorModel::getQualityAndRandomErrorWith<true, false, true> },
+          { &ErrorModel::getQualityAndRandomErrorWith<true, true, false>,   &ErrorModel::getQualityAndRandomErrorWith<true, true, true> } }
+    };
+    const bool withHomopolymerIndels = homopolymerIndelModel_.isActive();
+    const bool withMotifQualityDrop = motifQualityDropModel_.isActive();
+    const bool withLongreadErrors = longreadBaseDuplicationModel_.isActive() || longreadDeletionModel_.isActive();
+    pipeline_ = pipelines[withHomopolymerIndels][withMotifQualityDrop][withLongreadErrors];
+}
+
+void ErrorModel::save( const boost::filesystem::path& compiledErrorModelFile ) const
+{
+    ErrorModelBundleWriter bundle( compiledErrorModelFile );
+    qualityModel_.save( bundle );
+    sequencingMismatchModel_.save( bundle );
+    homopolymerIndelModel_.save( bundle );
+    motifQualityDropModel_.save( bundle );
+    qqTable_.save( bundle );
+    bundle.close();
 }
 
-void ErrorModel::getQualityAndRandomError( boost::mt19937& randomGen, const unsigned int cycle, const char base, unsigned int& quality, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
+template< bool withHomopolymerIndels, bool withMotifQualityDrop, bool withLongreadErrors >
+void ErrorModel::getQualityAndRandomErrorWith( model::FragmentRandomGenerator& randomGen, const unsigned int cycle, const char base, unsigned int& quality, unsigned int& randomErrorType, char& bclBase, ClusterErrorModelContext& clusterErrorModelContext )
 {
     bclBase = baseConverter_.normalizedBcl( base );
     if (bclBase==4)
@@ -866,20 +1124,23 @@ void ErrorModel::getQualityAndRandomError( boost::mt19937& randomGen, const unsi
 
 //    quality = qualityModel_.getQuality( randomGen, cycle, bclBase, clusterErrorModelContext );
     quality = qualityModel_.getQuality( randomGen, cycle, clusterErrorModelContext );
-    motifQualityDropModel_.applyQualityDrop( quality, bclBase, clusterErrorModelContext, cycle, randomGen );
-    randomQualityDropModel_.applyQualityDrop( quality, bclBase, clusterErrorModelContext );
-    qualityGlitchModel_.applyQualityDrop( quality, bclBase, clusterErrorModelContext );
-    happyPhasingModel_.applyQualityDrop( quality, bclBase, clusterErrorModelContext );
-
-    // Apply quality drop due to phasing, using an additive strategy
-    // This quality drop was calculated as part of the previous "applyQualityDrop" methods
-    if ((int)quality > clusterErrorModelContext.phasingContext.qualityDrop)
-    {
-      quality -= clusterErrorModelContext.phasingContext.qualityDrop;
-    }
-    else
+    // Without motif quality drops, the quality drop due to phasing stays at 0
+    // (RandomQualityDropModel and QualityGlitchModel are not implemented yet, and therefore not called)
+    if (withMotifQualityDrop)
     {
-      quality = 0;
+        motifQualityDropModel_.applyQualityDrop( quality, bclBase, clusterErrorModelContext, cycle, randomGen );
+        happyPhasingModel_.applyQualityDrop( quality, bclBase, clusterErrorModelContext );
+
+        // Apply quality drop due to phasing, using an additive strategy
+        // This quality drop was calculated as part of the previous "applyQualityDrop" methods
+        if ((int)quality > clusterErrorModelContext.phasingContext.qualityDrop)
+        {
+          quality -= clusterErrorModelContext.phasingContext.qualityDrop;
+        }
+        else
+        {
+          quality = 0;
+        }
     }
 
     // Make sure quality scores stay above 2
@@ -903,9 +1164,16 @@ void ErrorModel::getQualityAndRandomError( boost::mt19937& randomGen, const unsi
 #endif //ifdef REPORT_ERROR_RATE
 
     sequencingMismatchModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
-    homopolymerIndelModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
-    longreadBaseDuplicationModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
-    longreadDeletionModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
+    // Without any indel rate, the homopolymer model doesn't draw its random number for each homopolymer base either
+    if (withHomopolymerIndels)
+    {
+        homopolymerIndelModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
+    }
+    if (withLongreadErrors)
+    {
+        longreadBaseDuplicationModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
+        longreadDeletionModel_.apply( randomGen, errorRate, randomErrorType, bclBase, clusterErrorModelContext );
+    }
 }
 
 } // namespace genome
@@ -21,10 +21,10 @@ namespace genome
 {
 
 
-ReadClusterSharedData::ReadClusterSharedData( const unsigned int clusterLength, const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions )
+ReadClusterSharedData::ReadClusterSharedData( const unsigned int clusterLength, const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const boost::filesystem::path& compiledErrorModelFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions )
     : clusterLength_  ( clusterLength )
     , runInfo_        ( runInfo )
-    , errorModel_     ( qualityTableFiles, mismatchTableFile, homopolymerIndelTableFile, motifQualityDropTableFile, qqTableFile, errorModelOptions )
+    , errorModel_     ( qualityTableFiles, mismatchTableFile, homopolymerIndelTableFile, motifQualityDropTableFile, qqTableFile, compiledErrorModelFile, errorModelOptions )
     , userRandomSeed_ ( userRandomSeed )
 {
     SharedFastaReference::init( sampleGenomeDir );
@@ -62,7 +62,7 @@ ReadClusterSharedData::ReadClusterSharedData( const unsigned int clusterLength,
 }
 
 
-ReadClusterWithErrors::ReadClusterWithErrors(ReadClusterSharedData &sharedData, const EnrichedFragment& eFragment, boost::shared_ptr<boost::mt19937> randomGen)
+ReadClusterWithErrors::ReadClusterWithErrors(ReadClusterSharedData &sharedData, const EnrichedFragment& eFragment, const eagle::model::FragmentRandomGenerator& randomGen)
     : sharedData_(sharedData)
     , randomGen_(randomGen)
     , eFragment_(eFragment)
@@ -82,13 +82,12 @@ const char *ReadClusterWithErrors::getBclCluster( bool generateCigar, const bool
 {
     unsigned int posInCluster = 0;
     unsigned int readNum = 0;
-    ClusterErrorModelContext clusterErrorModelContext;
 
     lazyEvaluationDone_ = true;
 
     BOOST_FOREACH(const eagle::io::ReadDescription &rd, sharedData_.runInfo_.reads)
     {
-        clusterErrorModelContext.initialiseForNewRead();
+        startRead( readNum );
 
         unsigned int lastCigarOp = 0;
         unsigned int lastCigarOpCount = 0;
@@ -98,45 +97,19 @@ const char *ReadClusterWithErrors::getBclCluster( bool generateCigar, const bool
             usedDnaLength_.resize( readNum+1 );
         }
 
-//        unsigned int readLength = rd.lastCycle - rd.firstCycle + 1; //eFragment_.getReadLength( readNum );
-        for (unsigned int cycle=rd.firstCycle, posToRead=0; cycle<=rd.lastCycle; ++cycle, ++posToRead)
+        for (unsigned int cycle=rd.firstCycle; cycle<=rd.lastCycle; ++cycle)
         {
-            char base = eFragment_.getBase( readNum, posToRead );
-            unsigned int quality, randomErrorType;
-            char bclBase;
-            unsigned int newCigarOp = 0;
-            sharedData_.errorModel_.getQualityAndRandomError( *randomGen_, cycle, base, quality, randomErrorType, bclBase, clusterErrorModelContext );
-
-            switch (randomErrorType)
+            char bclBaseAndQ;
+            const unsigned int newCigarOp = applyErrorModel( readNum, cycle, bclBaseAndQ );
+            if (newCigarOp == 2) // 'D'
             {
-            case ErrorModel::NoError:
-            case ErrorModel::BaseSubstitution:
-            case ErrorModel::BaseInsertion:
-                {
-                    char bclBaseAndQ = bclBase | (quality<<2);
-                    assert( posInCluster < buf_.size() );
-                    buf_[posInCluster++] = bclBaseAndQ;
-                    //            ++stats[cycle][bclBase & 3];
-
-                    if (randomErrorType == ErrorModel::BaseInsertion)
-                    {
-                        --posToRead; // next cycle will read from the same pos
-                        newCigarOp = 1; // 1='I'
-                    }
-                    else
-                    {
-                        newCigarOp = 0; // 0='M'
-                    }
-                }
-                break;
-            case ErrorModel::BaseDeletion:
-                {
-                    --cycle; // repeat same cycle but will read next pos
-                    newCigarOp = 2; // 2='D'
-                }
-                break;
-            default:
-                assert( false );
+                --cycle; // repeat same cycle but will read next pos
+            }
+            else
+            {
+                assert( posInCluster < buf_.size() );
+                buf_[posInCluster++] = bclBaseAndQ;
+                //            ++stats[cycle][bclBase & 3];
             }
 
             if (generateCigar && (!dropLastBase || cycle<rd.lastCycle))
@@ -181,6 +154,56 @@ const char *ReadClusterWithErrors::getBclCluster( bool generateCigar, const bool
     return buf_.c_str();
 }
 
+void ReadClusterWithErrors::startRead( const unsigned int readNum )
+{
+    const eagle::io::ReadDescription &rd = sharedData_.runInfo_.reads[readNum];
+    clusterErrorModelContext_.initialiseForNewRead();
+    posToRead_ = 0;
+
+    // Template bases of the read in one go. Deletions make the read go further into the template,
+    // and the few bases beyond, like spans the bulk copy can't serve, go through getBase()
+    const unsigned int readLength = rd.lastCycle - rd.firstCycle + 1;
+    readBases_.resize( readLength );
+    prefetchedBases_ = eFragment_.copyBases( &readBases_[0], readNum, 0, readLength ) ? readLength : 0;
+}
+
+char ReadClusterWithErrors::getNextBclByte( const unsigned int readNum, const unsigned int cycle )
+{
+    char bclBaseAndQ;
+    while (applyErrorModel( readNum, cycle, bclBaseAndQ ) == 2) // 'D': same cycle but will read next pos
+    {
+    }
+    return bclBaseAndQ;
+}
+
+unsigned int ReadClusterWithErrors::applyErrorModel( const unsigned int readNum, const unsigned int cycle, char& bclBaseAndQ )
+{
+    char base = (posToRead_ < prefetchedBases_) ? readBases_[posToRead_] : eFragment_.getBase( readNum, posToRead_ );
+    unsigned int quality, randomErrorType;
+    char bclBase;
+    sharedData_.errorModel_.getQualityAndRandomError( randomGen_, cycle, base, quality, randomErrorType, bclBase, clusterErrorModelContext_ );
+
+    switch (randomErrorType)
+    {
+    case ErrorModel::NoError:
+    case ErrorModel::BaseSubstitution:
+        bclBaseAndQ = bclBase | (quality<<2);
+        ++posToRead_;
+        return 0; // 0='M'
+    case ErrorModel::BaseInsertion:
+        bclBaseAndQ = bclBase | (quality<<2);
+        return 1; // 1='I', next cycle will read from the same pos
+    case ErrorModel::BaseDeletion:
+        bclBaseAndQ = 0; // no base for this cycle yet
+        ++posToRead_;
+        return 2; // 2='D'
+    default:
+        assert( false );
+        bclBaseAndQ = 0;
+        return 0;
+    }
+}
+
 
 const std::vector<unsigned int>& ReadClusterWithErrors::getCigar( unsigned int readNum, const bool dropLastBase )
 {
@@ -247,21 +270,51 @@ const string ReadClusterWithErrors::getNucleotideOrQualitySequenceForRead( unsig
 }
 
 
-ReadClusterFactory::ReadClusterFactory( const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions )
+ReadClusterFactory::ReadClusterFactory( const eagle::io::RunInfo &runInfo, const boost::filesystem::path& sampleGenomeDir, const vector<boost::filesystem::path>& qualityTableFiles, const boost::filesystem::path& mismatchTableFile, const boost::filesystem::path& homopolymerIndelTableFile, const boost::filesystem::path& motifQualityDropTableFile, const boost::filesystem::path& qqTableFile, const boost::filesystem::path& compiledErrorModelFile, const unsigned int userRandomSeed, const std::vector< std::string >& errorModelOptions )
     : runInfo_(runInfo)
-    , sharedData_( runInfo_.getClusterLength(), runInfo_, sampleGenomeDir, qualityTableFiles, mismatchTableFile, homopolymerIndelTableFile, motifQualityDropTableFile, qqTableFile, userRandomSeed, errorModelOptions )
+    , sharedData_( runInfo_.getClusterLength(), runInfo_, sampleGenomeDir, qualityTableFiles, mismatchTableFile, homopolymerIndelTableFile, motifQualityDropTableFile, qqTableFile, compiledErrorModelFile, userRandomSeed, errorModelOptions )
 {
 }
 
 ReadClusterWithErrors ReadClusterFactory::getReadClusterWithErrors( const eagle::model::Fragment &f ) {
-    unsigned int seed = ((f.fragmentNum_+1) * sharedData_.userRandomSeed_) ^ 0x9e3779b9; // Avoid too many zeroes in the non-random initial state, as they delay real randomness
-    boost::shared_ptr< boost::mt19937 > randomGen( new boost::mt19937(seed) );
-    randomGen->discard( 10 ); // Generates several random values to make the state more random
+    // Counter-based generator: the stream only depends on (seed, fragmentNum), so no state needs initialising
+    eagle::model::FragmentRandomGenerator randomGen( sharedData_.userRandomSeed_, f.fragmentNum_ );
 
-    ReadClusterWithErrors cluster( sharedData_, EnrichedFragment( f, sharedData_.multiplexedFragmentStructures, randomGen->operator()()%2 ), randomGen );
+    ReadClusterWithErrors cluster( sharedData_, EnrichedFragment( f, sharedData_.multiplexedFragmentStructures, randomGen()%2 ), randomGen );
     return cluster;
 }
 
+void ReadClusterFactory::getBclClusterBlock( const std::vector< eagle::model::Fragment >& fragments, std::vector< char >& bclBlock )
+{
+    // Each cluster has its own random stream, so the order in which they progress doesn't change their bases
+    std::vector< ReadClusterWithErrors > clusters;
+    clusters.reserve( fragments.size() );
+    BOOST_FOREACH( const eagle::model::Fragment& f, fragments )
+    {
+        clusters.push_back( getReadClusterWithErrors( f ) );
+    }
+
+    const unsigned int clusterCount = clusters.size();
+    bclBlock.resize( sharedData_.clusterLength_ * clusterCount );
+    unsigned int readNum = 0;
+    BOOST_FOREACH(const eagle::io::ReadDescription &rd, runInfo_.reads)
+    {
+        for (unsigned int i=0; i<clusterCount; ++i)
+        {
+            clusters[i].startRead( readNum );
+        }
+        for (unsigned int cycle=rd.firstCycle; cycle<=rd.lastCycle; ++cycle)
+        {
+            char *bclCycle = &bclBlock[(cycle-1) * clusterCount];
+            for (unsigned int i=0; i<clusterCount; ++i)
+            {
+                bclCycle[i] = clusters[i].getNextBclByte( readNum, cycle );
+            }
+        }
+        readNum++;
+    }
+}
+
 
 } // namespace genome
 } // namespace eagle
@@ -23,6 +23,7 @@
 #include <boost/lambda/bind.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
+#include <cstring>
 #include <numeric>
 #include <algorithm>
 
@@ -32,31 +33,66 @@ namespace eagle
 namespace genome
 {
 
+namespace
+{
+
+class GlobalPosLess
+{
+public:
+    GlobalPosLess( const std::vector< eagle::io::FastaInfo >& infos ) : infos_( infos ) {}
+    bool operator()( const unsigned int lhs, const unsigned int rhs ) const
+    {
+        return infos_[lhs].position.first < infos_[rhs].position.first;
+    }
+private:
+    const std::vector< eagle::io::FastaInfo >& infos_;
+};
+
+} // anonymous namespace
+
+
 FastaReference::FastaReference (
     const eagle::io::FastaMetadata& metadata
     )
     : reader_(metadata)
     , mode_(std::ios_base::in)
-    , local2globalCache_roundRobin( 0 )
-    , local2globalCache_chr(2)
-    , local2globalCache_pos(2)
+    , currentPackedFile_( 0 )
+    , currentPackedContig_( 0 )
+    , global2localContigId_( -1 )
 {
     inputStructure(metadata);
+    boost::shared_ptr< ContigTables > tables( new ContigTables );
+    buildContigTables( *tables );
+    openPackedFiles( *tables );
+    contigTables_ = tables;
 #ifdef EAGLE_DEBUG_MODE
     std::cout << "FASTA index Metadata:" << std::endl
               << reader_.index() << std::endl;
 #endif
 }
 
+FastaReference::FastaReference (
+    const boost::shared_ptr< const ContigTables >& contigTables
+    )
+    : reader_(contigTables->index)
+    , mode_(std::ios_base::in)
+    , currentPackedFile_( 0 )
+    , currentPackedContig_( 0 )
+    , contigTables_( contigTables )
+    , global2localContigId_( -1 )
+{
+}
+
 FastaReference::FastaReference (
     const boost::filesystem::path& outputDir,
     const bool overwrite
     )
     : writer_(outputDir,overwrite)
     , mode_(std::ios_base::out)
-    , local2globalCache_roundRobin( 0 )
-    , local2globalCache_chr(2)
-    , local2globalCache_pos(2)
+    , currentPackedFile_( 0 )
+    , currentPackedContig_( 0 )
+    , contigTables_( new ContigTables )
+    , global2localContigId_( -1 )
 {
     outputStructure(outputDir);
 }
@@ -69,11 +105,14 @@ FastaReference::FastaReference (
     : reader_(metadata)
     , writer_(outputDir,overwrite)
     , mode_(std::ios_base::in & std::ios_base::out)
-    , local2globalCache_roundRobin( 0 )
-    , local2globalCache_chr(2)
-    , local2globalCache_pos(2)
+    , currentPackedFile_( 0 )
+    , currentPackedContig_( 0 )
+    , global2localContigId_( -1 )
 {
     inputStructure(metadata);
+    boost::shared_ptr< ContigTables > tables( new ContigTables );
+    buildContigTables( *tables );
+    contigTables_ = tables;
     outputStructure(outputDir);
 }
 
@@ -88,6 +127,38 @@ void FastaReference::inputStructure( const eagle::io::FastaMetadata& metadata )
     }
 }
 
+void FastaReference::openPackedFiles( ContigTables& tables ) const
+{
+    BOOST_FOREACH(const eagle::io::FastaIndex &idx, tables.index)
+    {
+        if (!boost::filesystem::exists( idx.first ) || !eagle::io::PackedFastaWriter::isUpToDate( idx.first ))
+        {
+            tables.packedFiles.clear();
+            return;
+        }
+        boost::shared_ptr< eagle::io::PackedFastaReader > packedFile( new eagle::io::PackedFastaReader( eagle::io::PackedFastaWriter::packedFilename( idx.first ) ) );
+        BOOST_FOREACH(const eagle::io::FastaInfo &info, idx.second)
+        {
+            const int contigNum = packedFile->findContig( info.contigName );
+            if (contigNum < 0 || packedFile->contig( contigNum ).size != info.contigSize)
+            {
+                EAGLE_WARNING( "Packed copy of " << idx.first << " does not match contig '" << info.contigName << "': using the FASTA file instead" );
+                tables.packedFiles.clear();
+                return;
+            }
+        }
+        tables.packedFiles.push_back( packedFile );
+    }
+    for (unsigned int i = 0; i < tables.infos.size(); ++i)
+    {
+        tables.packedContigIds.push_back( tables.packedFiles[ tables.fileIds[i] ]->findContig( tables.infos[i].contigName ) );
+    }
+    if (!tables.packedFiles.empty())
+    {
+        std::clog << "Reading reference bases from " << tables.packedFiles.size() << " packed FASTA file(s)" << std::endl;
+    }
+}
+
 void FastaReference::outputStructure( const boost::filesystem::path& outputDir )
 {
     if (!boost::filesystem::exists(outputDir) && !boost::filesystem::create_directory(outputDir) && !boost::filesystem::exists(outputDir))
@@ -115,57 +186,79 @@ void FastaReference::outputMode()
     }
 }
 
-unsigned long FastaReference::local2global( const eagle::model::Locus& location)
+void FastaReference::buildContigTables( ContigTables& tables ) const
 {
-    assert( location.pos() > 0 );
-    if (location.chr() == local2globalCache_chr[0])
+    tables.index = reader_.index();
+    std::vector< eagle::io::FastaInfo > infos;
+    std::vector< unsigned int > fileIds;
+    for (eagle::io::FastaConstIterator idx = tables.index.begin(); idx != tables.index.end(); ++idx)
     {
-        return local2globalCache_pos[0] + location.pos() - 1;
+        BOOST_FOREACH(const eagle::io::FastaInfo &info, idx->second)
+        {
+            infos.push_back( info );
+            fileIds.push_back( idx - tables.index.begin() );
+        }
     }
-    else if (location.chr() == local2globalCache_chr[1])
+    // Global positions follow the order of the contigs, unless they come from an out-of-order genome_size.xml
+    std::vector< unsigned int > order( infos.size() );
+    for (unsigned int i = 0; i < order.size(); ++i)
     {
-        return local2globalCache_pos[1] + location.pos() - 1;
+        order[i] = i;
     }
-    else
+    std::stable_sort( order.begin(), order.end(), GlobalPosLess( infos ) );
+    BOOST_FOREACH(const unsigned int i, order)
     {
-        static bool firstTime = true;
-        if (firstTime && local2globalCache_chr[local2globalCache_roundRobin] != "")
-        {
-            static int maxMsgCount = 100;
-            if (maxMsgCount > 0)
-            {
-                --maxMsgCount;
-                std::clog << "Warning: degraded performance due to more than 2 alleles - local2global: updating cache pos " << local2globalCache_roundRobin << " from " <<  local2globalCache_chr[local2globalCache_roundRobin]<< " to " << location.chr() << std::endl;
-            }
-            firstTime = false;
-        }
-        eagle::io::FastaInfo info;
-        boost::filesystem::path file = reader_.find(location.chr(),info);
-        if (file.empty())
-        {
-            std::stringstream message;
-            message << "Could not convert local position " << location << " into global" << std::endl;
-            EAGLE_ERROR( message.str() );
-        }
-        local2globalCache_chr[local2globalCache_roundRobin] = location.chr();
-        local2globalCache_pos[local2globalCache_roundRobin] = info.position.first;
-        local2globalCache_roundRobin = (local2globalCache_roundRobin+1)%2;
-        return info.position.first + location.pos() - 1;
+        tables.infos.push_back( infos[i] );
+        tables.ends.push_back( infos[i].position.first + infos[i].contigSize );
+        tables.files.push_back( tables.index.begin()[ fileIds[i] ].first );
+        tables.fileIds.push_back( fileIds[i] );
+        tables.ids.push_back( i );
+        // insert() keeps the first contig of a given name, like MultiFastaReader::find()
+        tables.indexByName.insert( std::make_pair( infos[i].contigName, tables.infos.size() - 1 ) );
     }
 }
 
+unsigned int FastaReference::findContig( const unsigned long globalPos ) const
+{
+    const std::vector< unsigned long >& ends = contigTables_->ends;
+    const unsigned int i = std::upper_bound( ends.begin(), ends.end(), globalPos ) - ends.begin();
+    if (i < contigTables_->infos.size() && contigTables_->infos[i].within( globalPos ))
+    {
+        return i;
+    }
+    return contigTables_->infos.size();
+}
+
+unsigned int FastaReference::findContig( const std::string& contigName ) const
+{
+    boost::unordered_map< std::string, unsigned int >::const_iterator it = contigTables_->indexByName.find( contigName );
+    return (it != contigTables_->indexByName.end()) ? it->second : contigTables_->infos.size();
+}
+
+unsigned long FastaReference::local2global( const eagle::model::Locus& location)
+{
+    assert( location.pos() > 0 );
+    const unsigned int i = findContig( location.chr() );
+    if (i == contigTables_->infos.size())
+    {
+        std::stringstream message;
+        message << "Could not convert local position " << location << " into global" << std::endl;
+        EAGLE_ERROR( message.str() );
+    }
+    return contigTables_->infos[i].position.first + location.pos() - 1;
+}
+
 eagle::model::Locus FastaReference::global2local(unsigned long globalPos)
 {
     if ( !global2localCache.within(globalPos) )
     {
-        std::clog << "global2local: updating cache from " << global2localCache.contigName;
-        //    eagle::io::FastaInfo info;
-        boost::filesystem::path file = reader_.find(globalPos,global2localCache);
-        if (file.empty())
+        const unsigned int i = findContig( globalPos );
+        if (i == contigTables_->infos.size())
         {
             EAGLE_ERROR( (boost::format("Could not convert global location %lu into local") % globalPos).str() );
         }
-        std::clog << " to " << global2localCache.contigName << std::endl;
+        global2localCache = contigTables_->infos[i];
+        global2localContigId_ = contigTables_->ids[i];
     }
 
     return eagle::model::Locus( global2localCache.contigName, globalPos - global2localCache.position.first + 1);
@@ -174,28 +267,127 @@ eagle::model::Locus FastaReference::global2local(unsigned long globalPos)
 void FastaReference::convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& posInContig )
 {
     eagle::model::Locus location = global2local(globalPos);
-    refId       = reader_.getGlobalContigId();
+    refId       = global2localContigId_;
     posInContig = location.pos();
 }
 
+void FastaReference::selectContig( const unsigned int i )
+{
+    currentGetInfo_ = contigTables_->infos[i];
+    currentGetFile_ = contigTables_->files[i];
+    currentContig_.reset();
+    if (!contigTables_->packedFiles.empty())
+    {
+        currentPackedFile_ = contigTables_->packedFiles[ contigTables_->fileIds[i] ].get();
+        currentPackedContig_ = contigTables_->packedContigIds[i];
+        currentPackedCursor_ = eagle::io::PackedFastaCursor();
+    }
+}
+
+const std::vector<char>& FastaReference::currentContigText()
+{
+    if (!currentContig_)
+    {
+        currentContig_ = ContigStore::get( currentGetFile_, currentGetInfo_ );
+    }
+    return *currentContig_;
+}
+
+char FastaReference::getFromCurrentContig( const unsigned long i, bool &overlapContigBoundary )
+{
+    if (currentPackedFile_)
+    {
+        const unsigned long posInContig = i - currentGetInfo_.position.first;
+        overlapContigBoundary = (posInContig >= currentGetInfo_.contigSize);
+        return currentPackedFile_->get( currentPackedContig_, posInContig % currentGetInfo_.contigSize, currentPackedCursor_ );
+    }
+    return getFromContigText( i, overlapContigBoundary );
+}
+
+// Same indexing as MultiFastaReader::operator[] and inCache(), on the text of the current contig
+char FastaReference::getFromContigText( const unsigned long i, bool &overlapContigBoundary )
+{
+    const std::vector<char>& text = currentContigText();
+    unsigned long posInContig = i - currentGetInfo_.position.first;
+    overlapContigBoundary = (posInContig >= currentGetInfo_.contigSize);
+    posInContig %= currentGetInfo_.contigSize;
+    unsigned long fullLinesCount = posInContig / currentGetInfo_.contigWidth.first;
+    unsigned long posInLine = posInContig % currentGetInfo_.contigWidth.first;
+    return text[fullLinesCount * currentGetInfo_.contigWidth.second + posInLine];
+}
+
+void FastaReference::selectContigAt( const unsigned long globalPos )
+{
+    if ( globalPos < currentGetInfo_.position.first || globalPos >= (currentGetInfo_.position.first + currentGetInfo_.contigSize) )
+    {
+        const unsigned int i = findContig( globalPos );
+        if (i == contigTables_->infos.size())
+        {
+            EAGLE_ERROR( (boost::format("Could not determine in which contig global pos %lu belongs to") % globalPos).str() );
+        }
+        selectContig( i );
+    }
+}
+
 char FastaReference::get( const unsigned long globalPos, const unsigned long offset, bool &overlapContigBoundary )
 {
     inputMode();
-    if ( globalPos < currentGetInfo_.position.first || globalPos >= (currentGetInfo_.position.first + currentGetInfo_.contigSize) )
+    selectContigAt( globalPos );
+    assert( globalPos >= currentGetInfo_.position.first && globalPos < (currentGetInfo_.position.first + currentGetInfo_.contigSize) && "Global position needs to be situated within contig's range" );
+    return getFromCurrentContig( globalPos + offset, overlapContigBoundary );
+}
+
+
+bool FastaReference::copyBases( char *dest, const unsigned long globalPos, const unsigned long offset, const unsigned long length, const bool reverse )
+{
+    inputMode();
+    selectContigAt( globalPos );
+    unsigned long posInContig = globalPos + offset - currentGetInfo_.position.first;
+    if (posInContig + length > currentGetInfo_.contigSize)
+    {
+        return false;
+    }
+    if (currentPackedFile_)
+    {
+        for (unsigned long i = 0; i < length; ++i)
+        {
+            const char base = currentPackedFile_->get( currentPackedContig_, posInContig + i, currentPackedCursor_ );
+            if (reverse)
+            {
+                dest[length - 1 - i] = ~base;
+            }
+            else
+            {
+                dest[i] = base;
+            }
+        }
+        return true;
+    }
+
+    // One FASTA line at a time
+    const std::vector<char>& text = currentContigText();
+    const unsigned int basesPerLine = currentGetInfo_.contigWidth.first;
+    for (unsigned long copied = 0; copied < length; )
     {
-        boost::filesystem::path file = reader_.find(globalPos,currentGetInfo_);
-        if (reader_.open( file ) || reader_.cache().empty())
+        const unsigned long posInLine = posInContig % basesPerLine;
+        const unsigned long count = std::min( basesPerLine - posInLine, length - copied );
+        const char *src = &text[(posInContig / basesPerLine) * currentGetInfo_.contigWidth.second + posInLine];
+        if (reverse)
         {
-            if (! reader_.read(currentGetInfo_) )
+            char *revDest = dest + length - 1 - copied;
+            for (unsigned long i = 0; i < count; ++i)
             {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read block of data from %s (cache has %lu bases)")
-                                                                  % file % reader_.cache().size()).str()));
+                *revDest-- = ~src[i];
             }
         }
+        else
+        {
+            memcpy( dest + copied, src, count );
+        }
+        copied += count;
+        posInContig += count;
     }
-    assert( globalPos >= currentGetInfo_.position.first && globalPos < (currentGetInfo_.position.first + currentGetInfo_.contigSize) && "Global position needs to be situated within contig's range" );
-    overlapContigBoundary = !reader_.inCache( globalPos + offset );
-    return reader_[globalPos + offset];
+    return true;
 }
 
 
@@ -204,19 +396,17 @@ char FastaReference::get( const eagle::model::Locus location, const unsigned lon
     inputMode();
     if (location.chr() != currentGetInfo_.contigName)
     {
-        boost::filesystem::path file = reader_.find(location.chr(),currentGetInfo_);
-        if (reader_.open( file ) || reader_.cache().empty())
-        {
-            if (! reader_.read(currentGetInfo_) )
-            {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read block of data from %s (cache has %lu bases)")
-                                                                  % file % reader_.cache().size()).str()));
-            }
+        const unsigned int i = findContig( location.chr() );
+        if (i == contigTables_->infos.size())
+        {   // lists the available contigs
+            eagle::io::FastaInfo info;
+            reader_.find( location.chr(), info );
+            EAGLE_ERROR( (boost::format("Contig '%s' not found") % location.chr()).str() );
         }
+        selectContig( i );
     }
     assert( location.pos() + currentGetInfo_.position.first + offset >= currentGetInfo_.position.first && "Global position needs to be situated within contig's range" );
-    overlapContigBoundary = !reader_.inCache( location.pos() + offset );
-    return reader_[location.pos() + offset];
+    return getFromCurrentContig( location.pos() + offset, overlapContigBoundary );
 }
 
 
@@ -16,6 +16,8 @@ namespace genome
 {
 
 PreferredFastaReader* SharedFastaReference::fastaReference_ = 0;
+PreferredFastaReader* SharedFastaReference::initialFastaReference_ = 0;
+boost::thread_specific_ptr< PreferredFastaReader > SharedFastaReference::threadFastaReference_;
 
 std::vector< boost::filesystem::path >  SharedFastaReference::sampleGenomeDir_;
 std::vector< PreferredFastaReader* >    SharedFastaReference::fastaReferenceArray_;
@@ -16,6 +16,8 @@ namespace genome
 
 TmpFastaReader::TmpFastaReader( const boost::filesystem::path &refDir )
     : fastaRef_ ( refDir )
+    , currentContigNum_( 0 )
+    , convertedContigNum_( 0 )
 {
     unsigned long globalPos = 0;
     std::vector<std::string> contigNames = fastaRef_.allContigNames();
@@ -77,43 +79,42 @@ TmpFastaReader::TmpFastaReader( const boost::filesystem::path &refDir )
     }
 }
 
-char TmpFastaReader::get( const unsigned long globalPos, const unsigned long offset, bool& overlapContigBoundary )
+unsigned int TmpFastaReader::walkToContig( const unsigned long globalPos, unsigned int contigNum ) const
 {
-    static unsigned int lastContigNum = 0 ;
-    static TmpFastaFileInfo *fileInfo = &fileInfos_[lastContigNum];
-    static char *cachedFileData = 0;
-    while (globalPos < fileInfo->globalPosMin)
+    while (globalPos < fileInfos_[contigNum].globalPosMin)
     {
-        fileInfo = &fileInfos_[--lastContigNum];
-
-        if (cachedFileData)
-        {
-            free( cachedFileData );
-            cachedFileData = 0;
-        }
+        --contigNum;
     }
-    while (globalPos > fileInfo->globalPosMax)
+    while (globalPos > fileInfos_[contigNum].globalPosMax)
     {
-        fileInfo = &fileInfos_[++lastContigNum];
+        ++contigNum;
+        assert( contigNum < fileInfos_.size() && "Global position beyond the last contig" );
+    }
+    return contigNum;
+}
 
-        if (cachedFileData)
-        {
-            free( cachedFileData );
-            cachedFileData = 0;
-        }
+char TmpFastaReader::get( const unsigned long globalPos, const unsigned long offset, bool& overlapContigBoundary )
+{
+    const unsigned int contigNum = walkToContig( globalPos, currentContigNum_ );
+    if (contigNum != currentContigNum_)
+    {
+        currentContigNum_ = contigNum;
+        currentFileData_.clear();
     }
+    TmpFastaFileInfo *fileInfo = &fileInfos_[currentContigNum_];
     unsigned long posInContig = (globalPos-fileInfo->globalPosMin+offset)%fileInfo->baseCount;
     unsigned long fullLinesCount = posInContig / fileInfo->basesPerLine;
     unsigned long posInLine = posInContig % fileInfo->basesPerLine;
     unsigned long posInFile = fileInfo->headerLength + fullLinesCount * (fileInfo->basesPerLine+1) + posInLine;
 
 
-    if (!cachedFileData)
+    if (currentFileData_.empty())
     {
         clog << "TmpFastaReader: Reading file " << fileInfo->contigName << endl;
-        cachedFileData = (char*)malloc( fileInfo->fileSize );
+        currentFileData_.resize( fileInfo->fileSize );
+        fileInfo->file->clear();
         fileInfo->file->seekg(0);
-        fileInfo->file->read( cachedFileData, fileInfo->fileSize );
+        fileInfo->file->read( &currentFileData_[0], fileInfo->fileSize );
         clog << "TmpFastaReader: Done reading file" << endl;
     }
 
@@ -122,7 +123,7 @@ char TmpFastaReader::get( const unsigned long globalPos, const unsigned long off
       char result;
       fileInfo->file->read( &result, 1 );
     */
-    char result = cachedFileData[posInFile];
+    char result = currentFileData_[posInFile];
 
     // Debugging
     /*
@@ -136,20 +137,36 @@ char TmpFastaReader::get( const unsigned long globalPos, const unsigned long off
     return result;
 }
 
-
-void TmpFastaReader::convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& posInContig )
+bool TmpFastaReader::copyBases( char *dest, const unsigned long globalPos, const unsigned long offset, const unsigned long length, const bool reverse )
 {
-    static unsigned int lastContigNum = 0 ;
-    static TmpFastaFileInfo *fileInfo = &fileInfos_[lastContigNum];
-    while (globalPos < fileInfo->globalPosMin)
+    // Same contract as FastaReference::copyBases, although get() wraps around the contig
+    const TmpFastaFileInfo &fileInfo = fileInfos_[ walkToContig( globalPos, currentContigNum_ ) ];
+    if (globalPos - fileInfo.globalPosMin + offset + length > fileInfo.baseCount)
     {
-        fileInfo = &fileInfos_[--lastContigNum];
+        return false;
     }
-    while (globalPos > fileInfo->globalPosMax)
+    bool overlapContigBoundary = false;
+    for (unsigned long i = 0; i < length; ++i)
     {
-        fileInfo = &fileInfos_[++lastContigNum];
+        const char base = get( globalPos, offset + i, overlapContigBoundary );
+        if (reverse)
+        {
+            dest[length - 1 - i] = ~base;
+        }
+        else
+        {
+            dest[i] = base;
+        }
     }
-    refId = lastContigNum;
+    return true;
+}
+
+
+void TmpFastaReader::convertFromGlobalPos( const unsigned long globalPos, int& refId, unsigned long& posInContig )
+{
+    convertedContigNum_ = walkToContig( globalPos, convertedContigNum_ );
+    const TmpFastaFileInfo *fileInfo = &fileInfos_[convertedContigNum_];
+    refId = convertedContigNum_;
     posInContig = (globalPos - fileInfo->globalPosMin) % fileInfo->baseCount + 1;
 }
 
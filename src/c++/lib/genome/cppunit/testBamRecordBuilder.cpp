@@ -0,0 +1,195 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testBamRecordBuilder.hh"
+
+using eagle::genome::EagleBamRecordBuilder;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBamRecordBuilder, registryName("BamRecordBuilder"));
+
+
+namespace
+{
+
+// CIGAR operations, as encoded in BAM
+const unsigned int CIGAR_M = 0;
+const unsigned int CIGAR_I = 1;
+const unsigned int CIGAR_D = 2;
+const unsigned int CIGAR_S = 4;
+
+unsigned int cigarOp( const unsigned int length, const unsigned int op )
+{
+    return length << 4 | op;
+}
+
+// BCL byte: quality in the top 6 bits, base (A=0,C=1,G=2,T=3) in the bottom 2
+char bcl( const unsigned int quality, const unsigned int base )
+{
+    return static_cast<char>( quality << 2 | base );
+}
+
+// Record built field by field, following the BAM specification
+class ExpectedRecord
+{
+public:
+    void addInt( const int value ) { add( &value, sizeof(value) ); }
+    void addBytes( const string &bytes ) { add( bytes.c_str(), bytes.size() ); }
+    void addName( const string &name ) { add( name.c_str(), name.size() + 1 ); }
+    // Prepends block_size
+    vector<char> bytes() const
+    {
+        vector<char> record( sizeof(int) + bytes_.size() );
+        const int blockSize = bytes_.size();
+        memcpy( &record[0], &blockSize, sizeof(blockSize) );
+        std::copy( bytes_.begin(), bytes_.end(), record.begin() + sizeof(int) );
+        return record;
+    }
+private:
+    void add( const void *data, const unsigned int size )
+    {
+        const char *ptr = static_cast<const char *>( data );
+        bytes_.insert( bytes_.end(), ptr, ptr + size );
+    }
+    vector<char> bytes_;
+};
+
+unsigned int flagOf( const vector<char> &record )
+{
+    unsigned int flagNc;
+    memcpy( &flagNc, &record[16], sizeof(flagNc) );
+    return flagNc >> 16;
+}
+
+} // anonymous namespace
+
+
+void TestBamRecordBuilder::setUp()
+{
+    // c1: global positions [0,14), c2: [14,24)
+    dir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testBamRecordBuilder-%%%%-%%%%" );
+    boost::filesystem::create_directory( dir_ );
+    {
+        ofstream os( (dir_ / "genome.fa").string().c_str() );
+        os << ">c1\nACGTACGTAC\nGTAC\n>c2\nTTTTGGGG\nCC\n";
+    }
+    {
+        ofstream os( (dir_ / "genome.fa.fai").string().c_str() );
+        os << "c1\t14\t4\t10\t11\nc2\t10\t24\t8\t9\n";
+    }
+    fastaReference_.reset( new PreferredFastaReader( dir_ ) );
+}
+
+void TestBamRecordBuilder::tearDown()
+{
+    fastaReference_.reset();
+    boost::filesystem::remove_all( dir_ );
+}
+
+void TestBamRecordBuilder::testForwardRead()
+{
+    // Cycles 1-6, with a quality-0 no-call on cycles 3 and 6
+    const char cluster[] = { bcl(30,0), bcl(30,1), bcl(0,0), bcl(20,3), bcl(25,2), bcl(0,2), bcl(35,1) };
+    vector<unsigned int> cigar;
+    cigar.push_back( cigarOp( 1, CIGAR_S ) );
+    cigar.push_back( cigarOp( 2, CIGAR_M ) );
+    cigar.push_back( cigarOp( 1, CIGAR_I ) );
+    cigar.push_back( cigarOp( 2, CIGAR_M ) );
+    cigar.push_back( cigarOp( 1, CIGAR_D ) );
+
+    EagleBamRecordBuilder builder( *fastaReference_ );
+    vector<char> record;
+    builder.build( record, cluster, 1, 6, false, 16, 3, -13, 1234567, 0x63, 60, cigar, false );
+
+    ExpectedRecord expected;
+    expected.addInt( 1 );                                   // refID: c2
+    expected.addInt( 2 );                                   // pos: 0-based, in c2
+    expected.addInt( 4681 << 16 | 60 << 8 | 16 );           // bin, MAPQ, l_read_name
+    expected.addInt( 0x63 << 16 | 5 );                      // FLAG, n_cigar_op
+    expected.addInt( 6 );                                   // l_seq
+    expected.addInt( 0 );                                   // next refID: c1
+    expected.addInt( 3 );                                   // next pos
+    expected.addInt( -13 );                                 // tlen
+    expected.addName( "FC:0:0:12:34567" );
+    for (unsigned int i=0; i<cigar.size(); ++i)
+    {
+        expected.addInt( cigar[i] );
+    }
+    expected.addBytes( string( "\x12\xF8\x4F", 3 ) );       // A C N T G N
+    expected.addBytes( string( "\x1E\x1E\x00\x14\x19\x00", 6 ) );
+    CPPUNIT_ASSERT( expected.bytes() == record );
+}
+
+void TestBamRecordBuilder::testReverseRead()
+{
+    // Cycles 7-11, with a quality-0 no-call on cycle 10, and a 0xFF byte on cycle 8, which only marks a no-call in reverse reads
+    const char cluster[] = { bcl(30,0), bcl(30,1), bcl(30,2), bcl(30,3), bcl(30,0), bcl(30,1),
+                             bcl(31,0), static_cast<char>(0xFF), bcl(12,1), bcl(0,2), bcl(40,3) };
+    vector<unsigned int> cigar;
+    cigar.push_back( cigarOp( 2, CIGAR_M ) );
+    cigar.push_back( cigarOp( 1, CIGAR_D ) );
+    cigar.push_back( cigarOp( 1, CIGAR_I ) );
+    cigar.push_back( cigarOp( 2, CIGAR_S ) );
+
+    EagleBamRecordBuilder builder( *fastaReference_ );
+    vector<char> record( 1000, 'x' ); // leftovers of a previous, longer record
+    builder.build( record, cluster, 7, 5, true, 3, 16, 13, 42, 0x93, 60, cigar, true );
+
+    ExpectedRecord expected;
+    expected.addInt( 0 );                                   // refID: c1
+    expected.addInt( 3 );                                   // pos
+    expected.addInt( 4681 << 16 | 60 << 8 | 12 );           // bin, MAPQ, l_read_name
+    expected.addInt( 0x93 << 16 | 4 );                      // FLAG, n_cigar_op
+    expected.addInt( 5 );                                   // l_seq
+    expected.addInt( 1 );                                   // next refID: c2
+    expected.addInt( 2 );                                   // next pos
+    expected.addInt( 13 );                                  // tlen
+    expected.addName( "FC:0:0:0:42" );
+    for (unsigned int i=cigar.size(); i>0; --i)
+    {
+        expected.addInt( cigar[i-1] );
+    }
+    // Reverse-complement of cycles 7-11: the complement of cycle 11 (T) comes first
+    expected.addBytes( string( "\x1F\x4F\x80", 3 ) );       // A N G N T
+    expected.addBytes( string( "\x28\x00\x0C\x3F\x1F", 5 ) );
+    CPPUNIT_ASSERT( expected.bytes() == record );
+}
+
+void TestBamRecordBuilder::testQcFail()
+{
+    // Reads with 64 no-calls or more don't pass filter
+    vector<char> cluster( 70, bcl(0,0) );
+    for (unsigned int i=0; i<6; ++i)
+    {
+        cluster[i] = bcl(30,1);
+    }
+    const vector<unsigned int> cigar( 1, cigarOp( 70, CIGAR_M ) );
+    EagleBamRecordBuilder builder( *fastaReference_ );
+    vector<char> record;
+
+    builder.build( record, &cluster[0], 1, 70, false, 0, 0, 0, 1, 0x63, 60, cigar, false );
+    CPPUNIT_ASSERT_EQUAL( 0x263u, flagOf( record ) );
+
+    cluster[6] = bcl(30,1);
+    builder.build( record, &cluster[0], 1, 70, false, 0, 0, 0, 1, 0x63, 60, cigar, false );
+    CPPUNIT_ASSERT_EQUAL( 0x63u, flagOf( record ) );
+
+    // Same count for a reverse read, where 0xFF bytes are no-calls too
+    cluster[6] = static_cast<char>(0xFF);
+    builder.build( record, &cluster[0], 1, 70, true, 0, 0, 0, 1, 0x93, 60, cigar, false );
+    CPPUNIT_ASSERT_EQUAL( 0x293u, flagOf( record ) );
+}
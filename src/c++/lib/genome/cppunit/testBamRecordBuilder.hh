@@ -0,0 +1,36 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_BAM_RECORD_BUILDER_HH
+#define EAGLE_GENOME_TEST_BAM_RECORD_BUILDER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "genome/BamRecordBuilder.hh"
+
+
+class TestBamRecordBuilder : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBamRecordBuilder );
+    CPPUNIT_TEST( testForwardRead );
+    CPPUNIT_TEST( testReverseRead );
+    CPPUNIT_TEST( testQcFail );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path dir_;
+    boost::scoped_ptr< PreferredFastaReader > fastaReference_;
+public:
+    void setUp();
+    void tearDown();
+    void testForwardRead();
+    void testReverseRead();
+    void testQcFail();
+};
+
+#endif //EAGLE_GENOME_TEST_BAM_RECORD_BUILDER_HH
@@ -0,0 +1,155 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testBamReorderWindow.hh"
+
+using eagle::genome::BamReorderWindow;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBamReorderWindow, registryName("BamReorderWindow"));
+
+
+namespace
+{
+
+const unsigned int RECORD_COUNT = 3000;
+
+// Smallest BAM-like record: block_size, followed by the record number
+void makeRecord( const unsigned long recordNum, vector<char> &record )
+{
+    const int blockSize = sizeof(recordNum);
+    record.resize( sizeof(blockSize) + blockSize );
+    memcpy( &record[0], &blockSize, sizeof(blockSize) );
+    memcpy( &record[sizeof(blockSize)], &recordNum, sizeof(recordNum) );
+}
+
+// Reverse read of fragment i, added once its forward read at i*4 got written, like BamOrMetadataOutput does.
+// Many of them share their position with others
+unsigned long reversePos( const unsigned long i )
+{
+    return i*4 + (i*7919) % 300;
+}
+
+// Returns the record numbers in output order, and the highest number of spilled runs open at once
+vector<unsigned long> runWindow( BamReorderWindow &window, unsigned int &maxSpilledRunCount )
+{
+    ostringstream os;
+    vector<char> record;
+    maxSpilledRunCount = 0;
+    for (unsigned long i=0; i<RECORD_COUNT; ++i)
+    {
+        window.flushUntilPos( i*4, os );
+        makeRecord( i, record );
+        window.add( reversePos( i ), record );
+        maxSpilledRunCount = std::max( maxSpilledRunCount, window.spilledRunCount() );
+    }
+    window.flushUntilPos( std::numeric_limits<unsigned long>::max(), os );
+    CPPUNIT_ASSERT( window.empty() );
+
+    const string bytes = os.str();
+    const unsigned int recordSize = sizeof(int) + sizeof(unsigned long);
+    CPPUNIT_ASSERT_EQUAL( (size_t)RECORD_COUNT * recordSize, bytes.size() );
+    vector<unsigned long> recordNums( RECORD_COUNT );
+    for (unsigned int i=0; i<RECORD_COUNT; ++i)
+    {
+        memcpy( &recordNums[i], bytes.data() + i*recordSize + sizeof(int), sizeof(unsigned long) );
+    }
+    return recordNums;
+}
+
+bool lessByPosThenInsertion( const unsigned long lhs, const unsigned long rhs )
+{
+    return reversePos( lhs ) < reversePos( rhs ) || (reversePos( lhs ) == reversePos( rhs ) && lhs < rhs);
+}
+
+unsigned int countSpillFiles( const boost::filesystem::path &dir )
+{
+    unsigned int count = 0;
+    for (boost::filesystem::directory_iterator it( dir ); it != boost::filesystem::directory_iterator(); ++it)
+    {
+        if (it->path().filename().string().find( ".reorder" ) != string::npos)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // anonymous namespace
+
+
+void TestBamReorderWindow::setUp()
+{
+    dir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir_ );
+}
+
+void TestBamReorderWindow::tearDown()
+{
+    boost::filesystem::remove_all( dir_ );
+}
+
+void TestBamReorderWindow::testUnlimited()
+{
+    BamReorderWindow window( dir_ / "test.bam" );
+    unsigned int maxSpilledRunCount = 0;
+    const vector<unsigned long> recordNums = runWindow( window, maxSpilledRunCount );
+    CPPUNIT_ASSERT_EQUAL( 0u, maxSpilledRunCount );
+
+    // Records at the same position keep their insertion order
+    vector<unsigned long> expected( RECORD_COUNT );
+    for (unsigned int i=0; i<RECORD_COUNT; ++i)
+    {
+        expected[i] = i;
+    }
+    sort( expected.begin(), expected.end(), lessByPosThenInsertion );
+    CPPUNIT_ASSERT( expected == recordNums );
+}
+
+void TestBamReorderWindow::testSpilledRuns()
+{
+    BamReorderWindow unlimitedWindow( dir_ / "unlimited.bam" );
+    unsigned int maxSpilledRunCount = 0;
+    const vector<unsigned long> expected = runWindow( unlimitedWindow, maxSpilledRunCount );
+
+    // About 8 records in memory, and merges as soon as 4 runs are open
+    BamReorderWindow window( dir_ / "test.bam", 100, 4 );
+    const vector<unsigned long> recordNums = runWindow( window, maxSpilledRunCount );
+    CPPUNIT_ASSERT( expected == recordNums );
+    CPPUNIT_ASSERT( maxSpilledRunCount > 1 );
+    CPPUNIT_ASSERT( maxSpilledRunCount < 4 );
+    CPPUNIT_ASSERT_EQUAL( 0u, countSpillFiles( dir_ ) );
+}
+
+void TestBamReorderWindow::testSpilledRunsRemoved()
+{
+    {
+        BamReorderWindow window( dir_ / "test.bam", 100, 4 );
+        vector<char> record;
+        for (unsigned long i=0; i<100; ++i)
+        {
+            makeRecord( i, record );
+            window.add( 1000 - i, record );
+        }
+        CPPUNIT_ASSERT( window.spilledRunCount() > 0 );
+        CPPUNIT_ASSERT_EQUAL( window.spilledRunCount(), countSpillFiles( dir_ ) );
+    }
+    // Not flushed: the temporary files go away with the window
+    CPPUNIT_ASSERT_EQUAL( 0u, countSpillFiles( dir_ ) );
+}
@@ -0,0 +1,34 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_BAM_REORDER_WINDOW_HH
+#define EAGLE_GENOME_TEST_BAM_REORDER_WINDOW_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+
+#include "genome/BamReorderWindow.hh"
+
+
+class TestBamReorderWindow : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBamReorderWindow );
+    CPPUNIT_TEST( testUnlimited );
+    CPPUNIT_TEST( testSpilledRuns );
+    CPPUNIT_TEST( testSpilledRunsRemoved );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path dir_;
+public:
+    void setUp();
+    void tearDown();
+    void testUnlimited();
+    void testSpilledRuns();
+    void testSpilledRunsRemoved();
+};
+
+#endif //EAGLE_GENOME_TEST_BAM_REORDER_WINDOW_HH
@@ -0,0 +1,91 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testContigStore.hh"
+
+using eagle::genome::ContigStore;
+using eagle::io::FastaInfo;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestContigStore, registryName("ContigStore"));
+
+
+namespace
+{
+
+// Contigs of the FASTA file written by setUp(): name, size, global pos, position in file, line width
+const FastaInfo contig1( "c1", 14, 0, 4, 10 );
+const FastaInfo contig2( "c2", 10, 14, 24, 8 );
+
+} // anonymous namespace
+
+
+void TestContigStore::setUp()
+{
+    filename_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testContigStore-%%%%-%%%%.fa" );
+    ofstream os( filename_.string().c_str() );
+    os << ">c1\nACGTACGTAC\nGTAC\n>c2\nTTTTGGGG\nCC\n";
+    ContigStore::setMaxBytes( 0 );
+}
+
+void TestContigStore::tearDown()
+{
+    ContigStore::clear();
+    boost::filesystem::remove( filename_ );
+}
+
+void TestContigStore::testSharedContigs()
+{
+    const unsigned long bytesBefore = ContigStore::bytes();
+    ContigStore::ContigText text1 = ContigStore::get( filename_, contig1 );
+    CPPUNIT_ASSERT_EQUAL( string("ACGTACGTAC\nGTAC"), string( text1->begin(), text1->end() ) );
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 15, ContigStore::bytes() );
+
+    // Same contig for another reader: same copy
+    ContigStore::ContigText otherReaderText1 = ContigStore::get( filename_, contig1 );
+    CPPUNIT_ASSERT( text1 == otherReaderText1 );
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 15, ContigStore::bytes() );
+
+    ContigStore::ContigText text2 = ContigStore::get( filename_, contig2 );
+    CPPUNIT_ASSERT_EQUAL( string("TTTTGGGG\nCC"), string( text2->begin(), text2->end() ) );
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 15 + 11, ContigStore::bytes() );
+}
+
+void TestContigStore::testEviction()
+{
+    const unsigned long bytesBefore = ContigStore::bytes();
+    ContigStore::setMaxBytes( bytesBefore + 20 );
+    ContigStore::ContigText text1 = ContigStore::get( filename_, contig1 );
+    ContigStore::ContigText text2 = ContigStore::get( filename_, contig2 );
+
+    // Active contigs stay in the store, even over budget
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 15 + 11, ContigStore::bytes() );
+
+    // Inactive ones get evicted, least recently used first
+    text1.reset();
+    text2.reset();
+    ContigStore::setMaxBytes( bytesBefore + 20 );
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 11, ContigStore::bytes() );
+
+    // Loading a contig evicts the inactive ones, not the active ones
+    text2 = ContigStore::get( filename_, contig2 );
+    text1 = ContigStore::get( filename_, contig1 );
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 15 + 11, ContigStore::bytes() );
+    text2.reset();
+    ContigStore::setMaxBytes( bytesBefore + 20 );
+    CPPUNIT_ASSERT_EQUAL( bytesBefore + 15, ContigStore::bytes() );
+    CPPUNIT_ASSERT_EQUAL( string("ACGTACGTAC\nGTAC"), string( text1->begin(), text1->end() ) );
+}
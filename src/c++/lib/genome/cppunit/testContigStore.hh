@@ -0,0 +1,32 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_CONTIG_STORE_HH
+#define EAGLE_GENOME_TEST_CONTIG_STORE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+
+#include "genome/ContigStore.hh"
+
+
+class TestContigStore : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestContigStore );
+    CPPUNIT_TEST( testSharedContigs );
+    CPPUNIT_TEST( testEviction );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path filename_;
+public:
+    void setUp();
+    void tearDown();
+    void testSharedContigs();
+    void testEviction();
+};
+
+#endif //EAGLE_GENOME_TEST_CONTIG_STORE_HH
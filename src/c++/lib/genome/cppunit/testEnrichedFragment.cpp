@@ -35,3 +35,20 @@ void TestEnrichedFragment::tearDown()
 void TestEnrichedFragment::testEnrichedFragment()
 {
 }
+
+void TestEnrichedFragment::testHardcodedCopyBases()
+{
+    const eagle::genome::FragmentComponentHardcoded component( "SeqPrimer1" );
+    const eagle::model::Fragment fragment;
+    for (unsigned int isForward = 0; isForward < 2; ++isForward)
+    {
+        char bases[6];
+        CPPUNIT_ASSERT( component.copyBases( bases, 4, 6, fragment, isForward ) );
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            CPPUNIT_ASSERT_EQUAL( component.getBase( 4 + i, fragment, isForward ), bases[i] );
+        }
+    }
+    char bases[7];
+    CPPUNIT_ASSERT( !component.copyBases( bases, 4, 7, fragment, true ) );
+}
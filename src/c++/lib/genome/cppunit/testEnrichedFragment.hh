@@ -17,12 +17,14 @@ class TestEnrichedFragment : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE( TestEnrichedFragment );
     CPPUNIT_TEST( testEnrichedFragment );
+    CPPUNIT_TEST( testHardcodedCopyBases );
     CPPUNIT_TEST_SUITE_END();
 private:
 public:
     void setUp();
     void tearDown();
     void testEnrichedFragment();
+    void testHardcodedCopyBases();
 };
 
 #endif //EAGLE_GENOME_TEST_FRAGMENT_HH
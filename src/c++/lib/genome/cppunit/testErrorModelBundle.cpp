@@ -0,0 +1,84 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/assign.hpp>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "common/Exceptions.hh"
+#include "testErrorModelBundle.hh"
+
+using eagle::genome::ErrorModelBundleReader;
+using eagle::genome::ErrorModelBundleWriter;
+using eagle::model::AliasTables;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestErrorModelBundle, registryName("ErrorModelBundle"));
+
+
+void TestErrorModelBundle::setUp()
+{
+    filename_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testErrorModelBundle-%%%%-%%%%.bin" );
+
+    const vector< double > weights1 = boost::assign::list_of(0.0)(1.0)(3.0);
+    const vector< double > weights2 = boost::assign::list_of(2.0)(0.0)(1.0)(1.0)(4.0);
+    const vector< vector< double > > weightsPerTable = boost::assign::list_of(weights1)(weights2);
+    const vector< unsigned int > counts = boost::assign::list_of(3)(0)(7);
+
+    ErrorModelBundleWriter writer( filename_ );
+    writer.add( eagle::genome::QUALITY_PROFILE_COUNTS, counts );
+    writer.add( eagle::genome::QUALITY_DISTRIBUTIONS, AliasTables( weightsPerTable ) );
+    writer.add( eagle::genome::QQ_ERROR_RATES, vector< double >() );
+    writer.close();
+}
+
+void TestErrorModelBundle::tearDown()
+{
+    boost::filesystem::remove( filename_ );
+}
+
+void TestErrorModelBundle::testRoundTrip()
+{
+    const ErrorModelBundleReader reader( filename_ );
+    const vector< unsigned int > expectedCounts = boost::assign::list_of(3)(0)(7);
+    CPPUNIT_ASSERT( expectedCounts == reader.getVector<unsigned int>( eagle::genome::QUALITY_PROFILE_COUNTS ) );
+    CPPUNIT_ASSERT( reader.getVector<double>( eagle::genome::QQ_ERROR_RATES ).empty() );
+
+    // The mapped tables draw the same outcomes as the ones they were compiled from
+    const vector< double > weights1 = boost::assign::list_of(0.0)(1.0)(3.0);
+    const vector< double > weights2 = boost::assign::list_of(2.0)(0.0)(1.0)(1.0)(4.0);
+    const AliasTables expected( boost::assign::list_of(weights1)(weights2) );
+    AliasTables tables;
+    reader.get( eagle::genome::QUALITY_DISTRIBUTIONS, tables );
+    CPPUNIT_ASSERT_EQUAL( 2u, tables.size() );
+    CPPUNIT_ASSERT_EQUAL( 3u, tables.outcomeCount( 0 ) );
+    CPPUNIT_ASSERT_EQUAL( 5u, tables.outcomeCount( 1 ) );
+    for (uint32_t random = 0; random < 0xFFF00000u; random += 0x00100000u)
+    {
+        CPPUNIT_ASSERT_EQUAL( expected.get( 0, random ), tables.get( 0, random ) );
+        CPPUNIT_ASSERT_EQUAL( expected.get( 1, random ), tables.get( 1, random ) );
+    }
+
+    // Missing section
+    CPPUNIT_ASSERT_THROW( reader.getVector<double>( eagle::genome::MOTIF_WEIGHTS ), eagle::common::CorruptedFileException );
+}
+
+void TestErrorModelBundle::testCorruptedFile()
+{
+    {
+        fstream fs( filename_.string().c_str(), ios::in | ios::out | ios::binary );
+        fs.seekp( -1, ios::end );
+        fs.put( 0x55 );
+    }
+    CPPUNIT_ASSERT_THROW( ErrorModelBundleReader reader( filename_ ), eagle::common::CorruptedFileException );
+}
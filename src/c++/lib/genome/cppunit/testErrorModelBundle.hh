@@ -0,0 +1,32 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_ERROR_MODEL_BUNDLE_HH
+#define EAGLE_GENOME_TEST_ERROR_MODEL_BUNDLE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+
+#include "genome/ErrorModelBundle.hh"
+
+
+class TestErrorModelBundle : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestErrorModelBundle );
+    CPPUNIT_TEST( testRoundTrip );
+    CPPUNIT_TEST( testCorruptedFile );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path filename_;
+public:
+    void setUp();
+    void tearDown();
+    void testRoundTrip();
+    void testCorruptedFile();
+};
+
+#endif //EAGLE_GENOME_TEST_ERROR_MODEL_BUNDLE_HH
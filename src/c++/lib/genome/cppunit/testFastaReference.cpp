@@ -0,0 +1,242 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testFastaReference.hh"
+
+using eagle::genome::MultiFastaReference;
+using eagle::genome::TmpFastaReader;
+using eagle::model::Locus;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFastaReference, registryName("FastaReference"));
+
+
+namespace
+{
+
+// Contigs of the FASTA files written by the tests: name, bases, FASTA line width
+const unsigned int CONTIG_COUNT = 3;
+const char *contigNames[] = { "c1", "c2", "c3" };
+const char *contigBases[] = { "ACGTACGTACGTAC", "TTnnGGGGCN", "AACCG" };
+const unsigned int contigWidths[] = { 10, 8, 5 };
+const unsigned long contigStarts[] = { 0, 14, 24 };
+
+void writeContig( ostream &fasta, ostream &fai, const unsigned int i, const unsigned long fileOffset )
+{
+    const string bases( contigBases[i] );
+    fasta << '>' << contigNames[i] << '\n';
+    for (unsigned long pos=0; pos<bases.size(); pos+=contigWidths[i])
+    {
+        fasta << bases.substr( pos, contigWidths[i] ) << '\n';
+    }
+    fai << contigNames[i] << '\t' << bases.size() << '\t' << fileOffset + strlen( contigNames[i] ) + 2 << '\t' << contigWidths[i] << '\t' << contigWidths[i] + 1 << '\n';
+}
+
+// Same contigs as genome.fa, one file per contig, in the order given by genome_size.xml
+void writeContigFiles( const boost::filesystem::path &dir )
+{
+    boost::filesystem::create_directory( dir );
+    ofstream xml( (dir / "genome_size.xml").string().c_str() );
+    xml << "<sequenceSizes>\n";
+    for (unsigned int i=0; i<CONTIG_COUNT; ++i)
+    {
+        const string filename = string( contigNames[i] ) + ".fa";
+        ofstream fasta( (dir / filename).string().c_str() );
+        ofstream fai( (dir / (filename + ".fai")).string().c_str() );
+        writeContig( fasta, fai, i, 0 );
+        xml << "<chromosome fileName=\"" << filename << "\" contigName=\"" << contigNames[i] << "\" totalBases=\"" << strlen( contigBases[i] ) << "\"/>\n";
+    }
+    xml << "</sequenceSizes>\n";
+}
+
+// Checks copyBases() against get() for every span of every contig, then at the contig ends
+template <typename Reader>
+void checkCopyBases( Reader &reader, Reader &baseReader )
+{
+    for (unsigned int contig=0; contig<CONTIG_COUNT; ++contig)
+    {
+        const unsigned long contigSize = strlen( contigBases[contig] );
+        for (unsigned long start=0; start<contigSize; ++start)
+        {
+            for (unsigned long length=1; start+length<=contigSize; ++length)
+            {
+                // globalPos anywhere before the span, as the fragments give it
+                const unsigned long globalPos = contigStarts[contig] + start/2;
+                const unsigned long offset = start - start/2;
+                string expected, expectedReverse;
+                for (unsigned long i=0; i<length; ++i)
+                {
+                    bool overlapContigBoundary;
+                    const char base = baseReader.get( globalPos, offset + i, overlapContigBoundary );
+                    expected += base;
+                    expectedReverse.insert( expectedReverse.begin(), ~base );
+                }
+                vector<char> bases( length );
+                CPPUNIT_ASSERT( reader.copyBases( &bases[0], globalPos, offset, length, false ) );
+                CPPUNIT_ASSERT_EQUAL( expected, string( bases.begin(), bases.end() ) );
+                CPPUNIT_ASSERT( reader.copyBases( &bases[0], globalPos, offset, length, true ) );
+                CPPUNIT_ASSERT_EQUAL( expectedReverse, string( bases.begin(), bases.end() ) );
+            }
+        }
+
+        // One base too many, or a span starting in the next contig: nothing gets copied
+        char bases[] = "xx";
+        CPPUNIT_ASSERT( !reader.copyBases( bases, contigStarts[contig], contigSize - 1, 2, false ) );
+        CPPUNIT_ASSERT( !reader.copyBases( bases, contigStarts[contig], contigSize - 1, 2, true ) );
+        CPPUNIT_ASSERT( !reader.copyBases( bases, contigStarts[contig] + 1, contigSize, 1, false ) );
+        CPPUNIT_ASSERT_EQUAL( string("xx"), string( bases ) );
+    }
+}
+
+} // anonymous namespace
+
+
+void TestFastaReference::setUp()
+{
+    // c1: global positions [0,14), c2: [14,24), c3: [24,29)
+    dir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testFastaReference-%%%%-%%%%" );
+    boost::filesystem::create_directory( dir_ );
+    {
+        ostringstream fasta;
+        ofstream fai( (dir_ / "genome.fa.fai").string().c_str() );
+        for (unsigned int i=0; i<CONTIG_COUNT; ++i)
+        {
+            writeContig( fasta, fai, i, fasta.str().size() );
+        }
+        ofstream os( (dir_ / "genome.fa").string().c_str() );
+        os << fasta.str();
+    }
+}
+
+void TestFastaReference::tearDown()
+{
+    boost::filesystem::remove_all( dir_ );
+}
+
+void TestFastaReference::testContigTables()
+{
+    MultiFastaReference reference( dir_ );
+    const boost::shared_ptr< const MultiFastaReference::ContigTables > tables = reference.contigTables();
+    CPPUNIT_ASSERT_EQUAL( 3ul, tables->infos.size() );
+    const char *names[] = { "c1", "c2", "c3" };
+    const unsigned long ends[] = { 14, 24, 29 };
+    for (unsigned int i=0; i<3; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL( string(names[i]), tables->infos[i].contigName );
+        CPPUNIT_ASSERT_EQUAL( ends[i], tables->ends[i] );
+        CPPUNIT_ASSERT_EQUAL( static_cast<int>(i), tables->ids[i] );
+        CPPUNIT_ASSERT_EQUAL( i, tables->indexByName.at( names[i] ) );
+    }
+    CPPUNIT_ASSERT_EQUAL( 10ul, reference.getContigLength( "c2" ) );
+
+    // Readers built on the same tables share them
+    MultiFastaReference otherReference( tables );
+    CPPUNIT_ASSERT( tables == otherReference.contigTables() );
+}
+
+void TestFastaReference::testGlobalToLocal()
+{
+    MultiFastaReference reference( dir_ );
+
+    // First and last base of each contig, going backwards too
+    const unsigned long globalPositions[] = { 0, 13, 14, 23, 24, 28, 13, 0 };
+    const char *expectedContigs[] = { "c1", "c1", "c2", "c2", "c3", "c3", "c1", "c1" };
+    const unsigned long expectedPositions[] = { 1, 14, 1, 10, 1, 5, 14, 1 };
+    const int expectedRefIds[] = { 0, 0, 1, 1, 2, 2, 0, 0 };
+    for (unsigned int i=0; i<8; ++i)
+    {
+        const Locus locus = reference.global2local( globalPositions[i] );
+        CPPUNIT_ASSERT_EQUAL( string(expectedContigs[i]), locus.chr() );
+        CPPUNIT_ASSERT_EQUAL( expectedPositions[i], locus.pos() );
+
+        int refId;
+        unsigned long posInContig;
+        reference.convertFromGlobalPos( globalPositions[i], refId, posInContig );
+        CPPUNIT_ASSERT_EQUAL( expectedRefIds[i], refId );
+        CPPUNIT_ASSERT_EQUAL( expectedPositions[i], posInContig );
+    }
+
+    // Past the end of the last contig
+    CPPUNIT_ASSERT_THROW( reference.global2local( 29 ), eagle::common::EagleException );
+    CPPUNIT_ASSERT_THROW( reference.global2local( 1000 ), eagle::common::EagleException );
+}
+
+void TestFastaReference::testLocalToGlobal()
+{
+    MultiFastaReference reference( dir_ );
+    CPPUNIT_ASSERT_EQUAL( 0ul, reference.local2global( Locus( "c1", 1 ) ) );
+    CPPUNIT_ASSERT_EQUAL( 13ul, reference.local2global( Locus( "c1", 14 ) ) );
+    CPPUNIT_ASSERT_EQUAL( 14ul, reference.local2global( Locus( "c2", 1 ) ) );
+    CPPUNIT_ASSERT_EQUAL( 28ul, reference.local2global( Locus( "c3", 5 ) ) );
+    CPPUNIT_ASSERT_EQUAL( 23ul, reference.local2global( Locus( "c2", 10 ) ) );
+
+    // Unknown contig name
+    CPPUNIT_ASSERT_THROW( reference.local2global( Locus( "c4", 1 ) ), eagle::common::EagleException );
+    bool overlapContigBoundary;
+    CPPUNIT_ASSERT_THROW( reference.get( Locus( "c4", 1 ), 0, overlapContigBoundary ), eagle::common::EagleException );
+
+    // The lookups by name still work after a failed one
+    CPPUNIT_ASSERT_EQUAL( 24ul, reference.local2global( Locus( "c3", 1 ) ) );
+}
+
+void TestFastaReference::testCopyBases()
+{
+    MultiFastaReference reference( dir_ ), baseReference( dir_ );
+    CPPUNIT_ASSERT( reference.contigTables()->packedFiles.empty() );
+    checkCopyBases( reference, baseReference );
+
+    bool overlapContigBoundary;
+    CPPUNIT_ASSERT_EQUAL( 'n', baseReference.get( 14, 3, overlapContigBoundary ) );
+}
+
+void TestFastaReference::testCopyPackedBases()
+{
+    // Bases read from the FASTA text before the packed copy exists
+    MultiFastaReference baseReference( dir_ );
+    {
+        eagle::io::PackedFastaWriter writer( eagle::io::PackedFastaWriter::packedFilename( dir_ / "genome.fa" ) );
+        for (unsigned int i=0; i<CONTIG_COUNT; ++i)
+        {
+            writer.beginContig( contigNames[i] );
+            writer.add( contigBases[i], strlen( contigBases[i] ) );
+            writer.endContig();
+        }
+        writer.close();
+    }
+    MultiFastaReference reference( dir_ );
+    CPPUNIT_ASSERT_EQUAL( 1ul, reference.contigTables()->packedFiles.size() );
+    checkCopyBases( reference, baseReference );
+}
+
+void TestFastaReference::testTmpFastaReaderCopyBases()
+{
+    writeContigFiles( dir_ / "contigs" );
+    {
+        TmpFastaReader reader( dir_ / "contigs" ), baseReader( dir_ / "contigs" );
+        checkCopyBases( reader, baseReader );
+    }
+
+    // A new reader starts from its own first contig
+    TmpFastaReader reader( dir_ / "contigs" );
+    MultiFastaReference reference( dir_ );
+    for (unsigned long globalPos=0; globalPos<29; ++globalPos)
+    {
+        bool overlapContigBoundary;
+        CPPUNIT_ASSERT_EQUAL( reference.get( globalPos, 0, overlapContigBoundary ), reader.get( globalPos, 0, overlapContigBoundary ) );
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_FASTA_REFERENCE_HH
+#define EAGLE_GENOME_TEST_FASTA_REFERENCE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+
+#include "genome/Reference.hh"
+#include "genome/TmpFastaReader.hh"
+
+
+class TestFastaReference : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFastaReference );
+    CPPUNIT_TEST( testContigTables );
+    CPPUNIT_TEST( testGlobalToLocal );
+    CPPUNIT_TEST( testLocalToGlobal );
+    CPPUNIT_TEST( testCopyBases );
+    CPPUNIT_TEST( testCopyPackedBases );
+    CPPUNIT_TEST( testTmpFastaReaderCopyBases );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path dir_;
+public:
+    void setUp();
+    void tearDown();
+    void testContigTables();
+    void testGlobalToLocal();
+    void testLocalToGlobal();
+    void testCopyBases();
+    void testCopyPackedBases();
+    void testTmpFastaReaderCopyBases();
+};
+
+#endif //EAGLE_GENOME_TEST_FASTA_REFERENCE_HH
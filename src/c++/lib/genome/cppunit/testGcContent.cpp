@@ -0,0 +1,75 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testGcContent.hh"
+
+using eagle::genome::GcContentIndex;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestGcContent, registryName("GcContent"));
+
+
+void TestGcContent::setUp()
+{
+}
+
+void TestGcContent::tearDown()
+{
+}
+
+void TestGcContent::testGcContentIndex()
+{
+    // Long enough to span several 64-base blocks, with lower case bases and Ns
+    string sequence;
+    for (unsigned int i=0; i<500; ++i)
+    {
+        sequence += "ACGTgcatNnAAGC"[(i * 7) % 14];
+    }
+    GcContentIndex index;
+    for (unsigned int i=0; i<sequence.size(); ++i)
+    {
+        index.push_back( sequence[i] );
+    }
+    CPPUNIT_ASSERT_EQUAL( (unsigned long)sequence.size(), index.size() );
+
+    const unsigned long windows[][2] = { {0,0}, {0,1}, {0,64}, {3,64}, {63,65}, {64,128}, {10,437}, {130,500}, {0,500}, {500,500} };
+    for (unsigned int w=0; w<sizeof(windows)/sizeof(windows[0]); ++w)
+    {
+        unsigned int expectedGc = 0, expectedOther = 0;
+        for (unsigned long i=windows[w][0]; i<windows[w][1]; ++i)
+        {
+            switch (toupper( sequence[i] ))
+            {
+            case 'C':
+            case 'G':
+                ++expectedGc;
+                break;
+            case 'A':
+            case 'T':
+                break;
+            default:
+                ++expectedOther;
+            }
+        }
+
+        unsigned int gcCount, otherCount;
+        index.count( windows[w][0], windows[w][1], gcCount, otherCount );
+        CPPUNIT_ASSERT_EQUAL( expectedGc, gcCount );
+        CPPUNIT_ASSERT_EQUAL( expectedOther, otherCount );
+    }
+
+    index.clear();
+    CPPUNIT_ASSERT_EQUAL( 0ul, index.size() );
+}
@@ -0,0 +1,28 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_GC_CONTENT_HH
+#define EAGLE_GENOME_TEST_GC_CONTENT_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "genome/GcContent.hh"
+
+
+class TestGcContent : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestGcContent );
+    CPPUNIT_TEST( testGcContentIndex );
+    CPPUNIT_TEST_SUITE_END();
+private:
+public:
+    void setUp();
+    void tearDown();
+    void testGcContentIndex();
+};
+
+#endif //EAGLE_GENOME_TEST_GC_CONTENT_HH
@@ -0,0 +1,161 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "common/Exceptions.hh"
+#include "genome/ErrorModelBundle.hh"
+#include "testMotifQualityDropModel.hh"
+
+using eagle::genome::ClusterErrorModelContext;
+using eagle::genome::ErrorModelBundleReader;
+using eagle::genome::ErrorModelBundleWriter;
+using eagle::genome::MotifQualityDropModel;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestMotifQualityDropModel, registryName("MotifQualityDropModel"));
+
+
+namespace
+{
+
+// Quality drop of each base of a read, as left by the model for the phasing model
+vector<int> getQualityDrops( MotifQualityDropModel &model, const string &read )
+{
+    ClusterErrorModelContext context;
+    eagle::model::FragmentRandomGenerator randomGen( 1, 2 );
+    vector<int> drops;
+    for (unsigned int i=0; i<read.size(); ++i)
+    {
+        const char bclBase = (30 << 2) | string("ACGT").find( read[i] );
+        unsigned int quality = 30;
+        model.applyQualityDrop( quality, bclBase, context, i+1, randomGen );
+        drops.push_back( context.phasingContext.qualityDrop );
+    }
+    return drops;
+}
+
+// No drop up to base firstDroppedBase (0-based), then the given drop until the end of the read
+vector<int> expectedDrops( const unsigned int readLength, const unsigned int firstDroppedBase, const int drop )
+{
+    vector<int> drops( readLength, 0 );
+    std::fill( drops.begin() + firstDroppedBase, drops.end(), drop );
+    return drops;
+}
+
+string repeat( const string &motif, const unsigned int count )
+{
+    string result;
+    for (unsigned int i=0; i<count; ++i)
+    {
+        result += motif;
+    }
+    return result;
+}
+
+// Each repeat gets checked once the bases before the current one contain it, with 4 bases or more beyond its first copy
+void checkRepeats( MotifQualityDropModel &model )
+{
+    // k=1: drop of 34-20 from 5 copies on
+    CPPUNIT_ASSERT( expectedDrops( 20, 5, 14 ) == getQualityDrops( model, repeat( "A", 20 ) ) );
+    // Repeat counts below the first line of the motif don't drop the quality
+    CPPUNIT_ASSERT( expectedDrops( 20, 8, 24 ) == getQualityDrops( model, repeat( "C", 20 ) ) );
+    // Motif without any entry
+    CPPUNIT_ASSERT( expectedDrops( 20, 20, 0 ) == getQualityDrops( model, repeat( "G", 20 ) ) );
+
+    // k=2, starting with any of the permutations of the motif
+    CPPUNIT_ASSERT( expectedDrops( 20, 6, 10 ) == getQualityDrops( model, repeat( "AC", 10 ) ) );
+    CPPUNIT_ASSERT( expectedDrops( 20, 6, 10 ) == getQualityDrops( model, repeat( "CA", 10 ) ) );
+
+    // k=3: the line of 2 copies serves the longer repeats too
+    CPPUNIT_ASSERT( expectedDrops( 21, 9, 20 ) == getQualityDrops( model, repeat( "ACG", 7 ) ) );
+    CPPUNIT_ASSERT( expectedDrops( 21, 9, 20 ) == getQualityDrops( model, repeat( "GAC", 7 ) ) );
+
+    // k=10
+    CPPUNIT_ASSERT( expectedDrops( 30, 20, 30 ) == getQualityDrops( model, repeat( "ACGTTGCAAC", 3 ) ) );
+    CPPUNIT_ASSERT( expectedDrops( 30, 20, 30 ) == getQualityDrops( model, repeat( "GCAACACGTT", 3 ) ) );
+
+    // No repeat
+    CPPUNIT_ASSERT( expectedDrops( 16, 16, 0 ) == getQualityDrops( model, "ACGTTGCAACTAGGCT" ) );
+}
+
+} // anonymous namespace
+
+
+void TestMotifQualityDropModel::setUp()
+{
+    tableFilename_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testMotifQualityDropModel-%%%%-%%%%.tsv" );
+    bundleFilename_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testMotifQualityDropModel-%%%%-%%%%.bin" );
+
+    // kmer (0-3 for A,C,G,T, as in the default table), repeat count, mean quality, quality:count.
+    // Single qualities make the drops independent of the random draws
+    ofstream os( tableFilename_.string().c_str() );
+    os << "#Kmer\trepeatCount\tmeanQualityAfter\tquality histogram pairs {quality:count}\n"
+       << "0\t5\t20\t20:1\n"             // A
+       << "1\t8\t10\t10:1\n"             // C
+       << "01\t3\t24\t24:1\n"            // AC
+       << "012\t2\t14\t14:1\n"           // ACG
+       << "0123321001\t2\t4\t4:1\n";     // ACGTTGCAAC
+}
+
+void TestMotifQualityDropModel::tearDown()
+{
+    boost::filesystem::remove( tableFilename_ );
+    boost::filesystem::remove( bundleFilename_ );
+}
+
+void TestMotifQualityDropModel::testRepeats()
+{
+    MotifQualityDropModel model( tableFilename_ );
+    CPPUNIT_ASSERT( model.isActive() );
+    checkRepeats( model );
+
+    MotifQualityDropModel inactiveModel( "" );
+    CPPUNIT_ASSERT( !inactiveModel.isActive() );
+    CPPUNIT_ASSERT( expectedDrops( 20, 20, 0 ) == getQualityDrops( inactiveModel, repeat( "A", 20 ) ) );
+}
+
+void TestMotifQualityDropModel::testBundle()
+{
+    {
+        const MotifQualityDropModel model( tableFilename_ );
+        ErrorModelBundleWriter writer( bundleFilename_ );
+        model.save( writer );
+        writer.close();
+    }
+
+    // Same drops from the compiled error model
+    const ErrorModelBundleReader reader( bundleFilename_ );
+    MotifQualityDropModel model( "" );
+    model.load( reader );
+    CPPUNIT_ASSERT( model.isActive() );
+    checkRepeats( model );
+}
+
+void TestMotifQualityDropModel::testCorruptedBundle()
+{
+    // Valid file, but the only motif group ends after the (empty) list of repeats
+    {
+        ErrorModelBundleWriter writer( bundleFilename_ );
+        writer.add( eagle::genome::MOTIF_KMERS, vector<uint64_t>() );
+        writer.add( eagle::genome::MOTIF_GROUPS, vector<uint64_t>( 1, 3 ) );
+        writer.add( eagle::genome::MOTIF_REPEATS, vector<uint64_t>() );
+        writer.add( eagle::genome::MOTIF_WEIGHTS, vector<double>() );
+        writer.close();
+    }
+
+    const ErrorModelBundleReader reader( bundleFilename_ );
+    MotifQualityDropModel model( "" );
+    CPPUNIT_ASSERT_THROW( model.load( reader ), eagle::common::CorruptedFileException );
+}
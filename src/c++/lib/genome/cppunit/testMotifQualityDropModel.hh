@@ -0,0 +1,35 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_MOTIF_QUALITY_DROP_MODEL_HH
+#define EAGLE_GENOME_TEST_MOTIF_QUALITY_DROP_MODEL_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+
+#include "genome/QualityModel.hh"
+
+
+class TestMotifQualityDropModel : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestMotifQualityDropModel );
+    CPPUNIT_TEST( testRepeats );
+    CPPUNIT_TEST( testBundle );
+    CPPUNIT_TEST( testCorruptedBundle );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tableFilename_;
+    boost::filesystem::path bundleFilename_;
+public:
+    void setUp();
+    void tearDown();
+    void testRepeats();
+    void testBundle();
+    void testCorruptedBundle();
+};
+
+#endif //EAGLE_GENOME_TEST_MOTIF_QUALITY_DROP_MODEL_HH
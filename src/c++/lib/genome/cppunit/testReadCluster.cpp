@@ -0,0 +1,158 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testReadCluster.hh"
+
+using eagle::genome::ReadClusterFactory;
+using eagle::genome::ReadClusterWithErrors;
+using eagle::model::Fragment;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestReadCluster, registryName("ReadCluster"));
+
+
+namespace
+{
+
+const unsigned int CONTIG_LENGTH = 600;
+const unsigned int READ_LENGTH = 20;
+const unsigned int CLUSTER_LENGTH = 2 * READ_LENGTH;
+const unsigned int FRAGMENT_COUNT = 24;
+
+// Counts the CIGAR operations of type op (1='I', 2='D') in the reads of the cluster
+unsigned int countCigarOps( ReadClusterWithErrors &cluster, const unsigned int op )
+{
+    unsigned int count = 0;
+    for (unsigned int readNum=0; readNum<2; ++readNum)
+    {
+        const vector<unsigned int> &cigar = cluster.getCigar( readNum );
+        for (unsigned int i=0; i<cigar.size(); ++i)
+        {
+            count += ((cigar[i] & 0xF) == op) ? (cigar[i] >> 4) : 0;
+        }
+    }
+    return count;
+}
+
+} // anonymous namespace
+
+
+void TestReadCluster::setUp()
+{
+    dir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testReadCluster-%%%%-%%%%" );
+    boost::filesystem::create_directories( dir_ / "genome" );
+    {
+        // Pseudo-random bases, 60 per line
+        ofstream fasta( (dir_ / "genome" / "chr.fa").string().c_str() );
+        fasta << ">chr\n";
+        unsigned int x = 12345;
+        for (unsigned int i=0; i<CONTIG_LENGTH; ++i)
+        {
+            x = x * 1103515245 + 12345;
+            fasta << "ACGT"[(x >> 16) & 3] << ((i % 60 == 59) ? "\n" : "");
+        }
+        ofstream fai( (dir_ / "genome" / "chr.fa.fai").string().c_str() );
+        fai << "chr\t" << CONTIG_LENGTH << "\t5\t60\t61\n";
+    }
+    {
+        ofstream runInfo( (dir_ / "RunInfo.xml").string().c_str() );
+        runInfo << "<?xml version=\"1.0\"?>\n"
+                << "<RunInfo Version=\"2\">\n"
+                << "  <Run Id=\"testReadCluster\" Number=\"1\" TileNameMethod=\"1\">\n"
+                << "    <Flowcell>FC</Flowcell>\n"
+                << "    <FlowcellLayout LaneCount=\"1\" SurfaceCount=\"1\" SwathCount=\"1\" TileCount=\"1\"/>\n"
+                << "    <Reads>\n"
+                << "      <Read FirstCycle=\"1\" LastCycle=\"" << READ_LENGTH << "\"/>\n"
+                << "      <Read FirstCycle=\"" << READ_LENGTH+1 << "\" LastCycle=\"" << CLUSTER_LENGTH << "\"/>\n"
+                << "    </Reads>\n"
+                << "  </Run>\n"
+                << "</RunInfo>\n";
+    }
+    {
+        // Every cycle: profile 0 picks profile 1 or 2, which give low qualities often enough to get many errors
+        ofstream qualityTable( (dir_ / "quality.qval").string().c_str() );
+        for (unsigned int cycle=1; cycle<=CLUSTER_LENGTH; ++cycle)
+        {
+            for (unsigned int profile=0; profile<=2; ++profile)
+            {
+                qualityTable << cycle << '\t' << profile;
+                for (unsigned int q=0; q<=40; ++q)
+                {
+                    const bool used = (profile == 0) ? (q == 1 || q == 2)
+                                    : (profile == 1) ? (q == 2 || q == 15 || q == 40)
+                                    : (q == 5 || q == 30);
+                    qualityTable << '\t' << (used ? 1 : 0);
+                }
+                qualityTable << '\n';
+            }
+        }
+    }
+    {
+        // Errors: x->A, x->C, x->G, x->T, deletion, insertions of A, C, G, T
+        ofstream mismatchTable( (dir_ / "mismatch.tsv").string().c_str() );
+        mismatchTable << "A\t0\t1\t1\t1\t3\t1\t1\t1\t1\n"
+                      << "C\t1\t0\t1\t1\t3\t1\t1\t1\t1\n"
+                      << "G\t1\t1\t0\t1\t3\t1\t1\t1\t1\n"
+                      << "T\t1\t1\t1\t0\t3\t1\t1\t1\t1\n";
+    }
+}
+
+void TestReadCluster::tearDown()
+{
+    boost::filesystem::remove_all( dir_ );
+}
+
+void TestReadCluster::testBclClusterBlock()
+{
+    const eagle::io::RunInfo runInfo( dir_ / "RunInfo.xml" );
+    const vector<boost::filesystem::path> qualityTables( 1, dir_ / "quality.qval" );
+    ReadClusterFactory factory( runInfo, dir_ / "genome", qualityTables, dir_ / "mismatch.tsv", "", "", "", "", 42, vector<string>() );
+
+    vector<Fragment> fragments;
+    for (unsigned int i=0; i<FRAGMENT_COUNT; ++i)
+    {
+        fragments.push_back( Fragment( 10 + i*15, 100 + i*3, 1000 + i*7 ) );
+    }
+
+    // Whole block, and a smaller one starting at a different fragment: each cluster gets the bytes of getBclCluster()
+    vector<char> bclBlock, bclSubBlock;
+    factory.getBclClusterBlock( fragments, bclBlock );
+    const vector<Fragment> subBlockFragments( fragments.begin() + 5, fragments.begin() + 8 );
+    factory.getBclClusterBlock( subBlockFragments, bclSubBlock );
+    CPPUNIT_ASSERT_EQUAL( static_cast<size_t>(CLUSTER_LENGTH * FRAGMENT_COUNT), bclBlock.size() );
+    CPPUNIT_ASSERT_EQUAL( static_cast<size_t>(CLUSTER_LENGTH * 3), bclSubBlock.size() );
+
+    unsigned int insertionCount = 0, deletionCount = 0;
+    for (unsigned int i=0; i<FRAGMENT_COUNT; ++i)
+    {
+        ReadClusterWithErrors cluster = factory.getReadClusterWithErrors( fragments[i] );
+        const string bclCluster( cluster.getBclCluster( true ), CLUSTER_LENGTH );
+        for (unsigned int cycle=0; cycle<CLUSTER_LENGTH; ++cycle)
+        {
+            CPPUNIT_ASSERT_EQUAL( bclCluster[cycle], bclBlock[cycle * FRAGMENT_COUNT + i] );
+            if (i >= 5 && i < 8)
+            {
+                CPPUNIT_ASSERT_EQUAL( bclCluster[cycle], bclSubBlock[cycle * 3 + i - 5] );
+            }
+        }
+        insertionCount += countCigarOps( cluster, 1 );
+        deletionCount += countCigarOps( cluster, 2 );
+    }
+
+    // The comparison covered both kinds of indels
+    CPPUNIT_ASSERT( insertionCount > 0 );
+    CPPUNIT_ASSERT( deletionCount > 0 );
+}
@@ -0,0 +1,30 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_GENOME_TEST_READ_CLUSTER_HH
+#define EAGLE_GENOME_TEST_READ_CLUSTER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <boost/filesystem.hpp>
+
+#include "genome/ReadCluster.hh"
+
+
+class TestReadCluster : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestReadCluster );
+    CPPUNIT_TEST( testBclClusterBlock );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path dir_;
+public:
+    void setUp();
+    void tearDown();
+    void testBclClusterBlock();
+};
+
+#endif //EAGLE_GENOME_TEST_READ_CLUSTER_HH
@@ -0,0 +1,391 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Concatenates indexed BAM files sharing the same header, without decompressing them
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <zlib.h>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/Bam.hh"
+#include "io/BamConcatenator.hh"
+
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace io
+{
+namespace bam
+{
+
+
+namespace
+{
+
+const unsigned int BGZF_HEADER_SIZE = 18;
+const unsigned int BGZF_EOF_SIZE = 28;
+
+// Samtools' pseudo-bin, whose 2 "chunks" are {first offset, last offset} and {mapped count, unmapped count}
+const unsigned int BAI_PSEUDO_BIN = 37450;
+
+template <typename T>
+T getLittleEndian( const char *bytes )
+{
+    T value;
+    memcpy( &value, bytes, sizeof(value) );
+    return value;
+}
+
+/**
+ ** \brief Reads the next complete BGZF block of 'is'
+ **
+ ** \return false at the end of the file
+ **/
+bool readBgzfBlock( istream &is, vector<char> &block, const boost::filesystem::path &filename )
+{
+    block.resize( BGZF_HEADER_SIZE );
+    if (!is.read( &block[0], BGZF_HEADER_SIZE ))
+    {
+        if (is.gcount() == 0)
+        {
+            return false;
+        }
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Truncated BGZF block header in " + filename.string() ) );
+    }
+    if ((unsigned char)block[0] != 31 || (unsigned char)block[1] != 139 || block[12] != 'B' || block[13] != 'C')
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Invalid BGZF block header in " + filename.string() ) );
+    }
+    const unsigned int blockSize = (unsigned char)block[16] + ((unsigned char)block[17] << 8) + 1;
+    block.resize( blockSize );
+    if (!is.read( &block[BGZF_HEADER_SIZE], blockSize - BGZF_HEADER_SIZE ))
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Truncated BGZF block in " + filename.string() ) );
+    }
+    return true;
+}
+
+void inflateBgzfBlock( const vector<char> &block, string &uncompressed, const boost::filesystem::path &filename )
+{
+    const unsigned int uncompressedSize = getLittleEndian<unsigned int>( &block[block.size() - 4] );
+    const size_t startSize = uncompressed.size();
+    uncompressed.resize( startSize + uncompressedSize );
+
+    z_stream stream = z_stream();
+    if (inflateInit2( &stream, 15 + 16 ) != Z_OK)
+    {
+        BOOST_THROW_EXCEPTION( common::EagleException( 0, "bgzf decompression: failed to initialise inflate stream" ) );
+    }
+    stream.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( &block[0] ) );
+    stream.avail_in = block.size();
+    stream.next_out = reinterpret_cast<Bytef*>( &uncompressed[startSize] );
+    stream.avail_out = uncompressedSize;
+    const int status = inflate( &stream, Z_FINISH );
+    inflateEnd( &stream );
+    if (status != Z_STREAM_END || stream.total_out != uncompressedSize)
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Failed to decompress BGZF block in " + filename.string() ) );
+    }
+}
+
+/**
+ ** \brief Length of the uncompressed BAM header at the start of 'bam'
+ **
+ ** \return 0 if 'bam' doesn't contain the whole header yet
+ **/
+size_t bamHeaderLength( const string &bam )
+{
+    // magic, l_text, text, n_ref, then {l_name, name, l_ref} for each reference
+    size_t length = 8;
+    if (bam.size() < length)
+    {
+        return 0;
+    }
+    length += getLittleEndian<int>( &bam[4] ) + 4;
+    if (bam.size() < length)
+    {
+        return 0;
+    }
+    const int refCount = getLittleEndian<int>( &bam[length - 4] );
+    for (int i=0; i<refCount; ++i)
+    {
+        if (bam.size() < length + 4)
+        {
+            return 0;
+        }
+        length += 4 + getLittleEndian<int>( &bam[length] ) + 4;
+    }
+    return bam.size() < length ? 0 : length;
+}
+
+/**
+ ** \brief Compressed size of the BAM header, which must end at a BGZF block boundary
+ **
+ ** \param headerBlocks filled with the compressed header
+ **/
+unsigned long readBamHeaderBlocks( istream &is, vector<char> &headerBlocks, const boost::filesystem::path &filename )
+{
+    vector<char> block;
+    string uncompressed;
+    size_t headerLength = 0;
+    headerBlocks.clear();
+    while (!headerLength)
+    {
+        if (!readBgzfBlock( is, block, filename ))
+        {
+            BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Truncated BAM header in " + filename.string() ) );
+        }
+        headerBlocks.insert( headerBlocks.end(), block.begin(), block.end() );
+        inflateBgzfBlock( block, uncompressed, filename );
+        headerLength = bamHeaderLength( uncompressed );
+    }
+    if (uncompressed.size() != headerLength)
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "The header of " + filename.string() + " shares its last BGZF block with the alignments" ) );
+    }
+    return headerBlocks.size();
+}
+
+
+struct BaiBin
+{
+    unsigned int bin;
+    vector<unsigned long long> chunkOffsets; // begin and end virtual offsets of each chunk
+};
+
+/**
+ ** \brief Index of one reference sequence in a .bai file
+ **/
+struct BaiReference
+{
+    vector<BaiBin> bins;
+    vector<unsigned long long> linearIndex;
+
+    bool hasAlignments() const
+    {
+        return !linearIndex.empty();
+    }
+
+    void shiftCompressedOffsets( const unsigned long long shift )
+    {
+        BOOST_FOREACH( BaiBin &bin, bins )
+        {
+            // Only the first chunk of the pseudo-bin holds offsets
+            const unsigned int offsetCount = (bin.bin == BAI_PSEUDO_BIN) ? 2 : bin.chunkOffsets.size();
+            for (unsigned int i=0; i<offsetCount && i<bin.chunkOffsets.size(); ++i)
+            {
+                bin.chunkOffsets[i] += shift << 16;
+            }
+        }
+        BOOST_FOREACH( unsigned long long &offset, linearIndex )
+        {
+            if (offset) // 0 is left by BamIndexer for the windows preceding the first alignment
+            {
+                offset += shift << 16;
+            }
+        }
+    }
+};
+
+template <typename T>
+void readBai( istream &is, T &value, const boost::filesystem::path &filename )
+{
+    if (!is.read( reinterpret_cast<char*>(&value), sizeof(value) ))
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAI", "Truncated BAM index " + filename.string() ) );
+    }
+}
+
+void readBaiReferences( const boost::filesystem::path &filename, vector<BaiReference> &references, unsigned long long &unplacedCount )
+{
+    ifstream is( filename.string().c_str(), ios_base::binary );
+    char magic[4];
+    if (!is.read( magic, 4 ) || memcmp( magic, "BAI\1", 4 ))
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAI", "Invalid BAM index " + filename.string() ) );
+    }
+    int refCount;
+    readBai( is, refCount, filename );
+    references.resize( refCount );
+    BOOST_FOREACH( BaiReference &reference, references )
+    {
+        int binCount;
+        readBai( is, binCount, filename );
+        reference.bins.resize( binCount );
+        BOOST_FOREACH( BaiBin &bin, reference.bins )
+        {
+            int chunkCount;
+            readBai( is, bin.bin, filename );
+            readBai( is, chunkCount, filename );
+            bin.chunkOffsets.resize( 2 * chunkCount );
+            BOOST_FOREACH( unsigned long long &offset, bin.chunkOffsets )
+            {
+                readBai( is, offset, filename );
+            }
+        }
+        int intervalCount;
+        readBai( is, intervalCount, filename );
+        reference.linearIndex.resize( intervalCount );
+        BOOST_FOREACH( unsigned long long &offset, reference.linearIndex )
+        {
+            readBai( is, offset, filename );
+        }
+    }
+    // Optional trailing field
+    unplacedCount = 0;
+    is.read( reinterpret_cast<char*>(&unplacedCount), sizeof(unplacedCount) );
+}
+
+template <typename T>
+void writeBai( ostream &os, const T value )
+{
+    os.write( reinterpret_cast<const char*>(&value), sizeof(value) );
+}
+
+void writeBaiReferences( const boost::filesystem::path &filename, const vector<BaiReference> &references, const unsigned long long unplacedCount )
+{
+    ofstream os( filename.string().c_str(), ios_base::binary );
+    os.write( "BAI\1", 4 );
+    writeBai<int>( os, references.size() );
+    BOOST_FOREACH( const BaiReference &reference, references )
+    {
+        writeBai<int>( os, reference.bins.size() );
+        BOOST_FOREACH( const BaiBin &bin, reference.bins )
+        {
+            writeBai<unsigned int>( os, bin.bin );
+            writeBai<int>( os, bin.chunkOffsets.size() / 2 );
+            BOOST_FOREACH( const unsigned long long offset, bin.chunkOffsets )
+            {
+                writeBai( os, offset );
+            }
+        }
+        writeBai<int>( os, reference.linearIndex.size() );
+        BOOST_FOREACH( const unsigned long long offset, reference.linearIndex )
+        {
+            writeBai( os, offset );
+        }
+    }
+    writeBai( os, unplacedCount );
+    if (!os.good())
+    {
+        cerr << "Can't write to " << filename << endl;
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot write file" ) );
+    }
+}
+
+void copyBytes( istream &is, ostream &os, unsigned long long count, const boost::filesystem::path &filename )
+{
+    vector<char> buffer( 1 << 20 );
+    while (count)
+    {
+        const unsigned long long chunkSize = min<unsigned long long>( count, buffer.size() );
+        if (!is.read( &buffer[0], chunkSize ))
+        {
+            BOOST_THROW_EXCEPTION( common::IoException( errno, "Failed to read from " + filename.string() ) );
+        }
+        serialize( os, &buffer[0], chunkSize );
+        count -= chunkSize;
+    }
+}
+
+/**
+ ** \brief Checks that the last BGZF_EOF_SIZE bytes of 'is' are the BGZF end-of-file block
+ **
+ ** Otherwise, dropping them would silently lose the last alignments of a truncated file
+ **/
+void checkBgzfEofBlock( istream &is, const unsigned long long fileSize, const boost::filesystem::path &filename )
+{
+    ostringstream expected;
+    serializeBgzfFooter( expected );
+
+    const streampos currentPos = is.tellg();
+    vector<char> eofBlock( BGZF_EOF_SIZE );
+    if (!is.seekg( fileSize - BGZF_EOF_SIZE ) || !is.read( &eofBlock[0], BGZF_EOF_SIZE ) || memcmp( &eofBlock[0], expected.str().data(), BGZF_EOF_SIZE ))
+    {
+        BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Missing BGZF end-of-file block in " + filename.string() ) );
+    }
+    is.seekg( currentPos );
+}
+
+} // anonymous namespace
+
+
+void concatenateBams( const vector<boost::filesystem::path> &parts, const boost::filesystem::path &bamPath )
+{
+    ofstream os( bamPath.string().c_str(), ios_base::binary );
+    if (!os.good())
+    {
+        BOOST_THROW_EXCEPTION( common::IoException( errno, "Failed to open output BAM file " + bamPath.string() ) );
+    }
+
+    vector<BaiReference> mergedIndex;
+    unsigned long long unplacedCount = 0;
+    for (unsigned int i=0; i<parts.size(); ++i)
+    {
+        ifstream is( parts[i].string().c_str(), ios_base::binary );
+        if (!is.good())
+        {
+            BOOST_THROW_EXCEPTION( common::IoException( errno, "Failed to open " + parts[i].string() ) );
+        }
+        vector<char> headerBlocks;
+        const unsigned long headerSize = readBamHeaderBlocks( is, headerBlocks, parts[i] );
+        if (i == 0)
+        {
+            serialize( os, &headerBlocks[0], headerBlocks.size() );
+        }
+
+        // Alignment blocks, without the final empty block
+        const unsigned long long partSize = boost::filesystem::file_size( parts[i] );
+        if (partSize < headerSize + BGZF_EOF_SIZE)
+        {
+            BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAM", "Missing BGZF end-of-file block in " + parts[i].string() ) );
+        }
+        checkBgzfEofBlock( is, partSize, parts[i] );
+        const unsigned long long shift = static_cast<unsigned long long>( os.tellp() ) - headerSize;
+        copyBytes( is, os, partSize - headerSize - BGZF_EOF_SIZE, parts[i] );
+
+        vector<BaiReference> partIndex;
+        unsigned long long partUnplacedCount;
+        readBaiReferences( parts[i].string() + ".bai", partIndex, partUnplacedCount );
+        if (i == 0)
+        {
+            mergedIndex = partIndex;
+        }
+        else if (partIndex.size() != mergedIndex.size())
+        {
+            BOOST_THROW_EXCEPTION( common::CorruptedFileException( "BAI", "Unexpected number of references in " + parts[i].string() + ".bai" ) );
+        }
+        for (unsigned int ref=0; ref<partIndex.size(); ++ref)
+        {
+            if (partIndex[ref].hasAlignments())
+            {
+                mergedIndex[ref] = partIndex[ref];
+                mergedIndex[ref].shiftCompressedOffsets( shift );
+            }
+        }
+        unplacedCount += partUnplacedCount;
+    }
+    serializeBgzfFooter( os );
+    os.close();
+
+    writeBaiReferences( bamPath.string() + ".bai", mergedIndex, unplacedCount );
+}
+
+
+} // namespace bam
+} // namespace io
+} // namespace eagle
@@ -12,8 +12,16 @@
 #include <iostream>
 #include <fstream>
 #include <cerrno>
+#include <cstring>
+#include <algorithm>
 #include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/thread/locks.hpp>
 #include "io/Bcl.hh"
 
 using namespace std;
@@ -25,69 +33,251 @@ namespace io
 {
 
 
-BclTile::BclTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const string &filenameTemplate, const string &statsFilenameTemplate, const string &filterFilename, const string &clocsFilename, const string &controlFilename, const bool verbose )
+BclTile::BclTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const string &filenameTemplate, const string &statsFilenameTemplate, const string &filterFilename, const string &clocsFilename, const string &controlFilename, const bool verbose, const BclFormat format, const unsigned long long blockSize )
         : expectedReadCount_     ( expectedReadCount )
         , clusterLength_         ( clusterLength )
+        , format_                ( format )
         , filenameTemplate_      ( filenameTemplate )
         , statsFilenameTemplate_ ( statsFilenameTemplate )
         , filterFilename_        ( filterFilename )
         , clocsFilename_         ( clocsFilename )
         , controlFilename_       ( controlFilename )
         , stats_                 ( clusterLength_, std::vector<unsigned int>(4, 0) )
+        , blockSize_             ( (blockSize > 0 && blockSize < expectedReadCount) ? blockSize : expectedReadCount )
         , passFilter_            ( expectedReadCount_, '\0' )
+        , nextPos_               ( 0 )
+        , blockStartPos_         ( 0 )
     {
         if (verbose)
         {
             clog << (boost::format("Creating new Bcl tile as %s, expecting %d reads") % filenameTemplate_ % expectedReadCount_).str() << endl;
+            if (isStreaming())
+            {
+                clog << (boost::format("Streaming Bcl tile to disk by blocks of %d clusters") % blockSize_).str() << endl;
+            }
         }
         assert (expectedReadCount_ < static_cast<unsigned int>(0xFFFFFFFF) && "Tile too large: BCL filter files can only contain 2^32 entries per tile");
         //boost::filesystem::create_directories( path_ );
 
-        ramTile_ = new char[clusterLength_*expectedReadCount_];
+        ramTile_ = new char[clusterLength_*blockSize_];
         assert (ramTile_ != 0);
     }
 
+    BclTile::~BclTile()
+    {
+        delete[] ramTile_;
+
+        // Leftover spill files of bcl.gz and cbcl tiles (the bcl ones are the actual output)
+        if (isStreaming() && format_ != BCL_FORMAT_BCL)
+        {
+            for (unsigned int i=0; i<clusterLength_; ++i)
+            {
+                boost::system::error_code ec;
+                boost::filesystem::remove( getSpillFilename( i ), ec );
+            }
+        }
+    }
+
     void BclTile::addClusterToRandomLocation( const char *bufCluster, const bool isPassingFilter )
     {
-        static unsigned long long nextPos = 0; // TODO: make this random
-        if (nextPos >= expectedReadCount_)
+        if (nextPos_ >= expectedReadCount_)
         {
             BOOST_THROW_EXCEPTION( eagle::common::OutOfLimitsException( "Trying to add a cluster to a full tile" ) );
         }
+        const unsigned long long posInBlock = nextPos_ - blockStartPos_;
         for (unsigned int i=0; i<clusterLength_; ++i)
         {
-            ramTile_[nextPos+expectedReadCount_*i] = bufCluster[i];
+            ramTile_[posInBlock+blockSize_*i] = bufCluster[i];
         }
         if (isPassingFilter) {
-            passFilter_[nextPos] = '\1';
+            passFilter_[nextPos_] = '\1';
+        }
+        nextPos_++;
+
+        if (isStreaming() && nextPos_ - blockStartPos_ == blockSize_)
+        {
+            spillBlock();
+        }
+    }
+
+    void BclTile::addClusters( const char *bclBlock, const unsigned int clusterCount, const vector<char> &isPassingFilter )
+    {
+        assert( isPassingFilter.size() == clusterCount );
+        if (nextPos_ + clusterCount > expectedReadCount_)
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::OutOfLimitsException( "Trying to add too many clusters to a tile" ) );
+        }
+        unsigned int added = 0;
+        while (added < clusterCount)
+        {
+            // Clusters that fit in the current block
+            const unsigned long long posInBlock = nextPos_ - blockStartPos_;
+            const unsigned int count = std::min<unsigned long long>( clusterCount - added, blockSize_ - posInBlock );
+            for (unsigned int i=0; i<clusterLength_; ++i)
+            {
+                memcpy( &ramTile_[posInBlock+blockSize_*i], &bclBlock[clusterCount*i + added], count );
+            }
+            for (unsigned int j=0; j<count; ++j)
+            {
+                if (isPassingFilter[added+j]) {
+                    passFilter_[nextPos_+j] = '\1';
+                }
+            }
+            nextPos_ += count;
+            added += count;
+
+            if (isStreaming() && nextPos_ - blockStartPos_ == blockSize_)
+            {
+                spillBlock();
+            }
         }
-        nextPos++;
     }
 
-    void BclTile::flushToDisk() const
+    void BclTile::flushToDisk()
     {
         clog << "Flushing tile to disk" << endl;
-        for (unsigned int i=0; i<clusterLength_; ++i)
+        if (isStreaming() && (nextPos_ > blockStartPos_ || nextPos_ < expectedReadCount_))
+        {
+            // Missing clusters are written as no-calls, to keep the cluster count announced in the headers
+            spillBlock( expectedReadCount_ - nextPos_ );
+        }
+        if (format_ != BCL_FORMAT_CBCL)
         {
-            writeBclFile(i);
-            writeStatsFile(i);
+            for (unsigned int i=0; i<clusterLength_; ++i)
+            {
+                if (!isStreaming())
+                {
+                    writeBclFile(i);
+                }
+                else if (format_ == BCL_FORMAT_BCL_GZ)
+                {
+                    compressSpillFile(i);
+                }
+                writeStatsFile(i);
+            }
         }
         writeFilterFile();
         writeClocsFile();
         writeControlFile();
     }
 
+    string BclTile::getBclFilename( const unsigned int cycle ) const
+    {
+        const string filename = (boost::format( filenameTemplate_) % (cycle+1)).str();
+        return (format_ == BCL_FORMAT_BCL_GZ) ? filename + ".gz" : filename;
+    }
+
+    string BclTile::getSpillFilename( const unsigned int cycle ) const
+    {
+        const string filename = (boost::format( filenameTemplate_) % (cycle+1)).str();
+        return (format_ == BCL_FORMAT_BCL) ? filename : filename + ".spill";
+    }
+
+    void BclTile::spillBlock( const unsigned long long paddingClusterCount )
+    {
+        const unsigned long long clusterCount = nextPos_ - blockStartPos_;
+        const vector<char> padding( paddingClusterCount, 0 );
+        for (unsigned int cycle=0; cycle<clusterLength_; ++cycle)
+        {
+            const string filename = getSpillFilename( cycle );
+            const bool isFirstBlock = (blockStartPos_ == 0);
+            ofstream os( filename.c_str(), isFirstBlock ? ios_base::binary : (ios_base::binary | ios_base::app) );
+            if( !os.good() )
+            {
+                cerr << "Can't write to " << filename << endl;
+                BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
+            }
+            if (isFirstBlock)
+            {
+                os.write( (const char*)&expectedReadCount_, 4);
+            }
+            os.write( &ramTile_[blockSize_*cycle], clusterCount);
+            if (!padding.empty())
+            {
+                os.write( &padding[0], padding.size());
+            }
+            if( !os.good() )
+            {
+                cerr << "Can't write to " << filename << endl;
+                BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot write file" ) );
+            }
+        }
+        blockStartPos_ = nextPos_;
+    }
+
+    void BclTile::compressSpillFile( const unsigned int cycle ) const
+    {
+        const string spillFilename = getSpillFilename( cycle );
+        const string filename = getBclFilename( cycle );
+        {
+            ifstream is( spillFilename.c_str(), ios_base::binary );
+            ofstream os( filename.c_str(), ios_base::binary );
+            if( !is.good() || !os.good() )
+            {
+                cerr << "Can't convert " << spillFilename << " to " << filename << endl;
+                BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
+            }
+            boost::iostreams::filtering_ostream bclStream;
+            bclStream.push( boost::iostreams::gzip_compressor( boost::iostreams::gzip::best_speed ) );
+            bclStream.push( os );
+            boost::iostreams::copy( is, bclStream );
+        }
+        boost::filesystem::remove( spillFilename );
+    }
+
     void BclTile::writeBclFile( const unsigned int cycle ) const
     {
-        string filename = (boost::format( filenameTemplate_) % (cycle+1)).str();
-        ofstream os( filename.c_str() );
+        const string filename = getBclFilename( cycle );
+        ofstream os( filename.c_str(), ios_base::binary );
         if( !os.good() )
         {
             cerr << "Can't write to " << filename << endl;
             BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
         }
-        os.write( (const char*)&expectedReadCount_, 4);
-        os.write( &ramTile_[expectedReadCount_*cycle], expectedReadCount_);
+        boost::iostreams::filtering_ostream bclStream;
+        if (format_ == BCL_FORMAT_BCL_GZ)
+        {
+            bclStream.push( boost::iostreams::gzip_compressor( boost::iostreams::gzip::best_speed ) );
+        }
+        bclStream.push( os );
+        bclStream.write( (const char*)&expectedReadCount_, 4);
+        bclStream.write( &ramTile_[blockSize_*cycle], expectedReadCount_);
+    }
+
+    void BclTile::getCompressedCbclBlock( const unsigned int cycle, vector<char> &compressedBlock ) const
+    {
+        // Streaming tiles only have their last block in memory: reload the whole cycle from its spill file
+        vector<char> spilledCycle;
+        if (isStreaming())
+        {
+            const string spillFilename = getSpillFilename( cycle );
+            ifstream is( spillFilename.c_str(), ios_base::binary );
+            spilledCycle.resize( expectedReadCount_ );
+            is.seekg( 4 );
+            is.read( &spilledCycle[0], expectedReadCount_ );
+            if( !is.good() )
+            {
+                cerr << "Can't read " << spillFilename << endl;
+                BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot read file" ) );
+            }
+        }
+
+        // 2 clusters per byte, the first one in the low nibble
+        const char *bclCycle = isStreaming() ? &spilledCycle[0] : &ramTile_[blockSize_*cycle];
+        vector<char> block( (expectedReadCount_ + 1) / 2, 0 );
+        for (unsigned long long i=0; i<expectedReadCount_; ++i)
+        {
+            const unsigned char bclBase = bclCycle[i];
+            const unsigned char nibble = (bclBase & 3) | (CbclWriter::getQualityBin( bclBase >> 2 ) << 2);
+            block[i/2] |= (i%2) ? (nibble << 4) : nibble;
+        }
+
+        compressedBlock.clear();
+        boost::iostreams::filtering_ostream gzipStream;
+        gzipStream.push( boost::iostreams::gzip_compressor( boost::iostreams::gzip::best_speed ) );
+        gzipStream.push( boost::iostreams::back_inserter( compressedBlock ) );
+        gzipStream.write( &block[0], block.size() );
+        gzipStream.reset(); // flushes the gzip footer
     }
 
     void BclTile::writeStatsFile( const unsigned int cycle ) const
@@ -213,6 +403,116 @@ BclTile::BclTile( const unsigned long long expectedReadCount, const unsigned int
 
 
 
+// Same 4 quality bins as the NovaSeq: bin 0 is reserved for the no-calls, which get reported as 'N'
+static const unsigned int cbclQualityBinCount = 4;
+static const unsigned int cbclBinnedQualities[cbclQualityBinCount] = { 2, 12, 23, 37 };
+
+CbclWriter::CbclWriter( const string &filenameTemplate, const unsigned int clusterLength, const unsigned int expectedTileCount )
+        : filenameTemplate_  ( filenameTemplate )
+        , clusterLength_     ( clusterLength )
+        , expectedTileCount_ ( expectedTileCount )
+    {
+    }
+
+    unsigned char CbclWriter::getQualityBin( const unsigned int quality )
+    {
+        if (quality == 0) { return 0; } // no-call only
+        if (quality < 15) { return 1; }
+        if (quality < 31) { return 2; }
+        return 3;
+    }
+
+    void CbclWriter::addTile( const unsigned int tileId, const BclTile &tile )
+    {
+        // Compression happens outside of the lock, so that the tiles of several threads get compressed in parallel
+        TileBlocks tileBlocks;
+        tileBlocks.tileId = tileId;
+        tileBlocks.clusterCount = tile.getClusterCount();
+        tileBlocks.compressedBlockPerCycle.resize( clusterLength_ );
+        for (unsigned int cycle=0; cycle<clusterLength_; ++cycle)
+        {
+            tile.getCompressedCbclBlock( cycle, tileBlocks.compressedBlockPerCycle[cycle] );
+        }
+
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        if (tiles_.size() >= expectedTileCount_)
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::OutOfLimitsException( "Trying to add too many tiles to a CBCL surface" ) );
+        }
+        tiles_.push_back( TileBlocks() );
+        std::swap( tiles_.back(), tileBlocks );
+        if (tiles_.size() == expectedTileCount_)
+        {
+            flushToDisk();
+        }
+    }
+
+    void CbclWriter::flushToDisk()
+    {
+        clog << (boost::format("Writing %d tiles as %s") % tiles_.size() % filenameTemplate_).str() << endl;
+        sort( tiles_.begin(), tiles_.end() );
+        for (unsigned int cycle=0; cycle<clusterLength_; ++cycle)
+        {
+            writeCbclFile( cycle );
+        }
+        tiles_.clear();
+    }
+
+    void CbclWriter::writeCbclFile( const unsigned int cycle ) const
+    {
+        string filename = (boost::format( filenameTemplate_) % (cycle+1)).str();
+        ofstream os( filename.c_str(), ios_base::binary );
+        if( !os.good() )
+        {
+            cerr << "Can't write to " << filename << endl;
+            BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
+        }
+
+        // Header
+        assert(sizeof(unsigned int) == 4);
+        const unsigned short version = 1;
+        const unsigned int headerSize = 2 + 4 + 1 + 1 + 4 + cbclQualityBinCount*8 + 4 + tiles_.size()*16 + 1;
+        const unsigned char bitsPerBasecall = 2, bitsPerQuality = 2;
+        const unsigned int binCount = cbclQualityBinCount;
+        const unsigned int tileCount = tiles_.size();
+        const unsigned char nonPfClustersExcluded = 0;
+        os.write( (const char*)&version, 2);
+        os.write( (const char*)&headerSize, 4);
+        os.write( (const char*)&bitsPerBasecall, 1);
+        os.write( (const char*)&bitsPerQuality, 1);
+        os.write( (const char*)&binCount, 4);
+        for (unsigned int bin=0; bin<cbclQualityBinCount; ++bin)
+        {
+            os.write( (const char*)&bin, 4);
+            os.write( (const char*)&cbclBinnedQualities[bin], 4);
+        }
+        os.write( (const char*)&tileCount, 4);
+        for (unsigned int i=0; i<tiles_.size(); ++i)
+        {
+            const unsigned int uncompressedBlockSize = (tiles_[i].clusterCount + 1) / 2;
+            const unsigned int compressedBlockSize = tiles_[i].compressedBlockPerCycle[cycle].size();
+            os.write( (const char*)&tiles_[i].tileId, 4);
+            os.write( (const char*)&tiles_[i].clusterCount, 4);
+            os.write( (const char*)&uncompressedBlockSize, 4);
+            os.write( (const char*)&compressedBlockSize, 4);
+        }
+        os.write( (const char*)&nonPfClustersExcluded, 1);
+
+        // Tile blocks, in the same order as in the header
+        for (unsigned int i=0; i<tiles_.size(); ++i)
+        {
+            const vector<char> &block = tiles_[i].compressedBlockPerCycle[cycle];
+            os.write( &block[0], block.size() );
+        }
+        if( !os.good() )
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Error writing " + filename ) );
+        }
+    }
+
+
+
+
     /*
 #include <boost/foreach.hpp>
 
@@ -14,7 +14,10 @@
 #include <cerrno>
 #include <boost/exception/all.hpp>
 #include <boost/format.hpp>
+#include "io/Bam.hh"
+#include "io/BgzfCompressor.hh"
 #include "io/Fastq.hh"
+#include "io/ParallelBgzfCompressor.hh"
 
 using namespace std;
 
@@ -25,13 +28,13 @@ namespace io
 {
 
 
-FastqTile::FastqTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const string &read1FastqFilename, const string &read2FastqFilename, const RunInfo &runInfo, const int lane, const unsigned int tileId, const bool verbose )
+FastqTile::FastqTile( const unsigned long long expectedReadCount, const unsigned int clusterLength, const string &read1FastqFilename, const string &read2FastqFilename, const RunInfo &runInfo, const int lane, const unsigned int tileId, const bool verbose, const int compressionLevel, const unsigned int compressionThreads )
         : expectedReadCount_ ( expectedReadCount )
         , clusterLength_     ( clusterLength )
         , read1FastqFilename_( read1FastqFilename )
         , read2FastqFilename_( read2FastqFilename )
-        , read1FastqFile_    ( read1FastqFilename.c_str() )
-        , read2FastqFile_    ( read2FastqFilename.c_str() )
+        , compressionLevel_  ( compressionLevel )
+        , compressionThreads_( compressionThreads )
         , infoFile_          ( (read1FastqFilename_ + ".info").c_str() )
         , readNamePrefix_    ( (boost::format("@EAGLE:%s:%s:%d:%04g:") % runInfo.runNumber % runInfo.flowcell % lane % tileId).str() ) // @HSQ1004:200:C0M7LACXX:1:1101:1187:2070 1:N:0:1
         , totalReadCount_    ( 0 )
@@ -42,34 +45,98 @@ FastqTile::FastqTile( const unsigned long long expectedReadCount, const unsigned
             clog << (boost::format("Creating new Fastq tile as (%s, %s), expecting %d reads") % read1FastqFilename % read2FastqFilename % expectedReadCount_).str() << endl;
         }
 
-        if( !read1FastqFile_.good() )
+        openFastqStream( read1FastqFilename, read1FastqFile_, read1Stream_ );
+        if( read2FastqFilename != "" )
         {
-            cerr << "Can't write to " << read1FastqFilename << endl;
-            BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
+            openFastqStream( read2FastqFilename, read2FastqFile_, read2Stream_ );
         }
 
-        if( read2FastqFilename != "" && !read2FastqFile_.good() )
+        if( !infoFile_.good() )
         {
-            cerr << "Can't write to " << read2FastqFilename << endl;
+            cerr << "Can't write to " << read1FastqFilename << ".info" << endl;
             BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
         }
 
-        if( !infoFile_.good() )
+        recordBuf_.reserve( readNamePrefix_.size() + 2 * clusterLength_ + 64 );
+   }
+
+    void FastqTile::openFastqStream( const string &filename, ofstream &file, boost::iostreams::filtering_ostream &stream )
+    {
+        file.open( filename.c_str(), ios_base::binary );
+        if( !file.good() )
         {
-            cerr << "Can't write to " << read1FastqFilename << ".info" << endl;
+            cerr << "Can't write to " << filename << endl;
             BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, "Cannot create file" ) );
         }
-   }
 
-    void FastqTile::addCluster( const string &read1Nucleotides, const string &read1Qualities, const string &read2Nucleotides, const string &read2Qualities, const bool isPassingFilter, const unsigned long coordX, const unsigned long coordY )
+        if (compressionLevel_ >= 0 && compressionThreads_ > 1)
+        {
+            stream.push( eagle::io::bam::ParallelBgzfCompressor( compressionLevel_, compressionThreads_ ) );
+        }
+        else if (compressionLevel_ >= 0)
+        {
+            stream.push( eagle::io::bam::BgzfCompressor( compressionLevel_ ) );
+        }
+        stream.push( file );
+    }
+
+    void FastqTile::closeFastqStream( ofstream &file, boost::iostreams::filtering_ostream &stream )
+    {
+        if (stream.empty())
+        {
+            return;
+        }
+        stream.pop();
+        if (compressionLevel_ >= 0)
+        {
+            io::serializeBgzfFooter( file );
+        }
+        file.close();
+    }
+
+    static void appendUnsigned( string &buf, unsigned long value )
     {
-        string readNamePart1 = readNamePrefix_ + (boost::format("%d:%d") % coordX % coordY).str();
+        char digits[20];
+        unsigned int digitCount = 0;
+        do
+        {
+            digits[digitCount++] = '0' + (value % 10);
+            value /= 10;
+        } while (value);
+        while (digitCount)
+        {
+            buf += digits[--digitCount];
+        }
+    }
+
+    void FastqTile::appendRecord( const char readNum, const string &nucleotides, const string &qualities, const bool isPassingFilter, const unsigned long coordX, const unsigned long coordY )
+    {
+        // @<prefix><x>:<y> <readNum>:<filtered>:0:1
+        recordBuf_ += readNamePrefix_;
+        appendUnsigned( recordBuf_, coordX );
+        recordBuf_ += ':';
+        appendUnsigned( recordBuf_, coordY );
+        recordBuf_ += ' ';
+        recordBuf_ += readNum;
+        recordBuf_ += isPassingFilter ? ":N:0:1\n" : ":Y:0:1\n";
+        recordBuf_ += nucleotides;
+        recordBuf_ += "\n+\n";
+        recordBuf_ += qualities;
+        recordBuf_ += '\n';
+    }
 
-        string read1Buf = readNamePart1 + " 1:" + (isPassingFilter?"N":"Y") + ":0:1\n" + read1Nucleotides + "\n+\n" + read1Qualities + "\n";
-        read1FastqFile_.write(read1Buf.c_str(), read1Buf.size());
+    void FastqTile::addCluster( const string &read1Nucleotides, const string &read1Qualities, const string &read2Nucleotides, const string &read2Qualities, const bool isPassingFilter, const unsigned long coordX, const unsigned long coordY )
+    {
+        recordBuf_.clear();
+        appendRecord( '1', read1Nucleotides, read1Qualities, isPassingFilter, coordX, coordY );
+        read1Stream_.write( recordBuf_.data(), recordBuf_.size() );
 
-        string read2Buf = readNamePart1 + " 2:" + (isPassingFilter?"N":"Y") + ":0:1\n" + read2Nucleotides + "\n+\n" + read2Qualities + "\n";
-        read2FastqFile_.write(read2Buf.c_str(), read2Buf.size());
+        if (!read2Stream_.empty())
+        {
+            recordBuf_.clear();
+            appendRecord( '2', read2Nucleotides, read2Qualities, isPassingFilter, coordX, coordY );
+            read2Stream_.write( recordBuf_.data(), recordBuf_.size() );
+        }
 
         totalReadCount_++;
         if (isPassingFilter)
@@ -80,8 +147,8 @@ FastqTile::FastqTile( const unsigned long long expectedReadCount, const unsigned
 
     void FastqTile::finaliseAndWriteInfo()
     {
-        read1FastqFile_.close();
-        read2FastqFile_.close();
+        closeFastqStream( read1FastqFile_, read1Stream_ );
+        closeFastqStream( read2FastqFile_, read2Stream_ );
 
         string info = (boost::format("TotalReadsRaw\t%lld\nTotalReadsPF\t%lld") % totalReadCount_ % passedFilterReadCount_).str();
         infoFile_.write( info.c_str(), info.length() );
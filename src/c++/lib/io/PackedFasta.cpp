@@ -0,0 +1,271 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Memory-mapped 2-bit representation of FASTA files.
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <algorithm>
+#include <cstring>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/PackedFasta.hh"
+
+
+namespace eagle
+{
+namespace io
+{
+
+
+PackedFastaWriter::PackedFastaWriter( const boost::filesystem::path& filename )
+    : filename_( filename )
+    , tmpFilename_( filename.string() + ".tmp" )
+    , out_( tmpFilename_.string().c_str(), std::ios::binary )
+    , currentByte_( 0 )
+    , contigStarted_( false )
+{
+    if (!out_.good())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Cannot create file %s") % tmpFilename_).str() ) );
+    }
+    writeUnsignedLong( MAGIC );
+    writeUnsignedLong( VERSION );
+    writeUnsignedLong( 0 ); // footer offset, updated by close()
+}
+
+void PackedFastaWriter::beginContig( const std::string& name )
+{
+    assert( !contigStarted_ );
+    ContigEntry entry;
+    entry.name = name;
+    entry.size = 0;
+    entry.basesOffset = out_.tellp();
+    contigs_.push_back( entry );
+    exceptions_.clear();
+    masks_.clear();
+    currentByte_ = 0;
+    contigStarted_ = true;
+}
+
+void PackedFastaWriter::add( const char *bases, const unsigned long count )
+{
+    assert( contigStarted_ );
+    unsigned long &pos = contigs_.back().size;
+    for (unsigned long i=0; i<count; ++i, ++pos)
+    {
+        const char base = bases[i];
+        const char upperBase = toupper( base );
+        unsigned char code = 0;
+        switch (upperBase)
+        {
+        case 'A': code = 0; break;
+        case 'C': code = 1; break;
+        case 'G': code = 2; break;
+        case 'T': code = 3; break;
+        default:
+            if (!exceptions_.empty() && exceptions_.back().base == upperBase && exceptions_.back().start + exceptions_.back().length == pos)
+            {
+                ++exceptions_.back().length;
+            }
+            else
+            {
+                PackedFastaException exception;
+                memset( &exception, 0, sizeof(exception) );
+                exception.start = pos;
+                exception.length = 1;
+                exception.base = upperBase;
+                exceptions_.push_back( exception );
+            }
+        }
+        if (base != upperBase)
+        {
+            if (!masks_.empty() && masks_.back().start + masks_.back().length == pos)
+            {
+                ++masks_.back().length;
+            }
+            else
+            {
+                PackedFastaMask mask;
+                mask.start = pos;
+                mask.length = 1;
+                masks_.push_back( mask );
+            }
+        }
+
+        currentByte_ |= code << ((pos & 3) << 1);
+        if ((pos & 3) == 3)
+        {
+            out_.put( currentByte_ );
+            currentByte_ = 0;
+        }
+    }
+}
+
+void PackedFastaWriter::endContig()
+{
+    assert( contigStarted_ );
+    ContigEntry &entry = contigs_.back();
+    if (entry.size & 3)
+    {
+        out_.put( currentByte_ );
+    }
+    align();
+
+    entry.exceptionCount = exceptions_.size();
+    entry.exceptionOffset = out_.tellp();
+    if (!exceptions_.empty())
+    {
+        out_.write( (const char*)&exceptions_[0], exceptions_.size() * sizeof(PackedFastaException) );
+    }
+    entry.maskCount = masks_.size();
+    entry.maskOffset = out_.tellp();
+    if (!masks_.empty())
+    {
+        out_.write( (const char*)&masks_[0], masks_.size() * sizeof(PackedFastaMask) );
+    }
+    contigStarted_ = false;
+}
+
+void PackedFastaWriter::close()
+{
+    assert( !contigStarted_ );
+    const unsigned long footerOffset = out_.tellp();
+    writeUnsignedLong( contigs_.size() );
+    for (std::vector< ContigEntry >::const_iterator it = contigs_.begin(); it != contigs_.end(); ++it)
+    {
+        writeUnsignedLong( it->name.size() );
+        out_.write( it->name.c_str(), it->name.size() );
+        align();
+        writeUnsignedLong( it->size );
+        writeUnsignedLong( it->basesOffset );
+        writeUnsignedLong( it->exceptionCount );
+        writeUnsignedLong( it->exceptionOffset );
+        writeUnsignedLong( it->maskCount );
+        writeUnsignedLong( it->maskOffset );
+    }
+    out_.seekp( 2 * sizeof(unsigned long) );
+    writeUnsignedLong( footerOffset );
+    out_.close();
+    if (out_.fail())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to write %s") % tmpFilename_).str() ) );
+    }
+
+    // Only make the file visible once complete, as other processes may be waiting for it
+    boost::filesystem::rename( tmpFilename_, filename_ );
+}
+
+void PackedFastaWriter::align()
+{
+    static const char zeros[sizeof(unsigned long)] = {0};
+    const unsigned long pos = out_.tellp();
+    if (pos % sizeof(unsigned long))
+    {
+        out_.write( zeros, sizeof(unsigned long) - pos % sizeof(unsigned long) );
+    }
+}
+
+bool PackedFastaWriter::isUpToDate( const boost::filesystem::path& fastaPath )
+{
+    const boost::filesystem::path packedPath = packedFilename( fastaPath );
+    return boost::filesystem::exists( packedPath )
+        && boost::filesystem::last_write_time( packedPath ) >= boost::filesystem::last_write_time( fastaPath );
+}
+
+
+PackedFastaReader::PackedFastaReader( const boost::filesystem::path& filename )
+{
+    try
+    {
+        file_.open( filename.string() );
+    }
+    catch (const std::exception &e)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to memory-map %s: %s") % filename % e.what()).str() ) );
+    }
+    const unsigned long *header = reinterpret_cast<const unsigned long *>( file_.data() );
+    if (file_.size() < 4 * sizeof(unsigned long) || header[0] != PackedFastaWriter::MAGIC)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "packed FASTA", (boost::format("%s is not a packed FASTA file") % filename).str() ) );
+    }
+    if (header[1] != PackedFastaWriter::VERSION)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::UnsupportedVersionException( (boost::format("%s: unsupported packed FASTA version %d") % filename % header[1]).str() ) );
+    }
+
+    const char *base = file_.data();
+    const unsigned long *footer = reinterpret_cast<const unsigned long *>( base + header[2] );
+    const unsigned long contigCount = *footer++;
+    for (unsigned long i=0; i<contigCount; ++i)
+    {
+        PackedFastaContig contig;
+        const unsigned long nameLength = *footer++;
+        contig.name = std::string( reinterpret_cast<const char *>( footer ), nameLength );
+        footer += (nameLength + sizeof(unsigned long) - 1) / sizeof(unsigned long);
+        contig.size           = footer[0];
+        contig.bases          = reinterpret_cast<const unsigned char *>( base + footer[1] );
+        contig.exceptionCount = footer[2];
+        contig.exceptions     = reinterpret_cast<const PackedFastaException *>( base + footer[3] );
+        contig.maskCount      = footer[4];
+        contig.masks          = reinterpret_cast<const PackedFastaMask *>( base + footer[5] );
+        footer += 6;
+        contigs_.push_back( contig );
+        // insert() keeps the first contig of a given name
+        contigIndexByName_.insert( std::make_pair( contig.name, contigs_.size() - 1 ) );
+    }
+}
+
+int PackedFastaReader::findContig( const std::string& name ) const
+{
+    boost::unordered_map< std::string, unsigned int >::const_iterator it = contigIndexByName_.find( name );
+    return (it != contigIndexByName_.end()) ? int(it->second) : -1;
+}
+
+
+namespace
+{
+
+template< class Run >
+bool startsAfter( const unsigned long pos, const Run &run )
+{
+    return pos < run.start;
+}
+
+// Returns the run containing pos, if any. 'cursor' is the index of the first run starting after pos
+template< class Run >
+const Run *findRun( const Run *runs, const unsigned long runCount, const unsigned long pos, unsigned long &cursor )
+{
+    if ( (cursor > 0 && pos < runs[cursor-1].start)
+         || (cursor < runCount && pos >= runs[cursor].start) )
+    {
+        cursor = std::upper_bound( runs, runs + runCount, pos, startsAfter<Run> ) - runs;
+    }
+    if (cursor > 0 && pos < runs[cursor-1].start + runs[cursor-1].length)
+    {
+        return &runs[cursor-1];
+    }
+    return 0;
+}
+
+} // anonymous namespace
+
+
+const PackedFastaException *PackedFastaReader::findException( const PackedFastaContig& contig, const unsigned long pos, unsigned long& cursor )
+{
+    return findRun( contig.exceptions, contig.exceptionCount, pos, cursor );
+}
+
+bool PackedFastaReader::isMasked( const PackedFastaContig& contig, const unsigned long pos, unsigned long& cursor )
+{
+    return findRun( contig.masks, contig.maskCount, pos, cursor ) != 0;
+}
+
+
+} // namespace io
+} // namespace eagle
@@ -0,0 +1,218 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description multi-threaded bgzf filtering stream: the uncompressed data is cut into
+ ** bgzf blocks, which are deflated by a pool of worker threads and written out in order.
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <zlib.h>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/ParallelBgzfCompressor.hh"
+
+
+namespace eagle
+{
+namespace io
+{
+namespace bam
+{
+
+
+namespace
+{
+
+const unsigned int BGZF_HEADER_SIZE = 18;
+const unsigned int BGZF_FOOTER_SIZE = 8;
+const unsigned int BGZF_MAX_BLOCK_SIZE = 0x10000;
+
+void putLittleEndian( std::vector<char> &buffer, const unsigned int offset, unsigned int value, const unsigned int byteCount )
+{
+    for (unsigned int i=0; i<byteCount; ++i, value >>= 8)
+    {
+        buffer[offset + i] = value & 0xff;
+    }
+}
+
+/**
+ ** \brief Deflates 'uncompressed' into a complete bgzf block (gzip member with the 'BC' extra field)
+ **
+ ** \param stream raw deflate stream, reset before use so that each worker can keep its own
+ **/
+void compressBgzfBlock( z_stream &stream, const std::vector<char> &uncompressed, std::vector<char> &bgzf )
+{
+    static const unsigned char header[BGZF_HEADER_SIZE] =
+        { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0 };
+
+    bgzf.resize( BGZF_MAX_BLOCK_SIZE );
+    std::copy( header, header + BGZF_HEADER_SIZE, bgzf.begin() );
+
+    if (deflateReset( &stream ) != Z_OK)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::EagleException( 0, "bgzf compression: failed to reset deflate stream" ) );
+    }
+    stream.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( &uncompressed[0] ) );
+    stream.avail_in = uncompressed.size();
+    stream.next_out = reinterpret_cast<Bytef*>( &bgzf[BGZF_HEADER_SIZE] );
+    stream.avail_out = BGZF_MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+    const int status = deflate( &stream, Z_FINISH );
+    if (status != Z_STREAM_END)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::EagleException( 0, (boost::format("bgzf compression: deflate failed (status %d)") % status).str() ) );
+    }
+
+    const unsigned int blockSize = BGZF_HEADER_SIZE + stream.total_out + BGZF_FOOTER_SIZE;
+    bgzf.resize( blockSize );
+    putLittleEndian( bgzf, 16, blockSize - 1, 2 );
+    const uLong crc = crc32( crc32( 0, Z_NULL, 0 ), reinterpret_cast<const Bytef*>( &uncompressed[0] ), uncompressed.size() );
+    putLittleEndian( bgzf, blockSize - 8, crc, 4 );
+    putLittleEndian( bgzf, blockSize - 4, uncompressed.size(), 4 );
+}
+
+} // anonymous namespace
+
+
+BgzfBlockQueue::BgzfBlockQueue(const int compressionLevel, const unsigned int threadCount)
+    : compressionLevel_( compressionLevel )
+    , blocks_( 4 * threadCount )
+    , submitted_( 0 )
+    , nextToCompress_( 0 )
+    , collected_( 0 )
+    , stopping_( false )
+{
+    for (unsigned int i=0; i<blocks_.size(); ++i)
+    {
+        blocks_[i].uncompressed.reserve( ParallelBgzfCompressor::max_uncompressed_per_block_ );
+        blocks_[i].bgzf.reserve( BGZF_MAX_BLOCK_SIZE );
+    }
+    for (unsigned int i=0; i<threadCount; ++i)
+    {
+        workers_.create_thread( boost::bind( &BgzfBlockQueue::compressBlocks, this ) );
+    }
+}
+
+BgzfBlockQueue::~BgzfBlockQueue()
+{
+    {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        stopping_ = true;
+    }
+    blockSubmitted_.notify_all();
+    workers_.join_all();
+}
+
+void BgzfBlockQueue::submitFillingBlock()
+{
+    {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        ++submitted_;
+    }
+    blockSubmitted_.notify_one();
+}
+
+const std::vector<char> *BgzfBlockQueue::oldestCompressedBlock(const bool wait)
+{
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    if (collected_ == submitted_)
+    {
+        return 0;
+    }
+    Block &block = blocks_[collected_ % blocks_.size()];
+    while (wait && !block.compressed && !workerException_)
+    {
+        blockCompressed_.wait( lock );
+    }
+    if (workerException_)
+    {
+        boost::rethrow_exception( workerException_ );
+    }
+    return block.compressed ? &block.bgzf : 0;
+}
+
+void BgzfBlockQueue::releaseOldestBlock()
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    Block &block = blocks_[collected_ % blocks_.size()];
+    block.uncompressed.clear();
+    block.compressed = false;
+    ++collected_;
+}
+
+void BgzfBlockQueue::compressBlocks()
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2( &stream, compressionLevel_, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK)
+    {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        try
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::EagleException( 0, (boost::format("bgzf compression: invalid compression level %d") % compressionLevel_).str() ) );
+        }
+        catch (...)
+        {
+            workerException_ = boost::current_exception();
+        }
+        blockCompressed_.notify_all();
+        return;
+    }
+
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    while (true)
+    {
+        while (nextToCompress_ == submitted_ && !stopping_)
+        {
+            blockSubmitted_.wait( lock );
+        }
+        if (nextToCompress_ == submitted_ || workerException_)
+        {
+            break;
+        }
+        Block &block = blocks_[nextToCompress_++ % blocks_.size()];
+
+        // The writing thread doesn't touch a submitted block until it is flagged as compressed
+        lock.unlock();
+        try
+        {
+            compressBgzfBlock( stream, block.uncompressed, block.bgzf );
+        }
+        catch (...)
+        {
+            lock.lock();
+            workerException_ = boost::current_exception();
+            blockCompressed_.notify_all();
+            break;
+        }
+        lock.lock();
+        block.compressed = true;
+        blockCompressed_.notify_all();
+    }
+    deflateEnd( &stream );
+}
+
+
+ParallelBgzfCompressor::ParallelBgzfCompressor(const int compressionLevel, const unsigned int threadCount)
+    : compressionLevel_( compressionLevel )
+    , threadCount_( std::max( threadCount, 1u ) )
+{
+}
+
+ParallelBgzfCompressor::ParallelBgzfCompressor(const ParallelBgzfCompressor& that)
+    : compressionLevel_( that.compressionLevel_ )
+    , threadCount_( that.threadCount_ )
+{
+}
+
+
+} // namespace bam
+} // namespace io
+} // namespace eagle
@@ -0,0 +1,171 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "testBamConcatenator.hh"
+#include "common/Exceptions.hh"
+#include "io/Bam.hh"
+#include "io/BamIndexer.hh"
+#include "io/BgzfCompressor.hh"
+
+using eagle::io::bam::concatenateBams;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBamConcatenator, registryName("BamConcatenator"));
+
+
+namespace
+{
+
+typedef pair<int, int> RefIdAndPos;
+
+// Header without text, with 2 references of 100kb
+void serializeHeader( ostream &os )
+{
+    const char magic[] = "BAM\1";
+    os.write( magic, 4 );
+    eagle::io::serialize( os, 0 );
+    eagle::io::serialize( os, 2 );
+    eagle::io::serialize( os, 3 );
+    eagle::io::serialize( os, "c1" );
+    eagle::io::serialize( os, 100000 );
+    eagle::io::serialize( os, 3 );
+    eagle::io::serialize( os, "c2" );
+    eagle::io::serialize( os, 100000 );
+}
+
+// Mapped single-base read named "r", without CIGAR
+void serializeAlignment( ostream &os, const RefIdAndPos &alignment )
+{
+    const unsigned int bin = eagle::io::bam_reg2bin( alignment.second, alignment.second + 1 );
+    eagle::io::serialize( os, 32 + 2 + 1 + 1 ); // fixed fields, name, seq, qual
+    eagle::io::serialize( os, alignment.first );
+    eagle::io::serialize( os, alignment.second );
+    eagle::io::serialize( os, bin << 16 | 50 << 8 | 2 );
+    eagle::io::serialize( os, 0 );
+    eagle::io::serialize( os, 1 );
+    eagle::io::serialize( os, -1 );
+    eagle::io::serialize( os, -1 );
+    eagle::io::serialize( os, 0 );
+    eagle::io::serialize( os, "r" );
+    eagle::io::serialize( os, '\x10' );
+    eagle::io::serialize( os, '\x1e' );
+}
+
+/**
+ ** \brief Writes an indexed BAM file the way BamOrMetadataOutput does
+ **
+ ** \param flushHeader if true, the header gets BGZF blocks of its own. So does each reference, always
+ **/
+void writeBam( const boost::filesystem::path &bamPath, const vector<RefIdAndPos> &alignments, const bool flushHeader = true )
+{
+    boost::iostreams::filtering_ostream bamStream;
+    bamStream.push( boost::iostreams::file_sink( bamPath.string() ) );
+    {
+        boost::iostreams::filtering_ostream bgzfStream;
+        bgzfStream.push( eagle::io::bam::BgzfCompressor( boost::iostreams::gzip_params( 1 ) ) );
+        boost::iostreams::file_sink baiSink( bamPath.string() + ".bai" );
+        bgzfStream.push( eagle::io::bam::BamIndexer<boost::iostreams::file_sink>( baiSink ) );
+        bgzfStream.push( bamStream );
+
+        serializeHeader( bgzfStream );
+        if (flushHeader)
+        {
+            bgzfStream.flush();
+        }
+        for (unsigned int i=0; i<alignments.size(); ++i)
+        {
+            if (i && alignments[i].first != alignments[i-1].first)
+            {
+                bgzfStream.flush();
+            }
+            serializeAlignment( bgzfStream, alignments[i] );
+        }
+        bgzfStream.pop();
+    }
+    eagle::io::serializeBgzfFooter( bamStream );
+}
+
+string readFile( const boost::filesystem::path &path )
+{
+    ifstream is( path.string().c_str(), ios_base::binary );
+    return string( istreambuf_iterator<char>( is ), istreambuf_iterator<char>() );
+}
+
+} // anonymous namespace
+
+
+void TestBamConcatenator::setUp()
+{
+    dir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir_ );
+}
+
+void TestBamConcatenator::tearDown()
+{
+    boost::filesystem::remove_all( dir_ );
+}
+
+
+void TestBamConcatenator::testConcatenation()
+{
+    // Enough reads for several BGZF blocks and linear index windows per reference
+    vector<RefIdAndPos> alignments1, alignments2;
+    for (int pos = 100; pos < 60000; pos += 7)
+    {
+        alignments1.push_back( make_pair( 0, pos ) );
+        alignments2.push_back( make_pair( 1, pos + 20000 ) );
+    }
+    vector<RefIdAndPos> allAlignments( alignments1 );
+    allAlignments.insert( allAlignments.end(), alignments2.begin(), alignments2.end() );
+
+    vector<boost::filesystem::path> parts;
+    parts.push_back( dir_ / "part1.bam" );
+    parts.push_back( dir_ / "part2.bam" );
+    writeBam( parts[0], alignments1 );
+    writeBam( parts[1], alignments2 );
+    writeBam( dir_ / "expected.bam", allAlignments );
+
+    concatenateBams( parts, dir_ / "merged.bam" );
+
+    // Same blocks as a BAM written in one go, so the same index as well
+    CPPUNIT_ASSERT( readFile( dir_ / "merged.bam" ) == readFile( dir_ / "expected.bam" ) );
+    CPPUNIT_ASSERT( readFile( dir_ / "merged.bam.bai" ) == readFile( dir_ / "expected.bam.bai" ) );
+}
+
+void TestBamConcatenator::testHeaderSharingBlock()
+{
+    vector<boost::filesystem::path> parts( 1, dir_ / "part.bam" );
+    writeBam( parts[0], vector<RefIdAndPos>( 1, make_pair( 0, 100 ) ), false );
+
+    CPPUNIT_ASSERT_THROW( concatenateBams( parts, dir_ / "merged.bam" ), eagle::common::CorruptedFileException );
+}
+
+void TestBamConcatenator::testMissingEofBlock()
+{
+    // Enough alignments for the last block to be at least as large as the BGZF end-of-file block
+    vector<RefIdAndPos> alignments;
+    for (int pos = 100; pos < 1000; ++pos)
+    {
+        alignments.push_back( make_pair( 0, pos ) );
+    }
+    vector<boost::filesystem::path> parts( 1, dir_ / "part.bam" );
+    writeBam( parts[0], alignments );
+    boost::filesystem::resize_file( parts[0], boost::filesystem::file_size( parts[0] ) - 28 );
+
+    CPPUNIT_ASSERT_THROW( concatenateBams( parts, dir_ / "merged.bam" ), eagle::common::CorruptedFileException );
+}
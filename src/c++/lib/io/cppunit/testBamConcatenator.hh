@@ -0,0 +1,33 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_IO_TEST_BAM_CONCATENATOR_HH
+#define EAGLE_IO_TEST_BAM_CONCATENATOR_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "io/BamConcatenator.hh"
+
+
+class TestBamConcatenator : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBamConcatenator );
+    CPPUNIT_TEST( testConcatenation );
+    CPPUNIT_TEST( testHeaderSharingBlock );
+    CPPUNIT_TEST( testMissingEofBlock );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path dir_;
+public:
+    void setUp();
+    void tearDown();
+    void testConcatenation();
+    void testHeaderSharingBlock();
+    void testMissingEofBlock();
+};
+
+#endif //EAGLE_IO_TEST_BAM_CONCATENATOR_HH
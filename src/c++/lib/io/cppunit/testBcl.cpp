@@ -5,10 +5,19 @@
  ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
  **/
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <boost/assign.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 
 using namespace std;
 using boost::assign::list_of;
@@ -19,6 +28,7 @@ using boost::assign::list_of;
 #include "testBcl.hh"
 
 using eagle::io::BclTile;
+using eagle::io::CbclWriter;
 
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBcl, registryName("Bcl"));
 
@@ -56,3 +66,106 @@ void TestBcl::testBclTile()
     // Test that we cannot overfill it
     CPPUNIT_ASSERT_THROW( tile.addClusterToRandomLocation( bufCluster ), eagle::common::OutOfLimitsException ); // too many clusters added to tile
 }
+
+void TestBcl::testCbclBlock()
+{
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)0, CbclWriter::getQualityBin( 0 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)1, CbclWriter::getQualityBin( 1 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)1, CbclWriter::getQualityBin( 2 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)1, CbclWriter::getQualityBin( 14 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)2, CbclWriter::getQualityBin( 15 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)2, CbclWriter::getQualityBin( 30 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)3, CbclWriter::getQualityBin( 31 ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned char)3, CbclWriter::getQualityBin( 41 ) );
+
+    // 3 clusters of 2 cycles: {A/Q40, no-call}, {C/Q10, G/Q20}, {T/Q2, A/Q35}
+    BclTile tile( 3, 2, "", "", "", "", "", false, eagle::io::BCL_FORMAT_CBCL );
+    const unsigned char clusters[3][2] = { { 0 | (40<<2), 0 }, { 1 | (10<<2), 2 | (20<<2) }, { 3 | (2<<2), 0 | (35<<2) } };
+    for (unsigned int i=0; i<3; ++i)
+    {
+        tile.addClusterToRandomLocation( reinterpret_cast<const char *>( clusters[i] ) );
+    }
+
+    // Each cycle is stored as 4 bits per cluster {qualityBin:2, base:2}, the first cluster in the low nibble.
+    // Only the no-call gets bin 0: T/Q2 is a called base, in bin 1
+    const unsigned char expectedBlocks[2][2] = { { 0xC | (0x5 << 4), 0x7 }, { 0x0 | (0xA << 4), 0xC } };
+    for (unsigned int cycle=0; cycle<2; ++cycle)
+    {
+        vector<char> compressedBlock;
+        tile.getCompressedCbclBlock( cycle, compressedBlock );
+
+        vector<char> block;
+        boost::iostreams::filtering_istream gunzipStream;
+        gunzipStream.push( boost::iostreams::gzip_decompressor() );
+        gunzipStream.push( boost::iostreams::array_source( &compressedBlock[0], compressedBlock.size() ) );
+        boost::iostreams::copy( gunzipStream, boost::iostreams::back_inserter( block ) );
+
+        CPPUNIT_ASSERT_EQUAL( (size_t)2, block.size() );
+        CPPUNIT_ASSERT_EQUAL( expectedBlocks[cycle][0], (unsigned char)block[0] );
+        CPPUNIT_ASSERT_EQUAL( expectedBlocks[cycle][1], (unsigned char)block[1] );
+    }
+}
+
+void TestBcl::testStreamingBclTile()
+{
+    // 5 clusters of 3 cycles, streamed by blocks of 2 clusters, with the last cluster missing
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir );
+    const string filenameTemplate = (dir / "C%d.bcl").string();
+    {
+        BclTile tile( 5, 3, filenameTemplate, (dir / "C%d.stats").string(), (dir / "s.filter").string(), (dir / "s.clocs").string(), (dir / "s.control").string(), false, eagle::io::BCL_FORMAT_BCL, 2 );
+        const char clusters[4][3] = { { 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 }, { 10, 11, 12 } };
+        for (unsigned int i=0; i<4; ++i)
+        {
+            tile.addClusterToRandomLocation( clusters[i] );
+        }
+        tile.flushToDisk();
+    }
+
+    // Each cycle file has the usual 4-byte cluster count header, then one byte per cluster, the missing one as a no-call
+    for (unsigned int cycle=0; cycle<3; ++cycle)
+    {
+        ifstream is( (dir / (boost::format("C%d.bcl") % (cycle+1)).str()).string().c_str(), ios_base::binary );
+        const vector<char> content( (istreambuf_iterator<char>( is )), istreambuf_iterator<char>() );
+        CPPUNIT_ASSERT_EQUAL( (size_t)9, content.size() );
+        CPPUNIT_ASSERT_EQUAL( (char)5, content[0] );
+        CPPUNIT_ASSERT_EQUAL( (char)0, content[1] );
+        for (unsigned int i=0; i<4; ++i)
+        {
+            CPPUNIT_ASSERT_EQUAL( (char)(1 + cycle + 3*i), content[4+i] );
+        }
+        CPPUNIT_ASSERT_EQUAL( (char)0, content[8] );
+    }
+    boost::filesystem::remove_all( dir );
+}
+
+void TestBcl::testAddClusters()
+{
+    // 5 clusters of 3 cycles, added as 2 cycle-major blocks of 3 and 2 clusters, streamed by blocks of 2 clusters
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir );
+    const string filenameTemplate = (dir / "C%d.bcl").string();
+    {
+        BclTile tile( 5, 3, filenameTemplate, (dir / "C%d.stats").string(), (dir / "s.filter").string(), (dir / "s.clocs").string(), (dir / "s.control").string(), false, eagle::io::BCL_FORMAT_BCL, 2 );
+        const char block1[3*3] = { 1, 4, 7,   2, 5, 8,   3, 6, 9 };
+        const char block2[3*2] = { 10, 13,   11, 14,   12, 15 };
+        tile.addClusters( block1, 3, vector<char>( 3, 1 ) );
+        tile.addClusters( block2, 2, vector<char>( 2, 1 ) );
+        CPPUNIT_ASSERT_THROW( tile.addClusters( block2, 1, vector<char>( 1, 1 ) ), eagle::common::OutOfLimitsException );
+        tile.flushToDisk();
+    }
+
+    // Same files as when adding the clusters one by one
+    for (unsigned int cycle=0; cycle<3; ++cycle)
+    {
+        ifstream is( (dir / (boost::format("C%d.bcl") % (cycle+1)).str()).string().c_str(), ios_base::binary );
+        const vector<char> content( (istreambuf_iterator<char>( is )), istreambuf_iterator<char>() );
+        CPPUNIT_ASSERT_EQUAL( (size_t)9, content.size() );
+        CPPUNIT_ASSERT_EQUAL( (char)5, content[0] );
+        for (unsigned int i=0; i<5; ++i)
+        {
+            CPPUNIT_ASSERT_EQUAL( (char)(1 + cycle + 3*i), content[4+i] );
+        }
+    }
+    boost::filesystem::remove_all( dir );
+}
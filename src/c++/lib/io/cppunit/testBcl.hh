@@ -17,12 +17,18 @@ class TestBcl : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE( TestBcl );
     CPPUNIT_TEST( testBclTile );
+    CPPUNIT_TEST( testCbclBlock );
+    CPPUNIT_TEST( testStreamingBclTile );
+    CPPUNIT_TEST( testAddClusters );
     CPPUNIT_TEST_SUITE_END();
 private:
 public:
     void setUp();
     void tearDown();
     void testBclTile();
+    void testCbclBlock();
+    void testStreamingBclTile();
+    void testAddClusters();
 };
 
 #endif //EAGLE_MODEL_TEST_BCL_HH
@@ -0,0 +1,71 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <iostream>
+#include <string>
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "testPackedFasta.hh"
+
+using eagle::io::PackedFastaCursor;
+using eagle::io::PackedFastaReader;
+using eagle::io::PackedFastaWriter;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestPackedFasta, registryName("PackedFasta"));
+
+
+void TestPackedFasta::setUp()
+{
+}
+
+void TestPackedFasta::tearDown()
+{
+}
+
+
+void TestPackedFasta::testRoundTrip()
+{
+    const boost::filesystem::path filename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "testPackedFasta-%%%%-%%%%.packed" );
+    const string contig1 = "ACGTNNNNacgtnnRYACGTAcgTTTTTTTTTTTTTTTTTTGA";
+    const string contig2 = "GATTACA";
+
+    PackedFastaWriter writer( filename );
+    writer.beginContig( "chr1" );
+    writer.add( contig1.c_str(), 10 );
+    writer.add( contig1.c_str() + 10, contig1.size() - 10 );
+    writer.endContig();
+    writer.beginContig( "chr2" );
+    writer.add( contig2.c_str(), contig2.size() );
+    writer.endContig();
+    writer.close();
+
+    PackedFastaReader reader( filename );
+    CPPUNIT_ASSERT_EQUAL( 2u, reader.contigCount() );
+    CPPUNIT_ASSERT_EQUAL( 1, reader.findContig( "chr2" ) );
+    CPPUNIT_ASSERT_EQUAL( -1, reader.findContig( "chr3" ) );
+    CPPUNIT_ASSERT_EQUAL( (unsigned long)contig1.size(), reader.contig( 0 ).size );
+
+    // Sequential access, as well as random access that needs to move the run cursors backwards
+    PackedFastaCursor cursor1, cursor2;
+    for (unsigned long i=0; i<contig1.size(); ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL( contig1[i], reader.get( 0, i, cursor1 ) );
+    }
+    for (unsigned long i=contig1.size(); i>0; --i)
+    {
+        CPPUNIT_ASSERT_EQUAL( contig1[i-1], reader.get( 0, i-1, cursor1 ) );
+    }
+    for (unsigned long i=0; i<contig2.size(); ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL( contig2[i], reader.get( 1, i, cursor2 ) );
+    }
+
+    boost::filesystem::remove( filename );
+}
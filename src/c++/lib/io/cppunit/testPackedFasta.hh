@@ -0,0 +1,28 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_IO_TEST_PACKED_FASTA_HH
+#define EAGLE_IO_TEST_PACKED_FASTA_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "io/PackedFasta.hh"
+
+
+class TestPackedFasta : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestPackedFasta );
+    CPPUNIT_TEST( testRoundTrip );
+    CPPUNIT_TEST_SUITE_END();
+private:
+public:
+    void setUp();
+    void tearDown();
+    void testRoundTrip();
+};
+
+#endif //EAGLE_IO_TEST_PACKED_FASTA_HH
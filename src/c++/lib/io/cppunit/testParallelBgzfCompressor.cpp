@@ -0,0 +1,393 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+using namespace std;
+
+#include "RegistryName.hh"
+#include "testParallelBgzfCompressor.hh"
+#include "io/Bam.hh"
+#include "io/BamIndexer.hh"
+#include "io/BgzfCompressor.hh"
+
+using eagle::io::bam::ParallelBgzfCompressor;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestParallelBgzfCompressor, registryName("ParallelBgzfCompressor"));
+
+
+namespace
+{
+
+typedef boost::iostreams::back_insert_device< vector<char> > VectorSink;
+
+// Samtools' pseudo-bin, whose 2 "chunks" are {first offset, last offset} and {mapped count, unmapped count}
+const unsigned int BAI_PSEUDO_BIN = 37450;
+const int REFERENCE_LENGTH = 2000000;
+const unsigned int READ_LENGTH = 100;
+
+// Where a bgzf block is in the compressed stream, and where its content is in the uncompressed one
+struct BgzfBlock
+{
+    unsigned long long compressedOffset;
+    unsigned int compressedSize;
+    size_t uncompressedOffset;
+    size_t uncompressedSize;
+};
+
+/**
+ ** \brief Inflates 'bgzf' block by block, checking that each block is a complete gzip member with a correct BSIZE field
+ **/
+string inflateBgzf( vector<char> &bgzf, vector<BgzfBlock> &blocks )
+{
+    string decompressed;
+    blocks.clear();
+    for (unsigned int pos = 0; pos < bgzf.size(); )
+    {
+        CPPUNIT_ASSERT( pos + 18 <= bgzf.size() );
+        CPPUNIT_ASSERT_EQUAL( 31, (int)(unsigned char)bgzf[pos] );
+        CPPUNIT_ASSERT_EQUAL( 'B', bgzf[pos + 12] );
+        CPPUNIT_ASSERT_EQUAL( 'C', bgzf[pos + 13] );
+        const unsigned int blockSize = (unsigned char)bgzf[pos + 16] + ((unsigned char)bgzf[pos + 17] << 8) + 1;
+
+        vector<char> block( 0x10000 );
+        z_stream stream = z_stream();
+        CPPUNIT_ASSERT_EQUAL( Z_OK, inflateInit2( &stream, 15 + 16 ) );
+        stream.next_in = reinterpret_cast<Bytef*>( &bgzf[pos] );
+        stream.avail_in = blockSize;
+        stream.next_out = reinterpret_cast<Bytef*>( &block[0] );
+        stream.avail_out = block.size();
+        CPPUNIT_ASSERT_EQUAL( Z_STREAM_END, inflate( &stream, Z_FINISH ) );
+        CPPUNIT_ASSERT_EQUAL( 0u, stream.avail_in );
+        const BgzfBlock bgzfBlock = { pos, blockSize, decompressed.size(), stream.total_out };
+        blocks.push_back( bgzfBlock );
+        decompressed.append( &block[0], stream.total_out );
+        inflateEnd( &stream );
+        pos += blockSize;
+    }
+    return decompressed;
+}
+
+/**
+ ** \brief Position in the uncompressed stream of a BAM index virtual offset
+ **
+ ** The compressed part of the virtual offset must be the start of one of 'blocks', or the end of the last one
+ **/
+size_t resolveVirtualOffset( const vector<BgzfBlock> &blocks, const unsigned long long virtualOffset )
+{
+    const unsigned long long compressedOffset = virtualOffset >> 16;
+    const size_t uncompressedOffset = virtualOffset & 0xFFFF;
+    BOOST_FOREACH( const BgzfBlock &block, blocks )
+    {
+        if (block.compressedOffset == compressedOffset)
+        {
+            CPPUNIT_ASSERT( uncompressedOffset <= block.uncompressedSize );
+            return block.uncompressedOffset + uncompressedOffset;
+        }
+    }
+    CPPUNIT_ASSERT( !blocks.empty() && uncompressedOffset == 0 && compressedOffset == blocks.back().compressedOffset + blocks.back().compressedSize );
+    return blocks.back().uncompressedOffset + blocks.back().uncompressedSize;
+}
+
+// Index of one reference: chunk virtual offsets of each bin, then the linear index
+struct BaiReference
+{
+    map< unsigned int, vector<unsigned long long> > bins;
+    vector<unsigned long long> linearIndex;
+};
+
+template <typename T>
+T readBai( const vector<char> &bai, size_t &pos )
+{
+    CPPUNIT_ASSERT( pos + sizeof(T) <= bai.size() );
+    T value;
+    memcpy( &value, &bai[pos], sizeof(T) );
+    pos += sizeof(T);
+    return value;
+}
+
+vector<BaiReference> parseBai( const vector<char> &bai )
+{
+    CPPUNIT_ASSERT( bai.size() >= 8 && string( &bai[0], 4 ) == "BAI\1" );
+    size_t pos = 4;
+    vector<BaiReference> references( readBai<int>( bai, pos ) );
+    BOOST_FOREACH( BaiReference &reference, references )
+    {
+        const int binCount = readBai<int>( bai, pos );
+        for (int i=0; i<binCount; ++i)
+        {
+            vector<unsigned long long> &chunks = reference.bins[readBai<unsigned int>( bai, pos )];
+            chunks.resize( 2 * readBai<int>( bai, pos ) );
+            BOOST_FOREACH( unsigned long long &offset, chunks )
+            {
+                offset = readBai<unsigned long long>( bai, pos );
+            }
+        }
+        reference.linearIndex.resize( readBai<int>( bai, pos ) );
+        BOOST_FOREACH( unsigned long long &offset, reference.linearIndex )
+        {
+            offset = readBai<unsigned long long>( bai, pos );
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL( 0ull, readBai<unsigned long long>( bai, pos ) );
+    CPPUNIT_ASSERT_EQUAL( bai.size(), pos );
+    return references;
+}
+
+// Header without text, with 2 references of 2Mb
+void serializeHeader( ostream &os )
+{
+    const char magic[] = "BAM\1";
+    os.write( magic, 4 );
+    eagle::io::serialize( os, 0 );
+    eagle::io::serialize( os, 2 );
+    eagle::io::serialize( os, 3 );
+    eagle::io::serialize( os, "c1" );
+    eagle::io::serialize( os, REFERENCE_LENGTH );
+    eagle::io::serialize( os, 3 );
+    eagle::io::serialize( os, "c2" );
+    eagle::io::serialize( os, REFERENCE_LENGTH );
+}
+
+// 100-base read with pseudo-random bases and qualities, so that the blocks don't compress too well
+void serializeAlignment( ostream &os, const int refId, const int pos, const bool unmapped, const unsigned int readNum )
+{
+    const unsigned int bin = eagle::io::bam_reg2bin( pos, pos + READ_LENGTH );
+    const string readName = (boost::format("r%05d") % readNum).str();
+    eagle::io::serialize( os, 32 + (int)readName.size() + 1 + 4 + (int)(READ_LENGTH + 1) / 2 + (int)READ_LENGTH );
+    eagle::io::serialize( os, refId );
+    eagle::io::serialize( os, pos );
+    eagle::io::serialize( os, bin << 16 | 50 << 8 | static_cast<unsigned int>( readName.size() + 1 ) );
+    eagle::io::serialize( os, (unmapped ? 4u : 0u) << 16 | 1 );
+    eagle::io::serialize( os, READ_LENGTH );
+    eagle::io::serialize( os, -1 );
+    eagle::io::serialize( os, -1 );
+    eagle::io::serialize( os, 0 );
+    eagle::io::serialize( os, readName );
+    eagle::io::serialize( os, READ_LENGTH << 4 ); // 100M
+    unsigned int random = readNum * 2654435761u;
+    for (unsigned int i=0; i<(READ_LENGTH + 1) / 2; ++i)
+    {
+        random = random * 1103515245 + 12345;
+        eagle::io::serialize( os, "\x11\x12\x14\x18\x21\x22\x24\x28\x41\x42\x44\x48\x81\x82\x84\x88"[random >> 28] );
+    }
+    for (unsigned int i=0; i<READ_LENGTH; ++i)
+    {
+        random = random * 1103515245 + 12345;
+        eagle::io::serialize( os, static_cast<char>( 2 + (random >> 27) ) );
+    }
+}
+
+/**
+ ** \brief Writes an indexed BAM stream the way BamMetadata does
+ **
+ ** The header gets bgzf blocks of its own, and so does each reference. 'flushOffsets' gets the uncompressed
+ ** offsets of these flushes
+ **/
+template <typename Compressor>
+void writeBam( const Compressor &compressor, vector<char> &bam, vector<char> &bai, vector<size_t> &flushOffsets )
+{
+    boost::iostreams::filtering_ostream bgzfStream;
+    bgzfStream.push( compressor );
+    VectorSink baiSink( bai );
+    bgzfStream.push( eagle::io::bam::BamIndexer<VectorSink>( baiSink ) );
+    bgzfStream.push( boost::iostreams::back_inserter( bam ) );
+
+    ostringstream os;
+    serializeHeader( os );
+    flushOffsets.clear();
+    for (int refId = -1; refId < 2; ++refId) // -1: the header alone
+    {
+        for (unsigned int readNum = 0; refId >= 0 && readNum < 10000; ++readNum)
+        {
+            serializeAlignment( os, refId, readNum * 150 + refId * 1000, readNum % 37 == 5, readNum );
+        }
+        const string bytes = os.str();
+        bgzfStream.write( bytes.data(), bytes.size() );
+        bgzfStream.flush();
+        flushOffsets.push_back( (flushOffsets.empty() ? 0 : flushOffsets.back()) + bytes.size() );
+        os.str( "" );
+    }
+    bgzfStream.pop();
+}
+
+} // anonymous namespace
+
+
+void TestParallelBgzfCompressor::setUp()
+{
+}
+
+void TestParallelBgzfCompressor::tearDown()
+{
+}
+
+
+void TestParallelBgzfCompressor::testRoundTrip()
+{
+    // Enough data for many blocks, written in uneven chunks and with an intermediate flush
+    string input;
+    for (unsigned int i=0; input.size() < 20 * ParallelBgzfCompressor::max_uncompressed_per_block_; ++i)
+    {
+        input += "ACGT"[(i * 7919) % 4];
+        input += static_cast<char>( i % 251 );
+    }
+
+    vector<char> output;
+    {
+        boost::iostreams::filtering_ostream bgzfStream;
+        bgzfStream.push( ParallelBgzfCompressor( 1, 3 ) );
+        bgzfStream.push( boost::iostreams::back_inserter( output ) );
+        const unsigned int half = input.size() / 2;
+        for (unsigned int pos = 0; pos < half; pos += 1000)
+        {
+            bgzfStream.write( &input[pos], min<unsigned int>( 1000, half - pos ) );
+        }
+        bgzfStream.flush();
+        bgzfStream.write( &input[half], input.size() - half );
+    }
+
+    vector<BgzfBlock> blocks;
+    const string decompressed = inflateBgzf( output, blocks );
+    CPPUNIT_ASSERT_EQUAL( 20u, (unsigned int)blocks.size() );
+    CPPUNIT_ASSERT( decompressed == input );
+}
+
+void TestParallelBgzfCompressor::testBamIndex()
+{
+    vector<char> singleThreadedBam, singleThreadedBai, bam, bai, bam4, bai4;
+    vector<size_t> flushOffsets;
+    writeBam( eagle::io::bam::BgzfCompressor( boost::iostreams::gzip_params( 1 ) ), singleThreadedBam, singleThreadedBai, flushOffsets );
+    writeBam( ParallelBgzfCompressor( 1, 1 ), bam, bai, flushOffsets );
+    writeBam( ParallelBgzfCompressor( 1, 4 ), bam4, bai4, flushOffsets );
+
+    // The number of threads changes nothing
+    CPPUNIT_ASSERT( bam4 == bam );
+    CPPUNIT_ASSERT( bai4 == bai );
+
+    vector<BgzfBlock> singleThreadedBlocks, blocks;
+    const string singleThreadedDecompressed = inflateBgzf( singleThreadedBam, singleThreadedBlocks );
+    const string decompressed = inflateBgzf( bam, blocks );
+    CPPUNIT_ASSERT( decompressed == singleThreadedDecompressed );
+    CPPUNIT_ASSERT_EQUAL( flushOffsets.back(), decompressed.size() );
+
+    // Blocks get cut at the same flushes as the single-threaded ones, and are full in-between
+    set<size_t> singleThreadedBlockEnds;
+    BOOST_FOREACH( const BgzfBlock &block, singleThreadedBlocks )
+    {
+        singleThreadedBlockEnds.insert( block.uncompressedOffset + block.uncompressedSize );
+    }
+    vector<size_t> expectedBlockEnds, blockEnds;
+    size_t segmentStart = 0;
+    BOOST_FOREACH( const size_t flushOffset, flushOffsets )
+    {
+        CPPUNIT_ASSERT( singleThreadedBlockEnds.count( flushOffset ) );
+        for (size_t end = segmentStart + ParallelBgzfCompressor::max_uncompressed_per_block_; end < flushOffset; end += ParallelBgzfCompressor::max_uncompressed_per_block_)
+        {
+            expectedBlockEnds.push_back( end );
+        }
+        expectedBlockEnds.push_back( flushOffset );
+        segmentStart = flushOffset;
+    }
+    BOOST_FOREACH( const BgzfBlock &block, blocks )
+    {
+        blockEnds.push_back( block.uncompressedOffset + block.uncompressedSize );
+    }
+    CPPUNIT_ASSERT( blockEnds == expectedBlockEnds );
+    // ... which makes the virtual offsets of both indexes differ
+    CPPUNIT_ASSERT( singleThreadedBlockEnds != set<size_t>( blockEnds.begin(), blockEnds.end() ) );
+    CPPUNIT_ASSERT( singleThreadedBai != bai );
+
+    // Alignments of each reference and bin, by uncompressed offset
+    vector< map< unsigned int, vector<size_t> > > binAlignments( 2 );
+    set<size_t> alignmentBoundaries;
+    unsigned int mappedCount[2] = {0, 0}, unmappedCount[2] = {0, 0};
+    for (size_t pos = flushOffsets.front(); pos < decompressed.size(); )
+    {
+        alignmentBoundaries.insert( pos );
+        const eagle::io::bam::BamAlignment &alignment = *reinterpret_cast<const eagle::io::bam::BamAlignment*>( &decompressed[pos + 4] );
+        if (alignment.getFlag() & 4)
+        {
+            ++unmappedCount[alignment.refId];
+        }
+        else
+        {
+            ++mappedCount[alignment.refId];
+            binAlignments[alignment.refId][alignment.getBin()].push_back( pos );
+        }
+        pos += 4 + *reinterpret_cast<const int*>( &decompressed[pos] );
+        CPPUNIT_ASSERT( pos <= decompressed.size() );
+    }
+    alignmentBoundaries.insert( decompressed.size() );
+
+    // Both indexes point to the same uncompressed offsets, each through the virtual offsets of its own blocks
+    const vector<BaiReference> singleThreadedReferences = parseBai( singleThreadedBai );
+    const vector<BaiReference> references = parseBai( bai );
+    CPPUNIT_ASSERT_EQUAL( 2u, (unsigned int)references.size() );
+    CPPUNIT_ASSERT_EQUAL( 2u, (unsigned int)singleThreadedReferences.size() );
+    for (unsigned int refId = 0; refId < 2; ++refId)
+    {
+        const BaiReference &singleThreadedReference = singleThreadedReferences[refId];
+        const BaiReference &reference = references[refId];
+
+        CPPUNIT_ASSERT_EQUAL( singleThreadedReference.linearIndex.size(), reference.linearIndex.size() );
+        CPPUNIT_ASSERT( reference.linearIndex.size() >= 90 ); // 1.5Mb of alignments, in 16kb windows
+        for (unsigned int i=0; i<reference.linearIndex.size(); ++i)
+        {
+            const size_t offset = resolveVirtualOffset( blocks, reference.linearIndex[i] );
+            CPPUNIT_ASSERT_EQUAL( resolveVirtualOffset( singleThreadedBlocks, singleThreadedReference.linearIndex[i] ), offset );
+            CPPUNIT_ASSERT( alignmentBoundaries.count( offset ) );
+        }
+
+        const vector<unsigned long long> &pseudoBin = reference.bins.find( BAI_PSEUDO_BIN )->second;
+        const vector<unsigned long long> &singleThreadedPseudoBin = singleThreadedReference.bins.find( BAI_PSEUDO_BIN )->second;
+        CPPUNIT_ASSERT_EQUAL( 4u, (unsigned int)pseudoBin.size() );
+        CPPUNIT_ASSERT_EQUAL( resolveVirtualOffset( singleThreadedBlocks, singleThreadedPseudoBin[0] ), resolveVirtualOffset( blocks, pseudoBin[0] ) );
+        CPPUNIT_ASSERT_EQUAL( resolveVirtualOffset( singleThreadedBlocks, singleThreadedPseudoBin[1] ), resolveVirtualOffset( blocks, pseudoBin[1] ) );
+        CPPUNIT_ASSERT_EQUAL( (unsigned long long)mappedCount[refId], pseudoBin[2] );
+        CPPUNIT_ASSERT_EQUAL( (unsigned long long)unmappedCount[refId], pseudoBin[3] );
+        CPPUNIT_ASSERT( singleThreadedPseudoBin[2] == pseudoBin[2] && singleThreadedPseudoBin[3] == pseudoBin[3] );
+
+        // Chunks get merged differently depending on the block boundaries, but must cover all the alignments of their bin
+        CPPUNIT_ASSERT_EQUAL( singleThreadedReference.bins.size(), reference.bins.size() );
+        CPPUNIT_ASSERT_EQUAL( binAlignments[refId].size() + 1, reference.bins.size() );
+        for (map< unsigned int, vector<size_t> >::const_iterator bin = binAlignments[refId].begin(); bin != binAlignments[refId].end(); ++bin)
+        {
+            CPPUNIT_ASSERT( reference.bins.count( bin->first ) && singleThreadedReference.bins.count( bin->first ) );
+            const vector<unsigned long long> *chunkLists[2] = { &reference.bins.find( bin->first )->second, &singleThreadedReference.bins.find( bin->first )->second };
+            const vector<BgzfBlock> *blockLists[2] = { &blocks, &singleThreadedBlocks };
+            for (unsigned int i=0; i<2; ++i)
+            {
+                vector< pair<size_t, size_t> > chunks;
+                for (unsigned int j=0; j<chunkLists[i]->size(); j+=2)
+                {
+                    chunks.push_back( make_pair( resolveVirtualOffset( *blockLists[i], (*chunkLists[i])[j] ), resolveVirtualOffset( *blockLists[i], (*chunkLists[i])[j+1] ) ) );
+                    CPPUNIT_ASSERT( alignmentBoundaries.count( chunks.back().first ) && alignmentBoundaries.count( chunks.back().second ) );
+                }
+                BOOST_FOREACH( const size_t alignmentOffset, bin->second )
+                {
+                    bool covered = false;
+                    for (unsigned int j=0; j<chunks.size() && !covered; ++j)
+                    {
+                        covered = (chunks[j].first <= alignmentOffset && alignmentOffset < chunks[j].second);
+                    }
+                    CPPUNIT_ASSERT( covered );
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_IO_TEST_PARALLEL_BGZF_COMPRESSOR_HH
+#define EAGLE_IO_TEST_PARALLEL_BGZF_COMPRESSOR_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "io/ParallelBgzfCompressor.hh"
+
+
+class TestParallelBgzfCompressor : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestParallelBgzfCompressor );
+    CPPUNIT_TEST( testRoundTrip );
+    CPPUNIT_TEST( testBamIndex );
+    CPPUNIT_TEST_SUITE_END();
+private:
+public:
+    void setUp();
+    void tearDown();
+    void testRoundTrip();
+    void testBamIndex();
+};
+
+#endif //EAGLE_IO_TEST_PARALLEL_BGZF_COMPRESSOR_HH
@@ -91,21 +91,12 @@ void FragmentsAllocator::run()
     totalSize = std::accumulate( contigLengths.begin(), contigLengths.end(), 0ul );
     clog << "total length: " << totalSize << endl;
 
-
-    vector<unsigned int> tileReadCount( options_.tileCount, 0 );
-    //  Get number of requested reads
-    unsigned long readCount = static_cast<unsigned long>(totalSize * options_.coverageDepth / options_.basesPerCluster);
-    clog << (boost::format("Starting the generation of %d fragments") % readCount).str() << endl;
-
-    boost::shared_ptr<eagle::model::IntervalGenerator> randomInterval;
-    boost::shared_ptr<eagle::model::MultiFragmentFilesReader> multiFragmentFilesReader;
     if (options_.mergeExistingFragments)
     {
-        // Merge pre-calculated fragments
-        // For this, the "interval generator" is actually a reader of existing fragments.* files
+        // Merge pre-calculated fragments, without copying them
         try
         {
-            multiFragmentFilesReader = boost::shared_ptr<eagle::model::MultiFragmentFilesReader>( new eagle::model::MultiFragmentFilesReader( contigLengths, contigNames, options_.outputDir, readCount ) );
+            mergeExistingFragments( contigLengths, contigNames );
         }
         catch (const eagle::common::EagleException &e)
         {
@@ -121,95 +112,52 @@ void FragmentsAllocator::run()
                 throw;
             }
         }
+        return;
+    }
+
+
+    vector<unsigned int> tileReadCount( options_.tileCount, 0 );
+    //  Get number of requested reads
+    unsigned long readCount = static_cast<unsigned long>(totalSize * options_.coverageDepth / options_.basesPerCluster);
+    clog << (boost::format("Starting the generation of %d fragments") % readCount).str() << endl;
+
+    boost::shared_ptr<eagle::model::IntervalGenerator> randomInterval;
+    if (options_.uniformCoverage)
+    {
+        double step = (double)options_.basesPerCluster / (double)options_.coverageDepth;
+        randomInterval = boost::shared_ptr<eagle::model::IntervalGenerator>( new eagle::model::UniformIntervalGenerator( contigLengths, (unsigned int)options_.templateLengthStatistics.median, step, readCount) );
     }
     else
     {
-        if (options_.uniformCoverage)
-        {
-            double step = (double)options_.basesPerCluster / (double)options_.coverageDepth;
-            randomInterval = boost::shared_ptr<eagle::model::IntervalGenerator>( new eagle::model::UniformIntervalGenerator( contigLengths, (unsigned int)options_.templateLengthStatistics.median, step, readCount) );
-        }
-        else
-        {
-            unsigned long extendedReadCount = static_cast<unsigned long>( ((double)readCount) / gcCoverageFit_.averageMultiplier() );
-            clog << (boost::format("  ...increased to %d \"discardable\" fragments") % extendedReadCount).str() << endl;
-            randomInterval = boost::shared_ptr<eagle::model::IntervalGenerator>( new eagle::model::RandomIntervalGeneratorUsingIntervalLengthDistribution( contigLengths, extendedReadCount, options_.templateLengthTableFile ) );
-        }
+        unsigned long extendedReadCount = static_cast<unsigned long>( ((double)readCount) / gcCoverageFit_.averageMultiplier() );
+        clog << (boost::format("  ...increased to %d \"discardable\" fragments") % extendedReadCount).str() << endl;
+        randomInterval = boost::shared_ptr<eagle::model::IntervalGenerator>( new eagle::model::RandomIntervalGeneratorUsingIntervalLengthDistribution( contigLengths, extendedReadCount, options_.templateLengthTableFile ) );
     }
 
 
-    std::ofstream out1     ( (options_.outputDir / "fragments.pos"      ).string().c_str(), ios::binary );
-    std::ofstream out2     ( (options_.outputDir / "fragments.length"   ).string().c_str(), ios::binary );
-    std::ofstream out3     ( (options_.outputDir / "fragments.tile"     ).string().c_str(), ios::binary );
     std::ofstream out4     ( (options_.outputDir / "fragments.stats"    ).string().c_str(), ios::binary );
-    std::ofstream indexFile( (options_.outputDir / "fragments.pos.index").string().c_str(), ios::binary );
-    std::ofstream shiftFile( (options_.outputDir / "fragments.pos.shift").string().c_str(), ios::binary );
-
-    // Write index file header
-    const unsigned long indexVersion = 1;
-    const unsigned long indexInterval = 1000;
-    indexFile.write( (char*)&indexVersion, sizeof(unsigned long));
-    indexFile.write( (char*)&indexInterval, sizeof(unsigned long));
-    unsigned long indexCount = 0;
+    eagle::model::FragmentBlockWriter blockWriter( options_.outputDir / "fragments.blocks", options_.tileCount );
 
 //        for (unsigned long i=0; i<readCount; ++i)
     unsigned long i=0;
     while (++i) // always true
     {
-        FragmentWithAllocationMetadata f = getNextFragment( randomInterval, multiFragmentFilesReader, i, readCount );
+        FragmentWithAllocationMetadata f = getNextFragment( randomInterval, i, readCount );
         if (!f.isValid())
         {
 //                EAGLE_WARNING( (boost::format("Early termination of fragments generation at fragment %d") % i).str() );
             break;
         }
 
-        // Output format:: binary 6 bytes per fragment
-        static unsigned long lastPos = 0;
-        static unsigned int shift = 0;
-        unsigned long posDiff = static_cast<unsigned long>(f.startPos_) - lastPos;
-/*
-        if ( posDiff >= 65536 )
-        {
-            clog << "posDiff   =" << posDiff << endl;
-            clog << "f.startPos_=" << f.startPos_ << endl;
-//                clog << "nextPos   =" << nextInterval.first << endl;
-            clog << "lastPos   =" << lastPos << endl;
-        }
-*/
         assert( f.fragmentLength_ < 65536 );
         assert( f.allocatedTile_ < 65536 );
-        lastPos = f.startPos_;
-        if (posDiff < 65535)
-        {
-            out1.write( (char*)&posDiff, 2);
-        }
-        else
-        {
-            const unsigned int const65535 = 65535;
-            const unsigned int posDiffByte2 = posDiff >> 32;
-            const unsigned int posDiffByte1 = ( posDiff >> 16 ) & 0xFFFF;
-            const unsigned int posDiffByte0 = posDiff & 0xFFFF;
-            assert( posDiffByte2 < 65536 );
-            out1.write( (char*)&const65535 , 2);
-            out1.write( (char*)&posDiffByte2, 2);
-            out1.write( (char*)&posDiffByte1, 2);
-            out1.write( (char*)&posDiffByte0, 2);
-            shift += 3;
-        }
-        out2.write( (char*)&f.fragmentLength_, 2);
-        out3.write( (char*)&f.allocatedTile_, 2);
+        blockWriter.add( f );
         tileReadCount[f.allocatedTile_]++;
         assert( tileReadCount[f.allocatedTile_] != 0xFFFFFFFF && "Tile too large" );
-
-        if (++indexCount == indexInterval)
-        {
-            indexFile.write( (char*)&lastPos, sizeof(unsigned long));
-            shiftFile.write( (char*)&shift, sizeof(unsigned int));
-            indexCount = 0;
-        }
     }
 
     out4.write( (char*)&tileReadCount[0], tileReadCount.size() * sizeof(unsigned int) );
+    blockWriter.close();
 
     // Count check
     unsigned long generatedCount = i-1;
@@ -237,48 +185,71 @@ void FragmentsAllocator::setRandomSeed()
 
 
 FragmentWithAllocationMetadata FragmentsAllocator::getNextFragment( boost::shared_ptr<eagle::model::IntervalGenerator>& randomInterval,
-                                                                    boost::shared_ptr<eagle::model::MultiFragmentFilesReader>& multiFragmentFilesReader,
                                                                     const unsigned long fragmentNum,
                                                                     const unsigned long fragmentCount)
 {
-    if (!options_.mergeExistingFragments)
+    while (1) // repeat until a valid fragment is generated, then return
     {
-        while (1) // repeat until a valid fragment is generated, then return
+        pair<unsigned long,unsigned int> nextInterval = randomInterval->getNext();
+        if (nextInterval.second == 0)
         {
-            pair<unsigned long,unsigned int> nextInterval = randomInterval->getNext();
-            if (nextInterval.second == 0)
-            {
-                return FragmentWithAllocationMetadata();
-            }
-            FragmentWithAllocationMetadata f( nextInterval );
+            return FragmentWithAllocationMetadata();
+        }
+        FragmentWithAllocationMetadata f( nextInterval );
 
-            if (gcCoverageFit_.needsDiscarding( f ))
-            {
-//                clog << "Discarding" << endl;
-                continue; // discard fragment and generate next one
-            }
+        if (gcCoverageFit_.needsDiscarding( f ))
+        {
+//            clog << "Discarding" << endl;
+            continue; // discard fragment and generate next one
+        }
 
-            switch (options_.tileAllocationMethod)
-            {
-            case eagle::main::FragmentsAllocatorOptions::TILE_ALLOCATION_RANDOM:
-                f.allocateRandomTile(options_.tileCount);
-                break;
-            case eagle::main::FragmentsAllocatorOptions::TILE_ALLOCATION_SEQUENCE:
-                f.allocateTileInSequence(options_.tileCount, fragmentNum, fragmentCount);
-                break;
-            case eagle::main::FragmentsAllocatorOptions::TILE_ALLOCATION_INTERLEAVED:
-                f.allocateInterleavedTile(options_.tileCount);
-                break;
-            default:
-                EAGLE_ERROR("tile allocation method not implemented");
-            }
-            return f;
+        switch (options_.tileAllocationMethod)
+        {
+        case eagle::main::FragmentsAllocatorOptions::TILE_ALLOCATION_RANDOM:
+            f.allocateRandomTile(options_.tileCount);
+            break;
+        case eagle::main::FragmentsAllocatorOptions::TILE_ALLOCATION_SEQUENCE:
+            f.allocateTileInSequence(options_.tileCount, fragmentNum, fragmentCount);
+            break;
+        case eagle::main::FragmentsAllocatorOptions::TILE_ALLOCATION_INTERLEAVED:
+            f.allocateInterleavedTile(options_.tileCount);
+            break;
+        default:
+            EAGLE_ERROR("tile allocation method not implemented");
         }
+        return f;
     }
-    else
+}
+
+void FragmentsAllocator::mergeExistingFragments( const std::vector<unsigned long>& contigLengths, const std::vector<string>& contigNames )
+{
+    // The per-contig directories are only listed in fragments.manifest: FragmentList shifts their fragments on the fly
+    vector<unsigned int> tileReadCount( options_.tileCount, 0 );
+    eagle::model::FragmentManifestWriter manifestWriter( options_.outputDir / "fragments.manifest" );
+    unsigned long posOffset = 0;
+    unsigned long fragmentCount = 0;
+    for (unsigned int i=0; i<contigNames.size(); ++i)
     {
-        return multiFragmentFilesReader->getNext();
+        const string dirName = string("fragments_") + contigNames[i];
+        if (!boost::filesystem::is_directory( options_.outputDir / dirName ))
+        {
+            EAGLE_ERROR( (boost::format("Missing directory %s") % (options_.outputDir / dirName).string()).str() );
+        }
+        eagle::model::FragmentList fragmentList( options_.outputDir / dirName );
+        for (unsigned int tile=0; tile<options_.tileCount; ++tile)
+        {
+            tileReadCount[tile] += fragmentList.getTileSize( tile );
+        }
+        const unsigned long contigFragmentCount = fragmentList.size();
+        manifestWriter.add( dirName, posOffset, contigFragmentCount );
+        fragmentCount += contigFragmentCount;
+        posOffset += contigLengths[i];
     }
+    manifestWriter.close();
+
+    std::ofstream statsFile( (options_.outputDir / "fragments.stats").string().c_str(), ios::binary );
+    statsFile.write( (char*)&tileReadCount[0], tileReadCount.size() * sizeof(unsigned int) );
+    clog << (boost::format("Merged %d fragments from %d directories") % fragmentCount % contigNames.size()).str() << endl;
 }
 
 
@@ -68,7 +68,7 @@ FragmentsAllocatorOptions::FragmentsAllocatorOptions()
         ("contig",                   bpo::value< std::string >(&contigName)->default_value(contigName),
                                      "If specified, only generate fragments for this contig")
         ("merge-existing-fragments", bpo::value< bool >(&mergeExistingFragments)->zero_tokens(),
-                                     "Merge pre-calculated fragment files. Don't compute new fragments.")
+                                     "Merge pre-calculated fragment directories by listing them in fragments.manifest. Don't compute new fragments.")
         ("gc-coverage-fit-table",    bpo::value< bfs::path >(&gcCoverageFitFile),
                                      "File describing how GC content affects the coverage")
         ("max-coverage-error",       bpo::value< double >(&maxCoverageError)->default_value( 0.25 ),
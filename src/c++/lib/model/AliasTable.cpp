@@ -0,0 +1,116 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Set of discrete distributions compiled into Walker/Vose alias tables,
+ ** for O(1) sampling with a single 32-bit random number.
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <numeric>
+
+#include "model/AliasTable.hh"
+
+using namespace std;
+
+
+namespace eagle
+{
+namespace model
+{
+
+
+AliasTables& AliasTables::operator=( const AliasTables& other )
+{
+    width_ = other.width_;
+    entries_ = other.entries_;
+    table_ = other.entries_.empty() ? other.table_ : &entries_[0];
+    outcomeCounts_ = other.outcomeCounts_;
+    return *this;
+}
+
+void AliasTables::assign( const unsigned int width, const vector< unsigned int >& outcomeCounts, const void *entries )
+{
+    width_ = width;
+    entries_.clear();
+    table_ = static_cast<const Entry *>( entries );
+    outcomeCounts_ = outcomeCounts;
+}
+
+void AliasTables::build( const vector< vector< double > >& weightsPerTable )
+{
+    width_ = 1;
+    for (unsigned int i=0; i<weightsPerTable.size(); ++i)
+    {
+        width_ = max<unsigned int>( width_, weightsPerTable[i].size() );
+    }
+
+    entries_.resize( weightsPerTable.size() * width_ );
+    outcomeCounts_.resize( weightsPerTable.size() );
+    const vector< double > defaultWeights( 1, 1.0 );
+    for (unsigned int i=0; i<weightsPerTable.size(); ++i)
+    {
+        const vector< double >& weights = weightsPerTable[i].empty() ? defaultWeights : weightsPerTable[i];
+        outcomeCounts_[i] = weights.size();
+        buildTable( weights, &entries_[i * width_] );
+    }
+    table_ = entries_.empty() ? 0 : &entries_[0];
+}
+
+void AliasTables::buildTable( const vector< double >& weights, Entry *table )
+{
+    const double sum = accumulate( weights.begin(), weights.end(), 0.0 );
+    if (sum <= 0)
+    {
+        // Unused entries of the parsed tables may have no weight at all: always return 0 for them
+        for (unsigned int i=0; i<width_; ++i)
+        {
+            table[i].threshold = (i == 0) ? 0xFFFFFFFF : 0;
+            table[i].alias = 0;
+        }
+        return;
+    }
+
+    // Vose's method: each column gets probability 1 in total, made of its own weight topped up by one alias.
+    // Padding columns have a zero weight, so they always redirect to their alias
+    vector< double > scaled( width_, 0.0 );
+    vector< unsigned int > small, large;
+    for (unsigned int i=0; i<width_; ++i)
+    {
+        scaled[i] = (i < weights.size()) ? weights[i] * width_ / sum : 0.0;
+        (scaled[i] < 1.0 ? small : large).push_back( i );
+    }
+    while (!small.empty() && !large.empty())
+    {
+        const unsigned int s = small.back();
+        const unsigned int l = large.back();
+        small.pop_back();
+        table[s].threshold = static_cast<uint32_t>( scaled[s] * 4294967296.0 );
+        table[s].alias = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+        {
+            large.pop_back();
+            small.push_back( l );
+        }
+    }
+
+    // Whatever remains has a probability of 1, give or take rounding errors
+    for (unsigned int i=0; i<large.size(); ++i)
+    {
+        table[large[i]].threshold = 0xFFFFFFFF;
+        table[large[i]].alias = large[i];
+    }
+    for (unsigned int i=0; i<small.size(); ++i)
+    {
+        table[small[i]].threshold = 0xFFFFFFFF;
+        table[small[i]].alias = small[i];
+    }
+}
+
+
+} // namespace model
+} // namespace eagle
@@ -7,7 +7,13 @@
  ** \author Lilian Janin
  **/
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <zlib.h>
 #include <boost/filesystem.hpp>
+#include "common/Exceptions.hh"
 #include "common/Logger.hh"
 #include "model/Fragment.hh"
 
@@ -57,6 +63,69 @@ void FragmentWithAllocationMetadata::allocateInterleavedTile(unsigned long tileC
     nextTile = (nextTile+1) % tileCount;
 }
 
+namespace
+{
+
+// Number of positions decoded at once from fragments.pos
+const unsigned int POSITION_BATCH_SIZE = 4096;
+
+void mapFileIfNotEmpty( boost::iostreams::mapped_file_source& file, const boost::filesystem::path& filename )
+{
+    boost::system::error_code ec;
+    const boost::uintmax_t fileSize = boost::filesystem::file_size( filename, ec );
+    if (!ec && fileSize > 0)
+    {
+        file.open( filename.string() );
+    }
+}
+
+const unsigned short *wordsOf( const boost::iostreams::mapped_file_source& file )
+{
+    return file.is_open() ? reinterpret_cast<const unsigned short *>( file.data() ) : 0;
+}
+
+unsigned long wordCountOf( const boost::iostreams::mapped_file_source& file )
+{
+    return file.is_open() ? file.size() / sizeof(unsigned short) : 0;
+}
+
+const unsigned long BLOCK_FILE_HEADER_SIZE = 4 * sizeof(unsigned long);
+
+// Same CRC-32 as boost::crc_32_type, but much faster on large blocks
+unsigned int checksum( const unsigned char *data, const unsigned long byteSize )
+{
+    return crc32( crc32( 0, Z_NULL, 0 ), data, byteSize );
+}
+
+void appendVarint( vector<unsigned char>& buffer, unsigned long value )
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back( static_cast<unsigned char>( value | 0x80 ) );
+        value >>= 7;
+    }
+    buffer.push_back( static_cast<unsigned char>( value ) );
+}
+
+// Returns false if the varint goes beyond end
+inline bool readVarint( const unsigned char *&ptr, const unsigned char *end, unsigned long& value )
+{
+    value = 0;
+    for (unsigned int shift = 0; ptr < end && shift < 64; shift += 7)
+    {
+        const unsigned char byte = *ptr++;
+        value |= static_cast<unsigned long>( byte & 0x7F ) << shift;
+        if (byte < 0x80)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+
 bool FragmentWithAllocationMetadata::operator<( const FragmentWithAllocationMetadata& rhs ) const
 {
     if (startPos_ < rhs.startPos_) return true;
@@ -67,15 +136,57 @@ bool FragmentWithAllocationMetadata::operator<( const FragmentWithAllocationMeta
 
 
 FragmentList::FragmentList( const boost::filesystem::path& dir, const unsigned long firstRequestedPos, const unsigned long lastRequestedPos, const unsigned long fetchBefore )
-    : in1( (dir/"fragments.pos"   ).string().c_str(), ios::binary )
-    , in2( (dir/"fragments.length").string().c_str(), ios::binary )
-    , in3( (dir/"fragments.tile"  ).string().c_str(), ios::binary )
-    , in4( (dir/"fragments.stats" ).string().c_str(), ios::binary )
+    : dir_( dir )
+    , nextManifestEntry_( 0 )
+    , fetchBefore_( fetchBefore )
+    , blockTileCount_( 0 )
+    , blockOffsets_( 0 )
+    , nextBlock_( 0 )
     , fragmentNum_( 0 )
+    , nextTileRecord_( 0 )
+    , positions_( POSITION_BATCH_SIZE )
+    , batchLengths_( POSITION_BATCH_SIZE )
+    , batchTiles_( POSITION_BATCH_SIZE )
+    , batchFragmentNums_( POSITION_BATCH_SIZE )
+    , positionCount_( 0 )
+    , nextPosition_( 0 )
+    , tileSelected_( false )
+    , selectedTile_( 0 )
     , currentPos_( 0 )
     , firstRequestedPos_( firstRequestedPos )
     , lastRequestedPos_( lastRequestedPos )
 {
+    // fragments.stats is still needed by getTileSize
+    mapFileIfNotEmpty( statsFile_, dir/"fragments.stats" );
+    posWords_ = lengths_ = tiles_ = 0;
+    posWordCount_ = recordCount_ = nextPosWord_ = 0;
+
+    // Each directory of the manifest gets its own FragmentList, restricted to the requested region
+    if (boost::filesystem::exists( dir/"fragments.manifest" ))
+    {
+        readManifest( dir/"fragments.manifest" );
+        return;
+    }
+
+    // The block headers are enough to skip what is before firstRequestedPos, so fetchBefore is not needed
+    if (boost::filesystem::exists( dir/"fragments.blocks" ))
+    {
+        openBlockFile( dir/"fragments.blocks" );
+        return;
+    }
+
+    /* Legacy format, only kept to read the directories written before fragments.blocks, as FragmentsAllocator
+     * doesn't write it anymore: binary 2 bytes per fragment in each file, except the position differences >= 65535,
+     * stored in fragments.pos as 65535 followed by the difference as 3 words, most significant first */
+    mapFileIfNotEmpty( posFile_, dir/"fragments.pos" );
+    mapFileIfNotEmpty( lengthFile_, dir/"fragments.length" );
+    mapFileIfNotEmpty( tileFile_, dir/"fragments.tile" );
+    posWords_ = wordsOf( posFile_ );
+    lengths_ = wordsOf( lengthFile_ );
+    tiles_ = wordsOf( tileFile_ );
+    posWordCount_ = wordCountOf( posFile_ );
+    recordCount_ = std::min( wordCountOf( lengthFile_ ), wordCountOf( tileFile_ ) );
+
     unsigned long startPos = (firstRequestedPos > fetchBefore) ? (firstRequestedPos - fetchBefore) : 0;
 
     // If a non-zero position is requested, use index file to jump as close as possible
@@ -113,11 +224,8 @@ FragmentList::FragmentList( const boost::filesystem::path& dir, const unsigned l
             shiftFile.seekg( (indexEntryNum-1) * sizeof(unsigned int) );
             shiftFile.read( (char*)&shift, sizeof(unsigned int));
 
-            unsigned long posInPosFile = (fragmentNum_ + shift) * 2;
-            unsigned long posInOtherFiles = fragmentNum_ * 2;
-            in1.seekg( posInPosFile );
-            in2.seekg( posInOtherFiles );
-            in3.seekg( posInOtherFiles );
+            // The other files are directly indexed by fragmentNum_
+            nextPosWord_ = fragmentNum_ + shift;
             currentPos_ = previousPos;
         }
     }
@@ -125,32 +233,20 @@ FragmentList::FragmentList( const boost::filesystem::path& dir, const unsigned l
 
 Fragment FragmentList::getNext( unsigned int desiredTile, unsigned int mask, unsigned int *tilePtr )
 {
+    if (!manifestEntries_.empty())
+    {
+        return getNextWithTile( desiredTile, mask, tilePtr );
+    }
+
+    assert( (!tileSelected_ || (desiredTile == selectedTile_ && mask == 0xFFFFFFFF)) && "Only the selected tile can be read once a tile is selected" );
+
     unsigned long length=0;
     unsigned int tile=0;
     do {
-        /* Format: binary 6 bytes per fragment */
-        unsigned long long posDiff = 0;
-        in1.read( (char*)&posDiff, 2);
-        in2.read( (char*)&length, 2);
-        in3.read( (char*)&tile, 2);
-        if (!in1.good())
+        if (!readNextRecord( length, tile, desiredTile, mask ))
         {
             return Fragment(); // returns a fragment that has .isValid()==false
         }
-        assert( in2.good() );
-        assert( in3.good() );
-        if (posDiff == 65535)
-        {
-            unsigned long posDiffByte2 = 0;
-            unsigned long posDiffByte1 = 0;
-            unsigned long posDiffByte0 = 0;
-            in1.read( (char*)&posDiffByte2, 2);
-            in1.read( (char*)&posDiffByte1, 2);
-            in1.read( (char*)&posDiffByte0, 2);
-            posDiff = (posDiffByte2 << 32) | (posDiffByte1 << 16) | posDiffByte0;
-        }
-        currentPos_ += posDiff;
-        ++fragmentNum_;
     } while ( (tile & mask) != desiredTile || ((currentPos_ < firstRequestedPos_) && (currentPos_+length-1 < firstRequestedPos_)) );
 
     if (currentPos_ > lastRequestedPos_)
@@ -169,32 +265,23 @@ Fragment FragmentList::getNext( unsigned int desiredTile, unsigned int mask, uns
 
 FragmentWithAllocationMetadata FragmentList::getNextWithTile( unsigned int desiredTile, unsigned int mask, unsigned int *tilePtr )
 {
+    if (!manifestEntries_.empty())
+    {
+        FragmentWithAllocationMetadata fragment = getNextFromManifest( desiredTile, mask );
+        if (tilePtr && fragment.isValid())
+        {
+            *tilePtr = fragment.allocatedTile_;
+        }
+        return fragment;
+    }
+
     unsigned long length=0;
     unsigned int tile=0;
     do {
-        /* Format: binary 6 bytes per fragment */
-        unsigned long long posDiff = 0;
-        in1.read( (char*)&posDiff, 2);
-        in2.read( (char*)&length, 2);
-        in3.read( (char*)&tile, 2);
-        if (!in1.good())
+        if (!readNextRecord( length, tile, desiredTile, mask ))
         {
             return FragmentWithAllocationMetadata(); // returns a fragment that has .isValid()==false
         }
-        assert( in2.good() );
-        assert( in3.good() );
-        if (posDiff == 65535)
-        {
-            unsigned long posDiffByte2 = 0;
-            unsigned long posDiffByte1 = 0;
-            unsigned long posDiffByte0 = 0;
-            in1.read( (char*)&posDiffByte2, 2);
-            in1.read( (char*)&posDiffByte1, 2);
-            in1.read( (char*)&posDiffByte0, 2);
-            posDiff = (posDiffByte2 << 32) | (posDiffByte1 << 16) | posDiffByte0;
-        }
-        currentPos_ += posDiff;
-        ++fragmentNum_;
     } while ( (tile & mask) != desiredTile || ((currentPos_ < firstRequestedPos_) && (currentPos_+length-1 < firstRequestedPos_)) );
 
     if (currentPos_ > lastRequestedPos_)
@@ -211,97 +298,728 @@ FragmentWithAllocationMetadata FragmentList::getNextWithTile( unsigned int desir
     return fragment;
 }
 
+void FragmentList::readManifest( const boost::filesystem::path& filename )
+{
+    ifstream manifestFile( filename.string().c_str() );
+    const string headerPrefix = "#EAGLE fragments manifest v";
+    string line;
+    if (!getline( manifestFile, line ) || line.compare( 0, headerPrefix.size(), headerPrefix ) != 0)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s is not a fragments manifest") % filename).str() ) );
+    }
+    const string version = line.substr( headerPrefix.size() );
+    unsigned long versionNum = 0;
+    if (!(istringstream( version ) >> versionNum) || versionNum != FragmentManifestWriter::VERSION)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::UnsupportedVersionException( (boost::format("%s: unsupported fragments manifest version %s") % filename % version).str() ) );
+    }
+
+    unsigned long fragmentCount = 0;
+    while (getline( manifestFile, line ))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        istringstream lineStream( line );
+        string entryDir;
+        ManifestEntry entry;
+        unsigned long entryFragmentCount = 0;
+        if (!getline( lineStream, entryDir, '\t' ) || !(lineStream >> entry.posOffset >> entryFragmentCount)
+            || (!manifestEntries_.empty() && entry.posOffset < manifestEntries_.back().posOffset))
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: invalid entry \"%s\"") % filename % line).str() ) );
+        }
+        entry.dir = boost::filesystem::path( entryDir ).is_absolute() ? boost::filesystem::path( entryDir ) : dir_ / entryDir;
+        entry.firstFragmentNum = fragmentCount;
+        fragmentCount += entryFragmentCount;
+        manifestEntries_.push_back( entry );
+    }
+}
+
+bool FragmentList::isManifestEntryInRegion( const unsigned int entryNum ) const
+{
+    // The fragments of an entry all end before the next entry's offset
+    return manifestEntries_[entryNum].posOffset <= lastRequestedPos_
+        && (entryNum + 1 == manifestEntries_.size() || manifestEntries_[entryNum + 1].posOffset > firstRequestedPos_);
+}
+
+FragmentList *FragmentList::openManifestEntry( const unsigned int entryNum ) const
+{
+    const ManifestEntry& entry = manifestEntries_[entryNum];
+    const unsigned long firstRequestedPos = (firstRequestedPos_ > entry.posOffset) ? (firstRequestedPos_ - entry.posOffset) : 0;
+    return new FragmentList( entry.dir, firstRequestedPos, lastRequestedPos_ - entry.posOffset, fetchBefore_ );
+}
+
+bool FragmentList::openNextManifestEntry()
+{
+    while (nextManifestEntry_ < manifestEntries_.size())
+    {
+        const unsigned int entryNum = nextManifestEntry_++;
+        if (manifestEntries_[entryNum].posOffset > lastRequestedPos_)
+        {
+            nextManifestEntry_ = manifestEntries_.size();
+            return false;
+        }
+        if (!isManifestEntryInRegion( entryNum ))
+        {
+            continue;
+        }
+
+        if (tileSelected_ && !manifestEntryLists_.empty())
+        {
+            // Tile view: the directories were opened once by indexTiles()
+            manifestFragmentList_.reset( new FragmentList( manifestEntryLists_[entryNum]->tileView( selectedTile_ ) ) );
+            return true;
+        }
+        manifestFragmentList_.reset( openManifestEntry( entryNum ) );
+        if (tileSelected_)
+        {
+            manifestFragmentList_->selectTile( selectedTile_ );
+        }
+        return true;
+    }
+    return false;
+}
+
+FragmentWithAllocationMetadata FragmentList::getNextFromManifest( const unsigned int desiredTile, const unsigned int mask )
+{
+    while (manifestFragmentList_ || openNextManifestEntry())
+    {
+        unsigned int tile = 0;
+        Fragment f = manifestFragmentList_->getNext( desiredTile, mask, &tile );
+        if (f.isValid())
+        {
+            const ManifestEntry& entry = manifestEntries_[nextManifestEntry_-1];
+            return FragmentWithAllocationMetadata( f.startPos_ + entry.posOffset, f.fragmentLength_, f.fragmentNum_ + entry.firstFragmentNum, tile );
+        }
+        manifestFragmentList_.reset();
+    }
+    return FragmentWithAllocationMetadata(); // returns a fragment that has .isValid()==false
+}
+
+bool FragmentList::readNextRecord( unsigned long& length, unsigned int& tile, const unsigned int desiredTile, const unsigned int mask )
+{
+    if (nextPosition_ == positionCount_)
+    {
+        const bool decoded = blockFile_.is_open() ? decodeNextBlock( desiredTile, mask )
+                             : (legacyTileRecords_ && tileSelected_) ? decodeNextTileRecords() : decodeNextPositions();
+        if (!decoded)
+        {
+            return false;
+        }
+    }
+    currentPos_ = positions_[nextPosition_];
+    length = batchLengths_[nextPosition_];
+    tile = batchTiles_[nextPosition_];
+    fragmentNum_ = batchFragmentNums_[nextPosition_] + 1;
+    ++nextPosition_;
+    return true;
+}
+
+// Legacy fragments.pos: see decodeNextBlock for the fragments.blocks written by FragmentsAllocator
+bool FragmentList::decodeNextPositions()
+{
+    const unsigned long maxCount = (fragmentNum_ < recordCount_) ? std::min<unsigned long>( POSITION_BATCH_SIZE, recordCount_ - fragmentNum_ ) : 0;
+    unsigned long pos = currentPos_;
+    unsigned long word = nextPosWord_;
+    unsigned int count = 0;
+    while (count < maxCount && word < posWordCount_)
+    {
+        unsigned long posDiff = posWords_[word++];
+        if (posDiff == 65535)
+        {
+            // Rare: the escape is only used for gaps of 65535 bases or more
+            if (word + 3 > posWordCount_)
+            {
+                break;
+            }
+            posDiff = ((unsigned long)posWords_[word] << 32) | ((unsigned long)posWords_[word+1] << 16) | posWords_[word+2];
+            word += 3;
+        }
+        pos += posDiff;
+        positions_[count] = pos;
+        batchLengths_[count] = lengths_[fragmentNum_ + count];
+        batchTiles_[count] = tiles_[fragmentNum_ + count];
+        batchFragmentNums_[count] = fragmentNum_ + count;
+        ++count;
+    }
+    nextPosWord_ = word;
+    positionCount_ = count;
+    nextPosition_ = 0;
+    return count > 0;
+}
+
+// Legacy files indexed by indexTiles(): only the records of the selected tile
+bool FragmentList::decodeNextTileRecords()
+{
+    if (selectedTile_ >= legacyTileRecords_->size())
+    {
+        return false;
+    }
+    const TileRecords& records = (*legacyTileRecords_)[selectedTile_];
+    const unsigned int count = std::min<unsigned long>( POSITION_BATCH_SIZE, records.positions.size() - nextTileRecord_ );
+    for (unsigned int i=0; i<count; ++i)
+    {
+        const unsigned int fragmentNum = records.fragmentNums[nextTileRecord_ + i];
+        positions_[i] = records.positions[nextTileRecord_ + i];
+        batchLengths_[i] = lengths_[fragmentNum];
+        batchTiles_[i] = selectedTile_;
+        batchFragmentNums_[i] = fragmentNum;
+    }
+    nextTileRecord_ += count;
+    positionCount_ = count;
+    nextPosition_ = 0;
+    return count > 0;
+}
+
+void FragmentList::openBlockFile( const boost::filesystem::path& filename )
+{
+    try
+    {
+        blockFile_.open( filename.string() );
+    }
+    catch (const std::exception &e)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to memory-map %s: %s") % filename % e.what()).str() ) );
+    }
+    unsigned long header[4] = { 0, 0, 0, 0 };
+    if (blockFile_.size() >= BLOCK_FILE_HEADER_SIZE)
+    {
+        memcpy( header, blockFile_.data(), sizeof(header) );
+    }
+    if (header[0] != FragmentBlockWriter::MAGIC)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s is not a fragment block file") % filename).str() ) );
+    }
+    if (header[1] != FragmentBlockWriter::VERSION)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::UnsupportedVersionException( (boost::format("%s: unsupported fragment block file version %d") % filename % header[1]).str() ) );
+    }
+    blockTileCount_ = header[2];
+
+    // Footer: all the blocks, then the blocks of each tile
+    const unsigned long fileSize = blockFile_.size();
+    unsigned long footerOffset = 0, blockCount = 0;
+    if (fileSize >= BLOCK_FILE_HEADER_SIZE + 2 * sizeof(unsigned long))
+    {
+        memcpy( &footerOffset, blockFile_.data() + fileSize - sizeof(unsigned long), sizeof(unsigned long) );
+    }
+    if (footerOffset >= BLOCK_FILE_HEADER_SIZE && footerOffset <= fileSize - 2 * sizeof(unsigned long))
+    {
+        memcpy( &blockCount, blockFile_.data() + footerOffset, sizeof(unsigned long) );
+    }
+    unsigned long listOffset = footerOffset + sizeof(unsigned long);
+    boost::shared_ptr<BlockOffsets> allBlockOffsetsPtr( new BlockOffsets );
+    boost::shared_ptr< std::vector<BlockOffsets> > tileBlockOffsetsPtr( new std::vector<BlockOffsets> );
+    BlockOffsets& blockOffsets = *allBlockOffsetsPtr;
+    std::vector<BlockOffsets>& tileBlockOffsets = *tileBlockOffsetsPtr;
+    bool validFooter = (footerOffset >= BLOCK_FILE_HEADER_SIZE && blockCount <= (fileSize - listOffset) / sizeof(unsigned long)
+                        && blockTileCount_ <= (fileSize - listOffset) / sizeof(unsigned long));
+    if (validFooter)
+    {
+        blockOffsets.resize( blockCount );
+        if (blockCount)
+        {
+            memcpy( &blockOffsets[0], blockFile_.data() + listOffset, blockCount * sizeof(unsigned long) );
+        }
+        listOffset += blockCount * sizeof(unsigned long);
+        tileBlockOffsets.resize( blockTileCount_ );
+        for (unsigned long tile=0; tile<blockTileCount_ && validFooter; ++tile)
+        {
+            unsigned long tileBlockCount = 0;
+            validFooter = (listOffset + sizeof(unsigned long) <= fileSize);
+            if (validFooter)
+            {
+                memcpy( &tileBlockCount, blockFile_.data() + listOffset, sizeof(unsigned long) );
+                listOffset += sizeof(unsigned long);
+                validFooter = (tileBlockCount <= (fileSize - listOffset) / sizeof(unsigned long));
+            }
+            if (validFooter)
+            {
+                tileBlockOffsets[tile].resize( tileBlockCount );
+                if (tileBlockCount)
+                {
+                    memcpy( &tileBlockOffsets[tile][0], blockFile_.data() + listOffset, tileBlockCount * sizeof(unsigned long) );
+                }
+                listOffset += tileBlockCount * sizeof(unsigned long);
+            }
+        }
+    }
+    if (!validFooter || fileSize != listOffset + sizeof(unsigned long))
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s is truncated (invalid footer)") % filename).str() ) );
+    }
+    for (unsigned long i=0; i<blockCount; ++i)
+    {
+        const unsigned long dataOffset = blockOffsets[i] + sizeof(FragmentBlockHeader);
+        FragmentBlockHeader blockHeader;
+        blockHeader.compressedSize = 0;
+        blockHeader.tile = 0;
+        if (blockOffsets[i] >= BLOCK_FILE_HEADER_SIZE && dataOffset <= footerOffset)
+        {
+            memcpy( &blockHeader, blockFile_.data() + blockOffsets[i], sizeof(blockHeader) );
+        }
+        if (blockOffsets[i] < BLOCK_FILE_HEADER_SIZE || dataOffset > footerOffset || blockHeader.compressedSize > footerOffset - dataOffset)
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: block %d goes beyond the end of the blocks") % filename % i).str() ) );
+        }
+        if (blockHeader.tile >= blockTileCount_ || blockHeader.recordCount > blockHeader.groupRecordCount)
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: block %d has an invalid header") % filename % i).str() ) );
+        }
+    }
+    // The lists of the tiles point to the same blocks
+    for (unsigned long tile=0; tile<blockTileCount_; ++tile)
+    {
+        for (unsigned long j=0; j<tileBlockOffsets[tile].size(); ++j)
+        {
+            if (!std::binary_search( blockOffsets.begin(), blockOffsets.end(), tileBlockOffsets[tile][j] ))
+            {
+                BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: unknown block offset in the list of tile %d") % filename % tile).str() ) );
+            }
+        }
+    }
+    allBlockOffsets_ = allBlockOffsetsPtr;
+    tileBlockOffsets_ = tileBlockOffsetsPtr;
+    blockOffsets_ = allBlockOffsets_.get();
+}
+
+bool FragmentList::decodeNextBlock( const unsigned int desiredTile, const unsigned int mask )
+{
+    // Records of several blocks get scattered at their rank in the group, to be read by increasing fragment number
+    const bool scatter = (mask != 0xFFFFFFFF);
+    while (nextBlock_ < blockOffsets_->size())
+    {
+        positionCount_ = 0;
+        nextPosition_ = 0;
+        unsigned int decodedRecordCount = 0;
+        bool lastGroup = false;
+        FragmentBlockHeader groupHeader;
+        memcpy( &groupHeader, blockFile_.data() + (*blockOffsets_)[nextBlock_], sizeof(groupHeader) );
+        while (nextBlock_ < blockOffsets_->size())
+        {
+            const char *block = blockFile_.data() + (*blockOffsets_)[nextBlock_];
+            FragmentBlockHeader header;
+            memcpy( &header, block, sizeof(header) );
+            if (header.firstFragmentNum != groupHeader.firstFragmentNum)
+            {
+                break;
+            }
+            ++nextBlock_;
+            if (header.groupRecordCount != groupHeader.groupRecordCount)
+            {
+                BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: block %d does not match the other blocks of its group") % (dir_/"fragments.blocks") % (nextBlock_-1)).str() ) );
+            }
+            if (header.minPos > lastRequestedPos_)
+            {
+                // Groups are sorted by position: none of the following ones can match either
+                lastGroup = true;
+                continue;
+            }
+            if (header.maxPos < firstRequestedPos_ || header.recordCount == 0 || (header.tile & mask) != desiredTile)
+            {
+                continue;
+            }
+            if (scatter && decodedRecordCount == 0)
+            {
+                if (positions_.size() < header.groupRecordCount)
+                {
+                    positions_.resize( header.groupRecordCount );
+                    batchLengths_.resize( header.groupRecordCount );
+                    batchTiles_.resize( header.groupRecordCount );
+                    batchFragmentNums_.resize( header.groupRecordCount );
+                }
+                std::fill( batchLengths_.begin(), batchLengths_.begin() + header.groupRecordCount, 0 ); // marks the records of the skipped blocks
+            }
+            decodeBlock( header, block, scatter );
+            decodedRecordCount += header.recordCount;
+        }
+        if (lastGroup)
+        {
+            nextBlock_ = blockOffsets_->size();
+        }
+
+        if (scatter && decodedRecordCount > 0)
+        {
+            positionCount_ = groupHeader.groupRecordCount;
+            if (decodedRecordCount < positionCount_)
+            {
+                // Removes the ranks of the skipped blocks: all the fragments have a non-zero length
+                unsigned int count = 0;
+                for (unsigned int i=0; i<positionCount_; ++i)
+                {
+                    if (batchLengths_[i])
+                    {
+                        positions_[count] = positions_[i];
+                        batchLengths_[count] = batchLengths_[i];
+                        batchTiles_[count] = batchTiles_[i];
+                        batchFragmentNums_[count] = batchFragmentNums_[i];
+                        ++count;
+                    }
+                }
+                positionCount_ = count;
+            }
+        }
+        if (positionCount_ > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FragmentList::decodeBlock( const FragmentBlockHeader& header, const char *block, const bool scatter )
+{
+    const unsigned int blockNum = nextBlock_ - 1;
+    const unsigned char *compressed = reinterpret_cast<const unsigned char *>( block + sizeof(header) );
+    blockPayload_.resize( std::max( header.payloadSize, 1u ) );
+    uLongf payloadSize = header.payloadSize;
+    if (uncompress( &blockPayload_[0], &payloadSize, compressed, header.compressedSize ) != Z_OK
+        || payloadSize != header.payloadSize
+        || checksum( &blockPayload_[0], payloadSize ) != header.checksum)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: block %d is corrupted (checksum mismatch)") % (dir_/"fragments.blocks") % blockNum).str() ) );
+    }
+
+    const unsigned int batchSize = scatter ? header.groupRecordCount : positionCount_ + header.recordCount;
+    if (positions_.size() < batchSize)
+    {
+        positions_.resize( batchSize );
+        batchLengths_.resize( batchSize );
+        batchTiles_.resize( batchSize );
+        batchFragmentNums_.resize( batchSize );
+    }
+    blockSlots_.resize( header.recordCount );
+    const unsigned char *ptr = &blockPayload_[0];
+    const unsigned char *end = ptr + payloadSize;
+    unsigned long fragmentNum = header.firstFragmentNum;
+    unsigned long value = 0;
+    bool valid = true;
+    for (unsigned int i=0; i<header.recordCount && valid; ++i)
+    {
+        valid = readVarint( ptr, end, value );
+        fragmentNum += value;
+        const unsigned long rank = fragmentNum - header.firstFragmentNum;
+        valid = valid && rank < header.groupRecordCount;
+        blockSlots_[i] = scatter ? rank : positionCount_ + i;
+        batchFragmentNums_[blockSlots_[i]] = fragmentNum;
+        batchTiles_[blockSlots_[i]] = header.tile;
+    }
+    unsigned long pos = header.minPos;
+    for (unsigned int i=0; i<header.recordCount && valid; ++i)
+    {
+        valid = readVarint( ptr, end, value );
+        pos += value;
+        positions_[blockSlots_[i]] = pos;
+    }
+    for (unsigned int i=0; i<header.recordCount && valid; ++i)
+    {
+        valid = readVarint( ptr, end, value ) && value > 0;
+        batchLengths_[blockSlots_[i]] = value;
+    }
+    if (!valid || ptr != end)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "fragments", (boost::format("%s: block %d does not contain %d records") % (dir_/"fragments.blocks") % blockNum % header.recordCount).str() ) );
+    }
+    if (!scatter)
+    {
+        positionCount_ += header.recordCount;
+    }
+}
+
 unsigned long long FragmentList::getTileSize( unsigned int tileNum )
 {
     unsigned int tileReadCount = 0;
-
-    in4.clear();
-    in4.seekg( tileNum * sizeof( unsigned int ) );
-    in4.read( (char*)&tileReadCount, sizeof( unsigned int ) );
+    if (statsFile_.is_open() && (tileNum + 1) * sizeof( unsigned int ) <= statsFile_.size())
+    {
+        memcpy( &tileReadCount, statsFile_.data() + tileNum * sizeof( unsigned int ), sizeof( unsigned int ) );
+    }
     return tileReadCount;
 }
 
 unsigned long long FragmentList::size()
 {
     unsigned long long allTilesReadCount = 0;
-
-    in4.clear();
-    in4.seekg( 0 );
-    while (in4.good())
+    const unsigned int tileCount = statsFile_.is_open() ? statsFile_.size() / sizeof( unsigned int ) : 0;
+    for (unsigned int tileNum=0; tileNum<tileCount; ++tileNum)
     {
-        unsigned int tileReadCount = 0;
-        in4.read( (char*)&tileReadCount, sizeof( unsigned int ) );
-        allTilesReadCount += tileReadCount;
+        allTilesReadCount += getTileSize( tileNum );
     }
     return allTilesReadCount;
 }
 
 
-//class MultiFragmentFilesReader
-MultiFragmentFilesReader::MultiFragmentFilesReader( const std::vector<unsigned long>& contigLengths, const std::vector<string>& contigNames, const boost::filesystem::path& dir, unsigned long& readCount, const bool verbose )
-//    : IntervalGenerator( contigLengths, readCount, 0, 0, 0, verbose)
-    : contigLengths_( contigLengths )
-    , contigNames_( contigNames )
-    , dir_( dir )
-    , currentContigNum_( 0 )
-    , currentContigStartPos_( 0 )
-    , fragmentList_( 0 )
+bool FragmentList::selectTile( unsigned int tileNum )
 {
-    openNextFragmentList( false );
+    if (!manifestEntries_.empty())
+    {
+        // Each directory selects the tile in its own blocks, or falls back to reading all its fragments
+        assert( nextManifestEntry_ == 0 && "Tile selection must happen before reading any fragment" );
+        selectedTile_ = tileNum;
+        tileSelected_ = true;
+        return true;
+    }
+
+    if (legacyTileRecords_)
+    {
+        assert( nextTileRecord_ == 0 && "Tile selection must happen before reading any fragment" );
+        selectedTile_ = tileNum;
+        tileSelected_ = true;
+        return true;
+    }
+
+    if (!blockFile_.is_open())
+    {
+        clog << "No fragment blocks found in " << dir_ << ": reading all the fragments to extract tile " << tileNum << endl;
+        return false;
+    }
+    assert( nextBlock_ == 0 && "Tile selection must happen before reading any fragment" );
+    if (tileNum >= blockTileCount_)
+    {
+        EAGLE_ERROR( (boost::format("Tile %d requested, but %s only contains %d tiles") % tileNum % (dir_/"fragments.blocks").string() % blockTileCount_).str() );
+    }
+
+    // Only walk through the blocks of this tile
+    blockOffsets_ = &(*tileBlockOffsets_)[tileNum];
+    clog << (boost::format("Using %d fragment block(s) for tile %d") % blockOffsets_->size() % tileNum).str() << endl;
+    selectedTile_ = tileNum;
+    tileSelected_ = true;
+    return true;
 }
 
-FragmentWithAllocationMetadata MultiFragmentFilesReader::getNext( const signed long testValue )
+void FragmentList::indexTiles()
 {
-    while (1)
+    if (!manifestEntries_.empty())
     {
-        FragmentWithAllocationMetadata f = fragmentList_->getNextWithTile( 0, 0 );
-        if (f.isValid())
+        assert( nextManifestEntry_ == 0 && "Tiles must be indexed before reading any fragment" );
+        manifestEntryLists_.resize( manifestEntries_.size() );
+        for (unsigned int entryNum=0; entryNum<manifestEntries_.size(); ++entryNum)
         {
-            f.startPos_ += currentContigStartPos_;
-            return f;
+            if (isManifestEntryInRegion( entryNum ))
+            {
+                FragmentList *entryList = openManifestEntry( entryNum );
+                manifestEntryLists_[entryNum].reset( entryList );
+                entryList->indexTiles();
+            }
         }
-        else
+        return;
+    }
+    if (blockFile_.is_open() || legacyTileRecords_)
+    {
+        return; // fragments.blocks has its own tile lists, and the legacy files only get indexed once
+    }
+
+    // Legacy files: one pass through all the fragments, instead of one per tile
+    assert( nextPosition_ == positionCount_ && "Tiles must be indexed before reading any fragment" );
+    boost::shared_ptr< std::vector<TileRecords> > tileRecords( new std::vector<TileRecords> );
+    bool endOfRegion = false;
+    while (!endOfRegion && decodeNextPositions())
+    {
+        for (unsigned int i=0; i<positionCount_; ++i)
         {
-            if (!openNextFragmentList( true ))
+            endOfRegion = (positions_[i] > lastRequestedPos_);
+            if (endOfRegion)
+            {
+                break;
+            }
+            const unsigned int tile = batchTiles_[i];
+            if (tile >= tileRecords->size())
             {
-                return FragmentWithAllocationMetadata();
+                tileRecords->resize( tile + 1 );
             }
+            (*tileRecords)[tile].positions.push_back( positions_[i] );
+            (*tileRecords)[tile].fragmentNums.push_back( batchFragmentNums_[i] );
         }
+        fragmentNum_ += positionCount_;
+        currentPos_ = positions_[positionCount_-1];
+    }
+    nextPosition_ = positionCount_;
+    legacyTileRecords_ = tileRecords;
+    clog << "Indexed the tiles of the fragments in " << dir_ << endl;
+}
+
+FragmentList FragmentList::tileView( const unsigned int tileNum ) const
+{
+    FragmentList view( *this );
+    view.selectTile( tileNum );
+    return view;
+}
+
+
+//class FragmentManifestWriter
+FragmentManifestWriter::FragmentManifestWriter( const boost::filesystem::path& filename )
+    : filename_( filename )
+    , out_( filename.string().c_str() )
+{
+    out_ << "#EAGLE fragments manifest v" << VERSION << endl;
+    out_ << "#directory\tglobalPosOffset\tfragmentCount" << endl;
+}
+
+void FragmentManifestWriter::add( const boost::filesystem::path& dir, const unsigned long posOffset, const unsigned long fragmentCount )
+{
+    out_ << dir.string() << '\t' << posOffset << '\t' << fragmentCount << endl;
+}
+
+void FragmentManifestWriter::close()
+{
+    out_.close();
+    if (out_.fail())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to write %s") % filename_).str() ) );
     }
 }
 
-bool MultiFragmentFilesReader::openNextFragmentList( bool advance )
+
+//class FragmentBlockWriter
+FragmentBlockWriter::FragmentBlockWriter( const boost::filesystem::path& filename, const unsigned long tileCount, const unsigned int groupSize )
+    : filename_( filename )
+    , out_( filename.string().c_str(), ios::binary )
+    , tileCount_( tileCount )
+    , groupSize_( groupSize )
+    , fragmentCount_( 0 )
+    , tileRecords_( tileCount )
+    , tileBlockOffsets_( tileCount )
+    , closed_( false )
 {
-    if (fragmentList_)
+    if (!out_.good())
     {
-        delete fragmentList_;
-        fragmentList_ = 0;
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Cannot create file %s") % filename).str() ) );
     }
-    if (currentContigNum_ >= contigNames_.size())
+    const unsigned long header[4] = { MAGIC, VERSION, tileCount, groupSize };
+    out_.write( (char*)header, sizeof(header) );
+    positions_.reserve( groupSize_ );
+    lengths_.reserve( groupSize_ );
+}
+
+FragmentBlockWriter::~FragmentBlockWriter()
+{
+    if (closed_)
     {
-        return false;
+        return;
+    }
+    // Only reached without close() while unwinding from another error: report this one instead of throwing it
+    try
+    {
+        close();
+    }
+    catch (const std::exception &e)
+    {
+        EAGLE_WARNING( "Failed to close " << filename_ << ": " << e.what() );
+    }
+}
+
+void FragmentBlockWriter::add( const FragmentWithAllocationMetadata& f )
+{
+    assert( f.allocatedTile_ < tileCount_ );
+    assert( (positions_.empty() || f.startPos_ >= positions_.back()) && "Fragments must be sorted by position" );
+    assert( f.fragmentLength_ > 0 && "Zero-length fragments cannot be stored" );
+    tileRecords_[f.allocatedTile_].push_back( positions_.size() );
+    positions_.push_back( f.startPos_ );
+    lengths_.push_back( f.fragmentLength_ );
+    if (positions_.size() >= groupSize_)
+    {
+        flushGroup();
     }
-    if (advance)
+}
+
+void FragmentBlockWriter::flushGroup()
+{
+    if (positions_.empty())
     {
-        currentContigStartPos_ += contigLengths_[ currentContigNum_ ];
-        ++currentContigNum_;
-        if (currentContigNum_ >= contigNames_.size())
+        return;
+    }
+    for (unsigned int tile=0; tile<tileCount_; ++tile)
+    {
+        if (!tileRecords_[tile].empty())
         {
-            return false;
+            writeBlock( tile );
+            tileRecords_[tile].clear();
         }
     }
-    const boost::filesystem::path dir( dir_/(string("fragments_")+contigNames_[ currentContigNum_ ]) );
-    if (is_directory(dir))
+    fragmentCount_ += positions_.size();
+    positions_.clear();
+    lengths_.clear();
+}
+
+void FragmentBlockWriter::writeBlock( const unsigned int tile )
+{
+    const vector<unsigned int>& records = tileRecords_[tile];
+    FragmentBlockHeader header;
+    memset( &header, 0, sizeof(header) );
+    header.firstFragmentNum = fragmentCount_;
+    header.minPos = positions_[records.front()];
+    header.tile = tile;
+    header.recordCount = records.size();
+    header.groupRecordCount = positions_.size();
+
+    payload_.clear();
+    unsigned int lastRank = 0;
+    for (unsigned int i=0; i<records.size(); ++i)
     {
-        clog << "Opening directory " << dir << endl;
-        fragmentList_ = new FragmentList( dir );
-        return true;
+        appendVarint( payload_, records[i] - lastRank );
+        lastRank = records[i];
     }
-    else
+    unsigned long lastPos = header.minPos;
+    for (unsigned int i=0; i<records.size(); ++i)
     {
-        EAGLE_ERROR( (boost::format("Missing directory %s") % dir.string()).str() );
+        const unsigned int rank = records[i];
+        appendVarint( payload_, positions_[rank] - lastPos );
+        lastPos = positions_[rank];
+        header.maxPos = std::max( header.maxPos, positions_[rank] + lengths_[rank] - 1 );
+    }
+    for (unsigned int i=0; i<records.size(); ++i)
+    {
+        appendVarint( payload_, lengths_[records[i]] );
+    }
+    header.payloadSize = payload_.size();
+    header.checksum = checksum( &payload_[0], payload_.size() );
+
+    uLongf compressedSize = compressBound( payload_.size() );
+    compressed_.resize( compressedSize );
+    if (compress2( &compressed_[0], &compressedSize, &payload_[0], payload_.size(), Z_DEFAULT_COMPRESSION ) != Z_OK)
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::EagleException( 0, (boost::format("%s: failed to compress block %d") % filename_ % blockOffsets_.size()).str() ) );
+    }
+    header.compressedSize = compressedSize;
+
+    blockOffsets_.push_back( out_.tellp() );
+    tileBlockOffsets_[tile].push_back( blockOffsets_.back() );
+    out_.write( (char*)&header, sizeof(header) );
+    out_.write( (char*)&compressed_[0], compressedSize );
+}
+
+void FragmentBlockWriter::close()
+{
+    if (closed_)
+    {
+        return;
+    }
+    flushGroup();
+
+    const unsigned long footerOffset = out_.tellp();
+    const unsigned long blockCount = blockOffsets_.size();
+    out_.write( (char*)&blockCount, sizeof(unsigned long));
+    if (blockCount)
+    {
+        out_.write( (char*)&blockOffsets_[0], blockCount * sizeof(unsigned long));
+    }
+    for (unsigned int tile=0; tile<tileCount_; ++tile)
+    {
+        const unsigned long tileBlockCount = tileBlockOffsets_[tile].size();
+        out_.write( (char*)&tileBlockCount, sizeof(unsigned long));
+        if (tileBlockCount)
+        {
+            out_.write( (char*)&tileBlockOffsets_[tile][0], tileBlockCount * sizeof(unsigned long));
+        }
+    }
+    out_.write( (char*)&footerOffset, sizeof(unsigned long));
+    out_.close();
+    closed_ = true;
+    if (out_.fail())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to write %s") % filename_).str() ) );
     }
-    return false;
 }
 
 
@@ -0,0 +1,81 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <boost/assign.hpp>
+
+using namespace std;
+using boost::assign::list_of;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testAliasTable.hh"
+
+using eagle::model::AliasTables;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestAliasTable, registryName("AliasTable"));
+
+
+void TestAliasTable::setUp()
+{
+}
+
+void TestAliasTable::tearDown()
+{
+}
+
+void TestAliasTable::testFrequencies()
+{
+    // Tables of different widths, including zero weights
+    const vector< vector< double > > weights = list_of
+        ( list_of(1.0)(2.0)(3.0)(4.0).convert_to_container< vector< double > >() )
+        ( list_of(0.0)(5.0)(0.0)(15.0)(0.0)(0.0)(30.0).convert_to_container< vector< double > >() )
+        ( list_of(0.0)(1.0).convert_to_container< vector< double > >() );
+    const AliasTables tables( weights );
+    CPPUNIT_ASSERT_EQUAL( 3u, tables.size() );
+
+    // Evenly spread random numbers must reproduce the weights
+    const unsigned int sampleCount = 1000000;
+    for (unsigned int t=0; t<weights.size(); ++t)
+    {
+        vector< unsigned int > counts( 10, 0 );
+        for (unsigned int i=0; i<sampleCount; ++i)
+        {
+            ++counts[ tables.get( t, static_cast<uint32_t>( (4294967296.0 * i) / sampleCount ) ) ];
+        }
+        const double sum = accumulate( weights[t].begin(), weights[t].end(), 0.0 );
+        for (unsigned int j=0; j<counts.size(); ++j)
+        {
+            const double expected = (j < weights[t].size()) ? weights[t][j] / sum : 0.0;
+            CPPUNIT_ASSERT_DOUBLES_EQUAL( expected, double(counts[j]) / sampleCount, 0.0001 );
+        }
+        CPPUNIT_ASSERT_EQUAL( (unsigned int)weights[t].size(), tables.outcomeCount( t ) );
+    }
+}
+
+void TestAliasTable::testDegenerateTables()
+{
+    // Empty and all-zero weights always return 0, like boost::random::discrete_distribution
+    const vector< vector< double > > weights = list_of
+        ( vector< double >() )
+        ( vector< double >( 3, 0.0 ) )
+        ( list_of(0.0)(0.0)(0.0)(2.0).convert_to_container< vector< double > >() );
+    const AliasTables tables( weights );
+    CPPUNIT_ASSERT_EQUAL( 1u, tables.outcomeCount( 0 ) );
+    for (unsigned int i=0; i<1000; ++i)
+    {
+        const uint32_t random = i * 4294967u;
+        CPPUNIT_ASSERT_EQUAL( 0u, tables.get( 0, random ) );
+        CPPUNIT_ASSERT_EQUAL( 0u, tables.get( 1, random ) );
+        CPPUNIT_ASSERT_EQUAL( 3u, tables.get( 2, random ) );
+    }
+    CPPUNIT_ASSERT_EQUAL( 3u, tables.get( 2, 0xFFFFFFFF ) );
+}
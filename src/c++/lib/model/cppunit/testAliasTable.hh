@@ -0,0 +1,30 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_MODEL_TEST_ALIAS_TABLE_HH
+#define EAGLE_MODEL_TEST_ALIAS_TABLE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "model/AliasTable.hh"
+
+
+class TestAliasTable : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestAliasTable );
+    CPPUNIT_TEST( testFrequencies );
+    CPPUNIT_TEST( testDegenerateTables );
+    CPPUNIT_TEST_SUITE_END();
+private:
+public:
+    void setUp();
+    void tearDown();
+    void testFrequencies();
+    void testDegenerateTables();
+};
+
+#endif //EAGLE_MODEL_TEST_ALIAS_TABLE_HH
@@ -5,10 +5,12 @@
  ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
  **/
 
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <boost/assign.hpp>
+#include <boost/filesystem.hpp>
 
 using namespace std;
 using boost::assign::list_of;
@@ -17,8 +19,13 @@ using boost::assign::list_of;
 
 #include "RegistryName.hh"
 #include "testFragment.hh"
+#include "common/Exceptions.hh"
 
 using eagle::model::Fragment;
+using eagle::model::FragmentBlockWriter;
+using eagle::model::FragmentList;
+using eagle::model::FragmentManifestWriter;
+using eagle::model::FragmentWithAllocationMetadata;
 
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFragment, registryName("Fragment"));
 
@@ -35,3 +42,361 @@ void TestFragment::tearDown()
 void TestFragment::testFragment()
 {
 }
+
+void TestFragment::testSelectTile()
+{
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir );
+
+    // No blocks yet: the caller must fall back to reading all the fragments
+    CPPUNIT_ASSERT( !FragmentList( dir ).selectTile( 0 ) );
+
+    // 3 tiles, groups of 2 records => tile 1 gets split over several blocks
+    {
+        FragmentBlockWriter writer( dir / "fragments.blocks", 3, 2 );
+        for (unsigned long i=0; i<10; ++i)
+        {
+            writer.add( FragmentWithAllocationMetadata( 1000 + 10*i, 300 + i, i, i % 3 ) );
+        }
+    }
+
+    FragmentList fragmentList( dir );
+    CPPUNIT_ASSERT( fragmentList.selectTile( 1 ) );
+    const unsigned long expectedFragmentNums[] = { 1, 4, 7 };
+    BOOST_FOREACH( const unsigned long fragmentNum, expectedFragmentNums )
+    {
+        unsigned int tile = 0;
+        Fragment f = fragmentList.getNext( 1, -1, &tile );
+        CPPUNIT_ASSERT( f.isValid() );
+        CPPUNIT_ASSERT_EQUAL( 1u, tile );
+        CPPUNIT_ASSERT_EQUAL( fragmentNum, f.fragmentNum_ );
+        CPPUNIT_ASSERT_EQUAL( 1000 + 10*fragmentNum, f.startPos_ );
+        CPPUNIT_ASSERT_EQUAL( 300 + fragmentNum, f.fragmentLength_ );
+    }
+    CPPUNIT_ASSERT( !fragmentList.getNext( 1 ).isValid() );
+
+    CPPUNIT_ASSERT_THROW( FragmentList( dir ).selectTile( 3 ), eagle::common::EagleException );
+
+    boost::filesystem::remove_all( dir );
+}
+
+void TestFragment::testFragmentList()
+{
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir );
+
+    // Enough fragments to span several decoding batches, with a few position differences needing the 65535 escape
+    const unsigned long fragmentCount = 10000;
+    vector<unsigned long> positions;
+    {
+        ofstream posFile( (dir/"fragments.pos").string().c_str(), ios::binary );
+        ofstream lengthFile( (dir/"fragments.length").string().c_str(), ios::binary );
+        ofstream tileFile( (dir/"fragments.tile").string().c_str(), ios::binary );
+        ofstream statsFile( (dir/"fragments.stats").string().c_str(), ios::binary );
+        unsigned long pos = 0;
+        unsigned int tileReadCount[3] = { 0, 0, 0 };
+        for (unsigned long i=0; i<fragmentCount; ++i)
+        {
+            const unsigned long posDiff = (i % 1000 == 999) ? 0x123456789ul + i : i % 100;
+            if (posDiff < 65535)
+            {
+                const unsigned short posDiff16 = posDiff;
+                posFile.write( (const char*)&posDiff16, 2 );
+            }
+            else
+            {
+                const unsigned short escape[4] = { 65535, (unsigned short)(posDiff >> 32), (unsigned short)(posDiff >> 16), (unsigned short)posDiff };
+                posFile.write( (const char*)escape, sizeof(escape) );
+            }
+            pos += posDiff;
+            positions.push_back( pos );
+            const unsigned short length = 300 + i % 50;
+            const unsigned short tile = i % 3;
+            lengthFile.write( (const char*)&length, 2 );
+            tileFile.write( (const char*)&tile, 2 );
+            ++tileReadCount[tile];
+        }
+        statsFile.write( (const char*)tileReadCount, sizeof(tileReadCount) );
+    }
+
+    FragmentList fragmentList( dir );
+    CPPUNIT_ASSERT_EQUAL( 10000ull, fragmentList.size() );
+    CPPUNIT_ASSERT_EQUAL( 3333ull, fragmentList.getTileSize( 1 ) );
+    CPPUNIT_ASSERT_EQUAL( 0ull, fragmentList.getTileSize( 3 ) );
+    for (unsigned long i=0; i<fragmentCount; ++i)
+    {
+        unsigned int tile = 0;
+        Fragment f = fragmentList.getNext( 0, 0, &tile );
+        CPPUNIT_ASSERT( f.isValid() );
+        CPPUNIT_ASSERT_EQUAL( positions[i], f.startPos_ );
+        CPPUNIT_ASSERT_EQUAL( 300 + i % 50, f.fragmentLength_ );
+        CPPUNIT_ASSERT_EQUAL( i, f.fragmentNum_ );
+        CPPUNIT_ASSERT_EQUAL( (unsigned int)(i % 3), tile );
+    }
+    CPPUNIT_ASSERT( !fragmentList.getNext().isValid() );
+
+    // Fragments of one tile, skipping the others
+    FragmentList tileFragmentList( dir );
+    for (unsigned long i=2; i<fragmentCount; i+=3)
+    {
+        Fragment f = tileFragmentList.getNext( 2 );
+        CPPUNIT_ASSERT_EQUAL( positions[i], f.startPos_ );
+        CPPUNIT_ASSERT_EQUAL( i, f.fragmentNum_ );
+    }
+    CPPUNIT_ASSERT( !tileFragmentList.getNext( 2 ).isValid() );
+
+    // Missing files behave as empty ones
+    CPPUNIT_ASSERT( !FragmentList( dir / "missing" ).getNext().isValid() );
+    CPPUNIT_ASSERT_EQUAL( 0ull, FragmentList( dir / "missing" ).size() );
+
+    boost::filesystem::remove_all( dir );
+}
+
+void TestFragment::testFragmentBlocks()
+{
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir );
+
+    // 10 groups of 1000 fragments, with a large gap in the middle, and tile 2 only present in group 5
+    const unsigned long fragmentCount = 10000;
+    vector<FragmentWithAllocationMetadata> fragments;
+    {
+        FragmentBlockWriter writer( dir / "fragments.blocks", 3, 1000 );
+        unsigned long pos = 0;
+        for (unsigned long i=0; i<fragmentCount; ++i)
+        {
+            pos += (i == 7000) ? 0x123456789ul : i % 100;
+            fragments.push_back( FragmentWithAllocationMetadata( pos, 300 + i % 50, i, (i / 1000 == 5) ? 2 : i % 2 ) );
+            writer.add( fragments.back() );
+        }
+    }
+
+    FragmentList fragmentList( dir );
+    for (unsigned long i=0; i<fragmentCount; ++i)
+    {
+        unsigned int tile = 0;
+        Fragment f = fragmentList.getNext( 0, 0, &tile );
+        CPPUNIT_ASSERT( f.isValid() );
+        CPPUNIT_ASSERT_EQUAL( fragments[i].startPos_, f.startPos_ );
+        CPPUNIT_ASSERT_EQUAL( fragments[i].fragmentLength_, f.fragmentLength_ );
+        CPPUNIT_ASSERT_EQUAL( i, f.fragmentNum_ );
+        CPPUNIT_ASSERT_EQUAL( fragments[i].allocatedTile_, tile );
+    }
+    CPPUNIT_ASSERT( !fragmentList.getNext().isValid() );
+
+    // Only group 5 contains tile 2
+    FragmentList tileFragmentList( dir );
+    for (unsigned long i=5000; i<6000; ++i)
+    {
+        Fragment f = tileFragmentList.getNext( 2 );
+        CPPUNIT_ASSERT_EQUAL( fragments[i].startPos_, f.startPos_ );
+        CPPUNIT_ASSERT_EQUAL( i, f.fragmentNum_ );
+    }
+    CPPUNIT_ASSERT( !tileFragmentList.getNext( 2 ).isValid() );
+
+    // Tiles 0 and 1 through a partial mask: their blocks get merged by fragment number
+    FragmentList maskFragmentList( dir );
+    for (unsigned long i=0; i<fragmentCount; ++i)
+    {
+        if (fragments[i].allocatedTile_ < 2)
+        {
+            Fragment f = maskFragmentList.getNext( 0, 2 );
+            CPPUNIT_ASSERT_EQUAL( i, f.fragmentNum_ );
+        }
+    }
+    CPPUNIT_ASSERT( !maskFragmentList.getNext( 0, 2 ).isValid() );
+
+    // Region: every fragment overlapping [firstPos,lastPos], including those starting before firstPos
+    const unsigned long firstPos = fragments[3500].startPos_;
+    const unsigned long lastPos = fragments[6500].startPos_;
+    FragmentList regionFragmentList( dir, firstPos, lastPos );
+    for (unsigned long i=0; i<fragmentCount; ++i)
+    {
+        if (fragments[i].startPos_ + fragments[i].fragmentLength_ - 1 >= firstPos && fragments[i].startPos_ <= lastPos)
+        {
+            Fragment f = regionFragmentList.getNext();
+            CPPUNIT_ASSERT_EQUAL( i, f.fragmentNum_ );
+        }
+    }
+    CPPUNIT_ASSERT( !regionFragmentList.getNext().isValid() );
+
+    // A corrupted block (tile 0 of group 0) is detected when decoded, and only then
+    {
+        fstream file( (dir / "fragments.blocks").string().c_str(), ios::in | ios::out | ios::binary );
+        file.seekp( 4 * sizeof(unsigned long) + sizeof(eagle::model::FragmentBlockHeader) + 10 );
+        file.put( 0x55 );
+    }
+    FragmentList corruptedFragmentList( dir );
+    CPPUNIT_ASSERT_THROW( corruptedFragmentList.getNext(), eagle::common::CorruptedFileException );
+    FragmentList otherTileFragmentList( dir );
+    CPPUNIT_ASSERT_EQUAL( 5000ul, otherTileFragmentList.getNext( 2 ).fragmentNum_ );
+    FragmentList selectedTileFragmentList( dir );
+    CPPUNIT_ASSERT( selectedTileFragmentList.selectTile( 1 ) );
+    CPPUNIT_ASSERT_EQUAL( 1ul, selectedTileFragmentList.getNext( 1 ).fragmentNum_ );
+
+    boost::filesystem::remove_all( dir );
+}
+
+void TestFragment::testFragmentManifest()
+{
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir );
+
+    // 3 contigs of 100000 bases, the 2nd one without any fragment
+    const unsigned long contigLength = 100000;
+    const unsigned long fragmentCounts[] = { 500, 0, 300 };
+    vector<FragmentWithAllocationMetadata> fragments; // expected global fragments
+    {
+        FragmentManifestWriter manifestWriter( dir / "fragments.manifest" );
+        for (unsigned int contig=0; contig<3; ++contig)
+        {
+            const string contigDir = (boost::format("fragments_chr%d") % contig).str();
+            boost::filesystem::create_directories( dir / contigDir );
+            FragmentBlockWriter blockWriter( dir / contigDir / "fragments.blocks", 3, 100 );
+            unsigned int tileReadCount[3] = { 0, 0, 0 };
+            for (unsigned long i=0; i<fragmentCounts[contig]; ++i)
+            {
+                const FragmentWithAllocationMetadata f( 100*i + contig, 300 + i % 50, i, (i + contig) % 3 );
+                blockWriter.add( f );
+                ++tileReadCount[f.allocatedTile_];
+                fragments.push_back( FragmentWithAllocationMetadata( f.startPos_ + contig*contigLength, f.fragmentLength_, fragments.size(), f.allocatedTile_ ) );
+            }
+            ofstream statsFile( (dir/contigDir/"fragments.stats").string().c_str(), ios::binary );
+            statsFile.write( (const char*)tileReadCount, sizeof(tileReadCount) );
+            manifestWriter.add( contigDir, contig*contigLength, fragmentCounts[contig] );
+        }
+        manifestWriter.close();
+    }
+
+    FragmentList fragmentList( dir );
+    BOOST_FOREACH( const FragmentWithAllocationMetadata& expected, fragments )
+    {
+        unsigned int tile = 0;
+        Fragment f = fragmentList.getNext( 0, 0, &tile );
+        CPPUNIT_ASSERT( f.isValid() );
+        CPPUNIT_ASSERT_EQUAL( expected.startPos_, f.startPos_ );
+        CPPUNIT_ASSERT_EQUAL( expected.fragmentLength_, f.fragmentLength_ );
+        CPPUNIT_ASSERT_EQUAL( expected.fragmentNum_, f.fragmentNum_ );
+        CPPUNIT_ASSERT_EQUAL( expected.allocatedTile_, tile );
+    }
+    CPPUNIT_ASSERT( !fragmentList.getNext().isValid() );
+
+    // Tile selection goes through each directory's blocks
+    FragmentList tileFragmentList( dir );
+    CPPUNIT_ASSERT( tileFragmentList.selectTile( 1 ) );
+    BOOST_FOREACH( const FragmentWithAllocationMetadata& expected, fragments )
+    {
+        if (expected.allocatedTile_ == 1)
+        {
+            Fragment f = tileFragmentList.getNext( 1 );
+            CPPUNIT_ASSERT_EQUAL( expected.startPos_, f.startPos_ );
+            CPPUNIT_ASSERT_EQUAL( expected.fragmentNum_, f.fragmentNum_ );
+        }
+    }
+    CPPUNIT_ASSERT( !tileFragmentList.getNext( 1 ).isValid() );
+
+    // Region overlapping the end of the 1st contig and the start of the 3rd one
+    const unsigned long firstPos = 45000;
+    const unsigned long lastPos = 2*contigLength + 1000;
+    FragmentList regionFragmentList( dir, firstPos, lastPos );
+    BOOST_FOREACH( const FragmentWithAllocationMetadata& expected, fragments )
+    {
+        if (expected.startPos_ + expected.fragmentLength_ - 1 >= firstPos && expected.startPos_ <= lastPos)
+        {
+            Fragment f = regionFragmentList.getNext();
+            CPPUNIT_ASSERT_EQUAL( expected.fragmentNum_, f.fragmentNum_ );
+        }
+    }
+    CPPUNIT_ASSERT( !regionFragmentList.getNext().isValid() );
+
+    // Manifests can list other manifests, e.g. to merge several datasets
+    const boost::filesystem::path mergedDir = dir / "merged";
+    boost::filesystem::create_directories( mergedDir );
+    {
+        FragmentManifestWriter manifestWriter( mergedDir / "fragments.manifest" );
+        manifestWriter.add( "..", 0, fragments.size() );
+        manifestWriter.add( dir, 3*contigLength, fragments.size() );
+        manifestWriter.close();
+    }
+    FragmentList mergedFragmentList( mergedDir );
+    for (unsigned int dataset=0; dataset<2; ++dataset)
+    {
+        BOOST_FOREACH( const FragmentWithAllocationMetadata& expected, fragments )
+        {
+            Fragment f = mergedFragmentList.getNext();
+            CPPUNIT_ASSERT_EQUAL( expected.startPos_ + dataset*3*contigLength, f.startPos_ );
+            CPPUNIT_ASSERT_EQUAL( expected.fragmentNum_ + dataset*fragments.size(), f.fragmentNum_ );
+        }
+    }
+    CPPUNIT_ASSERT( !mergedFragmentList.getNext().isValid() );
+
+    // Unknown versions are rejected
+    {
+        ofstream manifestFile( (mergedDir / "fragments.manifest").string().c_str() );
+        manifestFile << "#EAGLE fragments manifest v2" << endl;
+    }
+    CPPUNIT_ASSERT_THROW( FragmentList( mergedDir ).size(), eagle::common::UnsupportedVersionException );
+
+    boost::filesystem::remove_all( dir );
+}
+
+void TestFragment::testTileViews()
+{
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( dir / "legacy" );
+    boost::filesystem::create_directories( dir / "blocks" );
+
+    // One legacy directory and one fragments.blocks directory, merged by a manifest
+    const unsigned long fragmentCount = 10000;
+    {
+        ofstream posFile( (dir/"legacy"/"fragments.pos").string().c_str(), ios::binary );
+        ofstream lengthFile( (dir/"legacy"/"fragments.length").string().c_str(), ios::binary );
+        ofstream tileFile( (dir/"legacy"/"fragments.tile").string().c_str(), ios::binary );
+        FragmentBlockWriter blockWriter( dir / "blocks" / "fragments.blocks", 3, 1000 );
+        for (unsigned long i=0; i<fragmentCount; ++i)
+        {
+            const unsigned short posDiff = 10;
+            const unsigned short length = 300 + i % 50;
+            const unsigned short tile = (i * 7) % 3;
+            posFile.write( (const char*)&posDiff, 2 );
+            lengthFile.write( (const char*)&length, 2 );
+            tileFile.write( (const char*)&tile, 2 );
+            blockWriter.add( FragmentWithAllocationMetadata( 10*(i+1), length, i, tile ) );
+        }
+        FragmentManifestWriter manifestWriter( dir / "fragments.manifest" );
+        manifestWriter.add( "legacy", 0, fragmentCount );
+        manifestWriter.add( "blocks", 1000000, fragmentCount );
+        manifestWriter.close();
+    }
+
+    // The views of an indexed list, created in any order, give the same fragments as reading each tile on its own
+    const char *subDirs[] = { "legacy", "blocks", "" };
+    BOOST_FOREACH( const char *subDir, subDirs )
+    {
+        FragmentList fragmentList( dir / subDir );
+        fragmentList.indexTiles();
+        vector< boost::shared_ptr<FragmentList> > views;
+        for (unsigned int tile=3; tile>0; --tile)
+        {
+            views.push_back( boost::shared_ptr<FragmentList>( new FragmentList( fragmentList.tileView( tile-1 ) ) ) );
+        }
+        for (unsigned int tile=0; tile<3; ++tile)
+        {
+            FragmentList& view = *views[2-tile];
+            FragmentList expectedList( dir / subDir );
+            unsigned long count = 0;
+            for (Fragment expected = expectedList.getNext( tile ); expected.isValid(); expected = expectedList.getNext( tile ), ++count)
+            {
+                Fragment f = view.getNext( tile );
+                CPPUNIT_ASSERT( f.isValid() );
+                CPPUNIT_ASSERT_EQUAL( expected.startPos_, f.startPos_ );
+                CPPUNIT_ASSERT_EQUAL( expected.fragmentLength_, f.fragmentLength_ );
+                CPPUNIT_ASSERT_EQUAL( expected.fragmentNum_, f.fragmentNum_ );
+            }
+            CPPUNIT_ASSERT( !view.getNext( tile ).isValid() );
+            CPPUNIT_ASSERT( count >= fragmentCount / 3 );
+        }
+    }
+
+    boost::filesystem::remove_all( dir );
+}
@@ -17,12 +17,22 @@ class TestFragment : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE( TestFragment );
     CPPUNIT_TEST( testFragment );
+    CPPUNIT_TEST( testSelectTile );
+    CPPUNIT_TEST( testFragmentList );
+    CPPUNIT_TEST( testFragmentBlocks );
+    CPPUNIT_TEST( testFragmentManifest );
+    CPPUNIT_TEST( testTileViews );
     CPPUNIT_TEST_SUITE_END();
 private:
 public:
     void setUp();
     void tearDown();
     void testFragment();
+    void testSelectTile();
+    void testFragmentList();
+    void testFragmentBlocks();
+    void testFragmentManifest();
+    void testTileViews();
 };
 
 #endif //EAGLE_MODEL_TEST_FRAGMENT_HH
@@ -0,0 +1,77 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "Helpers.hh"
+
+#include "RegistryName.hh"
+#include "testFragmentRandomGenerator.hh"
+
+using eagle::model::FragmentRandomGenerator;
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFragmentRandomGenerator, registryName("FragmentRandomGenerator"));
+
+
+void TestFragmentRandomGenerator::setUp()
+{
+}
+
+void TestFragmentRandomGenerator::tearDown()
+{
+}
+
+void TestFragmentRandomGenerator::testKnownAnswers()
+{
+    // Philox4x32-10 test vectors from the Random123 distribution
+    uint32_t result[4];
+
+    const uint32_t counter1[4] = { 0, 0, 0, 0 };
+    const uint32_t key1[2] = { 0, 0 };
+    FragmentRandomGenerator::philox4x32( counter1, key1, result );
+    CPPUNIT_ASSERT_EQUAL( 0x6627e8d5u, result[0] );
+    CPPUNIT_ASSERT_EQUAL( 0xe169c58du, result[1] );
+    CPPUNIT_ASSERT_EQUAL( 0xbc57ac4cu, result[2] );
+    CPPUNIT_ASSERT_EQUAL( 0x9b00dbd8u, result[3] );
+
+    const uint32_t counter2[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+    const uint32_t key2[2] = { 0xa4093822, 0x299f31d0 };
+    FragmentRandomGenerator::philox4x32( counter2, key2, result );
+    CPPUNIT_ASSERT_EQUAL( 0xd16cfe09u, result[0] );
+    CPPUNIT_ASSERT_EQUAL( 0x94fdccebu, result[1] );
+    CPPUNIT_ASSERT_EQUAL( 0x5001e420u, result[2] );
+    CPPUNIT_ASSERT_EQUAL( 0x24126ea1u, result[3] );
+}
+
+void TestFragmentRandomGenerator::testReproducibility()
+{
+    // The stream of a fragment doesn't depend on which other fragments were generated before
+    vector< uint32_t > expected;
+    FragmentRandomGenerator gen1( 1, 123456789012ul );
+    for (unsigned int i=0; i<10; ++i)
+    {
+        expected.push_back( gen1() );
+    }
+
+    FragmentRandomGenerator other( 1, 123456789013ul );
+    other();
+    FragmentRandomGenerator gen2( 1, 123456789012ul );
+    for (unsigned int i=0; i<10; ++i)
+    {
+        CPPUNIT_ASSERT_EQUAL( expected[i], gen2() );
+    }
+
+    // Changing the seed or the fragment number gives another stream
+    FragmentRandomGenerator gen3( 2, 123456789012ul );
+    FragmentRandomGenerator gen4( 1, 123456789012ul + (1ul<<32) );
+    CPPUNIT_ASSERT( gen3() != expected[0] );
+    CPPUNIT_ASSERT( gen4() != expected[0] );
+}
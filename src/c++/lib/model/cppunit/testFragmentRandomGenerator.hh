@@ -0,0 +1,30 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **/
+
+#ifndef EAGLE_MODEL_TEST_FRAGMENT_RANDOM_GENERATOR_HH
+#define EAGLE_MODEL_TEST_FRAGMENT_RANDOM_GENERATOR_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "model/FragmentRandomGenerator.hh"
+
+
+class TestFragmentRandomGenerator : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFragmentRandomGenerator );
+    CPPUNIT_TEST( testKnownAnswers );
+    CPPUNIT_TEST( testReproducibility );
+    CPPUNIT_TEST_SUITE_END();
+private:
+public:
+    void setUp();
+    void tearDown();
+    void testKnownAnswers();
+    void testReproducibility();
+};
+
+#endif //EAGLE_MODEL_TEST_FRAGMENT_RANDOM_GENERATOR_HH
@@ -0,0 +1,72 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Command line options for 'compileErrorModel'
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <string>
+#include <vector>
+#include <boost/assign.hpp>
+
+#include "common/Exceptions.hh"
+#include "ErrorModelCompilerOptions.hh"
+
+namespace eagle
+{
+namespace main
+{
+
+
+namespace bpo = boost::program_options;
+namespace bfs = boost::filesystem;
+
+ErrorModelCompilerOptions::ErrorModelCompilerOptions()
+    : mismatchTableFile("")
+    , homopolymerIndelTableFile("")
+    , motifQualityDropTableFile("")
+    , qqTableFile("")
+{
+    parameters_.add_options()
+        ("quality-table,q",     bpo::value< std::vector< bfs::path > >(&qualityTableFiles),
+                                "[input]  \tFile containing the quality table: 1 line per cycle, tab-separated pairs \"quality:occurrences\" items")
+        ("mismatch-table",      bpo::value< bfs::path >(&mismatchTableFile),
+                                "[input]  \tFile containing the mismatch table (default: equal probabilities for each SNP, no indel)")
+        ("homopolymer-indel-table",      bpo::value< bfs::path >(&homopolymerIndelTableFile),
+                                "[input]  \tFile containing the homopolymer indel table (default: no indel)")
+        ("motif-quality-drop-table",   bpo::value< bfs::path >(&motifQualityDropTableFile),
+                                "[input]  \tFile containing the motif quality drop table (default: no quality drop)")
+        ("qq-table",            bpo::value< bfs::path >(&qqTableFile),
+                                "[input]  \tFile containing the QQ table (default: Phred values: error-rate=10^(-Q/10))")
+        ("output-file,o",       bpo::value< bfs::path >(&outputFile),
+                                "[output] \tCompiled error model, to be passed to simulateSequencer --compiled-error-model")
+        ;
+}
+
+void ErrorModelCompilerOptions::postProcess(bpo::variables_map &vm)
+{
+    eagle::common::OptionsHelper check(vm);
+
+    check.requiredOptions(boost::assign::list_of
+                          ("quality-table")
+                          ("output-file")
+                          );
+
+    check.addPathOptions(qualityTableFiles,"quality-table");
+    check.addPathOptions(mismatchTableFile,"mismatch-table");
+    check.addPathOptions(homopolymerIndelTableFile,"homopolymer-indel-table");
+    check.addPathOptions(motifQualityDropTableFile,"motif-quality-drop-table");
+    check.addPathOptions(qqTableFile,"qq-table");
+    check.inputPathsExist();
+
+    check.clearPathOptions();
+    check.addPathOptions(outputFile,"output-file");
+    check.outputFilesWriteable();
+}
+
+} //namespace main
+} // namespace eagle
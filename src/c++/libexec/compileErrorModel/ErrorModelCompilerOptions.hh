@@ -0,0 +1,47 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Command line options for 'compileErrorModel'
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_MAIN_ERROR_MODEL_COMPILER_OPTIONS_HH
+#define EAGLE_MAIN_ERROR_MODEL_COMPILER_OPTIONS_HH
+
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace eagle
+{
+namespace main
+{
+
+class ErrorModelCompilerOptions : public eagle::common::Options
+{
+public:
+    ErrorModelCompilerOptions();
+private:
+    std::string usagePrefix() const {return std::string("Usage:\n")
+                                          + std::string("       compileErrorModel --quality-table=<file> [--quality-table=<file2> ...] --output-file=<file> [options]");}
+    void postProcess(boost::program_options::variables_map &vm);
+
+public:
+    std::vector< boost::filesystem::path > qualityTableFiles;
+    boost::filesystem::path mismatchTableFile;
+    boost::filesystem::path homopolymerIndelTableFile;
+    boost::filesystem::path motifQualityDropTableFile;
+    boost::filesystem::path qqTableFile;
+    boost::filesystem::path outputFile;
+};
+
+} // namespace main
+} // namespace eagle
+
+#endif // EAGLE_MAIN_ERROR_MODEL_COMPILER_OPTIONS_HH
@@ -0,0 +1,29 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ **/
+
+
+#include <iostream>
+#include <vector>
+
+#include "genome/QualityModel.hh"
+#include "ErrorModelCompilerOptions.hh"
+
+
+static void errorModelCompilerLauncher(const eagle::main::ErrorModelCompilerOptions &options)
+{
+    // The plugin options are given to each simulation instead
+    const std::vector< std::string > noErrorModelOptions;
+    const eagle::genome::ErrorModel errorModel( options.qualityTableFiles, options.mismatchTableFile, options.homopolymerIndelTableFile, options.motifQualityDropTableFile, options.qqTableFile, "", noErrorModelOptions );
+    errorModel.save( options.outputFile );
+    std::clog << "Compiled error model written to " << options.outputFile << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    eagle::common::run(errorModelCompilerLauncher, argc, argv);
+}
@@ -0,0 +1,89 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Converts FASTA files to their packed 2-bit representation.
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "io/PackedFasta.hh"
+#include "FastaPacker.hh"
+
+
+namespace eagle
+{
+namespace main
+{
+
+
+void FastaPacker::run()
+{
+    BOOST_FOREACH( const boost::filesystem::path &fastaFile, fastaFiles_ )
+    {
+        if (!force_ && eagle::io::PackedFastaWriter::isUpToDate( fastaFile ))
+        {
+            std::clog << "Packed copy of " << fastaFile << " is up to date" << std::endl;
+            continue;
+        }
+        pack( fastaFile );
+    }
+}
+
+void FastaPacker::pack( const boost::filesystem::path &fastaFile )
+{
+    const boost::filesystem::path packedFile = eagle::io::PackedFastaWriter::packedFilename( fastaFile );
+    std::clog << "Packing " << fastaFile << " into " << packedFile << std::endl;
+
+    std::ifstream in( fastaFile.string().c_str() );
+    if (!in.good())
+    {
+        BOOST_THROW_EXCEPTION( eagle::common::IoException( errno, (boost::format("Failed to open FASTA file %s for reading") % fastaFile).str() ) );
+    }
+    eagle::io::PackedFastaWriter writer( packedFile );
+    bool inContig = false;
+    std::string line;
+    while (std::getline( in, line ))
+    {
+        if (!line.empty() && line[line.size()-1] == '\r')
+        {
+            line.resize( line.size()-1 );
+        }
+        if (!line.empty() && line[0] == '>')
+        {
+            if (inContig)
+            {
+                writer.endContig();
+            }
+            // Contig name stops at the first space, as in MultiFastaReader
+            writer.beginContig( line.substr( 1, line.find( ' ' ) - 1 ) );
+            inContig = true;
+        }
+        else if (!line.empty())
+        {
+            if (!inContig)
+            {
+                BOOST_THROW_EXCEPTION( eagle::common::CorruptedFileException( "FASTA", (boost::format("%s: bases found before the first contig header") % fastaFile).str() ) );
+            }
+            writer.add( line.c_str(), line.size() );
+        }
+    }
+    if (inContig)
+    {
+        writer.endContig();
+    }
+    writer.close();
+}
+
+
+} // namespace main
+} // namespace eagle
@@ -0,0 +1,43 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Converts FASTA files to their packed 2-bit representation.
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_MAIN_FASTA_PACKER_HH
+#define EAGLE_MAIN_FASTA_PACKER_HH
+
+#include <vector>
+#include <boost/filesystem.hpp>
+
+
+namespace eagle
+{
+namespace main
+{
+
+
+class FastaPacker
+{
+public:
+    FastaPacker( const std::vector<boost::filesystem::path> &fastaFiles, const bool force )
+    : fastaFiles_( fastaFiles )
+    , force_( force )
+    {}
+    void run();
+private:
+    void pack( const boost::filesystem::path &fastaFile );
+
+    const std::vector<boost::filesystem::path> fastaFiles_;
+    const bool force_;
+};
+
+} // namespace main
+} // namespace eagle
+
+#endif // EAGLE_MAIN_FASTA_PACKER_HH
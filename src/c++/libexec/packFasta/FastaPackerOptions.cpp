@@ -0,0 +1,70 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Command line options for 'packFasta'
+ **
+ ** \author Lilian Janin
+ **/
+
+#include <string>
+#include <vector>
+#include <boost/format.hpp>
+
+#include "common/Exceptions.hh"
+#include "common/FileSystem.hh"
+#include "FastaPackerOptions.hh"
+
+namespace eagle
+{
+namespace main
+{
+
+
+namespace bpo = boost::program_options;
+namespace bfs = boost::filesystem;
+
+FastaPackerOptions::FastaPackerOptions()
+    : force(false)
+{
+    unnamedOptions_.add_options()
+        ("positional", bpo::value< std::vector< bfs::path > >(&fastaFiles), "list of files, or just 1 directory")
+        ;
+    positionalOptions_.add("positional",-1);
+}
+
+void FastaPackerOptions::postProcess(bpo::variables_map &vm)
+{
+    eagle::common::OptionsHelper check(vm);
+    force = static_cast<bool>(vm.count("force"));
+
+    if (fastaFiles.empty())
+    {
+        throw bpo::validation_error(bpo::validation_error::at_least_one_value_required, "", "positional");
+    }
+
+    check.addPathOptions(fastaFiles,"positional");
+    check.inputPathsExist();
+
+    if ( 1 == fastaFiles.size() && bfs::is_directory(fastaFiles[0]) )
+    {
+        eagle::common::Glob FS(".*\\.fa(sta)?$");
+        fastaFiles = FS.glob( fastaFiles[0] );
+    } else {
+        for (unsigned int i = 0; i < fastaFiles.size(); i++)
+        {
+            if (bfs::is_directory(fastaFiles[i]))
+            {
+                const boost::format message = boost::format("\n   *** FASTA file #%d has an invalid value: ***"
+                                                            "\n   ***       It should point to a file, but a directory already exists with name %s ***\n")
+                                                            % i % fastaFiles[i];
+                BOOST_THROW_EXCEPTION(eagle::common::InvalidOptionException(message.str()));
+            }
+        }
+    }
+}
+
+} //namespace main
+} // namespace eagle
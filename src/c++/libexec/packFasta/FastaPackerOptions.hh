@@ -0,0 +1,45 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ ** \description Command line options for 'packFasta'
+ **
+ ** \author Lilian Janin
+ **/
+
+#ifndef EAGLE_MAIN_FASTA_PACKER_OPTIONS_HH
+#define EAGLE_MAIN_FASTA_PACKER_OPTIONS_HH
+
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "common/Program.hh"
+
+namespace eagle
+{
+namespace main
+{
+
+class FastaPackerOptions : public eagle::common::Options
+{
+public:
+    FastaPackerOptions();
+private:
+    std::string usagePrefix() const {return std::string("Usage:\n")
+                                          + std::string("       packFasta <fasta1.fa> [<fasta2.fa> [... <fastaN.fa>]]  [options]\n")
+                                          + std::string("Or:\n")
+                                          + std::string("       packFasta <fastaDir>  [options]");}
+    void postProcess(boost::program_options::variables_map &vm);
+
+public:
+    std::vector< boost::filesystem::path > fastaFiles;
+    bool force;
+};
+
+} // namespace main
+} // namespace eagle
+
+#endif // EAGLE_MAIN_FASTA_PACKER_OPTIONS_HH
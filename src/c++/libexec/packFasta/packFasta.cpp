@@ -0,0 +1,23 @@
+/**
+ ** Copyright (c) 2014 Illumina, Inc.
+ **
+ ** This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+ ** covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+ **
+ **/
+
+
+#include "FastaPacker.hh"
+#include "FastaPackerOptions.hh"
+
+
+static void fastaPackerLauncher(const eagle::main::FastaPackerOptions &options)
+{
+    eagle::main::FastaPacker fastaPacker( options.fastaFiles, options.force );
+    fastaPacker.run();
+}
+
+int main(int argc, char *argv[])
+{
+    eagle::common::run(fastaPackerLauncher, argc, argv);
+}
@@ -8,15 +8,22 @@
  **/
 
 #include <boost/ptr_container/ptr_deque.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>
 
+#include "common/BackgroundWriter.hh"
 #include "common/Exceptions.hh"
 #include "common/Logger.hh"
 #include "common/Semaphore.hh"
+#include "genome/ContigStore.hh"
 #include "genome/SharedFastaReference.hh"
 #include "genome/ReferenceToSample.hh"
+#include "io/BamConcatenator.hh"
 #include "io/Bcl.hh"
 #include "io/Fastq.hh"
 #include "genome/BamMetadata.hh"
@@ -40,20 +47,30 @@ SequencerSimulator::SequencerSimulator (const SequencerSimulatorOptions &options
     , runInfo_        ( options.runInfo )
     , tileNum_        ( (options_.lane-1)*options_.tilesPerLane + (options_.tileNum-1) )
     , fragmentList_   ( options_.fragmentsDir /*options.binNum*(options.readCount/options.binCount)*/ )
-    , readClusterFactory_( runInfo_, options_.sampleGenomeDir, options_.qualityTableFiles, options_.mismatchTableFile, options_.homopolymerIndelTableFile, options_.motifQualityDropTableFile, options_.qqTableFile, options_.randomSeed, options_.errorModelOptions )
+    , readClusterFactory_( runInfo_, options_.sampleGenomeDir, options_.qualityTableFiles, options_.mismatchTableFile, options_.homopolymerIndelTableFile, options_.motifQualityDropTableFile, options_.qqTableFile, options_.compiledErrorModelFile, options_.randomSeed, options_.errorModelOptions )
+    , nextTileToGenerate_( 0 )
+    , nextBamChromosomeToGenerate_( 0 )
 {
+    genome::ContigStore::setMaxBytes( options_.sampleGenomeCacheMemory << 20 );
 }
 
 void SequencerSimulator::run()
 {
-    if (options_.generateBclTile)
+    if (options_.allTiles)
     {
-        generateBclTile();
+        generateAllTiles();
     }
-
-    if (options_.generateFastqTile)
+    else
     {
-        generateFastqTile();
+        if (options_.generateBclTile)
+        {
+            generateBclTile();
+        }
+
+        if (options_.generateFastqTile)
+        {
+            generateFastqTile();
+        }
     }
 
     if (options_.generateBam)
@@ -69,66 +86,102 @@ void SequencerSimulator::run()
 
 
 void SequencerSimulator::generateBclTile()
+{
+    eagle::common::BackgroundWriter bclWriter( options_.synchronousTileFlush );
+    generateBclTile( fragmentList_, options_.lane, tileNum_, options_.tileId, bclWriter );
+    bclWriter.wait();
+}
+
+void SequencerSimulator::generateBclTile( eagle::model::FragmentList &fragmentList, const unsigned int lane, const unsigned int tileNum, const unsigned int tileId, eagle::common::BackgroundWriter &bclWriter )
 {    // for each tile in the to-be-processed set:
-    unsigned long long tileReadCount = fragmentList_.getTileSize( tileNum_ );
-    clog << "SequencerSimulator::generateBclTile: tile=" << tileNum_ << ", readCount=" << tileReadCount << endl;
-
-    unsigned int tileId = options_.tileId;
-    string bclFilenameTemplate = (boost::format("%s/Data/Intensities/BaseCalls/L%03g/C%%d.1/s_%d_%g.bcl") % options_.outDir.string() % options_.lane % options_.lane % tileId).str();
-    string statsFilenameTemplate = (boost::format("%s/Data/Intensities/BaseCalls/L%03g/C%%d.1/s_%d_%g.stats") % options_.outDir.string() % options_.lane % options_.lane % tileId).str();
-    string filterFilename = (boost::format("%s/Data/Intensities/BaseCalls/L00%d/s_%d_%04g.filter") % options_.outDir.string() % options_.lane % options_.lane % tileId).str();
-    string posFilename = (boost::format("%s/Data/Intensities/s_%d_%04g_pos.txt") % options_.outDir.string() % options_.lane % tileId).str();
-    string clocsFilename = (boost::format("%s/Data/Intensities/L00%d/s_%d_%04g.clocs") % options_.outDir.string() % options_.lane % options_.lane % tileId).str();
-    string controlFilename = (boost::format("%s/Data/Intensities/BaseCalls/L00%d/s_%d_%04g.control") % options_.outDir.string() % options_.lane % options_.lane % tileId).str();
+    unsigned long long tileReadCount = fragmentList.getTileSize( tileNum );
+    clog << "SequencerSimulator::generateBclTile: tile=" << tileNum << ", readCount=" << tileReadCount << endl;
+    fragmentList.selectTile( tileNum );
+
+    string bclFilenameTemplate = (boost::format("%s/Data/Intensities/BaseCalls/L%03g/C%%d.1/s_%d_%g.bcl") % options_.outDir.string() % lane % lane % tileId).str();
+    string statsFilenameTemplate = (boost::format("%s/Data/Intensities/BaseCalls/L%03g/C%%d.1/s_%d_%g.stats") % options_.outDir.string() % lane % lane % tileId).str();
+    string filterFilename = (boost::format("%s/Data/Intensities/BaseCalls/L00%d/s_%d_%04g.filter") % options_.outDir.string() % lane % lane % tileId).str();
+    string posFilename = (boost::format("%s/Data/Intensities/s_%d_%04g_pos.txt") % options_.outDir.string() % lane % tileId).str();
+    string clocsFilename = (boost::format("%s/Data/Intensities/L00%d/s_%d_%04g.clocs") % options_.outDir.string() % lane % lane % tileId).str();
+    string controlFilename = (boost::format("%s/Data/Intensities/BaseCalls/L00%d/s_%d_%04g.control") % options_.outDir.string() % lane % lane % tileId).str();
     unsigned int clusterLength = runInfo_.getClusterLength();
-    BclTile bclTile( tileReadCount, clusterLength, bclFilenameTemplate, statsFilenameTemplate, filterFilename, clocsFilename, controlFilename );
-
-    for (unsigned int i=0; i<tileReadCount; ++i)
+    boost::shared_ptr<BclTile> bclTile( new BclTile( tileReadCount, clusterLength, bclFilenameTemplate, statsFilenameTemplate, filterFilename, clocsFilename, controlFilename, true, options_.bclFormat, options_.bclBlockSize ) );
+
+    // Clusters get generated by blocks, cycle by cycle, which keeps each cycle's error model tables in cache
+    const unsigned int clusterBlockSize = 256;
+    vector< eagle::model::Fragment > fragments;
+    vector< char > bclBlock;
+    vector< char > isPassingFilter;
+    for (unsigned long long i=0; i<tileReadCount; i+=clusterBlockSize)
     {
-        // Read next paired read position for our tile(s) of interest
-        eagle::model::Fragment fragment = fragmentList_.getNext( tileNum_ );
-        eagle::genome::ReadClusterWithErrors readClusterWithErrors = readClusterFactory_.getReadClusterWithErrors( fragment );
-
-        // Apply errors
-        //automatically done by class//            readClusterWithErrors.generateErrors();
+        // Read next paired read positions for our tile(s) of interest
+        fragments.clear();
+        for (unsigned long long j=i; j<tileReadCount && j<i+clusterBlockSize; ++j)
+        {
+            fragments.push_back( fragmentList.getNext( tileNum ) );
+        }
 
         // Output BCL
-        const char *bclCluster = readClusterWithErrors.getBclCluster();
-        bool isPassingFilter = model::PassFilter::isBclClusterPassingFilter( bclCluster, clusterLength );
-        bclTile.addClusterToRandomLocation( bclCluster, isPassingFilter );
+        readClusterFactory_.getBclClusterBlock( fragments, bclBlock );
+        model::PassFilter::getBclBlockPassFilter( &bclBlock[0], fragments.size(), clusterLength, isPassingFilter );
+        bclTile->addClusters( &bclBlock[0], fragments.size(), isPassingFilter );
     }
 
-    // Flush tile to disk (TODO: ...in parallel with next tile's creation)
+    // Flush tile to disk in the background, in parallel with the next tile's creation
+    bclWriter.write( boost::bind( &SequencerSimulator::flushBclTile, this, bclTile, lane, tileId ) );
+}
+
+void SequencerSimulator::flushBclTile( const boost::shared_ptr<BclTile> bclTile, const unsigned int lane, const unsigned int tileId )
+{
     if (options_.maxConcurrentWriters > 0)
     {
         clog << "Ready to flush tile. Waiting for semaphore." << endl;
         eagle::common::Semaphore semaphore( "EagleSemaphore", options_.maxConcurrentWriters );
         semaphore.wait();
-        bclTile.flushToDisk();
+        bclTile->flushToDisk();
         semaphore.post();
     }
     else
     {
-        bclTile.flushToDisk();
+        bclTile->flushToDisk();
+    }
+
+    if (options_.bclFormat == io::BCL_FORMAT_CBCL)
+    {
+        const unsigned int surface = getTileSurface( tileId );
+        std::map< std::pair< unsigned int, unsigned int >, boost::shared_ptr< io::CbclWriter > >::iterator cbclWriter = cbclWriters_.find( make_pair( lane, surface ) );
+        if (cbclWriter == cbclWriters_.end())
+        {
+            EAGLE_ERROR( (boost::format("No CBCL file was opened for surface %d of lane %d (tile %d)") % surface % lane % tileId).str() );
+        }
+        cbclWriter->second->addTile( tileId, *bclTile );
     }
 }
 
 void SequencerSimulator::generateFastqTile()
+{
+    generateFastqTile( fragmentList_, options_.lane, tileNum_, options_.tileId );
+}
+
+void SequencerSimulator::generateFastqTile( eagle::model::FragmentList &fragmentList, const unsigned int lane, const unsigned int tileNum, const unsigned int tileId )
 {    // for each tile in the to-be-processed set:
-    unsigned long long tileReadCount = fragmentList_.getTileSize( tileNum_ );
-    clog << "SequencerSimulator::generateFastqTile: tile=" << tileNum_ << ", readCount=" << tileReadCount << endl;
+    unsigned long long tileReadCount = fragmentList.getTileSize( tileNum );
+    clog << "SequencerSimulator::generateFastqTile: tile=" << tileNum << ", readCount=" << tileReadCount << endl;
+    fragmentList.selectTile( tileNum );
 
-    //unsigned int tileId = options_.tileId;
-    string fastqFilenameTemplate = (boost::format("%s/EAGLE_S%d_L%03g_R%%d_001.fastq") % options_.outDir.string() % (tileNum_ + 1) % options_.lane).str();
+    const bool compressed = (options_.fastqCompressionLevel >= 0);
+    string fastqFilenameTemplate = (boost::format("%s/EAGLE_S%d_L%03g_R%%d_001.fastq%s") % options_.outDir.string() % (tileNum + 1) % lane % (compressed?".gz":"")).str();
     string read1FastqFilename = (boost::format(fastqFilenameTemplate) % 1).str();
     string read2FastqFilename = (boost::format(fastqFilenameTemplate) % 2).str();
     unsigned int clusterLength = runInfo_.getClusterLength();
-    FastqTile fastqTile( tileReadCount, clusterLength, read1FastqFilename, read2FastqFilename, runInfo_, options_.lane, options_.tileId );
+    // With --tiles=all, the threads are already busy generating tiles in parallel
+    const unsigned int compressionThreads = options_.allTiles ? 1 : options_.threads;
+    FastqTile fastqTile( tileReadCount, clusterLength, read1FastqFilename, read2FastqFilename, runInfo_, lane, tileId, true, options_.fastqCompressionLevel, compressionThreads );
 
     for (unsigned int i=0; i<tileReadCount; ++i)
     {
         // Read next paired read position for our tile(s) of interest
-        eagle::model::Fragment fragment = fragmentList_.getNext( tileNum_ );
+        eagle::model::Fragment fragment = fragmentList.getNext( tileNum );
         eagle::genome::ReadClusterWithErrors readClusterWithErrors = readClusterFactory_.getReadClusterWithErrors( fragment );
 
         // Output FASTQ
@@ -157,6 +210,113 @@ void SequencerSimulator::generateFastqTile()
     fastqTile.finaliseAndWriteInfo();
 }
 
+void SequencerSimulator::generateAllTiles()
+{
+    const unsigned int tileCount = options_.laneCount * options_.tilesPerLane;
+    const unsigned int threadCount = std::min( options_.threads, tileCount );
+    clog << "SequencerSimulator::generateAllTiles: tileCount=" << tileCount << ", threads=" << threadCount << endl;
+
+    if (options_.generateBclTile && options_.bclFormat == io::BCL_FORMAT_CBCL)
+    {
+        createCbclWriters();
+    }
+
+    // All the threads share the error models and the fragment structures of readClusterFactory_, as well as fragmentList_:
+    // each tile reads a view of it that only decodes the fragment blocks of its own tile, so that the fragment files
+    // are only opened and read once overall
+    fragmentList_.indexTiles();
+    nextTileToGenerate_ = 0;
+    boost::thread_group workers;
+    for (unsigned int i=0; i<threadCount; ++i)
+    {
+        workers.create_thread( boost::bind( &SequencerSimulator::generateTilesFromQueue, this ) );
+    }
+    workers.join_all();
+
+    if (workerException_)
+    {
+        boost::rethrow_exception( workerException_ );
+    }
+}
+
+unsigned int SequencerSimulator::getTileSurface( unsigned int tileId )
+{
+    // The first digit of Illumina tile ids is the surface (e.g. 1101 is on the top surface, 2101 on the bottom one)
+    while (tileId >= 10)
+    {
+        tileId /= 10;
+    }
+    return tileId;
+}
+
+void SequencerSimulator::createCbclWriters()
+{
+    map< unsigned int, unsigned int > tileCountPerSurface;
+    BOOST_FOREACH( const unsigned int tileId, options_.tileIds )
+    {
+        ++tileCountPerSurface[ getTileSurface( tileId ) ];
+    }
+
+    const unsigned int clusterLength = runInfo_.getClusterLength();
+    for (unsigned int lane=1; lane<=options_.laneCount; ++lane)
+    {
+        typedef pair< unsigned int, unsigned int > SurfaceAndTileCount;
+        BOOST_FOREACH( const SurfaceAndTileCount& surfaceAndTileCount, tileCountPerSurface )
+        {
+            const unsigned int surface = surfaceAndTileCount.first;
+            string cbclFilenameTemplate = (boost::format("%s/Data/Intensities/BaseCalls/L%03g/C%%d.1/L%03g_%d.cbcl") % options_.outDir.string() % lane % lane % surface).str();
+            cbclWriters_[ make_pair( lane, surface ) ].reset( new io::CbclWriter( cbclFilenameTemplate, clusterLength, surfaceAndTileCount.second ) );
+        }
+    }
+}
+
+void SequencerSimulator::generateTilesFromQueue()
+{
+    const unsigned int tileCount = options_.laneCount * options_.tilesPerLane;
+    try
+    {
+        // Each worker flushes its previous BCL tile while generating the next one
+        eagle::common::BackgroundWriter bclWriter( options_.synchronousTileFlush );
+        genome::SharedFastaReference::initForCurrentThread();
+        while (true)
+        {
+            unsigned int tileNum;
+            {
+                boost::lock_guard<boost::mutex> lock( tileQueueMutex_ );
+                if (nextTileToGenerate_ >= tileCount || workerException_)
+                {
+                    break;
+                }
+                tileNum = nextTileToGenerate_++;
+            }
+
+            const unsigned int lane = tileNum / options_.tilesPerLane + 1;
+            const unsigned int tileId = options_.tileIds[ tileNum % options_.tilesPerLane ];
+            if (options_.generateBclTile)
+            {
+                eagle::model::FragmentList fragmentList( fragmentList_.tileView( tileNum ) );
+                generateBclTile( fragmentList, lane, tileNum, tileId, bclWriter );
+            }
+            if (options_.generateFastqTile)
+            {
+                eagle::model::FragmentList fragmentList( fragmentList_.tileView( tileNum ) );
+                generateFastqTile( fragmentList, lane, tileNum, tileId );
+            }
+        }
+        bclWriter.wait();
+    }
+    catch (...)
+    {
+        // Keep the first failure, to be rethrown by the main thread once all the workers have stopped
+        boost::lock_guard<boost::mutex> lock( tileQueueMutex_ );
+        if (!workerException_)
+        {
+            workerException_ = boost::current_exception();
+        }
+    }
+    genome::SharedFastaReference::releaseForCurrentThread();
+}
+
 /*
 bool fetchNextFragment( const genome::RefToSampleSegment& segment,
                         const unsigned long currentPos,
@@ -168,19 +328,108 @@ bool fetchNextFragment( const genome::RefToSampleSegment& segment,
 */
 
 void SequencerSimulator::generateBam()
+{
+    const boost::filesystem::path bamPath = options_.outDir / options_.outFilename;
+    if (options_.bamChromosomes.size() == 1)
+    {
+        generateBam( options_.bamChromosomes[0], bamPath, options_.threads );
+        return;
+    }
+
+    // Chromosomes in reference order, so that their concatenation is sorted
+    vector< string > chromosomes;
+    {
+        PreferredFastaReader referenceGenome( options_.sampleGenomeDir / ".." / "reference_genome" );
+        BOOST_FOREACH( const string &contigName, referenceGenome.allContigNames() )
+        {
+            if (find( options_.bamChromosomes.begin(), options_.bamChromosomes.end(), contigName ) != options_.bamChromosomes.end())
+            {
+                chromosomes.push_back( contigName );
+            }
+        }
+    }
+    BOOST_FOREACH( const string &chromosome, options_.bamChromosomes )
+    {
+        if (find( chromosomes.begin(), chromosomes.end(), chromosome ) == chromosomes.end())
+        {
+            BOOST_THROW_EXCEPTION( eagle::common::InvalidOptionException( (boost::format("Chromosome '%s' of --bam-region not found in reference genome") % chromosome).str() ) );
+        }
+    }
+
+    // Each worker writes whole chromosomes into their own indexed BAM file, which then only get concatenated
+    vector< boost::filesystem::path > bamParts;
+    for (unsigned int i=0; i<chromosomes.size(); ++i)
+    {
+        bamParts.push_back( (boost::format("%s.part%d") % bamPath.string() % i).str() );
+    }
+    const unsigned int threadCount = std::min<unsigned int>( options_.threads, chromosomes.size() );
+    clog << "SequencerSimulator::generateBam: chromosomes=" << chromosomes.size() << ", threads=" << threadCount << endl;
+    nextBamChromosomeToGenerate_ = 0;
+    boost::thread_group workers;
+    for (unsigned int i=0; i<threadCount; ++i)
+    {
+        workers.create_thread( boost::bind( &SequencerSimulator::generateBamChromosomesFromQueue, this, boost::cref( chromosomes ), boost::cref( bamParts ) ) );
+    }
+    workers.join_all();
+
+    if (workerException_)
+    {
+        boost::rethrow_exception( workerException_ );
+    }
+
+    io::bam::concatenateBams( bamParts, bamPath );
+    BOOST_FOREACH( const boost::filesystem::path &bamPart, bamParts )
+    {
+        boost::filesystem::remove( bamPart );
+        boost::filesystem::remove( bamPart.string() + ".bai" );
+    }
+}
+
+void SequencerSimulator::generateBamChromosomesFromQueue( const vector< string > &chromosomes, const vector< boost::filesystem::path > &bamParts )
+{
+    try
+    {
+        genome::SharedFastaReference::initForCurrentThread();
+        while (true)
+        {
+            unsigned int chromosomeNum;
+            {
+                boost::lock_guard<boost::mutex> lock( tileQueueMutex_ );
+                if (nextBamChromosomeToGenerate_ >= chromosomes.size() || workerException_)
+                {
+                    break;
+                }
+                chromosomeNum = nextBamChromosomeToGenerate_++;
+            }
+            // Parallelism comes from the chromosomes: one compression thread each
+            generateBam( chromosomes[chromosomeNum], bamParts[chromosomeNum], 1 );
+        }
+    }
+    catch (...)
+    {
+        // Keep the first failure, to be rethrown by the main thread once all the workers have stopped
+        boost::lock_guard<boost::mutex> lock( tileQueueMutex_ );
+        if (!workerException_)
+        {
+            workerException_ = boost::current_exception();
+        }
+    }
+    genome::SharedFastaReference::releaseForCurrentThread();
+}
+
+void SequencerSimulator::generateBam( const string &currentChr, const boost::filesystem::path &bamPath, const unsigned int compressionThreads )
 {
     clock_t startTime = clock();
-    const string currentChr( options_.bamRegion );
     genome::RefToSampleSegmentReader refToSampleSegmentReader( options_.sampleGenomeDir / "segmentsFromRef.tsv", currentChr );
 //    refToSampleSegmentReader.jumpToChromosome( currentChr );
     vector< genome::RefToSampleSegment > segmentsToMerge;
     vector< model::Fragment > fragmentForSegment;
     vector< model::FragmentList* > fragmentListForSegment;
-    vector< string > sharedFastReaderIdForSegment;
+    vector< unsigned int > sharedFastReaderIdForSegment;
     unsigned long currentPos = 0;
 
     PreferredFastaReader mainReferenceGenome( options_.sampleGenomeDir / ".." / "reference_genome" );
-    eagle::genome::BamOrMetadataOutput bamOrMetadataOutput( options_.outDir / options_.outFilename, runInfo_, &mainReferenceGenome /*, currentChr*/);
+    eagle::genome::BamOrMetadataOutput bamOrMetadataOutput( bamPath, runInfo_, &mainReferenceGenome, options_.bamCompressionLevel, compressionThreads, options_.bamReorderWindowMemory << 20 /*, currentChr*/);
 
     // Find the global ref position of the desired chromosmes
     unsigned long chrGlobalPosInRef = 0;
@@ -217,7 +466,7 @@ void SequencerSimulator::generateBam()
             fragmentListForSegment.push_back( new model::FragmentList( options_.fragmentsDir, firstGlobalPosInSample, lastGlobalPosInSample, 500 ) ); //!!!!!!!!get this 500 dynamically
             cout << "Adding allele to merge: " << refToSampleSegment << " (sample global pos range: " << firstGlobalPosInSample << "-" << lastGlobalPosInSample << ")" << endl;
             currentPos = refToSampleSegment.refPos_;
-            sharedFastReaderIdForSegment.push_back( refToSampleSegment.sampleChrAllele_ );
+            sharedFastReaderIdForSegment.push_back( genome::SharedFastaReference::alleleIndex( refToSampleSegment.sampleChrAllele_ ) );
         }
         else
         {
@@ -311,6 +560,7 @@ void SequencerSimulator::generateBam()
         }
     }
     while (segmentAvailable);
+    bamOrMetadataOutput.close();
 }
 
 
@@ -320,7 +570,7 @@ void SequencerSimulator::generateSampleBam()
     unsigned long long readCount = fragmentList_.size(); // fragmentList_.getTileSize( tileNum_ );
     clog << "SequencerSimulator::generateBam: readCount=" << readCount << endl;
 
-    eagle::genome::BamOrMetadataOutput bamOrMetadataOutput( options_.outDir / options_.outFilename, runInfo_ );
+    eagle::genome::BamOrMetadataOutput bamOrMetadataOutput( options_.outDir / options_.outFilename, runInfo_, eagle::genome::SharedFastaReference::get(), options_.bamCompressionLevel, options_.threads, options_.bamReorderWindowMemory << 20 );
 
     for (unsigned long long i=0; i<readCount; ++i)
     {
@@ -336,6 +586,7 @@ void SequencerSimulator::generateSampleBam()
         // Output BAM
         bamOrMetadataOutput.add(readClusterWithErrors);
     }
+    bamOrMetadataOutput.close();
 }
 
 
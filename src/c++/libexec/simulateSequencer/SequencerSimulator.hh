@@ -10,6 +10,15 @@
 #ifndef EAGLE_MAIN_SEQUENCER_SIMULATOR_HH
 #define EAGLE_MAIN_SEQUENCER_SIMULATOR_HH
 
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/exception_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/BackgroundWriter.hh"
 #include "io/RunInfo.hh"
 #include "genome/EnrichedFragment.hh"
 #include "genome/ReadCluster.hh"
@@ -29,15 +38,34 @@ public:
     void run();
     void generateBclTile();
     void generateFastqTile();
+    void generateAllTiles();
     void generateBam();
     void generateSampleBam();
 
 private:
+    void generateBclTile( eagle::model::FragmentList &fragmentList, const unsigned int lane, const unsigned int tileNum, const unsigned int tileId, eagle::common::BackgroundWriter &bclWriter );
+    void flushBclTile( const boost::shared_ptr<eagle::io::BclTile> bclTile, const unsigned int lane, const unsigned int tileId );
+    void generateFastqTile( eagle::model::FragmentList &fragmentList, const unsigned int lane, const unsigned int tileNum, const unsigned int tileId );
+    void generateTilesFromQueue();
+    void generateBam( const std::string &currentChr, const boost::filesystem::path &bamPath, const unsigned int compressionThreads );
+    void generateBamChromosomesFromQueue( const std::vector< std::string > &chromosomes, const std::vector< boost::filesystem::path > &bamParts );
+    void createCbclWriters();
+    static unsigned int getTileSurface( unsigned int tileId );
+
     const SequencerSimulatorOptions &options_;
     eagle::io::RunInfo runInfo_;
     unsigned int tileNum_;
     eagle::model::FragmentList fragmentList_;
     eagle::genome::ReadClusterFactory readClusterFactory_;
+
+    // Shared between the worker threads of generateAllTiles, or of generateBam with several chromosomes
+    boost::mutex tileQueueMutex_;
+    unsigned int nextTileToGenerate_;
+    unsigned int nextBamChromosomeToGenerate_;
+    boost::exception_ptr workerException_;
+
+    // One CBCL writer per {lane, surface} with --bcl-format=cbcl. Only filled before the workers start
+    std::map< std::pair< unsigned int, unsigned int >, boost::shared_ptr< eagle::io::CbclWriter > > cbclWriters_;
 };
 
 } // namespace main
@@ -14,6 +14,10 @@
 #include <boost/assign.hpp>
 #include <boost/foreach.hpp>
 #include <boost/assert.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "SequencerSimulatorOptions.hh"
 
@@ -27,6 +31,8 @@ namespace bfs = boost::filesystem;
 
 SequencerSimulatorOptions::SequencerSimulatorOptions()
     : generateBclTile(false)
+    , bclFormatStr("bcl")
+    , bclFormat(eagle::io::BCL_FORMAT_BCL)
     , generateFastqTile(false)
     , generateBam(false)
     , generateSampleBam(false)
@@ -36,6 +42,7 @@ SequencerSimulatorOptions::SequencerSimulatorOptions()
     , homopolymerIndelTableFile("")
     , motifQualityDropTableFile("")
     , qqTableFile("")
+    , compiledErrorModelFile("")
     , outDir()
     , outFilename()
     , readCount(1000000)
@@ -46,7 +53,18 @@ SequencerSimulatorOptions::SequencerSimulatorOptions()
     , lane(0)
     , tileNum(0)
     , tileId(0)
+    , tiles("")
+    , allTiles(false)
+    , tileIdList("")
+    , tileIds()
+    , threads(1)
+    , bamCompressionLevel(boost::iostreams::gzip::best_speed)
+    , bamReorderWindowMemory(1024)
+    , sampleGenomeCacheMemory(4096)
+    , fastqCompressionLevel(-1)
     , maxConcurrentWriters(0)
+    , synchronousTileFlush(false)
+    , bclBlockSize(0)
     , randomSeed(1)
     , dropLastBase(false)
 {
@@ -67,6 +85,8 @@ SequencerSimulatorOptions::SequencerSimulatorOptions()
                                 "[input]  \tFile containing the motif quality drop table (default: no quality drop)")
         ("qq-table",            bpo::value< bfs::path >(&qqTableFile),
                                 "[input]  \tFile containing the QQ table (default: Phred values: error-rate=10^(-Q/10))")
+        ("compiled-error-model", bpo::value< bfs::path >(&compiledErrorModelFile),
+                                "[input]  \tFile generated by compileErrorModel from the above tables, used instead of them to start faster")
         ("output-dir,o",        bpo::value< bfs::path >(&outDir)->default_value(outDir),
                                 "[output] \tFull path to the output directory")
         ("output-filename",     bpo::value< bfs::path >(&outFilename),
@@ -74,6 +94,7 @@ SequencerSimulatorOptions::SequencerSimulatorOptions()
         ;
     namedOptions_.add_options()
         ("generate-bcl-tile", bpo::value< bool >(&generateBclTile)->zero_tokens(), "Generates BCL tile identified by the following parameters:")
+        ("bcl-format", bpo::value<std::string>(&bclFormatStr)->default_value(bclFormatStr), "Format of the BCL base calls: bcl, bcl.gz, or cbcl (NovaSeq-style files gathering all the tiles of a lane surface, requires --tiles=all)")
         ("generate-fastq-tile", bpo::value< bool >(&generateFastqTile)->zero_tokens(), "Generates FASTQ tile identified by the following parameters:")
         ("read-count,n", bpo::value<unsigned int>(&readCount)->default_value(readCount), "Number of reads")
         ("lane-count,m", bpo::value<unsigned int>(&laneCount)->default_value(laneCount), "Number of lanes")
@@ -81,11 +102,20 @@ SequencerSimulatorOptions::SequencerSimulatorOptions()
         ("lane,l", bpo::value<unsigned int>(&lane)->default_value(lane), "Lane of the tile to be processed (1-based value)")
         ("tile-num", bpo::value<unsigned int>(&tileNum)->default_value(tileNum), "Tile number to be processed in the specified lane (1-based value)")
         ("tile-id", bpo::value<unsigned int>(&tileId)->default_value(tileId), "Tile id corresponding to the provided tile number for the desired naming scheme")
+        ("tiles", bpo::value<std::string>(&tiles), "Set to 'all' to generate every tile of every lane in a single process, instead of the tile identified by --lane and --tile-num")
+        ("tile-ids", bpo::value<std::string>(&tileIdList), "Comma-separated list of tile ids, in tile-num order, used to name the tiles of each lane when --tiles=all")
+        ("threads", bpo::value<unsigned int>(&threads)->default_value(threads), "Number of tiles generated in parallel when --tiles=all, or number of compression threads with --generate-bam, --generate-sample-bam and compressed --generate-fastq-tile")
         ("max-concurrent-writers", bpo::value<unsigned int>(&maxConcurrentWriters)->default_value(maxConcurrentWriters), "Number of EAGLE processes allowed to flush their tile simultaneously (0=unlimited). This is per computer. Some disks exhibit better performance when this is set to 1.")
+        ("synchronous-tile-flush", bpo::value< bool >(&synchronousTileFlush)->zero_tokens(), "Flush each BCL tile to disk before generating the next one. By default, a tile is flushed in the background while the next one is generated, which keeps up to two tiles in memory per thread")
+        ("bcl-block-size", bpo::value<unsigned long>(&bclBlockSize)->default_value(bclBlockSize), "Maximum number of clusters of a BCL tile kept in memory (0=whole tile). Larger tiles get appended to their per-cycle files by blocks of this many clusters, which bounds the memory used per tile regardless of its density")
         ("random-seed", bpo::value<unsigned int>(&randomSeed)->default_value(randomSeed), "Multiplier used to calculate the actual seeds used for the generation of mismatches for each read")
         ("generate-bam", bpo::value< bool >(&generateBam)->zero_tokens(), "Generates BAM file aligned on the reference genome")
         ("generate-sample-bam", bpo::value< bool >(&generateSampleBam)->zero_tokens(), "Generates BAM file aligned on the sample genome")
-        ("bam-region", bpo::value<std::string>(&bamRegion), "Bam region to generate (e.g. chr1 or chr1:1000-2000)")
+        ("bam-compression-level", bpo::value<int>(&bamCompressionLevel)->default_value(bamCompressionLevel), "Gzip compression level of the BAM output (0=none, 1=fastest, 9=best)")
+        ("bam-reorder-window-memory", bpo::value<unsigned long>(&bamReorderWindowMemory)->default_value(bamReorderWindowMemory), "Memory in MB used to hold the reverse reads of the BAM output until their position is reached (0=unlimited). Beyond this, they get spilled to sorted temporary files next to the BAM file and merged back when written")
+        ("sample-genome-cache-memory", bpo::value<unsigned long>(&sampleGenomeCacheMemory)->default_value(sampleGenomeCacheMemory), "Memory in MB used to keep the sample genome contigs that are not being read from (e.g. the other alleles of the current chromosome) loaded. Each contig is loaded once for all the alleles and threads; beyond this, the least recently used ones get unloaded")
+        ("fastq-compression-level", bpo::value<int>(&fastqCompressionLevel)->default_value(fastqCompressionLevel), "Gzip compression level of the FASTQ output, written as BGZF-compressed .fastq.gz files (-1=uncompressed .fastq files, 0=none, 1=fastest, 9=best)")
+        ("bam-region", bpo::value<std::string>(&bamRegion), "Bam region to generate (e.g. chr1 or chr1:1000-2000), or comma-separated list of chromosomes (e.g. chr1,chr2,chrX), generated in parallel by --threads workers and concatenated into a single indexed BAM file")
         ("drop-last-base", bpo::value< bool >(&dropLastBase)->zero_tokens(), "Don't include the last base of each read in BAM output (e.g. read length 101 becomes 100)")
         ("error-model-options", bpo::value< std::vector< std::string > >(&errorModelOptions), "Used to initialise an error model plugin. value should be plugin-name:key=value:key=value:etc.\nDefault values:\n LONGREAD-deletion:prob=0.0:dist-file=filename\n LONGREAD-base-duplication:prob=0.0")
 //        ("bin-num", bpo::value<unsigned int>(&binNum)->default_value(binNum), "Bin number to generate")
@@ -105,10 +135,75 @@ void SequencerSimulatorOptions::postProcess(bpo::variables_map &vm)
                           ("run-info")
                           ("sample-genome-dir")
                           ("fragments-dir")
-                          ("quality-table")
                           );
+    if (vm.count("compiled-error-model"))
+    {
+        const std::vector<std::string> tableOptions = boost::assign::list_of("quality-table")("mismatch-table")("homopolymer-indel-table")("motif-quality-drop-table")("qq-table");
+        BOOST_FOREACH( const std::string& tableOption, tableOptions )
+        {
+            if (vm.count(tableOption))
+            {
+                const boost::format message = boost::format("\n   *** '%s' cannot be used with 'compiled-error-model', which already contains all the tables ***\n") % tableOption;
+                BOOST_THROW_EXCEPTION(eagle::common::InvalidOptionException(message.str()));
+            }
+        }
+    }
+    else
+    {
+        check.requiredOptions(boost::assign::list_of
+                              ("quality-table")
+                              );
+    }
+
+    if      (bclFormatStr == "bcl"   ) { bclFormat = eagle::io::BCL_FORMAT_BCL; }
+    else if (bclFormatStr == "bcl.gz") { bclFormat = eagle::io::BCL_FORMAT_BCL_GZ; }
+    else if (bclFormatStr == "cbcl"  ) { bclFormat = eagle::io::BCL_FORMAT_CBCL; }
+    else
+    {
+        const boost::format message = boost::format("\n   *** Invalid value for 'bcl-format': %s (possible values are bcl, bcl.gz and cbcl) ***\n") % bclFormatStr;
+        BOOST_THROW_EXCEPTION(eagle::common::InvalidOptionException(message.str()));
+    }
+    if (mode == "generate-bcl-tile" && bclFormat == eagle::io::BCL_FORMAT_CBCL && !vm.count("tiles"))
+    {
+        const boost::format message = boost::format("\n   *** 'bcl-format=cbcl' requires 'tiles=all', as each CBCL file contains all the tiles of a lane surface ***\n");
+        BOOST_THROW_EXCEPTION(eagle::common::InvalidOptionException(message.str()));
+    }
 
-    if (mode == "generate-bcl-tile" || mode == "generate-fastq-tile")
+    if ((mode == "generate-bcl-tile" || mode == "generate-fastq-tile") && vm.count("tiles"))
+    {
+        using eagle::common::InvalidOptionException;
+        if (tiles != "all")
+        {
+            const boost::format message = boost::format("\n   *** Invalid value for 'tiles': %s (only 'all' is supported) ***\n") % tiles;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+        allTiles = true;
+        check.requiredOptions(boost::assign::list_of
+                              ("tile-ids")
+                              );
+        check.inRange<unsigned int>(std::make_pair(threads,"threads"),1);  // 1 <= threads < inf
+
+        std::vector< std::string > tileIdTokens;
+        boost::split( tileIdTokens, tileIdList, boost::is_any_of(",") );
+        BOOST_FOREACH( const std::string& token, tileIdTokens )
+        {
+            try
+            {
+                tileIds.push_back( boost::lexical_cast<unsigned int>( token ) );
+            }
+            catch (const boost::bad_lexical_cast &)
+            {
+                const boost::format message = boost::format("\n   *** Invalid tile id in 'tile-ids': '%s' ***\n") % token;
+                BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+            }
+        }
+        if (tileIds.size() != tilesPerLane)
+        {
+            const boost::format message = boost::format("\n   *** 'tile-ids' contains %d tile ids, but 'tiles-per-lane' is %d ***\n") % tileIds.size() % tilesPerLane;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+    else if (mode == "generate-bcl-tile" || mode == "generate-fastq-tile")
     {
         check.requiredOptions(boost::assign::list_of
                               ("lane")
@@ -122,6 +217,7 @@ void SequencerSimulatorOptions::postProcess(bpo::variables_map &vm)
                               ("output-filename")
                               ("bam-region")
                               );
+        boost::split( bamChromosomes, bamRegion, boost::is_any_of(",") );
     }
     else // if (mode == "generate-sample-bam")
     {
@@ -129,6 +225,17 @@ void SequencerSimulatorOptions::postProcess(bpo::variables_map &vm)
                               ("output-filename")
                               );
     }
+
+    if (mode == "generate-fastq-tile")
+    {
+        check.inRange<int>(std::make_pair(fastqCompressionLevel,"fastq-compression-level"),-1,10);  // -1 <= level < 10
+    }
+
+    if (mode == "generate-bam" || mode == "generate-sample-bam")
+    {
+        check.inRange<unsigned int>(std::make_pair(threads,"threads"),1);  // 1 <= threads < inf
+        check.inRange<int>(std::make_pair(bamCompressionLevel,"bam-compression-level"),0,10);  // 0 <= level < 10
+    }
 }
 
 } //namespace main
@@ -17,6 +17,7 @@
 #include <boost/filesystem.hpp>
 
 #include "common/Program.hh"
+#include "io/Bcl.hh"
 
 namespace eagle
 {
@@ -35,6 +36,8 @@ private:
 
 public:
     bool generateBclTile;
+    std::string bclFormatStr;
+    eagle::io::BclFormat bclFormat;
     bool generateFastqTile;
     bool generateBam;
     bool generateSampleBam;
@@ -46,6 +49,7 @@ public:
     boost::filesystem::path homopolymerIndelTableFile;
     boost::filesystem::path motifQualityDropTableFile;
     boost::filesystem::path qqTableFile;
+    boost::filesystem::path compiledErrorModelFile;
     boost::filesystem::path outDir;
     boost::filesystem::path outFilename;
     unsigned int readCount;
@@ -56,9 +60,21 @@ public:
     unsigned int lane;
     unsigned int tileNum;
     unsigned int tileId;
+    std::string tiles;
+    bool allTiles;
+    std::string tileIdList;
+    std::vector< unsigned int > tileIds;
+    unsigned int threads;
+    int bamCompressionLevel;
+    unsigned long bamReorderWindowMemory;
+    unsigned long sampleGenomeCacheMemory;
+    int fastqCompressionLevel;
     unsigned int maxConcurrentWriters;
+    bool synchronousTileFlush;
+    unsigned long bclBlockSize;
     unsigned int randomSeed;
     std::string bamRegion;
+    std::vector< std::string > bamChromosomes;
     bool dropLastBase;
     std::vector< std::string > errorModelOptions;
 };
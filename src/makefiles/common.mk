@@ -34,6 +34,8 @@ ALLOCATE_FRAGMENTS := $(EAGLE_BINDIR)/allocateFragments
 CREATE_RUN_FOLDER  := $(EAGLE_BINDIR)/createRunFolder
 SIMULATE_SEQUENCER := $(EAGLE_LIBEXECDIR)/simulateSequencer
 CANONICAL2SEGMENTS := $(EAGLE_LIBEXECDIR)/canonical2segments
+PACK_FASTA         := $(EAGLE_LIBEXECDIR)/packFasta
+COMPILE_ERROR_MODEL := $(EAGLE_LIBEXECDIR)/compileErrorModel
 
 #Index = $(shell echo "$(2)" | sed -r -e "s/[ \t]+/\n/g" | grep -n $(1) | cut -d ':' -f 1)
 
@@ -37,6 +37,32 @@ endif
 ifneq (,$(GC_COVERAGE_FIT_TABLE))
 GC_COVERAGE_FIT_TABLE_OPTION = --gc-coverage-fit-table=$(GC_COVERAGE_FIT_TABLE)
 endif
+ifneq (,$(SIMULATE_SEQUENCER_THREADS))
+SIMULATE_SEQUENCER_THREADS_OPTION = --threads=$(SIMULATE_SEQUENCER_THREADS)
+endif
+# bcl, bcl.gz or cbcl (cbcl is only available with the all-tiles target)
+ifneq (,$(BCL_FORMAT))
+BCL_FORMAT_OPTION = --bcl-format=$(BCL_FORMAT)
+endif
+# A CBCL file holds all the tiles of a lane surface, which the tile-by-tile rules can't write
+ifeq (cbcl,$(BCL_FORMAT))
+TILE_BCL_FORMAT_OPTION = $(error BCL_FORMAT=cbcl needs all the tiles in a single run: use the 'all-tiles' target)
+else
+TILE_BCL_FORMAT_OPTION = $(BCL_FORMAT_OPTION)
+endif
+# When set, the error model tables are compiled once into COMPILED_ERROR_MODEL_FILE (see compileErrorModel),
+# which every simulateSequencer process then maps instead of parsing the tables again
+ifneq (,$(COMPILED_ERROR_MODEL))
+COMPILED_ERROR_MODEL_FILE = $(EAGLE_OUTDIR)/errorModel.compiled
+ERROR_MODEL_TABLES_OPTION = --compiled-error-model=$(COMPILED_ERROR_MODEL_FILE)
+else
+ERROR_MODEL_TABLES_OPTION = $(QUALITY_TABLE:%=--quality-table=%) $(QQ_TABLE_OPTION) $(MISMATCH_TABLE_OPTION) \
+                            $(HOMOPOLYMER_INDEL_TABLE_OPTION) $(MOTIF_QUALITY_DROP_TABLE_OPTION)
+endif
+# Compressed .fastq.gz output when set (1=fastest, 9=best)
+ifneq (,$(FASTQ_COMPRESSION_LEVEL))
+FASTQ_COMPRESSION_LEVEL_OPTION = --fastq-compression-level=$(FASTQ_COMPRESSION_LEVEL)
+endif
 
 CHROMOSOME_ALLELES_FORWARD_AND_REVERSE = $(CHROMOSOME_ALLELES) $(CHROMOSOME_ALLELES:%=%_rev) 
 
@@ -50,6 +76,38 @@ TileCount := $(shell dc -e "$(words $(TILES)) $(words $(LANES)) *p")
 sge: $(foreach lane,$(LANES),$(foreach tile,$(TILES), \
      $(EAGLE_OUTDIR)/sge/$(shell printf "L%03i" $(lane))_$(tile).bcl.completed ))
 
+# Same output as 'all', generated by a single process: the models are only loaded once and the tiles are
+# shared between SIMULATE_SEQUENCER_THREADS threads
+.PHONY: all-tiles
+all-tiles: $(EAGLE_OUTDIR)/.all-tiles.bcl.completed
+$(EAGLE_OUTDIR)/.all-tiles.bcl.completed: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done $(COMPILED_ERROR_MODEL_FILE)
+	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-bcl-tile \
+	        --run-info=$< \
+	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
+	        $(ERROR_MODEL_TABLES_OPTION) \
+	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
+	        --fragments-dir="$(dir $(word 2,$^))" \
+	        --output-dir="$(dir $<)" \
+	        --lane-count=$(words $(LANES)) \
+	        --tiles-per-lane=$(words $(TILES)) \
+	        --tiles=all --tile-ids="$(subst $(SPACE),$(COMMA),$(TILES))" \
+	        $(SIMULATE_SEQUENCER_THREADS_OPTION) \
+	        $(BCL_FORMAT_OPTION) \
+	        $(RANDOM_SEED_OPTION) \
+	        $(SEQUENCER_SIMULATOR_OPTIONS) \
+	$(AND) $(TOUCH) $@
+
+.PHONY: compiled-error-model
+compiled-error-model: $(COMPILED_ERROR_MODEL_FILE)
+$(EAGLE_OUTDIR)/errorModel.compiled: $(QUALITY_TABLE) $(QQ_TABLE) $(MISMATCH_TABLE) $(HOMOPOLYMER_INDEL_TABLE) $(MOTIF_QUALITY_DROP_TABLE)
+	$(TIME) $(COMPILE_ERROR_MODEL) --force \
+	        $(QUALITY_TABLE:%=--quality-table=%) \
+	        $(QQ_TABLE_OPTION) \
+	        $(MISMATCH_TABLE_OPTION) \
+	        $(HOMOPOLYMER_INDEL_TABLE_OPTION) \
+	        $(MOTIF_QUALITY_DROP_TABLE_OPTION) \
+	        --output-file=$@
+
 .PHONY: print-output-contig-names
 print-output-contig-names: $(REFERENCE_GENOME)
 	( $(TIME) $(APPLY_VARIANTS) --only-print-output-contig-names $(EAGLE_FORCE) \
@@ -71,6 +129,7 @@ $(EAGLE_OUTDIR)/$(SAMPLE_GENOME)/genome_size.xml: $(REFERENCE_GENOME)
 	  --sample-genome=$(dir $@) \
 	  --annotated-variant-list=$(dir $@)/canonical.vcf \
 	  $(GENOME_MUTATOR_OPTIONS) \
+	  $(AND) $(TIME) $(PACK_FASTA) --force $(dir $@) \
 	) &> $(EAGLE_OUTDIR)/$(SAMPLE_GENOME).$(notdir $(APPLY_VARIANTS)).log
 
 .PRECIOUS: $(EAGLE_OUTDIR)/$(SAMPLE_GENOME).$(notdir $(ALLOCATE_FRAGMENTS)).log
@@ -139,26 +198,30 @@ $(EAGLE_OUTDIR)/$(SAMPLE_GENOME)/segmentsFromRef.tsv: $(EAGLE_OUTDIR)/$(SAMPLE_G
 .PHONY: bam bams
 bam: eagle.bam.bai
 
-eagle.bam.bai: eagle.bam
-	$(TIME) $(SAMTOOLS) index eagle.bam
+eagle.bam.bai: eagle.bam ;
 
-eagle.bam: $(foreach bamChr, $(BAM_CHROMOSOMES), $(subst $(PIPE),$(BACKSLASHED_PIPE),eagle_$(bamChr).bam))
-ifeq (1,$(words $(BAM_CHROMOSOMES)))
-	cp "$^" $@
-else
-	$(SAMTOOLS) view -H "eagle_$(word 1,${BAM_CHROMOSOMES}).bam" | tr -d '\0' | grep --text SN | sed 's/.*\tSN:\(.*\)\t.*/eagle_\1.bam/' | xargs ls -f 2> /dev/null | xargs $(TIME) $(SAMTOOLS) cat -o eagle.bam
-endif
-#	$(TIME) $(SAMTOOLS) cat -o eagle.bam $^
+# All the chromosomes in a single run: simulateSequencer writes them in parallel and concatenates them along with their index
+eagle.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done $(EAGLE_OUTDIR)/sample_genome/segmentsFromRef.tsv $(COMPILED_ERROR_MODEL_FILE)
+	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-bam \
+	        --run-info=$< \
+	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
+	        $(ERROR_MODEL_TABLES_OPTION) \
+	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
+	        --fragments-dir="$(EAGLE_OUTDIR)/fragments" \
+	        --output-dir="$(EAGLE_OUTDIR)" \
+	        --output-filename=eagle.bam \
+	        --lane-count=$(words $(LANES)) \
+	        --tiles-per-lane=$(words $(TILES)) \
+	        $(RANDOM_SEED_OPTION) \
+	        $(SIMULATE_SEQUENCER_THREADS_OPTION) \
+	        $(SEQUENCER_SIMULATOR_OPTIONS) \
+			--bam-region="$(subst $(SPACE),$(COMMA),$(BAM_CHROMOSOMES))"
 
-eagle_%.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done $(EAGLE_OUTDIR)/sample_genome/segmentsFromRef.tsv
+eagle_%.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done $(EAGLE_OUTDIR)/sample_genome/segmentsFromRef.tsv $(COMPILED_ERROR_MODEL_FILE)
 	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-bam \
 	        --run-info=$< \
 	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
-	        $(QUALITY_TABLE:%=--quality-table=%) \
-	        $(QQ_TABLE_OPTION) \
-	        $(MISMATCH_TABLE_OPTION) \
-	        $(HOMOPOLYMER_INDEL_TABLE_OPTION) \
-	        $(MOTIF_QUALITY_DROP_TABLE_OPTION) \
+	        $(ERROR_MODEL_TABLES_OPTION) \
 	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
 	        --fragments-dir="$(EAGLE_OUTDIR)/fragments" \
 	        --output-dir="$(EAGLE_OUTDIR)" \
@@ -166,20 +229,17 @@ eagle_%.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments
 	        --lane-count=$(words $(LANES)) \
 	        --tiles-per-lane=$(words $(TILES)) \
 	        $(RANDOM_SEED_OPTION) \
+	        $(SIMULATE_SEQUENCER_THREADS_OPTION) \
 	        $(SEQUENCER_SIMULATOR_OPTIONS) \
 			--bam-region="$*"
 
 .PHONY: sample-bam
 sample-bam: eagle.sample.bam
-eagle.sample.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done
+eagle.sample.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done $(COMPILED_ERROR_MODEL_FILE)
 	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-sample-bam \
 	        --run-info=$< \
 	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
-	        $(QUALITY_TABLE:%=--quality-table=%) \
-	        $(QQ_TABLE_OPTION) \
-	        $(MISMATCH_TABLE_OPTION) \
-	        $(HOMOPOLYMER_INDEL_TABLE_OPTION) \
-	        $(MOTIF_QUALITY_DROP_TABLE_OPTION) \
+	        $(ERROR_MODEL_TABLES_OPTION) \
 	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
 	        --fragments-dir="$(EAGLE_OUTDIR)/fragments" \
 	        --output-dir="$(EAGLE_OUTDIR)" \
@@ -187,9 +247,31 @@ eagle.sample.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/frag
 	        --lane-count=$(words $(LANES)) \
 	        --tiles-per-lane=$(words $(TILES)) \
 	        $(RANDOM_SEED_OPTION) \
+	        $(SIMULATE_SEQUENCER_THREADS_OPTION) \
 	        $(SEQUENCER_SIMULATOR_OPTIONS)
 
 
 .PHONY: fastq
 fastq: $(foreach lane,$(LANES),$(foreach tile,$(TILES), \
        $(EAGLE_OUTDIR)/.$(shell printf "L%03i" $(lane))_$(tile).fastq.completed ))
+
+# Same output as 'fastq', generated by a single process whose tiles are shared between SIMULATE_SEQUENCER_THREADS threads.
+# The tile-by-tile rules run one process per tile in parallel already, and don't get the threads option
+.PHONY: fastq-all-tiles
+fastq-all-tiles: $(EAGLE_OUTDIR)/.all-tiles.fastq.completed
+$(EAGLE_OUTDIR)/.all-tiles.fastq.completed: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments/fragments.done $(COMPILED_ERROR_MODEL_FILE)
+	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-fastq-tile \
+	        --run-info=$< \
+	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
+	        $(ERROR_MODEL_TABLES_OPTION) \
+	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
+	        --fragments-dir="$(dir $(word 2,$^))" \
+	        --output-dir="$(dir $<)" \
+	        --lane-count=$(words $(LANES)) \
+	        --tiles-per-lane=$(words $(TILES)) \
+	        --tiles=all --tile-ids="$(subst $(SPACE),$(COMMA),$(TILES))" \
+	        $(FASTQ_COMPRESSION_LEVEL_OPTION) \
+	        $(SIMULATE_SEQUENCER_THREADS_OPTION) \
+	        $(RANDOM_SEED_OPTION) \
+	        $(SEQUENCER_SIMULATOR_OPTIONS) \
+	$(AND) $(TOUCH) $@
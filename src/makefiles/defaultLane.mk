@@ -28,11 +28,7 @@ $(EAGLE_OUTDIR)/.$(fmtLane)_%.bcl.completed:
 	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-bcl-tile \
 	        --run-info=$< \
 	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
-	        $(QUALITY_TABLE:%=--quality-table=%) \
-	        $(QQ_TABLE_OPTION) \
-	        $(MISMATCH_TABLE_OPTION) \
-	        $(HOMOPOLYMER_INDEL_TABLE_OPTION) \
-	        $(MOTIF_QUALITY_DROP_TABLE_OPTION) \
+	        $(ERROR_MODEL_TABLES_OPTION) \
 	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
 	        --fragments-dir="$(dir $(word 2,$^))" \
 	        --output-dir="$(dir $<)" \
@@ -40,6 +36,7 @@ $(EAGLE_OUTDIR)/.$(fmtLane)_%.bcl.completed:
 	        --tiles-per-lane=$(words $(TILES)) \
 	        --lane=$(@:$(EAGLE_OUTDIR)/.L00%_$(*).bcl.completed=%) \
 	        --tile-num=$(tile.$*) --tile-id=$* \
+	        $(TILE_BCL_FORMAT_OPTION) \
 	        $(RANDOM_SEED_OPTION) \
 	        $(SEQUENCER_SIMULATOR_OPTIONS) \
 	$(AND) $(TOUCH) $@
@@ -53,10 +50,12 @@ $(EAGLE_OUTDIR)/sge/$(fmtLane)_%.bcl.completed:
 
 # Explicit rule for all tiles in a lane:
 $(foreach t,$(TILES), $(EAGLE_OUTDIR)/.$(fmtLane)_$(t).bcl.completed): $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml \
-                                                                       $(EAGLE_OUTDIR)/fragments/fragments.done
+                                                                       $(EAGLE_OUTDIR)/fragments/fragments.done \
+                                                                       $(COMPILED_ERROR_MODEL_FILE)
 
 $(foreach t,$(TILES), $(EAGLE_OUTDIR)/sge/$(fmtLane)_$(t).bcl.completed): $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml \
                                                                           $(EAGLE_OUTDIR)/fragments/fragments.done \
+                                                                          $(COMPILED_ERROR_MODEL_FILE) \
                                                                           $(EAGLE_OUTDIR)/sge/.sentinel
 
 
@@ -65,11 +64,7 @@ $(EAGLE_OUTDIR)/.$(fmtLane)_%.fastq.completed:
 	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-fastq-tile \
 	        --run-info=$< \
 	        --sample-genome-dir="$(EAGLE_OUTDIR)/$(SAMPLE_GENOME)" \
-	        $(QUALITY_TABLE:%=--quality-table=%) \
-	        $(QQ_TABLE_OPTION) \
-	        $(MISMATCH_TABLE_OPTION) \
-	        $(HOMOPOLYMER_INDEL_TABLE_OPTION) \
-	        $(MOTIF_QUALITY_DROP_TABLE_OPTION) \
+	        $(ERROR_MODEL_TABLES_OPTION) \
 	        $(ERROR_MODEL_OPTIONS:%=--error-model-options=%) \
 	        --fragments-dir="$(dir $(word 2,$^))" \
 	        --output-dir="$(dir $<)" \
@@ -77,9 +72,11 @@ $(EAGLE_OUTDIR)/.$(fmtLane)_%.fastq.completed:
 	        --tiles-per-lane=$(words $(TILES)) \
 	        --lane=$(@:$(EAGLE_OUTDIR)/.L00%_$(*).fastq.completed=%) \
 	        --tile-num=$(tile.$*) --tile-id=$* \
+	        $(FASTQ_COMPRESSION_LEVEL_OPTION) \
 	        $(RANDOM_SEED_OPTION) \
 	        $(SEQUENCER_SIMULATOR_OPTIONS) \
 	$(AND) $(TOUCH) $@
 
 $(foreach t,$(TILES), $(EAGLE_OUTDIR)/.$(fmtLane)_$(t).fastq.completed): $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml \
-                                                                         $(EAGLE_OUTDIR)/fragments/fragments.done
+                                                                         $(EAGLE_OUTDIR)/fragments/fragments.done \
+                                                                         $(COMPILED_ERROR_MODEL_FILE)
@@ -69,8 +69,8 @@ $(EAGLE_OUTDIR)/$(SAMPLE_GENOME)/sample_complete.txt: $(EAGLE_OUTDIR)/$(SAMPLE_G
 .PRECIOUS: $(EAGLE_OUTDIR)/$(SAMPLE_GENOME).$(notdir $(ALLOCATE_FRAGMENTS)).log
 .PHONY: fragments $(notdir $(ALLOCATE_FRAGMENTS))
 fragments: $(notdir $(ALLOCATE_FRAGMENTS))
-$(notdir $(ALLOCATE_FRAGMENTS)): $(EAGLE_OUTDIR)/fragments.pos
-$(EAGLE_OUTDIR)/fragments.pos: sample
+$(notdir $(ALLOCATE_FRAGMENTS)): $(EAGLE_OUTDIR)/fragments.blocks
+$(EAGLE_OUTDIR)/fragments.blocks: sample
 	( $(TIME) $(ALLOCATE_FRAGMENTS) $(EAGLE_FORCE) \
 	  --sample-genome-dir=$(EAGLE_OUTDIR)/$(SAMPLE_GENOME) \
 	  --output-dir=$(dir $@) \
@@ -90,7 +90,7 @@ include $(foreach ln, $(LANES), $(MAKEFILES_DIR)/defaultLane.mk)
 
 .PHONY: bam
 bam: test.bam
-test.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments.pos
+test.bam: $(EAGLE_OUTDIR)/$(RUN_FOLDER)/RunInfo.xml $(EAGLE_OUTDIR)/fragments.blocks
 	$(TIME) $(SIMULATE_SEQUENCER) $(EAGLE_FORCE) --generate-bam \
 	        --run-info=$< \
 	        --sample-genome-dir=$(EAGLE_OUTDIR)/$(SAMPLE_GENOME) \
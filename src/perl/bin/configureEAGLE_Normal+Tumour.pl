@@ -386,29 +386,29 @@ else {
 }
 
 print $makefileHandle "\n# Simulate tumour purity sub-datasets\n";
-print $makefileHandle "tumour_normal_sim: ${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.pos\n";
-print $makefileHandle "${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.pos: ${tumourDir}/EAGLE_normalForPurityMix/Makefile\n";
+print $makefileHandle "tumour_normal_sim: ${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.done\n";
+print $makefileHandle "${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.done: ${tumourDir}/EAGLE_normalForPurityMix/Makefile\n";
 #print $makefileHandle "\t\$(MAKE) -C ${tumourDir}/EAGLE_normalForPurityMix fragments\n";
 print $makefileHandle "\tcd ${tumourDir}/EAGLE_normalForPurityMix \\\n";
   print $makefileHandle "\t\$(AND) time ${QSUB_PREFIX_GENOME_MUTATOR}\${MAKE} -C ${tumourDir}/EAGLE_normalForPurityMix fragments${QSUB_SUFFIX}\n";
 
 print $makefileHandle "\n";
-print $makefileHandle "tumour_tumour_sim: ${tumourDir}/EAGLE_tumourForPurityMix/fragments/fragments.pos\n";
-print $makefileHandle "${tumourDir}/EAGLE_tumourForPurityMix/fragments/fragments.pos: ${tumourDir}/EAGLE_tumourForPurityMix/Makefile\n";
+print $makefileHandle "tumour_tumour_sim: ${tumourDir}/EAGLE_tumourForPurityMix/fragments/fragments.done\n";
+print $makefileHandle "${tumourDir}/EAGLE_tumourForPurityMix/fragments/fragments.done: ${tumourDir}/EAGLE_tumourForPurityMix/Makefile\n";
 #print $makefileHandle "\t\$(MAKE) -C ${tumourDir}/EAGLE_tumourForPurityMix fragments\n";
 print $makefileHandle "\tcd ${tumourDir}/EAGLE_tumourForPurityMix \\\n";
 print $makefileHandle "\t\$(AND) time ${QSUB_PREFIX_GENOME_MUTATOR}\${MAKE} -C ${tumourDir}/EAGLE_tumourForPurityMix fragments${QSUB_SUFFIX}\n";
 
 print $makefileHandle "\n# Merge tumour purity sub-datasets to ${tumourDir}\n";
-print $makefileHandle "tumour_merged: ${tumourDir}/fragments/fragments.pos\n";
-print $makefileHandle "${tumourDir}/fragments/fragments.pos: ${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.pos ${tumourDir}/EAGLE_tumourForPurityMix/fragments/fragments.pos\n";
+print $makefileHandle "tumour_merged: ${tumourDir}/fragments/fragments.done\n";
+print $makefileHandle "${tumourDir}/fragments/fragments.done: ${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.done ${tumourDir}/EAGLE_tumourForPurityMix/fragments/fragments.done\n";
 print $makefileHandle "\tcd ${tumourDir} \\\n";
 print $makefileHandle "\t\$(AND) $EAGLE_LIBEXEC/mergeSampleGenomes.pl -i EAGLE_normalForPurityMix -j EAGLE_tumourForPurityMix \\\n";
 print $makefileHandle "\t\$(AND) $EAGLE_LIBEXEC/mergeFragments.pl -i EAGLE_normalForPurityMix -j EAGLE_tumourForPurityMix -a \"`grep CHROMOSOME_ALLELES Makefile | cut -d ' ' -f 3-`\"\n";
 
 print $makefileHandle "\n# Prepare normal\n";
 print $makefileHandle "normal_prep: ${normalDir}/Makefile\n";
-print $makefileHandle "${normalDir}/Makefile: ${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.pos\n";
+print $makefileHandle "${normalDir}/Makefile: ${tumourDir}/EAGLE_normalForPurityMix/fragments/fragments.done\n";
 print $makefileHandle "\t${programPath}/configureEAGLE.pl ${commonOptions} ${prefixedSharedVariants} --genome-mutator-options=\"--prefix=normal_\" --coverage-depth=" . ${normalCoverage}/2 . " ${normalDir} \\\n";
 print $makefileHandle "\t\$(AND) rm -rf ${normalDir}/reference_genome \\\n";
 print $makefileHandle "\t\$(AND) ln -s ${tumourDir}/EAGLE_normalForPurityMix/reference_genome ${normalDir}/reference_genome \\\n";
@@ -416,7 +416,7 @@ print $makefileHandle "\t\$(AND) ln -s ${tumourDir}/EAGLE_normalForPurityMix/sam
 
 print $makefileHandle "\n# Simulate tumour\n";
 print $makefileHandle "tumour: ${tumourDir}/RunFolder/RunInfo.xml\n";
-print $makefileHandle "${tumourDir}/RunFolder/RunInfo.xml: ${tumourDir}/fragments/fragments.pos\n";
+print $makefileHandle "${tumourDir}/RunFolder/RunInfo.xml: ${tumourDir}/fragments/fragments.done\n";
 print $makefileHandle "\t\$(MAKE) -C ${tumourDir} ${SGE_STRING}\n";
 
 print $makefileHandle "\n# Simulate normal\n";
@@ -0,0 +1,210 @@
+#!/usr/bin/env perl
+
+=head1 LICENSE
+
+Copyright (c) 2014 Illumina, Inc.
+
+This file is part of Illumina's Enhanced Artificial Genome Engine (EAGLE),
+covered by the "BSD 2-Clause License" (see accompanying LICENSE file)
+
+=head1 NAME
+
+dumpFragments.pl
+
+=head1 DESCRIPTION
+
+Prints one line per fragment: global start position, length and zero-based tile number, tab-separated.
+Follows fragments.manifest when present (virtual merge of other fragment directories),
+otherwise reads fragments.blocks when present, otherwise fragments.{pos,length,tile}.
+
+=head1 DIAGNOSTICS
+
+=head2 Exit status
+
+0: successful completion
+1: abnormal completion
+2: fatal error
+
+=head2 Errors
+
+All error messages are prefixed with "ERROR: ".
+
+=head1 AUTHOR
+
+Lilian Janin
+
+=cut
+
+use warnings FATAL => 'all';
+use strict;
+use Cwd qw(abs_path);
+use File::Spec;
+use Compress::Zlib;
+
+use Getopt::Long;
+
+
+my $VERSION = '@EAGLE_VERSION_FULL@';
+
+my $programName = (File::Spec->splitpath(abs_path($0)))[2];
+my $Version_text =
+    "$programName $VERSION\n"
+  . "Copyright (c) 2014 Illumina, Inc.\n";
+
+my $usage =
+    "Usage: $programName [options]\n"
+  . "\t-d, --fragments-dir=PATH     - directory containing the fragments.* files (default: current directory)\n"
+
+  . "\t--help                       - prints usage guide\n"
+  . "\t--version                    - prints version information\n";
+
+my $help             = 0;
+my $isVersion        = 0;
+my $dir              = ".";
+
+my $result = GetOptions(
+    "fragments-dir|d=s"     => \$dir,
+
+    "version"               => \$isVersion,
+    "help"                  => \$help
+);
+
+if ($isVersion) {
+    print $Version_text;
+    exit(0);
+}
+if ($result == 0 || $help) {
+    die "$usage";
+}
+die("ERROR: Unrecognized command-line argument(s): @ARGV")  if (0 < @ARGV);
+
+
+sub readBytes {
+  my ($handle, $byteCount, $filename) = @_;
+  my $bytes = "";
+  (read( $handle, $bytes, $byteCount ) == $byteCount) or die "ERROR: $filename is truncated";
+  return $bytes;
+}
+
+# Unsigned LEB128 varints, as written by FragmentBlockWriter
+sub decodeVarints {
+  my ($payload, $count, $posRef) = @_;
+  my @values = ();
+  for (my $i=0; $i<$count; ++$i) {
+    my $value = 0;
+    my $shift = 0;
+    while (1) {
+      ($$posRef < length( $payload )) or die "ERROR: truncated block payload";
+      my $byte = ord( substr( $payload, $$posRef++, 1 ) );
+      $value |= ($byte & 0x7F) << $shift;
+      last if ($byte < 0x80);
+      $shift += 7;
+    }
+    push @values, $value;
+  }
+  return @values;
+}
+
+dumpFragments( $dir, 0 );
+
+
+# Positions are shifted by $posOffset, as required by the fragments.manifest files that list this directory
+sub dumpFragments {
+  my ($dir, $posOffset) = @_;
+  if (-e "$dir/fragments.manifest") {
+    dumpFragmentManifest( $dir, $posOffset );
+  }
+  elsif (-e "$dir/fragments.blocks") {
+    dumpFragmentBlocks( $dir, $posOffset );
+  }
+  else {
+    dumpLegacyFragmentFiles( $dir, $posOffset );
+  }
+}
+
+# fragments.manifest (see include/model/Fragment.hh): one "directory, global position offset, fragment count" line per listed directory
+sub dumpFragmentManifest {
+  my ($dir, $posOffset) = @_;
+  my $filename = "$dir/fragments.manifest";
+  open my $in, "<", $filename or die "ERROR: Can't open $filename";
+  my $header = <$in>;
+  (defined $header && $header =~ /^#EAGLE fragments manifest v1$/) or die "ERROR: $filename is not a version 1 fragments manifest";
+  while (my $line = <$in>) {
+    chomp $line;
+    next if ($line eq "" || $line =~ /^#/);
+    my ($entryDir, $entryPosOffset) = split( /\t/, $line );
+    (defined $entryPosOffset) or die "ERROR: $filename: invalid entry \"$line\"";
+    $entryDir = "$dir/$entryDir" if ($entryDir !~ m{^/});
+    dumpFragments( $entryDir, $posOffset + $entryPosOffset );
+  }
+  close $in;
+}
+
+# fragments.blocks v2 (see include/model/Fragment.hh): each group of consecutive fragments is stored as one block per tile,
+# so the records of a group's blocks get merged back by fragment number
+sub dumpFragmentBlocks {
+  my ($dir, $posOffset) = @_;
+  my $filename = "$dir/fragments.blocks";
+  open my $in, "<", $filename or die "ERROR: Can't open $filename";
+  binmode $in;
+  my $fileHeader = readBytes( $in, 32, $filename );
+  my (undef, $version, $tileCount, undef) = unpack( 'Q4', $fileHeader );
+  (substr( $fileHeader, 0, 8 ) eq "EFRAGBLK" && $version == 2) or die "ERROR: $filename is not a version 2 fragment block file";
+
+  seek( $in, -8, 2 );
+  my $footerOffset = unpack( 'Q', readBytes( $in, 8, $filename ) );
+  seek( $in, $footerOffset, 0 );
+  my $blockCount = unpack( 'Q', readBytes( $in, 8, $filename ) );
+  my @blockOffsets = unpack( "Q$blockCount", readBytes( $in, 8 * $blockCount, $filename ) );
+
+  my $groupFirstFragmentNum = -1;
+  my @groupLines = ();
+  foreach my $blockOffset (@blockOffsets) {
+    seek( $in, $blockOffset, 0 );
+    my ($firstFragmentNum, $minPos, undef, $tile, $recordCount, undef, $payloadSize, $compressedSize, $checksum) = unpack( 'Q3L6', readBytes( $in, 48, $filename ) );
+    my $payload = uncompress( readBytes( $in, $compressedSize, $filename ) );
+    (defined $payload && length( $payload ) == $payloadSize && crc32( $payload ) == $checksum) or die "ERROR: $filename: corrupted block at offset $blockOffset";
+
+    if ($firstFragmentNum != $groupFirstFragmentNum) {
+      print @groupLines;
+      @groupLines = ();
+      $groupFirstFragmentNum = $firstFragmentNum;
+    }
+    my $payloadPos = 0;
+    my @rankDiffs = decodeVarints( $payload, $recordCount, \$payloadPos );
+    my @posDiffs = decodeVarints( $payload, $recordCount, \$payloadPos );
+    my @lengths = decodeVarints( $payload, $recordCount, \$payloadPos );
+    my $rank = 0;
+    my $pos = $posOffset + $minPos;
+    for (my $i=0; $i<$recordCount; ++$i) {
+      $rank += $rankDiffs[$i];
+      $pos += $posDiffs[$i];
+      $groupLines[$rank] = "$pos\t$lengths[$i]\t$tile\n";
+    }
+  }
+  print @groupLines;
+  close $in;
+}
+
+sub dumpLegacyFragmentFiles {
+  my ($dir, $posOffset) = @_;
+  # Legacy format: 2 bytes per fragment in each file, except the position differences >= 65535,
+  # stored in fragments.pos as 65535 followed by the difference as 3 words, most significant first
+  open my $posFile, "<", "$dir/fragments.pos" or die "ERROR: Can't open $dir/fragments.pos";
+  open my $lengthFile, "<", "$dir/fragments.length" or die "ERROR: Can't open $dir/fragments.length";
+  open my $tileFile, "<", "$dir/fragments.tile" or die "ERROR: Can't open $dir/fragments.tile";
+  binmode $posFile;
+  binmode $lengthFile;
+  binmode $tileFile;
+  my $pos = $posOffset;
+  my ($word, $length, $tile);
+  while (read( $posFile, $word, 2 ) == 2 && read( $lengthFile, $length, 2 ) == 2 && read( $tileFile, $tile, 2 ) == 2) {
+    my $posDiff = unpack( 'S', $word );
+    if ($posDiff == 65535) {
+      my @words = unpack( 'S3', readBytes( $posFile, 6, "$dir/fragments.pos" ) );
+      $posDiff = ($words[0] << 32) | ($words[1] << 16) | $words[2];
+    }
+    $pos += $posDiff;
+    print "$pos\t" . unpack( 'S', $length ) . "\t" . unpack( 'S', $tile ) . "\n";
+  }
+}
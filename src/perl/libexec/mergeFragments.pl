@@ -118,18 +118,18 @@ die("ERROR: Unrecognized command-line argument(s): @ARGV")  if (0 < @ARGV);
 
 
 # Check that we won't overwrite any existing file
-(! -e "fragments/fragments.length") or die "fragments.* already exist in the current directory. Aborting.";
+(! -e "fragments/fragments.manifest" && ! -e "fragments/fragments.length" && ! -e "fragments/fragments.blocks") or die "fragments.* already exist in the current directory. Aborting.";
 system( "mkdir -p fragments" );
 
-# Merging fragments.length : simple concatenation
-system( "cat $PARAMS{dataset1}/fragments/fragments.length $PARAMS{dataset2}/fragments/fragments.length > fragments/fragments.length" );
-
-# Merging fragments.tile : simple concatenation
-system( "cat $PARAMS{dataset1}/fragments/fragments.tile $PARAMS{dataset2}/fragments/fragments.tile > fragments/fragments.tile" );
+my $dataset1Length = `grep totalBases $PARAMS{dataset1}/sample_genome/genome_size.xml |sed 's/.*totalBases="*//' | cut -d '"' -f 1 | awk 'BEGIN { sum=0 } { sum+=\$1 } END { print sum }'`;
+chomp $dataset1Length;
+print "Length of dataset 1: $dataset1Length\n";
 
 # Merging fragments.stats : sum of each int32
 my $myInt32_1 = "";
 my $myInt32_2 = "";
+my $fragmentCount1 = 0;
+my $fragmentCount2 = 0;
 open INF1, "<$PARAMS{dataset1}/fragments/fragments.stats" or die "Can't open $PARAMS{dataset1}/fragments/fragments.stats";
 open INF2, "<$PARAMS{dataset2}/fragments/fragments.stats" or die "Can't open $PARAMS{dataset2}/fragments/fragments.stats";
 open OUTF, ">fragments/fragments.stats" or die "Can't open fragments/fragments.stats for writing";
@@ -152,6 +152,8 @@ while ($dataAvailable)
     }
     if ($dataAvailable)
       {
+        $fragmentCount1 += $a;
+        $fragmentCount2 += $b;
         $a += $b;
         print OUTF pack('L',$a);
       }
@@ -160,47 +162,14 @@ close INF1;
 close INF2;
 close OUTF;
 
-# Merging fragments.pos : concatenation with adjustment of first value of second dataset
-my $finalPosInDataset1 = 0;
-open INF1, "<$PARAMS{dataset1}/fragments/fragments.pos" or die "Can't open $PARAMS{dataset1}/fragments/fragments.pos";
-binmode INF1;
-my $myInt16;
-while (read (INF1, $myInt16, 2))
-  {
-    my $offset = unpack('S',$myInt16);
-    #    print "offset=$offset\n";
-    ($offset < 65535) or die "TODO long offset";
-    $finalPosInDataset1 += $offset;
-  }
-close INF1;
-print "finalPosInDataset1 = $finalPosInDataset1 \n";
-my $dataset1Length = `grep totalBases $PARAMS{dataset1}/sample_genome/genome_size.xml |sed 's/.*totalBases="*//' | cut -d '"' -f 1 | awk 'BEGIN { sum=0 } { sum+=\$1 } END { print sum }'`;
-print "Length of dataset 1: $dataset1Length\n";
-system( "cp $PARAMS{dataset1}/fragments/fragments.pos fragments/fragments.pos" );
-open OUTF, ">>fragments/fragments.pos" or die "Can't open fragments/fragments.pos";
-binmode OUTF;
-my $offset = $dataset1Length - $finalPosInDataset1;
-
-open INF1, "<$PARAMS{dataset2}/fragments/fragments.pos" or die "Can't open $PARAMS{dataset2}/fragments/fragments.pos";
-binmode INF1;
-read (INF1, $myInt16, 2);
-my $val += unpack('S',$myInt16);
-($val < 65535) or die "TODO long offset";
-print "New offset=$offset\n";
-close INF1;
-$offset += $val;
-if ($offset < 65535) {
-  print OUTF pack('s',$offset);
-}
-else {
-  ($offset < 65536*65536*65536) or die "Oh noooo, the jump between the 2 datasets is too large!";
-  print OUTF pack( 's', 65535 );
-  print OUTF pack( 's', $offset >> 32 );
-  print OUTF pack( 's', ( $offset >> 16 ) & 0xFFFF );
-  print OUTF pack( 's', $offset & 0xFFFF );
-}
-
-system( "tail -c +3 $PARAMS{dataset2}/fragments/fragments.pos >> fragments/fragments.pos" );
+# Virtual merge: fragments.manifest (see include/model/Fragment.hh) lists the fragment directories of both datasets,
+# the positions of dataset2 being shifted by the length of dataset1. No fragment gets copied.
+open MANIFEST, ">fragments/fragments.manifest" or die "Can't open fragments/fragments.manifest for writing";
+print MANIFEST "#EAGLE fragments manifest v1\n";
+print MANIFEST "#directory\tglobalPosOffset\tfragmentCount\n";
+print MANIFEST manifestEntryDir( $PARAMS{dataset1} ) . "\t0\t$fragmentCount1\n";
+print MANIFEST manifestEntryDir( $PARAMS{dataset2} ) . "\t$dataset1Length\t$fragmentCount2\n";
+close MANIFEST or die "Failed to write fragments/fragments.manifest";
 
 system( "touch fragments/fragments.done" );
 
@@ -220,3 +189,10 @@ foreach my $allele (@alleles) {
 
 
 print "Fragments successfully merged\n";
+
+
+# Relative directories are relative to the manifest's directory, i.e. "fragments"
+sub manifestEntryDir {
+  my ($dataset) = @_;
+  return ($dataset =~ m{^/}) ? "$dataset/fragments" : "../$dataset/fragments";
+}